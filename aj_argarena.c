@@ -0,0 +1,278 @@
+/**
+ * @file
+ * @brief Request-scoped arena for MsgArg graphs and their backing data.
+ */
+#include <qcc/platform.h>
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aj_argarena.h"
+
+#define DEFAULT_BLOCK_SIZE  (16 * 1024)
+#define ARENA_ALIGN         16
+
+typedef struct _arena_block {
+    struct _arena_block* next;
+    size_t size;
+    size_t used;
+    /* data follows, ARENA_ALIGN aligned */
+} arena_block;
+
+typedef struct _arena_args {
+    struct _arena_args* next;
+    alljoyn_msgarg args;
+    size_t capacity;            /* elements created */
+    size_t used;                /* elements handed out this time */
+} arena_args;
+
+struct _aj_argarena_handle {
+    size_t blockSize;
+    arena_block* blocks;        /* current block first */
+    size_t nextBlockSize;       /* size of the merged block after a reset */
+    size_t bytesInUse;
+    size_t highWater;
+    uint32_t numBlocks;
+
+    arena_args* freeArgs;
+    arena_args* usedArgs;
+    uint32_t numArgArrays;
+    uint32_t argArraysReused;
+    uint32_t argArraysCreated;
+};
+
+static pthread_key_t s_threadKey;
+static pthread_once_t s_threadKeyOnce = PTHREAD_ONCE_INIT;
+
+#define BLOCK_HEADER ((sizeof(arena_block) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+static size_t align_up(size_t n)
+{
+    return (n + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+}
+
+static arena_block* new_block(aj_argarena arena, size_t minSize)
+{
+    size_t size = arena->nextBlockSize > arena->blockSize ? arena->nextBlockSize : arena->blockSize;
+    arena_block* block;
+
+    if (size < minSize) {
+        size = minSize;
+    }
+    block = (arena_block*) malloc(BLOCK_HEADER + size);
+    if (!block) {
+        return NULL;
+    }
+    block->size = size;
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->nextBlockSize = 0;
+    arena->numBlocks++;
+    return block;
+}
+
+aj_argarena aj_argarena_create(size_t blockSize)
+{
+    aj_argarena arena = (aj_argarena) calloc(1, sizeof(struct _aj_argarena_handle));
+
+    if (!arena) {
+        return NULL;
+    }
+    arena->blockSize = blockSize ? align_up(blockSize) : DEFAULT_BLOCK_SIZE;
+    return arena;
+}
+
+static void destroy_args(arena_args* list)
+{
+    while (list) {
+        arena_args* next = list->next;
+        alljoyn_msgarg_destroy(list->args);
+        free(list);
+        list = next;
+    }
+}
+
+void aj_argarena_destroy(aj_argarena arena)
+{
+    if (!arena) {
+        return;
+    }
+    destroy_args(arena->freeArgs);
+    destroy_args(arena->usedArgs);
+    while (arena->blocks) {
+        arena_block* next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+    free(arena);
+}
+
+static void destroy_thread_arena(void* arena)
+{
+    aj_argarena_destroy((aj_argarena) arena);
+}
+
+static void create_thread_key(void)
+{
+    pthread_key_create(&s_threadKey, &destroy_thread_arena);
+}
+
+aj_argarena aj_argarena_forthread(void)
+{
+    aj_argarena arena;
+
+    pthread_once(&s_threadKeyOnce, &create_thread_key);
+    arena = (aj_argarena) pthread_getspecific(s_threadKey);
+    if (!arena) {
+        arena = aj_argarena_create(0);
+        if (arena) {
+            pthread_setspecific(s_threadKey, arena);
+        }
+    }
+    return arena;
+}
+
+void aj_argarena_reset(aj_argarena arena)
+{
+    arena_args* rec = arena->usedArgs;
+
+    /* Clearing drops whatever the args own; the arrays themselves are kept */
+    while (rec) {
+        arena_args* next = rec->next;
+        size_t i;
+        for (i = 0; i < rec->used; ++i) {
+            alljoyn_msgarg_clear(alljoyn_msgarg_array_element(rec->args, i));
+        }
+        rec->used = 0;
+        rec->next = arena->freeArgs;
+        arena->freeArgs = rec;
+        rec = next;
+    }
+    arena->usedArgs = NULL;
+
+    if (arena->numBlocks > 1) {
+        /* The request outgrew one block: replace them all with one big enough for next time */
+        while (arena->blocks) {
+            arena_block* next = arena->blocks->next;
+            free(arena->blocks);
+            arena->blocks = next;
+        }
+        arena->numBlocks = 0;
+        arena->nextBlockSize = align_up(arena->highWater);
+    } else if (arena->blocks) {
+        arena->blocks->used = 0;
+    }
+    arena->bytesInUse = 0;
+}
+
+void* aj_argarena_alloc(aj_argarena arena, size_t size)
+{
+    arena_block* block = arena->blocks;
+    void* p;
+
+    size = align_up(size ? size : 1);
+    if (!block || block->size - block->used < size) {
+        block = new_block(arena, size);
+        if (!block) {
+            return NULL;
+        }
+    }
+    p = (char*) block + BLOCK_HEADER + block->used;
+    block->used += size;
+    arena->bytesInUse += size;
+    if (arena->bytesInUse > arena->highWater) {
+        arena->highWater = arena->bytesInUse;
+    }
+    return p;
+}
+
+char* aj_argarena_strdup(aj_argarena arena, const char* str)
+{
+    size_t len = strlen(str) + 1;
+    char* copy = (char*) aj_argarena_alloc(arena, len);
+
+    if (copy) {
+        memcpy(copy, str, len);
+    }
+    return copy;
+}
+
+char* aj_argarena_printf(aj_argarena arena, const char* format, ...)
+{
+    va_list ap;
+    char* str;
+    int len;
+
+    va_start(ap, format);
+    len = vsnprintf(NULL, 0, format, ap);
+    va_end(ap);
+    if (len < 0) {
+        return NULL;
+    }
+    str = (char*) aj_argarena_alloc(arena, (size_t) len + 1);
+    if (str) {
+        va_start(ap, format);
+        vsnprintf(str, (size_t) len + 1, format, ap);
+        va_end(ap);
+    }
+    return str;
+}
+
+alljoyn_msgarg aj_argarena_msgargs(aj_argarena arena, size_t numArgs)
+{
+    arena_args** link;
+    arena_args** bestLink = NULL;
+    arena_args* rec;
+
+    if (numArgs == 0) {
+        numArgs = 1;
+    }
+    /* Best fit, but never waste more than half of an array */
+    for (link = &arena->freeArgs; *link; link = &(*link)->next) {
+        size_t capacity = (*link)->capacity;
+        if (capacity >= numArgs && capacity <= 2 * numArgs &&
+            (!bestLink || capacity < (*bestLink)->capacity)) {
+            bestLink = link;
+            if (capacity == numArgs) {
+                break;
+            }
+        }
+    }
+
+    if (bestLink) {
+        rec = *bestLink;
+        *bestLink = rec->next;
+        arena->argArraysReused++;
+    } else {
+        rec = (arena_args*) malloc(sizeof(arena_args));
+        if (!rec) {
+            return NULL;
+        }
+        rec->args = alljoyn_msgarg_array_create(numArgs);
+        if (!rec->args) {
+            free(rec);
+            return NULL;
+        }
+        rec->capacity = numArgs;
+        arena->numArgArrays++;
+        arena->argArraysCreated++;
+    }
+    rec->used = numArgs;
+    rec->next = arena->usedArgs;
+    arena->usedArgs = rec;
+    return rec->args;
+}
+
+void aj_argarena_getstats(aj_argarena arena, aj_argarena_stats* stats)
+{
+    stats->blocks = arena->numBlocks;
+    stats->bytesInUse = arena->bytesInUse;
+    stats->highWater = arena->highWater;
+    stats->argArrays = arena->numArgArrays;
+    stats->argArraysReused = arena->argArraysReused;
+    stats->argArraysCreated = arena->argArraysCreated;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file
+ * @brief Request-scoped arena for MsgArg graphs and their backing data.
+ *
+ * alljoyn_msgarg_set() and the typed setters only reference strings and
+ * arrays, so the data a reply is built from just has to live until the reply
+ * has been marshalled. The arena hands out that backing memory from a few
+ * large blocks, and hands out MsgArg arrays that it recycles instead of
+ * destroying: aj_argarena_reset() clears every array it gave out and rewinds
+ * the blocks, so a handler that builds the same shape of reply every time
+ * performs no heap allocation once the arena is warm.
+ *
+ * Nothing obtained from the arena may be used after the next reset. An arg
+ * that has to outlive the request must be copied with alljoyn_msgarg_copy()
+ * or stabilized with alljoyn_msgarg_stabilize() into an arg the caller owns.
+ *
+ * An arena is not thread-safe; use one per thread, see aj_argarena_forthread().
+ */
+#ifndef _AJ_ARGARENA_H
+#define _AJ_ARGARENA_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/MsgArg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Arena handle */
+typedef struct _aj_argarena_handle* aj_argarena;
+
+/** Allocation counters, see aj_argarena_getstats(). */
+typedef struct {
+    uint32_t blocks;            /**< Backing blocks currently owned */
+    size_t bytesInUse;          /**< Bytes handed out since the last reset */
+    size_t highWater;           /**< Most bytes in use at once */
+    uint32_t argArrays;         /**< MsgArg arrays owned, in use or not */
+    uint32_t argArraysReused;   /**< MsgArg arrays served from the free list */
+    uint32_t argArraysCreated;  /**< MsgArg arrays that had to be created */
+} aj_argarena_stats;
+
+/**
+ * Create an arena.
+ *
+ * @param blockSize  Size of each backing block, or 0 for 16 KiB. Larger
+ *                   requests get a block of their own.
+ */
+aj_argarena aj_argarena_create(size_t blockSize);
+
+/** Destroy every MsgArg array and block owned by the arena. */
+void aj_argarena_destroy(aj_argarena arena);
+
+/**
+ * The calling thread's arena, created on first use and destroyed when the
+ * thread exits. Suited to method handlers running on dispatcher threads.
+ */
+aj_argarena aj_argarena_forthread(void);
+
+/**
+ * Release everything handed out since the previous reset. MsgArg arrays are
+ * cleared and kept for reuse; the first block is kept and any extra blocks are
+ * merged into one of the high-water size on the next allocation.
+ */
+void aj_argarena_reset(aj_argarena arena);
+
+/** Uninitialized memory aligned for any type, or NULL on allocation failure. */
+void* aj_argarena_alloc(aj_argarena arena, size_t size);
+
+/** Copy of a string. */
+char* aj_argarena_strdup(aj_argarena arena, const char* str);
+
+/** printf into arena memory. */
+char* aj_argarena_printf(aj_argarena arena, const char* format, ...);
+
+/**
+ * An array of @p numArgs empty MsgArgs, as alljoyn_msgarg_array_create()
+ * would return, owned by the arena. Do not destroy it.
+ */
+alljoyn_msgarg aj_argarena_msgargs(aj_argarena arena, size_t numArgs);
+
+/** Copy the allocation counters. */
+void aj_argarena_getstats(aj_argarena arena, aj_argarena_stats* stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,2007 @@
+/**
+ * @file
+ * @brief Streaming conversion between MsgArgs and JSON or CBOR.
+ */
+#include <qcc/platform.h>
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aj_argcodec.h"
+
+/* Containers nest at most 32 deep in a signature; variants can add more */
+#define CODEC_MAX_DEPTH 64
+
+typedef enum {
+    NUM_SIGNED,
+    NUM_UNSIGNED,
+    NUM_DOUBLE,
+    NUM_BOOL
+} num_kind;
+
+typedef struct {
+    num_kind kind;
+    int64_t i;                  /* NUM_SIGNED, NUM_BOOL */
+    uint64_t u;                 /* NUM_UNSIGNED */
+    double d;                   /* NUM_DOUBLE */
+} num_value;
+
+/*
+ * Output buffer
+ */
+
+void aj_argbuf_init(aj_argbuf* buf)
+{
+    memset(buf, 0, sizeof(*buf));
+}
+
+void aj_argbuf_free(aj_argbuf* buf)
+{
+    free(buf->data);
+    memset(buf, 0, sizeof(*buf));
+}
+
+/* Room for @p extra more bytes plus the terminating NUL */
+static QStatus buf_reserve(aj_argbuf* out, size_t extra)
+{
+    if (out->len + extra + 1 > out->cap) {
+        size_t cap = out->cap ? out->cap : 256;
+        uint8_t* data;
+        while (cap < out->len + extra + 1) {
+            cap *= 2;
+        }
+        data = (uint8_t*) realloc(out->data, cap);
+        if (!data) {
+            return ER_OUT_OF_MEMORY;
+        }
+        out->data = data;
+        out->cap = cap;
+    }
+    return ER_OK;
+}
+
+static QStatus buf_put(aj_argbuf* out, const void* data, size_t size)
+{
+    QStatus status = buf_reserve(out, size);
+    if (ER_OK == status) {
+        memcpy(out->data + out->len, data, size);
+        out->len += size;
+        out->data[out->len] = '\0';
+    }
+    return status;
+}
+
+static QStatus buf_putc(aj_argbuf* out, char c)
+{
+    QStatus status = buf_reserve(out, 1);
+    if (ER_OK == status) {
+        out->data[out->len++] = (uint8_t) c;
+        out->data[out->len] = '\0';
+    }
+    return status;
+}
+
+/*
+ * Signatures and scalars
+ */
+
+/* Length of the complete type at the start of sig, 0 if it is not valid */
+static size_t type_len(const char* sig, int depth)
+{
+    size_t i;
+    size_t n;
+
+    if (depth > CODEC_MAX_DEPTH) {
+        return 0;
+    }
+    switch (*sig) {
+    case 'y': case 'b': case 'n': case 'q': case 'i': case 'u': case 'x': case 't':
+    case 'd': case 's': case 'o': case 'g': case 'h': case 'v':
+        return 1;
+
+    case 'a':
+        if (sig[1] != '{') {
+            n = type_len(sig + 1, depth + 1);
+            return n ? n + 1 : 0;
+        }
+        if (!sig[2] || !strchr("ybnqiuxtdsog", sig[2])) {
+            return 0;
+        }
+        n = type_len(sig + 3, depth + 1);
+        if (!n || sig[3 + n] != '}') {
+            return 0;
+        }
+        return n + 4;
+
+    case '(':
+        for (i = 1; sig[i] != ')'; i += n) {
+            n = type_len(sig + i, depth + 1);
+            if (!n) {
+                return 0;
+            }
+        }
+        return i > 1 ? i + 1 : 0;
+
+    default:
+        return 0;
+    }
+}
+
+static size_t scalar_size(char code)
+{
+    switch (code) {
+    case 'y':
+        return 1;
+
+    case 'n': case 'q':
+        return 2;
+
+    case 'b': case 'i': case 'u':
+        return 4;
+
+    case 'x': case 't': case 'd':
+        return 8;
+
+    default:
+        return 0;
+    }
+}
+
+static QStatus get_num(alljoyn_msgarg arg, alljoyn_typeid type, num_value* v)
+{
+    QStatus status;
+
+    memset(v, 0, sizeof(*v));
+    v->kind = NUM_SIGNED;
+    switch (type) {
+    case ALLJOYN_BYTE: {
+            uint8_t y;
+            status = alljoyn_msgarg_get_uint8(arg, &y);
+            v->i = y;
+            return status;
+        }
+
+    case ALLJOYN_BOOLEAN: {
+            QCC_BOOL b;
+            status = alljoyn_msgarg_get_bool(arg, &b);
+            v->kind = NUM_BOOL;
+            v->i = b ? 1 : 0;
+            return status;
+        }
+
+    case ALLJOYN_INT16: {
+            int16_t n;
+            status = alljoyn_msgarg_get_int16(arg, &n);
+            v->i = n;
+            return status;
+        }
+
+    case ALLJOYN_UINT16: {
+            uint16_t q;
+            status = alljoyn_msgarg_get_uint16(arg, &q);
+            v->i = q;
+            return status;
+        }
+
+    case ALLJOYN_INT32: {
+            int32_t i;
+            status = alljoyn_msgarg_get_int32(arg, &i);
+            v->i = i;
+            return status;
+        }
+
+    case ALLJOYN_UINT32: {
+            uint32_t u;
+            status = alljoyn_msgarg_get_uint32(arg, &u);
+            v->i = u;
+            return status;
+        }
+
+    case ALLJOYN_INT64:
+        return alljoyn_msgarg_get_int64(arg, &v->i);
+
+    case ALLJOYN_UINT64:
+        v->kind = NUM_UNSIGNED;
+        return alljoyn_msgarg_get_uint64(arg, &v->u);
+
+    case ALLJOYN_DOUBLE:
+        v->kind = NUM_DOUBLE;
+        return alljoyn_msgarg_get_double(arg, &v->d);
+
+    case ALLJOYN_HANDLE: {
+            int fd = -1;
+            status = alljoyn_msgarg_get(arg, "h", &fd);
+            v->i = fd;
+            return status;
+        }
+
+    default:
+        return ER_INVALID_DATA;
+    }
+}
+
+/* Element @p idx of a scalar array of type @p code */
+static void load_elem(char code, const void* data, size_t idx, num_value* v)
+{
+    memset(v, 0, sizeof(*v));
+    v->kind = NUM_SIGNED;
+    switch (code) {
+    case 'y': v->i = ((const uint8_t*) data)[idx]; break;
+    case 'b': v->kind = NUM_BOOL; v->i = ((const QCC_BOOL*) data)[idx] ? 1 : 0; break;
+    case 'n': v->i = ((const int16_t*) data)[idx]; break;
+    case 'q': v->i = ((const uint16_t*) data)[idx]; break;
+    case 'i': v->i = ((const int32_t*) data)[idx]; break;
+    case 'u': v->i = ((const uint32_t*) data)[idx]; break;
+    case 'x': v->i = ((const int64_t*) data)[idx]; break;
+    case 't': v->kind = NUM_UNSIGNED; v->u = ((const uint64_t*) data)[idx]; break;
+    default: v->kind = NUM_DOUBLE; v->d = ((const double*) data)[idx]; break;
+    }
+}
+
+/* The string getters fill in a pointer to the arg's own string */
+static QStatus get_str(alljoyn_msgarg arg, alljoyn_typeid type, const char** str)
+{
+    char* s = NULL;
+    QStatus status;
+
+    switch (type) {
+    case ALLJOYN_STRING: status = alljoyn_msgarg_get_string(arg, (char*) &s); break;
+    case ALLJOYN_OBJECT_PATH: status = alljoyn_msgarg_get_objectpath(arg, (char*) &s); break;
+    default: status = alljoyn_msgarg_get_signature(arg, (char*) &s); break;
+    }
+    *str = s ? s : "";
+    return status;
+}
+
+static QStatus get_scalar_array(alljoyn_msgarg arg, char code, size_t* n, const void** data)
+{
+    void* p = NULL;
+    QStatus status;
+
+    switch (code) {
+    case 'y': status = alljoyn_msgarg_get_uint8_array(arg, n, (uint8_t*) &p); break;
+    case 'b': status = alljoyn_msgarg_get_bool_array(arg, n, (QCC_BOOL*) &p); break;
+    case 'n': status = alljoyn_msgarg_get_int16_array(arg, n, (int16_t*) &p); break;
+    case 'q': status = alljoyn_msgarg_get_uint16_array(arg, n, (uint16_t*) &p); break;
+    case 'i': status = alljoyn_msgarg_get_int32_array(arg, n, (int32_t*) &p); break;
+    case 'u': status = alljoyn_msgarg_get_uint32_array(arg, n, (uint32_t*) &p); break;
+    case 'x': status = alljoyn_msgarg_get_int64_array(arg, n, (int64_t*) &p); break;
+    case 't': status = alljoyn_msgarg_get_uint64_array(arg, n, (uint64_t*) &p); break;
+    case 'd': status = alljoyn_msgarg_get_double_array(arg, n, (double*) &p); break;
+    default: return ER_INVALID_DATA;
+    }
+    *data = p;
+    return status;
+}
+
+/* An empty array has no element to look at, so ask for its signature */
+static QCC_BOOL is_dict(alljoyn_msgarg arg, size_t n)
+{
+    char sig[4];
+
+    if (n) {
+        alljoyn_msgarg elem = NULL;
+        alljoyn_msgarg_get_array_element(arg, 0, &elem);
+        return elem && alljoyn_msgarg_gettype(elem) == ALLJOYN_DICT_ENTRY;
+    }
+    sig[0] = sig[1] = '\0';
+    alljoyn_msgarg_signature(arg, sig, sizeof(sig));
+    return sig[1] == '{';
+}
+
+/*
+ * JSON encoder
+ */
+
+static QStatus put_u64(aj_argbuf* out, uint64_t u)
+{
+    char digits[20];
+    size_t n = 0;
+
+    do {
+        digits[sizeof(digits) - ++n] = (char) ('0' + u % 10);
+        u /= 10;
+    } while (u);
+    return buf_put(out, digits + sizeof(digits) - n, n);
+}
+
+static QStatus json_put_num(aj_argbuf* out, const num_value* v)
+{
+    char text[32];
+
+    switch (v->kind) {
+    case NUM_BOOL:
+        return v->i ? buf_put(out, "true", 4) : buf_put(out, "false", 5);
+
+    case NUM_UNSIGNED:
+        return put_u64(out, v->u);
+
+    case NUM_DOUBLE:
+        if (!isfinite(v->d)) {
+            return buf_put(out, "null", 4);
+        }
+        return buf_put(out, text, (size_t) snprintf(text, sizeof(text), "%.17g", v->d));
+
+    default:
+        if (v->i < 0) {
+            QStatus status = buf_putc(out, '-');
+            return ER_OK == status ? put_u64(out, (uint64_t) -(v->i + 1) + 1) : status;
+        }
+        return put_u64(out, (uint64_t) v->i);
+    }
+}
+
+static QStatus json_put_string(aj_argbuf* out, const char* str)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char* run = str;
+    QStatus status = buf_putc(out, '"');
+
+    /* Copy runs of characters that need no escaping in one go */
+    for (; ER_OK == status && *str; ++str) {
+        uint8_t c = (uint8_t) *str;
+        char esc[6];
+        size_t escLen = 2;
+
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        status = buf_put(out, run, (size_t) (str - run));
+        esc[0] = '\\';
+        switch (c) {
+        case '"': esc[1] = '"'; break;
+        case '\\': esc[1] = '\\'; break;
+        case '\n': esc[1] = 'n'; break;
+        case '\r': esc[1] = 'r'; break;
+        case '\t': esc[1] = 't'; break;
+        case '\b': esc[1] = 'b'; break;
+        case '\f': esc[1] = 'f'; break;
+        default:
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 15];
+            escLen = 6;
+            break;
+        }
+        if (ER_OK == status) {
+            status = buf_put(out, esc, escLen);
+        }
+        run = str + 1;
+    }
+    if (ER_OK == status) {
+        status = buf_put(out, run, (size_t) (str - run));
+    }
+    if (ER_OK == status) {
+        status = buf_putc(out, '"');
+    }
+    return status;
+}
+
+static QStatus encode_json(aj_argbuf* out, alljoyn_msgarg arg, int depth);
+
+/* Object keys have to be strings in JSON, so other key types are quoted */
+static QStatus json_put_key(aj_argbuf* out, alljoyn_msgarg key)
+{
+    alljoyn_typeid type = alljoyn_msgarg_gettype(key);
+    QStatus status;
+
+    if (type == ALLJOYN_STRING || type == ALLJOYN_OBJECT_PATH || type == ALLJOYN_SIGNATURE) {
+        const char* str;
+        status = get_str(key, type, &str);
+        return ER_OK == status ? json_put_string(out, str) : status;
+    } else {
+        num_value v;
+        status = get_num(key, type, &v);
+        if (ER_OK == status) {
+            status = buf_putc(out, '"');
+        }
+        if (ER_OK == status) {
+            status = json_put_num(out, &v);
+        }
+        if (ER_OK == status) {
+            status = buf_putc(out, '"');
+        }
+        return status;
+    }
+}
+
+static QStatus encode_json(aj_argbuf* out, alljoyn_msgarg arg, int depth)
+{
+    alljoyn_typeid type;
+    QStatus status = ER_OK;
+    size_t n;
+    size_t i;
+
+    if (!arg || depth > CODEC_MAX_DEPTH) {
+        return ER_INVALID_DATA;
+    }
+    type = alljoyn_msgarg_gettype(arg);
+    switch (type) {
+    case ALLJOYN_STRING:
+    case ALLJOYN_OBJECT_PATH:
+    case ALLJOYN_SIGNATURE: {
+            const char* str;
+            status = get_str(arg, type, &str);
+            return ER_OK == status ? json_put_string(out, str) : status;
+        }
+
+    case ALLJOYN_VARIANT: {
+            alljoyn_msgarg inner = NULL;
+            status = alljoyn_msgarg_get(arg, "v", &inner);
+            return ER_OK == status ? encode_json(out, inner, depth + 1) : status;
+        }
+
+    case ALLJOYN_STRUCT:
+        n = alljoyn_msgarg_getnummembers(arg);
+        status = buf_putc(out, '[');
+        for (i = 0; i < n && ER_OK == status; ++i) {
+            if (i) {
+                status = buf_putc(out, ',');
+            }
+            if (ER_OK == status) {
+                status = encode_json(out, alljoyn_msgarg_getmember(arg, i), depth + 1);
+            }
+        }
+        return ER_OK == status ? buf_putc(out, ']') : status;
+
+    case ALLJOYN_DICT_ENTRY:
+        status = buf_putc(out, '[');
+        if (ER_OK == status) {
+            status = encode_json(out, alljoyn_msgarg_getkey(arg), depth + 1);
+        }
+        if (ER_OK == status) {
+            status = buf_putc(out, ',');
+        }
+        if (ER_OK == status) {
+            status = encode_json(out, alljoyn_msgarg_getvalue(arg), depth + 1);
+        }
+        return ER_OK == status ? buf_putc(out, ']') : status;
+
+    case ALLJOYN_ARRAY: {
+            QCC_BOOL dict;
+            n = alljoyn_msgarg_get_array_numberofelements(arg);
+            dict = is_dict(arg, n);
+            status = buf_putc(out, dict ? '{' : '[');
+            for (i = 0; i < n && ER_OK == status; ++i) {
+                alljoyn_msgarg elem = NULL;
+                alljoyn_msgarg_get_array_element(arg, i, &elem);
+                if (i) {
+                    status = buf_putc(out, ',');
+                }
+                if (ER_OK != status || !elem) {
+                    return elem ? status : ER_INVALID_DATA;
+                }
+                if (dict) {
+                    status = json_put_key(out, alljoyn_msgarg_getkey(elem));
+                    if (ER_OK == status) {
+                        status = buf_putc(out, ':');
+                    }
+                    if (ER_OK == status) {
+                        status = encode_json(out, alljoyn_msgarg_getvalue(elem), depth + 1);
+                    }
+                } else {
+                    status = encode_json(out, elem, depth + 1);
+                }
+            }
+            return ER_OK == status ? buf_putc(out, dict ? '}' : ']') : status;
+        }
+
+    default:
+        break;
+    }
+
+    if ((type & 0xff) == 'a' && (type >> 8)) {
+        char code = (char) (type >> 8);
+        const void* data = NULL;
+        num_value v;
+        status = get_scalar_array(arg, code, &n, &data);
+        if (ER_OK == status) {
+            status = buf_putc(out, '[');
+        }
+        for (i = 0; i < n && ER_OK == status; ++i) {
+            if (i) {
+                status = buf_putc(out, ',');
+            }
+            load_elem(code, data, i, &v);
+            if (ER_OK == status) {
+                status = json_put_num(out, &v);
+            }
+        }
+        return ER_OK == status ? buf_putc(out, ']') : status;
+    } else {
+        num_value v;
+        status = get_num(arg, type, &v);
+        return ER_OK == status ? json_put_num(out, &v) : status;
+    }
+}
+
+QStatus aj_argcodec_tojson(const alljoyn_msgarg arg, aj_argbuf* out)
+{
+    return encode_json(out, arg, 0);
+}
+
+QStatus aj_argcodec_argstojson(const alljoyn_msgarg args, size_t numArgs, aj_argbuf* out)
+{
+    QStatus status = buf_putc(out, '[');
+    size_t i;
+
+    for (i = 0; i < numArgs && ER_OK == status; ++i) {
+        if (i) {
+            status = buf_putc(out, ',');
+        }
+        if (ER_OK == status) {
+            status = encode_json(out, alljoyn_msgarg_array_element(args, i), 0);
+        }
+    }
+    return ER_OK == status ? buf_putc(out, ']') : status;
+}
+
+/*
+ * CBOR encoder
+ */
+
+enum {
+    CBOR_UINT = 0,
+    CBOR_NINT = 1,
+    CBOR_BYTES = 2,
+    CBOR_TEXT = 3,
+    CBOR_ARRAY = 4,
+    CBOR_MAP = 5,
+    CBOR_TAG = 6,
+    CBOR_SIMPLE = 7
+};
+
+/* Initial byte plus the argument in its shortest form */
+static QStatus cbor_head(aj_argbuf* out, int major, uint64_t value)
+{
+    uint8_t head[9];
+    size_t len;
+    size_t i;
+
+    if (value < 24) {
+        head[0] = (uint8_t) ((major << 5) | value);
+        len = 1;
+    } else {
+        size_t bytes = value <= 0xff ? 1 : value <= 0xffff ? 2 : value <= 0xffffffffull ? 4 : 8;
+        head[0] = (uint8_t) ((major << 5) | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+        for (i = 0; i < bytes; ++i) {
+            head[bytes - i] = (uint8_t) (value >> (8 * i));
+        }
+        len = bytes + 1;
+    }
+    return buf_put(out, head, len);
+}
+
+static QStatus cbor_put_num(aj_argbuf* out, const num_value* v)
+{
+    uint8_t f[9];
+    uint64_t bits;
+    int i;
+
+    switch (v->kind) {
+    case NUM_BOOL:
+        return buf_putc(out, (char) (v->i ? 0xf5 : 0xf4));
+
+    case NUM_UNSIGNED:
+        return cbor_head(out, CBOR_UINT, v->u);
+
+    case NUM_DOUBLE:
+        memcpy(&bits, &v->d, sizeof(bits));
+        f[0] = 0xfb;
+        for (i = 0; i < 8; ++i) {
+            f[8 - i] = (uint8_t) (bits >> (8 * i));
+        }
+        return buf_put(out, f, sizeof(f));
+
+    default:
+        if (v->i < 0) {
+            return cbor_head(out, CBOR_NINT, (uint64_t) -(v->i + 1));
+        }
+        return cbor_head(out, CBOR_UINT, (uint64_t) v->i);
+    }
+}
+
+static QStatus cbor_put_text(aj_argbuf* out, const char* str)
+{
+    size_t len = strlen(str);
+    QStatus status = cbor_head(out, CBOR_TEXT, len);
+    return ER_OK == status ? buf_put(out, str, len) : status;
+}
+
+static QStatus encode_cbor(aj_argbuf* out, alljoyn_msgarg arg, int depth)
+{
+    alljoyn_typeid type;
+    QStatus status = ER_OK;
+    size_t n;
+    size_t i;
+
+    if (!arg || depth > CODEC_MAX_DEPTH) {
+        return ER_INVALID_DATA;
+    }
+    type = alljoyn_msgarg_gettype(arg);
+    switch (type) {
+    case ALLJOYN_STRING:
+    case ALLJOYN_OBJECT_PATH:
+    case ALLJOYN_SIGNATURE: {
+            const char* str;
+            status = get_str(arg, type, &str);
+            return ER_OK == status ? cbor_put_text(out, str) : status;
+        }
+
+    case ALLJOYN_VARIANT: {
+            alljoyn_msgarg inner = NULL;
+            status = alljoyn_msgarg_get(arg, "v", &inner);
+            return ER_OK == status ? encode_cbor(out, inner, depth + 1) : status;
+        }
+
+    case ALLJOYN_STRUCT:
+        n = alljoyn_msgarg_getnummembers(arg);
+        status = cbor_head(out, CBOR_ARRAY, n);
+        for (i = 0; i < n && ER_OK == status; ++i) {
+            status = encode_cbor(out, alljoyn_msgarg_getmember(arg, i), depth + 1);
+        }
+        return status;
+
+    case ALLJOYN_DICT_ENTRY:
+        status = cbor_head(out, CBOR_ARRAY, 2);
+        if (ER_OK == status) {
+            status = encode_cbor(out, alljoyn_msgarg_getkey(arg), depth + 1);
+        }
+        if (ER_OK == status) {
+            status = encode_cbor(out, alljoyn_msgarg_getvalue(arg), depth + 1);
+        }
+        return status;
+
+    case ALLJOYN_ARRAY: {
+            QCC_BOOL dict;
+            n = alljoyn_msgarg_get_array_numberofelements(arg);
+            dict = is_dict(arg, n);
+            status = cbor_head(out, dict ? CBOR_MAP : CBOR_ARRAY, n);
+            for (i = 0; i < n && ER_OK == status; ++i) {
+                alljoyn_msgarg elem = NULL;
+                alljoyn_msgarg_get_array_element(arg, i, &elem);
+                if (!elem) {
+                    return ER_INVALID_DATA;
+                }
+                if (dict) {
+                    status = encode_cbor(out, alljoyn_msgarg_getkey(elem), depth + 1);
+                    if (ER_OK == status) {
+                        status = encode_cbor(out, alljoyn_msgarg_getvalue(elem), depth + 1);
+                    }
+                } else {
+                    status = encode_cbor(out, elem, depth + 1);
+                }
+            }
+            return status;
+        }
+
+    case ALLJOYN_BYTE_ARRAY: {
+            const void* data = NULL;
+            status = get_scalar_array(arg, 'y', &n, &data);
+            if (ER_OK == status) {
+                status = cbor_head(out, CBOR_BYTES, n);
+            }
+            return ER_OK == status ? buf_put(out, data, n) : status;
+        }
+
+    default:
+        break;
+    }
+
+    if ((type & 0xff) == 'a' && (type >> 8)) {
+        char code = (char) (type >> 8);
+        const void* data = NULL;
+        num_value v;
+        status = get_scalar_array(arg, code, &n, &data);
+        if (ER_OK == status) {
+            status = cbor_head(out, CBOR_ARRAY, n);
+        }
+        for (i = 0; i < n && ER_OK == status; ++i) {
+            load_elem(code, data, i, &v);
+            status = cbor_put_num(out, &v);
+        }
+        return status;
+    } else {
+        num_value v;
+        status = get_num(arg, type, &v);
+        return ER_OK == status ? cbor_put_num(out, &v) : status;
+    }
+}
+
+QStatus aj_argcodec_tocbor(const alljoyn_msgarg arg, aj_argbuf* out)
+{
+    return encode_cbor(out, arg, 0);
+}
+
+QStatus aj_argcodec_argstocbor(const alljoyn_msgarg args, size_t numArgs, aj_argbuf* out)
+{
+    QStatus status = cbor_head(out, CBOR_ARRAY, numArgs);
+    size_t i;
+
+    for (i = 0; i < numArgs && ER_OK == status; ++i) {
+        status = encode_cbor(out, alljoyn_msgarg_array_element(args, i), 0);
+    }
+    return status;
+}
+
+/*
+ * Building args
+ */
+
+/* Convert @p v to the scalar type @p code and store it at @p dst */
+static QStatus store_num(char code, const num_value* v, void* dst)
+{
+    int64_t i = 0;
+    uint64_t u = 0;
+    QCC_BOOL isInt = QCC_FALSE;
+    QCC_BOOL isUint = QCC_FALSE;
+
+    if (code == 'b') {
+        if (v->kind != NUM_BOOL) {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+        *(QCC_BOOL*) dst = v->i ? QCC_TRUE : QCC_FALSE;
+        return ER_OK;
+    }
+    switch (v->kind) {
+    case NUM_SIGNED:
+        i = v->i;
+        isInt = QCC_TRUE;
+        u = (uint64_t) v->i;
+        isUint = v->i >= 0;
+        break;
+
+    case NUM_UNSIGNED:
+        u = v->u;
+        isUint = QCC_TRUE;
+        i = (int64_t) v->u;
+        isInt = v->u <= (uint64_t) INT64_MAX;
+        break;
+
+    case NUM_DOUBLE:
+        /* Integral doubles are accepted for integer types, e.g. 3.0 from a JSON producer */
+        if (v->d == floor(v->d) && v->d >= -9223372036854775808.0 && v->d < 9223372036854775808.0) {
+            i = (int64_t) v->d;
+            isInt = QCC_TRUE;
+        }
+        if (v->d == floor(v->d) && v->d >= 0 && v->d < 18446744073709551616.0) {
+            u = (uint64_t) v->d;
+            isUint = QCC_TRUE;
+        }
+        break;
+
+    default:
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+
+    switch (code) {
+    case 'y':
+        if (!isUint || u > 0xff) {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+        *(uint8_t*) dst = (uint8_t) u;
+        return ER_OK;
+
+    case 'n':
+        if (!isInt || i < -32768 || i > 32767) {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+        *(int16_t*) dst = (int16_t) i;
+        return ER_OK;
+
+    case 'q':
+        if (!isUint || u > 0xffff) {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+        *(uint16_t*) dst = (uint16_t) u;
+        return ER_OK;
+
+    case 'i':
+        if (!isInt || i < INT32_MIN || i > INT32_MAX) {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+        *(int32_t*) dst = (int32_t) i;
+        return ER_OK;
+
+    case 'u':
+        if (!isUint || u > 0xffffffffu) {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+        *(uint32_t*) dst = (uint32_t) u;
+        return ER_OK;
+
+    case 'x':
+        if (!isInt) {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+        *(int64_t*) dst = i;
+        return ER_OK;
+
+    case 't':
+        if (!isUint) {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+        *(uint64_t*) dst = u;
+        return ER_OK;
+
+    case 'd':
+        *(double*) dst = v->kind == NUM_DOUBLE ? v->d : v->kind == NUM_UNSIGNED ? (double) v->u : (double) v->i;
+        return ER_OK;
+
+    default:
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+}
+
+static QStatus set_num(alljoyn_msgarg out, char code, const num_value* v)
+{
+    union { uint8_t y; QCC_BOOL b; int16_t n; uint16_t q; int32_t i; uint32_t u; int64_t x; uint64_t t; double d; } s;
+    QStatus status = store_num(code, v, &s);
+
+    if (ER_OK != status) {
+        return status;
+    }
+    switch (code) {
+    case 'y': return alljoyn_msgarg_set_uint8(out, s.y);
+    case 'b': return alljoyn_msgarg_set_bool(out, s.b);
+    case 'n': return alljoyn_msgarg_set_int16(out, s.n);
+    case 'q': return alljoyn_msgarg_set_uint16(out, s.q);
+    case 'i': return alljoyn_msgarg_set_int32(out, s.i);
+    case 'u': return alljoyn_msgarg_set_uint32(out, s.u);
+    case 'x': return alljoyn_msgarg_set_int64(out, s.x);
+    case 't': return alljoyn_msgarg_set_uint64(out, s.t);
+    default: return alljoyn_msgarg_set_double(out, s.d);
+    }
+}
+
+static QStatus set_scalar_array(alljoyn_msgarg out, char code, void* data, size_t n)
+{
+    switch (code) {
+    case 'y': return alljoyn_msgarg_set_uint8_array(out, n, (uint8_t*) data);
+    case 'b': return alljoyn_msgarg_set_bool_array(out, n, (QCC_BOOL*) data);
+    case 'n': return alljoyn_msgarg_set_int16_array(out, n, (int16_t*) data);
+    case 'q': return alljoyn_msgarg_set_uint16_array(out, n, (uint16_t*) data);
+    case 'i': return alljoyn_msgarg_set_int32_array(out, n, (int32_t*) data);
+    case 'u': return alljoyn_msgarg_set_uint32_array(out, n, (uint32_t*) data);
+    case 'x': return alljoyn_msgarg_set_int64_array(out, n, (int64_t*) data);
+    case 't': return alljoyn_msgarg_set_uint64_array(out, n, (uint64_t*) data);
+    default: return alljoyn_msgarg_set_double_array(out, n, (double*) data);
+    }
+}
+
+static QStatus set_str(alljoyn_msgarg out, char code, const char* str)
+{
+    switch (code) {
+    case 's': return alljoyn_msgarg_set_string(out, str);
+    case 'o': return alljoyn_msgarg_set_objectpath(out, str);
+    default: return alljoyn_msgarg_set_signature(out, str);
+    }
+}
+
+static QStatus set_str_array(alljoyn_msgarg out, char code, const char** strs, size_t n)
+{
+    switch (code) {
+    case 's': return alljoyn_msgarg_set_string_array(out, n, strs);
+    case 'o': return alljoyn_msgarg_set_objectpath_array(out, n, strs);
+    default: return alljoyn_msgarg_set_signature_array(out, n, strs);
+    }
+}
+
+/* Set @p out to an array of @p n already built elements; sig is not NUL terminated */
+static QStatus set_array(aj_argarena arena, alljoyn_msgarg out, const char* sig, size_t sigLen,
+                         alljoyn_msgarg elems, size_t n)
+{
+    char* arraySig = (char*) aj_argarena_alloc(arena, sigLen + 1);
+    if (!arraySig) {
+        return ER_OUT_OF_MEMORY;
+    }
+    memcpy(arraySig, sig, sigLen);
+    arraySig[sigLen] = '\0';
+    return alljoyn_msgarg_set(out, arraySig, n, elems);
+}
+
+static size_t count_members(const char* sig, size_t sigLen)
+{
+    size_t n = 0;
+    size_t pos;
+
+    for (pos = 1; pos < sigLen - 1; pos += type_len(sig + pos, 0)) {
+        n++;
+    }
+    return n;
+}
+
+/* Parse a JSON style number from a NUL terminated token */
+static QCC_BOOL parse_number(const char* token, num_value* v)
+{
+    char* end = NULL;
+
+    memset(v, 0, sizeof(*v));
+    if (!*token) {
+        return QCC_FALSE;
+    }
+    errno = 0;
+    if (!strpbrk(token, ".eE")) {
+        if (token[0] == '-') {
+            v->kind = NUM_SIGNED;
+            v->i = strtoll(token, &end, 10);
+        } else {
+            v->u = strtoull(token, &end, 10);
+            v->kind = v->u <= (uint64_t) INT64_MAX ? NUM_SIGNED : NUM_UNSIGNED;
+            v->i = (int64_t) v->u;
+        }
+        if (errno == 0 && *end == '\0') {
+            return QCC_TRUE;
+        }
+        errno = 0;
+    }
+    /* Fractions, exponents and integers too large for 64 bits */
+    v->kind = NUM_DOUBLE;
+    v->d = strtod(token, &end);
+    return *end == '\0' && errno == 0;
+}
+
+/*
+ * JSON decoder
+ */
+
+typedef struct {
+    const char* p;
+    const char* end;
+    aj_argarena arena;
+} json_cursor;
+
+static QStatus decode_json(json_cursor* cur, const char* sig, size_t sigLen, alljoyn_msgarg out,
+                           alljoyn_msgarg members, int depth);
+
+static void json_ws(json_cursor* cur)
+{
+    while (cur->p < cur->end && (*cur->p == ' ' || *cur->p == '\t' || *cur->p == '\n' || *cur->p == '\r')) {
+        cur->p++;
+    }
+}
+
+static QCC_BOOL json_expect(json_cursor* cur, char c)
+{
+    json_ws(cur);
+    if (cur->p < cur->end && *cur->p == c) {
+        cur->p++;
+        return QCC_TRUE;
+    }
+    return QCC_FALSE;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static QCC_BOOL json_hex4(const char* p, const char* end, uint32_t* cp)
+{
+    int i;
+
+    if (end - p < 4) {
+        return QCC_FALSE;
+    }
+    *cp = 0;
+    for (i = 0; i < 4; ++i) {
+        int h = hex_value(p[i]);
+        if (h < 0) {
+            return QCC_FALSE;
+        }
+        *cp = (*cp << 4) | (uint32_t) h;
+    }
+    return QCC_TRUE;
+}
+
+static size_t put_utf8(char* dst, uint32_t cp)
+{
+    if (cp < 0x80) {
+        dst[0] = (char) cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        dst[0] = (char) (0xc0 | (cp >> 6));
+        dst[1] = (char) (0x80 | (cp & 0x3f));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        dst[0] = (char) (0xe0 | (cp >> 12));
+        dst[1] = (char) (0x80 | ((cp >> 6) & 0x3f));
+        dst[2] = (char) (0x80 | (cp & 0x3f));
+        return 3;
+    }
+    dst[0] = (char) (0xf0 | (cp >> 18));
+    dst[1] = (char) (0x80 | ((cp >> 12) & 0x3f));
+    dst[2] = (char) (0x80 | ((cp >> 6) & 0x3f));
+    dst[3] = (char) (0x80 | (cp & 0x3f));
+    return 4;
+}
+
+/*
+ * Parse a string into arena memory, or just skip it when @p str is NULL.
+ * Escapes never expand, so the raw length bounds the decoded length.
+ */
+static QStatus json_string(json_cursor* cur, const char** str)
+{
+    const char* start;
+    const char* p;
+    char* dst = NULL;
+    size_t len = 0;
+
+    if (!json_expect(cur, '"')) {
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+    start = cur->p;
+    for (p = start; p < cur->end && *p != '"'; ++p) {
+        if (*p == '\\') {
+            ++p;
+        }
+    }
+    if (p >= cur->end) {
+        return ER_INVALID_DATA;
+    }
+    if (str) {
+        dst = (char*) aj_argarena_alloc(cur->arena, (size_t) (p - start) + 1);
+        if (!dst) {
+            return ER_OUT_OF_MEMORY;
+        }
+    }
+
+    for (p = start; *p != '"'; ++p) {
+        char c = *p;
+        if ((uint8_t) c < 0x20) {
+            return ER_INVALID_DATA;
+        }
+        if (c == '\\') {
+            uint32_t cp;
+            c = *++p;
+            switch (c) {
+            case '"': case '\\': case '/': break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'u':
+                if (!json_hex4(p + 1, cur->end, &cp)) {
+                    return ER_INVALID_DATA;
+                }
+                p += 4;
+                /* A surrogate pair takes two escapes (12 input bytes for 4 output bytes) */
+                if (cp >= 0xd800 && cp < 0xdc00 && cur->end - p > 6 && p[1] == '\\' && p[2] == 'u') {
+                    uint32_t low;
+                    if (json_hex4(p + 3, cur->end, &low) && low >= 0xdc00 && low < 0xe000) {
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                        p += 6;
+                    }
+                }
+                if (cp == 0) {
+                    return ER_INVALID_DATA;     /* MsgArg strings cannot hold NUL */
+                }
+                if (dst) {
+                    len += put_utf8(dst + len, cp);
+                }
+                continue;
+
+            default:
+                return ER_INVALID_DATA;
+            }
+        }
+        if (dst) {
+            dst[len++] = c;
+        }
+    }
+    cur->p = p + 1;
+    if (dst) {
+        dst[len] = '\0';
+        *str = dst;
+    }
+    return ER_OK;
+}
+
+/* Copy the number token at the cursor into @p token */
+static QCC_BOOL json_token(json_cursor* cur, char* token, size_t size)
+{
+    size_t n = 0;
+
+    json_ws(cur);
+    while (cur->p + n < cur->end && strchr("+-0123456789.eE", cur->p[n]) && cur->p[n]) {
+        if (n + 1 >= size) {
+            return QCC_FALSE;
+        }
+        token[n] = cur->p[n];
+        n++;
+    }
+    token[n] = '\0';
+    return n > 0;
+}
+
+static QCC_BOOL json_literal(json_cursor* cur, const char* word)
+{
+    size_t len = strlen(word);
+
+    json_ws(cur);
+    if ((size_t) (cur->end - cur->p) >= len && 0 == memcmp(cur->p, word, len)) {
+        cur->p += len;
+        return QCC_TRUE;
+    }
+    return QCC_FALSE;
+}
+
+/* A number, true or false */
+static QStatus json_num(json_cursor* cur, num_value* v)
+{
+    char token[64];
+
+    memset(v, 0, sizeof(*v));
+    if (json_literal(cur, "true") || json_literal(cur, "false")) {
+        v->kind = NUM_BOOL;
+        v->i = cur->p[-1] == 'e' && cur->p[-2] == 'u';
+        return ER_OK;
+    }
+    if (!json_token(cur, token, sizeof(token)) || !parse_number(token, v)) {
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+    cur->p += strlen(token);
+    return ER_OK;
+}
+
+static QStatus json_skip(json_cursor* cur, int depth)
+{
+    num_value v;
+    QStatus status = ER_OK;
+
+    if (depth > CODEC_MAX_DEPTH) {
+        return ER_INVALID_DATA;
+    }
+    json_ws(cur);
+    if (cur->p >= cur->end) {
+        return ER_INVALID_DATA;
+    }
+    switch (*cur->p) {
+    case '"':
+        return json_string(cur, NULL);
+
+    case '[':
+    case '{': {
+            char close = *cur->p == '[' ? ']' : '}';
+            QCC_BOOL object = close == '}';
+            cur->p++;
+            if (json_expect(cur, close)) {
+                return ER_OK;
+            }
+            do {
+                if (object) {
+                    status = json_string(cur, NULL);
+                    if (ER_OK == status && !json_expect(cur, ':')) {
+                        status = ER_INVALID_DATA;
+                    }
+                }
+                if (ER_OK == status) {
+                    status = json_skip(cur, depth + 1);
+                }
+            } while (ER_OK == status && json_expect(cur, ','));
+            if (ER_OK == status && !json_expect(cur, close)) {
+                status = ER_INVALID_DATA;
+            }
+            return status;
+        }
+
+    case 'n':
+        return json_literal(cur, "null") ? ER_OK : ER_INVALID_DATA;
+
+    default:
+        return json_num(cur, &v);
+    }
+}
+
+/* Number of elements of the array or object whose opening bracket was just consumed */
+static QStatus json_count(json_cursor* cur, QCC_BOOL object, size_t* n)
+{
+    json_cursor scan = *cur;
+    char close = object ? '}' : ']';
+    QStatus status = ER_OK;
+
+    *n = 0;
+    if (json_expect(&scan, close)) {
+        return ER_OK;
+    }
+    do {
+        if (object) {
+            status = json_string(&scan, NULL);
+            if (ER_OK == status && !json_expect(&scan, ':')) {
+                status = ER_INVALID_DATA;
+            }
+        }
+        if (ER_OK == status) {
+            status = json_skip(&scan, 1);
+        }
+        if (ER_OK == status) {
+            (*n)++;
+        }
+    } while (ER_OK == status && json_expect(&scan, ','));
+    if (ER_OK == status && !json_expect(&scan, close)) {
+        status = ER_INVALID_DATA;
+    }
+    return status;
+}
+
+/* Separator after element @p i of @p n */
+static QStatus json_sep(json_cursor* cur, size_t i, size_t n)
+{
+    if (i + 1 < n) {
+        return json_expect(cur, ',') ? ER_OK : ER_INVALID_DATA;
+    }
+    return ER_OK;
+}
+
+/* Signature for a JSON value in a variant */
+static const char* json_infer(json_cursor* cur)
+{
+    json_cursor peek = *cur;
+    num_value v;
+
+    json_ws(&peek);
+    if (peek.p >= peek.end) {
+        return NULL;
+    }
+    switch (*peek.p) {
+    case '"': return "s";
+    case '[': return "av";
+    case '{': return "a{sv}";
+    case 't': case 'f': return "b";
+    case 'n': return NULL;
+    default:
+        if (ER_OK != json_num(&peek, &v)) {
+            return NULL;
+        }
+        return v.kind == NUM_DOUBLE ? "d" : v.kind == NUM_UNSIGNED ? "t" : "x";
+    }
+}
+
+static QStatus json_key(json_cursor* cur, char code, alljoyn_msgarg out)
+{
+    const char* str = NULL;
+    QStatus status = json_string(cur, &str);
+    num_value v;
+
+    if (ER_OK != status) {
+        return status;
+    }
+    if (code == 's' || code == 'o' || code == 'g') {
+        return set_str(out, code, str);
+    }
+    if (code == 'b' && (0 == strcmp(str, "true") || 0 == strcmp(str, "false"))) {
+        v.kind = NUM_BOOL;
+        v.i = str[0] == 't';
+    } else if (!parse_number(str, &v)) {
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+    return set_num(out, code, &v);
+}
+
+static QStatus json_dict(json_cursor* cur, const char* sig, size_t sigLen, alljoyn_msgarg out, int depth)
+{
+    const char* valueSig = sig + 3;
+    size_t valueLen = sigLen - 5;
+    alljoyn_msgarg entries;
+    alljoyn_msgarg kv;
+    size_t n;
+    size_t i;
+    QStatus status;
+
+    /* An empty dictionary may come back as [] from producers that cannot tell */
+    if (json_expect(cur, '[')) {
+        if (!json_expect(cur, ']')) {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+        n = 0;
+    } else if (!json_expect(cur, '{')) {
+        return ER_BUS_SIGNATURE_MISMATCH;
+    } else {
+        status = json_count(cur, QCC_TRUE, &n);
+        if (ER_OK != status) {
+            return status;
+        }
+    }
+
+    /* Keys and values of all entries come from one array */
+    entries = aj_argarena_msgargs(cur->arena, n);
+    kv = aj_argarena_msgargs(cur->arena, 2 * n);
+    if (!entries || !kv) {
+        return ER_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < n; ++i) {
+        alljoyn_msgarg key = alljoyn_msgarg_array_element(kv, 2 * i);
+        alljoyn_msgarg value = alljoyn_msgarg_array_element(kv, 2 * i + 1);
+        status = json_key(cur, sig[2], key);
+        if (ER_OK == status && !json_expect(cur, ':')) {
+            status = ER_INVALID_DATA;
+        }
+        if (ER_OK == status) {
+            status = decode_json(cur, valueSig, valueLen, value, NULL, depth + 1);
+        }
+        if (ER_OK == status) {
+            status = alljoyn_msgarg_setdictentry(alljoyn_msgarg_array_element(entries, i), key, value);
+        }
+        if (ER_OK == status) {
+            status = json_sep(cur, i, n);
+        }
+        if (ER_OK != status) {
+            return status;
+        }
+    }
+    if (n && !json_expect(cur, '}')) {
+        return ER_INVALID_DATA;
+    }
+    return set_array(cur->arena, out, sig, sigLen, entries, n);
+}
+
+static QStatus json_array(json_cursor* cur, const char* sig, size_t sigLen, alljoyn_msgarg out, int depth)
+{
+    char code = sig[1];
+    size_t n;
+    size_t i;
+    QStatus status;
+
+    if (!json_expect(cur, '[')) {
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+    status = json_count(cur, QCC_FALSE, &n);
+    if (ER_OK != status) {
+        return status;
+    }
+
+    if (scalar_size(code)) {
+        size_t size = scalar_size(code);
+        uint8_t* data = (uint8_t*) aj_argarena_alloc(cur->arena, n ? n * size : 1);
+        if (!data) {
+            return ER_OUT_OF_MEMORY;
+        }
+        for (i = 0; i < n && ER_OK == status; ++i) {
+            num_value v;
+            status = json_num(cur, &v);
+            if (ER_OK == status) {
+                status = store_num(code, &v, data + i * size);
+            }
+            if (ER_OK == status) {
+                status = json_sep(cur, i, n);
+            }
+        }
+        if (ER_OK == status) {
+            status = set_scalar_array(out, code, data, n);
+        }
+    } else if (code == 's' || code == 'o' || code == 'g') {
+        const char** strs = (const char**) aj_argarena_alloc(cur->arena, (n ? n : 1) * sizeof(char*));
+        if (!strs) {
+            return ER_OUT_OF_MEMORY;
+        }
+        for (i = 0; i < n && ER_OK == status; ++i) {
+            status = json_string(cur, &strs[i]);
+            if (ER_OK == status) {
+                status = json_sep(cur, i, n);
+            }
+        }
+        if (ER_OK == status) {
+            status = set_str_array(out, code, strs, n);
+        }
+    } else {
+        alljoyn_msgarg elems = aj_argarena_msgargs(cur->arena, n);
+        size_t k = code == '(' ? count_members(sig + 1, sigLen - 1) : 0;
+        /* Members of all struct elements come from one array */
+        alljoyn_msgarg members = k ? aj_argarena_msgargs(cur->arena, n * k) : NULL;
+        if (!elems || (k && !members)) {
+            return ER_OUT_OF_MEMORY;
+        }
+        for (i = 0; i < n && ER_OK == status; ++i) {
+            status = decode_json(cur, sig + 1, sigLen - 1, alljoyn_msgarg_array_element(elems, i),
+                                 k ? alljoyn_msgarg_array_element(members, i * k) : NULL, depth + 1);
+            if (ER_OK == status) {
+                status = json_sep(cur, i, n);
+            }
+        }
+        if (ER_OK == status) {
+            status = set_array(cur->arena, out, sig, sigLen, elems, n);
+        }
+    }
+    if (ER_OK == status && !json_expect(cur, ']')) {
+        status = ER_INVALID_DATA;
+    }
+    return status;
+}
+
+/*
+ * Decode the value at the cursor as the complete type sig[0..sigLen). For a
+ * struct, @p members may supply the member args.
+ */
+static QStatus decode_json(json_cursor* cur, const char* sig, size_t sigLen, alljoyn_msgarg out,
+                           alljoyn_msgarg members, int depth)
+{
+    QStatus status = ER_OK;
+
+    if (depth > CODEC_MAX_DEPTH) {
+        return ER_INVALID_DATA;
+    }
+    switch (sig[0]) {
+    case 's':
+    case 'o':
+    case 'g': {
+            const char* str = NULL;
+            status = json_string(cur, &str);
+            return ER_OK == status ? set_str(out, sig[0], str) : status;
+        }
+
+    case 'v': {
+            const char* inner = json_infer(cur);
+            alljoyn_msgarg arg;
+            if (!inner) {
+                return ER_BUS_SIGNATURE_MISMATCH;
+            }
+            arg = aj_argarena_msgargs(cur->arena, 1);
+            if (!arg) {
+                return ER_OUT_OF_MEMORY;
+            }
+            status = decode_json(cur, inner, strlen(inner), arg, NULL, depth + 1);
+            return ER_OK == status ? alljoyn_msgarg_set(out, "v", arg) : status;
+        }
+
+    case 'a':
+        return sig[1] == '{' ? json_dict(cur, sig, sigLen, out, depth) : json_array(cur, sig, sigLen, out, depth);
+
+    case '(': {
+            size_t k = count_members(sig, sigLen);
+            size_t pos = 1;
+            size_t i;
+            if (!members) {
+                members = aj_argarena_msgargs(cur->arena, k);
+                if (!members) {
+                    return ER_OUT_OF_MEMORY;
+                }
+            }
+            if (!json_expect(cur, '[')) {
+                return ER_BUS_SIGNATURE_MISMATCH;
+            }
+            for (i = 0; i < k && ER_OK == status; ++i) {
+                size_t n = type_len(sig + pos, 0);
+                status = decode_json(cur, sig + pos, n, alljoyn_msgarg_array_element(members, i), NULL, depth + 1);
+                if (ER_OK == status) {
+                    status = json_sep(cur, i, k);
+                }
+                pos += n;
+            }
+            if (ER_OK == status && !json_expect(cur, ']')) {
+                status = ER_BUS_SIGNATURE_MISMATCH;
+            }
+            return ER_OK == status ? alljoyn_msgarg_setstruct(out, members, k) : status;
+        }
+
+    case 'h':
+        return ER_NOT_IMPLEMENTED;
+
+    default: {
+            num_value v;
+            status = json_num(cur, &v);
+            return ER_OK == status ? set_num(out, sig[0], &v) : status;
+        }
+    }
+}
+
+/* Number of complete types in @p signature, 0 if it is invalid */
+static size_t count_types(const char* signature)
+{
+    size_t count = 0;
+    size_t pos = 0;
+
+    while (signature[pos]) {
+        size_t n = type_len(signature + pos, 0);
+        if (!n) {
+            return 0;
+        }
+        pos += n;
+        count++;
+    }
+    return count;
+}
+
+QStatus aj_argcodec_fromjson(const char* text, size_t len, const char* signature, aj_argarena arena, alljoyn_msgarg* arg)
+{
+    json_cursor cur;
+    size_t sigLen = type_len(signature, 0);
+    QStatus status;
+
+    *arg = NULL;
+    if (!sigLen || signature[sigLen]) {
+        return ER_BUS_BAD_SIGNATURE;
+    }
+    cur.p = text;
+    cur.end = text + len;
+    cur.arena = arena;
+    *arg = aj_argarena_msgargs(arena, 1);
+    if (!*arg) {
+        return ER_OUT_OF_MEMORY;
+    }
+    status = decode_json(&cur, signature, sigLen, *arg, NULL, 0);
+    json_ws(&cur);
+    if (ER_OK == status && cur.p != cur.end) {
+        status = ER_INVALID_DATA;
+    }
+    return status;
+}
+
+QStatus aj_argcodec_argsfromjson(const char* text, size_t len, const char* signature, aj_argarena arena,
+                                 alljoyn_msgarg* args, size_t* numArgs)
+{
+    size_t count = count_types(signature);
+    json_cursor cur;
+    size_t pos = 0;
+    size_t i;
+    QStatus status = ER_OK;
+
+    *args = NULL;
+    *numArgs = 0;
+    if (!count && signature[0]) {
+        return ER_BUS_BAD_SIGNATURE;
+    }
+    cur.p = text;
+    cur.end = text + len;
+    cur.arena = arena;
+    if (!json_expect(&cur, '[')) {
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+    *args = aj_argarena_msgargs(arena, count);
+    if (!*args) {
+        return ER_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < count && ER_OK == status; ++i) {
+        size_t n = type_len(signature + pos, 0);
+        status = decode_json(&cur, signature + pos, n, alljoyn_msgarg_array_element(*args, i), NULL, 0);
+        if (ER_OK == status) {
+            status = json_sep(&cur, i, count);
+        }
+        pos += n;
+    }
+    if (ER_OK == status && !json_expect(&cur, ']')) {
+        status = ER_BUS_SIGNATURE_MISMATCH;
+    }
+    json_ws(&cur);
+    if (ER_OK == status && cur.p != cur.end) {
+        status = ER_INVALID_DATA;
+    }
+    if (ER_OK == status) {
+        *numArgs = count;
+    }
+    return status;
+}
+
+/*
+ * CBOR decoder
+ */
+
+typedef struct {
+    const uint8_t* p;
+    const uint8_t* end;
+    aj_argarena arena;
+} cbor_cursor;
+
+typedef struct {
+    int major;
+    int info;                   /* low 5 bits of the initial byte */
+    uint64_t value;
+} cbor_item;
+
+static QStatus decode_cbor(cbor_cursor* cur, const char* sig, size_t sigLen, alljoyn_msgarg out,
+                           alljoyn_msgarg members, int depth);
+
+static QStatus cbor_read(cbor_cursor* cur, cbor_item* item, QCC_BOOL consume)
+{
+    const uint8_t* p = cur->p;
+    size_t bytes;
+    size_t i;
+
+    if (p >= cur->end) {
+        return ER_INVALID_DATA;
+    }
+    item->major = *p >> 5;
+    item->info = *p & 31;
+    p++;
+    if (item->info < 24) {
+        item->value = (uint64_t) item->info;
+        bytes = 0;
+    } else if (item->info <= 27) {
+        bytes = (size_t) 1 << (item->info - 24);
+    } else {
+        /* Indefinite lengths are never written by the encoder */
+        return item->info == 31 ? ER_NOT_IMPLEMENTED : ER_INVALID_DATA;
+    }
+    if ((size_t) (cur->end - p) < bytes) {
+        return ER_INVALID_DATA;
+    }
+    if (bytes) {
+        item->value = 0;
+        for (i = 0; i < bytes; ++i) {
+            item->value = (item->value << 8) | p[i];
+        }
+    }
+    if (consume) {
+        cur->p = p + bytes;
+    }
+    return ER_OK;
+}
+
+static double half_to_double(uint16_t h)
+{
+    int exp = (h >> 10) & 0x1f;
+    double mant = h & 0x3ff;
+    double d;
+
+    if (exp == 0) {
+        d = ldexp(mant, -24);
+    } else if (exp != 31) {
+        d = ldexp(mant + 1024, exp - 25);
+    } else {
+        d = mant == 0 ? INFINITY : NAN;
+    }
+    return (h & 0x8000) ? -d : d;
+}
+
+static QStatus cbor_num(cbor_cursor* cur, num_value* v)
+{
+    cbor_item item;
+    QStatus status = cbor_read(cur, &item, QCC_TRUE);
+
+    memset(v, 0, sizeof(*v));
+    if (ER_OK != status) {
+        return status;
+    }
+    switch (item.major) {
+    case CBOR_UINT:
+        v->kind = item.value <= (uint64_t) INT64_MAX ? NUM_SIGNED : NUM_UNSIGNED;
+        v->u = item.value;
+        v->i = (int64_t) item.value;
+        return ER_OK;
+
+    case CBOR_NINT:
+        if (item.value > (uint64_t) INT64_MAX) {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+        v->kind = NUM_SIGNED;
+        v->i = -1 - (int64_t) item.value;
+        return ER_OK;
+
+    case CBOR_SIMPLE:
+        if (item.info == 20 || item.info == 21) {
+            v->kind = NUM_BOOL;
+            v->i = item.info == 21;
+            return ER_OK;
+        }
+        v->kind = NUM_DOUBLE;
+        if (item.info == 25) {
+            v->d = half_to_double((uint16_t) item.value);
+        } else if (item.info == 26) {
+            uint32_t bits = (uint32_t) item.value;
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            v->d = f;
+        } else if (item.info == 27) {
+            memcpy(&v->d, &item.value, sizeof(v->d));
+        } else {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+        return ER_OK;
+
+    default:
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+}
+
+/* A text (or byte) string copied into arena memory and NUL terminated */
+static QStatus cbor_string(cbor_cursor* cur, int major, const char** str, size_t* len)
+{
+    cbor_item item;
+    QStatus status = cbor_read(cur, &item, QCC_TRUE);
+    char* dst;
+
+    if (ER_OK != status) {
+        return status;
+    }
+    if (item.major != major) {
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+    if (item.value > (uint64_t) (cur->end - cur->p)) {
+        return ER_INVALID_DATA;
+    }
+    dst = (char*) aj_argarena_alloc(cur->arena, (size_t) item.value + 1);
+    if (!dst) {
+        return ER_OUT_OF_MEMORY;
+    }
+    memcpy(dst, cur->p, (size_t) item.value);
+    dst[item.value] = '\0';
+    cur->p += item.value;
+    *str = dst;
+    if (len) {
+        *len = (size_t) item.value;
+    }
+    return ER_OK;
+}
+
+/* Read an array or map head; every element takes at least one byte, which bounds the count */
+static QStatus cbor_container(cbor_cursor* cur, int major, size_t* n)
+{
+    cbor_item item;
+    QStatus status = cbor_read(cur, &item, QCC_TRUE);
+
+    if (ER_OK != status) {
+        return status;
+    }
+    if (item.major != major) {
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+    if (item.value > (uint64_t) (cur->end - cur->p)) {
+        return ER_INVALID_DATA;
+    }
+    *n = (size_t) item.value;
+    return ER_OK;
+}
+
+static const char* cbor_infer(cbor_cursor* cur)
+{
+    cbor_item item;
+
+    if (ER_OK != cbor_read(cur, &item, QCC_FALSE)) {
+        return NULL;
+    }
+    switch (item.major) {
+    case CBOR_UINT: return item.value <= (uint64_t) INT64_MAX ? "x" : "t";
+    case CBOR_NINT: return "x";
+    case CBOR_BYTES: return "ay";
+    case CBOR_TEXT: return "s";
+    case CBOR_ARRAY: return "av";
+    case CBOR_MAP: return "a{sv}";
+    case CBOR_SIMPLE:
+        if (item.info == 20 || item.info == 21) {
+            return "b";
+        }
+        return (item.info >= 25 && item.info <= 27) ? "d" : NULL;
+    default: return NULL;
+    }
+}
+
+static QStatus cbor_dict(cbor_cursor* cur, const char* sig, size_t sigLen, alljoyn_msgarg out, int depth)
+{
+    alljoyn_msgarg entries;
+    alljoyn_msgarg kv;
+    size_t n;
+    size_t i;
+    QStatus status = cbor_container(cur, CBOR_MAP, &n);
+
+    if (ER_OK != status) {
+        return status;
+    }
+    entries = aj_argarena_msgargs(cur->arena, n);
+    kv = aj_argarena_msgargs(cur->arena, 2 * n);
+    if (!entries || !kv) {
+        return ER_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < n && ER_OK == status; ++i) {
+        alljoyn_msgarg key = alljoyn_msgarg_array_element(kv, 2 * i);
+        alljoyn_msgarg value = alljoyn_msgarg_array_element(kv, 2 * i + 1);
+        status = decode_cbor(cur, sig + 2, 1, key, NULL, depth + 1);
+        if (ER_OK == status) {
+            status = decode_cbor(cur, sig + 3, sigLen - 5, value, NULL, depth + 1);
+        }
+        if (ER_OK == status) {
+            status = alljoyn_msgarg_setdictentry(alljoyn_msgarg_array_element(entries, i), key, value);
+        }
+    }
+    return ER_OK == status ? set_array(cur->arena, out, sig, sigLen, entries, n) : status;
+}
+
+static QStatus cbor_array(cbor_cursor* cur, const char* sig, size_t sigLen, alljoyn_msgarg out, int depth)
+{
+    char code = sig[1];
+    cbor_item item;
+    size_t n;
+    size_t i;
+    QStatus status;
+
+    /* ay is written as a byte string */
+    if (code == 'y' && ER_OK == cbor_read(cur, &item, QCC_FALSE) && item.major == CBOR_BYTES) {
+        const char* bytes;
+        status = cbor_string(cur, CBOR_BYTES, &bytes, &n);
+        return ER_OK == status ? alljoyn_msgarg_set_uint8_array(out, n, (uint8_t*) bytes) : status;
+    }
+    status = cbor_container(cur, CBOR_ARRAY, &n);
+    if (ER_OK != status) {
+        return status;
+    }
+
+    if (scalar_size(code)) {
+        size_t size = scalar_size(code);
+        uint8_t* data = (uint8_t*) aj_argarena_alloc(cur->arena, n ? n * size : 1);
+        if (!data) {
+            return ER_OUT_OF_MEMORY;
+        }
+        for (i = 0; i < n && ER_OK == status; ++i) {
+            num_value v;
+            status = cbor_num(cur, &v);
+            if (ER_OK == status) {
+                status = store_num(code, &v, data + i * size);
+            }
+        }
+        return ER_OK == status ? set_scalar_array(out, code, data, n) : status;
+    } else if (code == 's' || code == 'o' || code == 'g') {
+        const char** strs = (const char**) aj_argarena_alloc(cur->arena, (n ? n : 1) * sizeof(char*));
+        if (!strs) {
+            return ER_OUT_OF_MEMORY;
+        }
+        for (i = 0; i < n && ER_OK == status; ++i) {
+            status = cbor_string(cur, CBOR_TEXT, &strs[i], NULL);
+        }
+        return ER_OK == status ? set_str_array(out, code, strs, n) : status;
+    } else {
+        alljoyn_msgarg elems = aj_argarena_msgargs(cur->arena, n);
+        size_t k = code == '(' ? count_members(sig + 1, sigLen - 1) : 0;
+        alljoyn_msgarg members = k ? aj_argarena_msgargs(cur->arena, n * k) : NULL;
+        if (!elems || (k && !members)) {
+            return ER_OUT_OF_MEMORY;
+        }
+        for (i = 0; i < n && ER_OK == status; ++i) {
+            status = decode_cbor(cur, sig + 1, sigLen - 1, alljoyn_msgarg_array_element(elems, i),
+                                 k ? alljoyn_msgarg_array_element(members, i * k) : NULL, depth + 1);
+        }
+        return ER_OK == status ? set_array(cur->arena, out, sig, sigLen, elems, n) : status;
+    }
+}
+
+static QStatus decode_cbor(cbor_cursor* cur, const char* sig, size_t sigLen, alljoyn_msgarg out,
+                           alljoyn_msgarg members, int depth)
+{
+    QStatus status = ER_OK;
+
+    if (depth > CODEC_MAX_DEPTH) {
+        return ER_INVALID_DATA;
+    }
+    switch (sig[0]) {
+    case 's':
+    case 'o':
+    case 'g': {
+            const char* str = NULL;
+            status = cbor_string(cur, CBOR_TEXT, &str, NULL);
+            return ER_OK == status ? set_str(out, sig[0], str) : status;
+        }
+
+    case 'v': {
+            const char* inner = cbor_infer(cur);
+            alljoyn_msgarg arg;
+            if (!inner) {
+                return ER_BUS_SIGNATURE_MISMATCH;
+            }
+            arg = aj_argarena_msgargs(cur->arena, 1);
+            if (!arg) {
+                return ER_OUT_OF_MEMORY;
+            }
+            status = decode_cbor(cur, inner, strlen(inner), arg, NULL, depth + 1);
+            return ER_OK == status ? alljoyn_msgarg_set(out, "v", arg) : status;
+        }
+
+    case 'a':
+        return sig[1] == '{' ? cbor_dict(cur, sig, sigLen, out, depth) : cbor_array(cur, sig, sigLen, out, depth);
+
+    case '(': {
+            size_t k = count_members(sig, sigLen);
+            size_t pos = 1;
+            size_t n;
+            size_t i;
+            status = cbor_container(cur, CBOR_ARRAY, &n);
+            if (ER_OK != status) {
+                return status;
+            }
+            if (n != k) {
+                return ER_BUS_SIGNATURE_MISMATCH;
+            }
+            if (!members) {
+                members = aj_argarena_msgargs(cur->arena, k);
+                if (!members) {
+                    return ER_OUT_OF_MEMORY;
+                }
+            }
+            for (i = 0; i < k && ER_OK == status; ++i) {
+                size_t len = type_len(sig + pos, 0);
+                status = decode_cbor(cur, sig + pos, len, alljoyn_msgarg_array_element(members, i), NULL, depth + 1);
+                pos += len;
+            }
+            return ER_OK == status ? alljoyn_msgarg_setstruct(out, members, k) : status;
+        }
+
+    case 'h':
+        return ER_NOT_IMPLEMENTED;
+
+    default: {
+            num_value v;
+            status = cbor_num(cur, &v);
+            return ER_OK == status ? set_num(out, sig[0], &v) : status;
+        }
+    }
+}
+
+QStatus aj_argcodec_fromcbor(const uint8_t* data, size_t len, const char* signature, aj_argarena arena, alljoyn_msgarg* arg)
+{
+    cbor_cursor cur;
+    size_t sigLen = type_len(signature, 0);
+    QStatus status;
+
+    *arg = NULL;
+    if (!sigLen || signature[sigLen]) {
+        return ER_BUS_BAD_SIGNATURE;
+    }
+    cur.p = data;
+    cur.end = data + len;
+    cur.arena = arena;
+    *arg = aj_argarena_msgargs(arena, 1);
+    if (!*arg) {
+        return ER_OUT_OF_MEMORY;
+    }
+    status = decode_cbor(&cur, signature, sigLen, *arg, NULL, 0);
+    if (ER_OK == status && cur.p != cur.end) {
+        status = ER_INVALID_DATA;
+    }
+    return status;
+}
+
+QStatus aj_argcodec_argsfromcbor(const uint8_t* data, size_t len, const char* signature, aj_argarena arena,
+                                 alljoyn_msgarg* args, size_t* numArgs)
+{
+    size_t count = count_types(signature);
+    cbor_cursor cur;
+    size_t pos = 0;
+    size_t n;
+    size_t i;
+    QStatus status;
+
+    *args = NULL;
+    *numArgs = 0;
+    if (!count && signature[0]) {
+        return ER_BUS_BAD_SIGNATURE;
+    }
+    cur.p = data;
+    cur.end = data + len;
+    cur.arena = arena;
+    status = cbor_container(&cur, CBOR_ARRAY, &n);
+    if (ER_OK != status) {
+        return status;
+    }
+    if (n != count) {
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+    *args = aj_argarena_msgargs(arena, count);
+    if (!*args) {
+        return ER_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < count && ER_OK == status; ++i) {
+        size_t typeLen = type_len(signature + pos, 0);
+        status = decode_cbor(&cur, signature + pos, typeLen, alljoyn_msgarg_array_element(*args, i), NULL, 0);
+        pos += typeLen;
+    }
+    if (ER_OK == status && cur.p != cur.end) {
+        status = ER_INVALID_DATA;
+    }
+    if (ER_OK == status) {
+        *numArgs = count;
+    }
+    return status;
+}
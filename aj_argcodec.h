@@ -0,0 +1,108 @@
+/**
+ * @file
+ * @brief Streaming conversion between MsgArgs and JSON or CBOR.
+ *
+ * The encoders walk a MsgArg tree by type id and append straight to a
+ * growable buffer; nothing is formatted through intermediate strings the way
+ * alljoyn_msgarg_tostring() does. Mapping:
+ *
+ * | MsgArg                  | JSON                  | CBOR                        |
+ * |-------------------------|-----------------------|-----------------------------|
+ * | integers, handles       | number                | unsigned / negative integer |
+ * | b                       | true / false          | simple value 20 / 21        |
+ * | d                       | number (NaN/Inf null) | float64                     |
+ * | s, o, g                 | string                | text string                 |
+ * | ay                      | array of numbers      | byte string                 |
+ * | other arrays, structs   | array                 | array                       |
+ * | a{..}                   | object (keys quoted)  | map (native keys)           |
+ * | v                       | the contained value   | the contained value         |
+ *
+ * Decoding needs the signature, because JSON and CBOR do not say which
+ * integer width or container type was meant. A variant, which the encoding
+ * does not type, is given the natural type of what it holds: 's', 'b', 'x'
+ * (or 't' above INT64_MAX), 'd', 'ay' (CBOR byte strings), 'av' for arrays
+ * and 'a{sv}' for objects and maps.
+ *
+ * Decoded args and everything they reference are allocated from an
+ * aj_argarena and do not reference the input text.
+ */
+#ifndef _AJ_ARGCODEC_H
+#define _AJ_ARGCODEC_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/MsgArg.h>
+
+#include "aj_argarena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Output buffer owned by the caller. The encoders append at len and grow
+ * data with realloc(); set len to 0 to reuse the buffer. data is kept NUL
+ * terminated past len so JSON output can be printed directly.
+ */
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+} aj_argbuf;
+
+/** Initialize an empty buffer. */
+void aj_argbuf_init(aj_argbuf* buf);
+
+/** Free the buffer's storage. */
+void aj_argbuf_free(aj_argbuf* buf);
+
+/**
+ * Append the JSON encoding of one arg.
+ *
+ * @return #ER_OK, #ER_OUT_OF_MEMORY, or #ER_INVALID_DATA for an arg that is
+ *         not set.
+ */
+QStatus aj_argcodec_tojson(const alljoyn_msgarg arg, aj_argbuf* out);
+
+/** Append a message body, @p numArgs args, as one JSON array. */
+QStatus aj_argcodec_argstojson(const alljoyn_msgarg args, size_t numArgs, aj_argbuf* out);
+
+/** Append the CBOR encoding of one arg. */
+QStatus aj_argcodec_tocbor(const alljoyn_msgarg arg, aj_argbuf* out);
+
+/** Append a message body, @p numArgs args, as one CBOR array. */
+QStatus aj_argcodec_argstocbor(const alljoyn_msgarg args, size_t numArgs, aj_argbuf* out);
+
+/**
+ * Decode one JSON value of the single complete type @p signature.
+ *
+ * @param text       The JSON text; need not be NUL terminated.
+ * @param len        Length of @p text.
+ * @param signature  A single complete type.
+ * @param arena      Arena the arg and its data are allocated from.
+ * @param[out] arg   Receives the arg.
+ *
+ * @return #ER_OK, #ER_BUS_BAD_SIGNATURE, or #ER_BUS_SIGNATURE_MISMATCH if the
+ *         JSON does not fit the signature.
+ */
+QStatus aj_argcodec_fromjson(const char* text, size_t len, const char* signature, aj_argarena arena, alljoyn_msgarg* arg);
+
+/**
+ * Decode a JSON array holding one value per complete type of @p signature,
+ * as written by aj_argcodec_argstojson().
+ */
+QStatus aj_argcodec_argsfromjson(const char* text, size_t len, const char* signature, aj_argarena arena,
+                                 alljoyn_msgarg* args, size_t* numArgs);
+
+/** Decode one CBOR data item; see aj_argcodec_fromjson(). */
+QStatus aj_argcodec_fromcbor(const uint8_t* data, size_t len, const char* signature, aj_argarena arena, alljoyn_msgarg* arg);
+
+/** Decode a CBOR array as written by aj_argcodec_argstocbor(). */
+QStatus aj_argcodec_argsfromcbor(const uint8_t* data, size_t len, const char* signature, aj_argarena arena,
+                                 alljoyn_msgarg* args, size_t* numArgs);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,521 @@
+/**
+ * @file
+ * @brief Asynchronous authentication listener that looks credentials up in
+ * a password file on a bounded pool of worker threads.
+ */
+#include <qcc/platform.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alljoyn_c/AuthListener.h>
+
+#include "aj_authpool.h"
+#include "aj_time.h"
+
+#define DEFAULT_WORKERS         4
+#define DEFAULT_MAX_QUEUED      256
+#define DEFAULT_CACHE_TTL_MS    60000
+#define DEFAULT_KEY_EXPIRATION  3600
+#define MAX_WORKERS             64
+#define MAX_AUTH_COUNT          3
+#define CACHE_SLOTS             256     /* direct-mapped by user name */
+#define PENDING_SLOTS           64      /* direct-mapped by peer name */
+#define MAX_LINE                512
+#define ANY_USER                "*"
+
+typedef struct _auth_job {
+    struct _auth_job* next;
+    alljoyn_authlistener listener;
+    void* authContext;
+    QCC_BOOL verify;
+    char* peerName;
+    char* userName;
+    char* password;                     /* verify only: the password the peer presented */
+} auth_job;
+
+/*
+ * A cache slot is keyed by user name; a pending slot by the peer whose
+ * lookup succeeded, until authentication_complete says whether the peer
+ * knew the password.
+ */
+typedef struct {
+    char* key;
+    char* userName;
+    char* password;
+    uint64_t expiresAt;
+} auth_entry;
+
+struct _aj_authpool_handle {
+    alljoyn_busattachment bus;
+    alljoyn_authlistener listener;
+    char* passwordFile;
+    aj_authpool_config config;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t workers[MAX_WORKERS];
+    uint32_t numStarted;
+    QCC_BOOL stopping;
+
+    auth_job* head;
+    auth_job* tail;
+    uint32_t depth;
+
+    auth_entry cache[CACHE_SLOTS];
+    auth_entry pending[PENDING_SLOTS];
+
+    aj_authpool_stats stats;
+};
+
+static uint32_t hash_name(const char* name)
+{
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (uint8_t) *name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static char* dup_or_null(const char* s)
+{
+    return (s && *s) ? strdup(s) : NULL;
+}
+
+static const char* user_key(const char* userName)
+{
+    return (userName && *userName) ? userName : ANY_USER;
+}
+
+static void clear_entry(auth_entry* e)
+{
+    free(e->key);
+    free(e->userName);
+    free(e->password);
+    memset(e, 0, sizeof(*e));
+}
+
+static void free_job(auth_job* job)
+{
+    free(job->peerName);
+    free(job->userName);
+    free(job->password);
+    free(job);
+}
+
+/* Password of @p userName in the file, or NULL. The caller frees it. */
+static char* lookup_password(const char* path, const char* userName)
+{
+    char line[MAX_LINE];
+    char* password = NULL;
+    FILE* fp = fopen(path, "r");
+
+    if (!fp) {
+        printf("aj_authpool: cannot open %s\n", path);
+        return NULL;
+    }
+    while (!password && fgets(line, sizeof(line), fp)) {
+        char* sep;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || !(sep = strchr(line, ':'))) {
+            continue;
+        }
+        *sep = '\0';
+        if (0 == strcmp(line, userName)) {
+            password = strdup(sep + 1);
+        }
+    }
+    fclose(fp);
+    return password;
+}
+
+/* Cached password of @p userName, copied, or NULL. Called with the lock held. */
+static char* cache_get(aj_authpool pool, const char* userName)
+{
+    auth_entry* e = &pool->cache[hash_name(userName) & (CACHE_SLOTS - 1)];
+
+    if (!e->key || strcmp(e->key, userName)) {
+        return NULL;
+    }
+    if (aj_time_now_ms() >= e->expiresAt) {
+        clear_entry(e);
+        return NULL;
+    }
+    return strdup(e->password);
+}
+
+/* Remember which user a peer looked up until its authentication completes */
+static void set_pending(aj_authpool pool, const char* peerName, const char* userName, const char* password)
+{
+    auth_entry* e;
+
+    if (!peerName) {
+        return;
+    }
+    e = &pool->pending[hash_name(peerName) & (PENDING_SLOTS - 1)];
+    pthread_mutex_lock(&pool->lock);
+    clear_entry(e);
+    e->key = strdup(peerName);
+    e->userName = strdup(userName);
+    e->password = strdup(password);
+    if (!e->key || !e->userName || !e->password) {
+        clear_entry(e);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void respond_credentials(aj_authpool pool, alljoyn_authlistener listener, void* authContext,
+                                const char* userName, const char* password)
+{
+    alljoyn_credentials credentials = NULL;
+
+    if (password) {
+        credentials = alljoyn_credentials_create();
+        alljoyn_credentials_setpassword(credentials, password);
+        if (userName) {
+            alljoyn_credentials_setusername(credentials, userName);
+        }
+        alljoyn_credentials_setexpiration(credentials, pool->config.keyExpiration);
+    }
+    alljoyn_authlistener_requestcredentialsresponse(listener, authContext, password ? QCC_TRUE : QCC_FALSE,
+                                                    credentials);
+    if (credentials) {
+        alljoyn_credentials_destroy(credentials);
+    }
+}
+
+static void reject(aj_authpool pool, const auth_job* job)
+{
+    if (job->verify) {
+        alljoyn_authlistener_verifycredentialsresponse(job->listener, job->authContext, QCC_FALSE);
+    } else {
+        alljoyn_authlistener_requestcredentialsresponse(job->listener, job->authContext, QCC_FALSE, NULL);
+    }
+}
+
+static void process(aj_authpool pool, const auth_job* job)
+{
+    const char* userName = user_key(job->userName);
+    char* password = lookup_password(pool->passwordFile, userName);
+    QCC_BOOL accept = password ? QCC_TRUE : QCC_FALSE;
+
+    if (!password) {
+        __sync_fetch_and_add(&pool->stats.notFound, 1);
+        printf("aj_authpool: no password for user %s\n", userName);
+    }
+    if (job->verify) {
+        if (password && (!job->password || strcmp(password, job->password))) {
+            accept = QCC_FALSE;
+        }
+        if (accept) {
+            set_pending(pool, job->peerName, userName, password);
+        }
+        alljoyn_authlistener_verifycredentialsresponse(job->listener, job->authContext, accept);
+    } else {
+        if (accept) {
+            set_pending(pool, job->peerName, userName, password);
+        }
+        respond_credentials(pool, job->listener, job->authContext, job->userName, password);
+    }
+    free(password);
+}
+
+static void* worker_thread(void* arg)
+{
+    aj_authpool pool = (aj_authpool) arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        auth_job* job;
+        QCC_BOOL stopping;
+
+        while (!pool->head && !pool->stopping) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (!pool->head) {
+            break;
+        }
+        job = pool->head;
+        pool->head = job->next;
+        if (!pool->head) {
+            pool->tail = NULL;
+        }
+        pool->depth--;
+
+        stopping = pool->stopping;
+
+        /* Look up and respond without the lock; the file read is what the pool is for */
+        pthread_mutex_unlock(&pool->lock);
+        if (stopping) {
+            __sync_fetch_and_add(&pool->stats.rejected, 1);
+            reject(pool, job);
+        } else {
+            process(pool, job);
+        }
+        free_job(job);
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/* Queue a job, or reject it inline if the queue is full. Takes ownership of @p job. */
+static void submit(aj_authpool pool, auth_job* job)
+{
+    QCC_BOOL full;
+
+    pthread_mutex_lock(&pool->lock);
+    full = pool->stopping || pool->depth >= pool->config.maxQueued;
+    if (!full) {
+        job->next = NULL;
+        if (pool->tail) {
+            pool->tail->next = job;
+        } else {
+            pool->head = job;
+        }
+        pool->tail = job;
+        if (++pool->depth > pool->stats.maxDepth) {
+            pool->stats.maxDepth = pool->depth;
+        }
+        pthread_cond_signal(&pool->wake);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (full) {
+        __sync_fetch_and_add(&pool->stats.rejected, 1);
+        reject(pool, job);
+        free_job(job);
+    } else {
+        __sync_fetch_and_add(&pool->stats.queued, 1);
+    }
+}
+
+static auth_job* new_job(alljoyn_authlistener listener, void* authContext, QCC_BOOL verify, const char* peerName,
+                         const char* userName, const char* password)
+{
+    auth_job* job = (auth_job*) calloc(1, sizeof(auth_job));
+
+    if (job) {
+        job->listener = listener;
+        job->authContext = authContext;
+        job->verify = verify;
+        job->peerName = dup_or_null(peerName);
+        job->userName = dup_or_null(userName);
+        job->password = dup_or_null(password);
+    }
+    return job;
+}
+
+static QStatus request_credentials(const void* context, alljoyn_authlistener listener, const char* authMechanism,
+                                   const char* peerName, uint16_t authCount, const char* userName,
+                                   uint16_t credMask, void* authContext)
+{
+    aj_authpool pool = (aj_authpool) context;
+    char* password;
+    auth_job* job;
+
+    __sync_fetch_and_add(&pool->stats.requests, 1);
+    if (authCount > MAX_AUTH_COUNT || !(credMask & ALLJOYN_CRED_PASSWORD)) {
+        alljoyn_authlistener_requestcredentialsresponse(listener, authContext, QCC_FALSE, NULL);
+        return ER_OK;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    password = cache_get(pool, user_key(userName));
+    pthread_mutex_unlock(&pool->lock);
+    if (password) {
+        __sync_fetch_and_add(&pool->stats.cacheHits, 1);
+        respond_credentials(pool, listener, authContext, userName, password);
+        free(password);
+        return ER_OK;
+    }
+
+    job = new_job(listener, authContext, QCC_FALSE, peerName, userName, NULL);
+    if (!job) {
+        alljoyn_authlistener_requestcredentialsresponse(listener, authContext, QCC_FALSE, NULL);
+        return ER_OK;
+    }
+    submit(pool, job);
+    return ER_OK;
+}
+
+static QStatus verify_credentials(const void* context, alljoyn_authlistener listener, const char* authMechanism,
+                                  const char* peerName, const alljoyn_credentials credentials, void* authContext)
+{
+    aj_authpool pool = (aj_authpool) context;
+    const char* userName = alljoyn_credentials_isset(credentials, ALLJOYN_CRED_USER_NAME) ?
+                           alljoyn_credentials_getusername(credentials) : NULL;
+    const char* presented = alljoyn_credentials_isset(credentials, ALLJOYN_CRED_PASSWORD) ?
+                            alljoyn_credentials_getpassword(credentials) : NULL;
+    char* password;
+    auth_job* job;
+
+    __sync_fetch_and_add(&pool->stats.requests, 1);
+    pthread_mutex_lock(&pool->lock);
+    password = cache_get(pool, user_key(userName));
+    pthread_mutex_unlock(&pool->lock);
+    if (password) {
+        __sync_fetch_and_add(&pool->stats.cacheHits, 1);
+        alljoyn_authlistener_verifycredentialsresponse(listener, authContext,
+                                                       (presented && 0 == strcmp(presented, password)) ?
+                                                       QCC_TRUE : QCC_FALSE);
+        free(password);
+        return ER_OK;
+    }
+
+    /* The credentials are only valid during this call, so the job keeps copies */
+    job = new_job(listener, authContext, QCC_TRUE, peerName, userName, presented);
+    if (!job) {
+        alljoyn_authlistener_verifycredentialsresponse(listener, authContext, QCC_FALSE);
+        return ER_OK;
+    }
+    submit(pool, job);
+    return ER_OK;
+}
+
+static void authentication_complete(const void* context, const char* authMechanism, const char* peerName,
+                                    QCC_BOOL success)
+{
+    aj_authpool pool = (aj_authpool) context;
+    auth_entry* pending;
+
+    if (success) {
+        __sync_fetch_and_add(&pool->stats.completed, 1);
+    } else {
+        __sync_fetch_and_add(&pool->stats.failed, 1);
+        printf("aj_authpool: authentication with %s failed\n", peerName ? peerName : "<unknown>");
+    }
+    if (!peerName) {
+        return;
+    }
+
+    /* Only a user whose peer proved it knows the password goes into the cache */
+    pthread_mutex_lock(&pool->lock);
+    pending = &pool->pending[hash_name(peerName) & (PENDING_SLOTS - 1)];
+    if (pending->key && 0 == strcmp(pending->key, peerName)) {
+        if (success) {
+            auth_entry* e = &pool->cache[hash_name(pending->userName) & (CACHE_SLOTS - 1)];
+            clear_entry(e);
+            e->key = pending->userName;
+            e->password = pending->password;
+            e->expiresAt = aj_time_now_ms() + pool->config.cacheTtlMs;
+            pending->userName = NULL;
+            pending->password = NULL;
+        }
+        clear_entry(pending);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+aj_authpool aj_authpool_create(alljoyn_busattachment bus, const char* passwordFile, const char* keyStore,
+                               const aj_authpool_config* config)
+{
+    alljoyn_authlistenerasync_callbacks callbacks = {
+        &request_credentials,
+        &verify_credentials,
+        NULL,
+        &authentication_complete
+    };
+    aj_authpool pool = (aj_authpool) calloc(1, sizeof(struct _aj_authpool_handle));
+    QStatus status;
+
+    if (!pool) {
+        return NULL;
+    }
+    if (config) {
+        pool->config = *config;
+    }
+    if (!pool->config.mechanisms) {
+        pool->config.mechanisms = AJ_AUTHPOOL_MECHANISMS;
+    }
+    if (!pool->config.numWorkers) {
+        pool->config.numWorkers = DEFAULT_WORKERS;
+    }
+    if (pool->config.numWorkers > MAX_WORKERS) {
+        pool->config.numWorkers = MAX_WORKERS;
+    }
+    if (!pool->config.maxQueued) {
+        pool->config.maxQueued = DEFAULT_MAX_QUEUED;
+    }
+    if (!pool->config.cacheTtlMs) {
+        pool->config.cacheTtlMs = DEFAULT_CACHE_TTL_MS;
+    }
+    if (!pool->config.keyExpiration) {
+        pool->config.keyExpiration = DEFAULT_KEY_EXPIRATION;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+
+    pool->passwordFile = strdup(passwordFile);
+    pool->listener = alljoyn_authlistenerasync_create(&callbacks, pool);
+    if (!pool->passwordFile || !pool->listener) {
+        aj_authpool_destroy(pool);
+        return NULL;
+    }
+    for (pool->numStarted = 0; pool->numStarted < pool->config.numWorkers; ++pool->numStarted) {
+        if (pthread_create(&pool->workers[pool->numStarted], NULL, worker_thread, pool) != 0) {
+            break;
+        }
+    }
+    if (!pool->numStarted) {
+        aj_authpool_destroy(pool);
+        return NULL;
+    }
+
+    status = alljoyn_busattachment_enablepeersecurity(bus, pool->config.mechanisms, pool->listener, keyStore,
+                                                      pool->config.isShared);
+    if (ER_OK != status) {
+        printf("aj_authpool: cannot enable peer security (%s)\n", QCC_StatusText(status));
+        aj_authpool_destroy(pool);
+        return NULL;
+    }
+    pool->bus = bus;
+    return pool;
+}
+
+void aj_authpool_destroy(aj_authpool pool)
+{
+    uint32_t i;
+
+    if (!pool) {
+        return;
+    }
+
+    /* Workers reject what is still queued; requests arriving meanwhile are rejected inline */
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = QCC_TRUE;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->numStarted; ++i) {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    /* The bus must stop calling the listener before it goes */
+    if (pool->bus) {
+        alljoyn_busattachment_enablepeersecurity(pool->bus, NULL, NULL, NULL, QCC_FALSE);
+    }
+    if (pool->listener) {
+        alljoyn_authlistenerasync_destroy(pool->listener);
+    }
+    for (i = 0; i < CACHE_SLOTS; ++i) {
+        clear_entry(&pool->cache[i]);
+    }
+    for (i = 0; i < PENDING_SLOTS; ++i) {
+        clear_entry(&pool->pending[i]);
+    }
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->passwordFile);
+    free(pool);
+}
+
+void aj_authpool_getstats(aj_authpool pool, aj_authpool_stats* stats)
+{
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+}
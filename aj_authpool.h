@@ -0,0 +1,92 @@
+/**
+ * @file
+ * @brief Asynchronous authentication listener that looks credentials up in
+ * a password file on a bounded pool of worker threads.
+ *
+ * A synchronous auth listener answers on the AllJoyn dispatcher thread, so
+ * when many peers authenticate at once, e.g. after a hub reboot, every
+ * password lookup waits for the one before it. This listener is created
+ * with alljoyn_authlistenerasync_create(). It queues each credential
+ * request and verification and returns at once. A worker reads the
+ * password file and completes the request with
+ * alljoyn_authlistener_requestcredentialsresponse() or
+ * alljoyn_authlistener_verifycredentialsresponse(). When the queue is full
+ * the request is rejected, and the peer retries later.
+ *
+ * A user whose peer authenticated successfully is cached with its password
+ * for cacheTtlMs. Further requests for that user are answered on the
+ * dispatcher thread without touching the file or the queue. The cache is
+ * keyed by user name, because peers come back under new unique names after
+ * a reboot.
+ *
+ * Password file: one "user:password" per line. Empty lines and lines
+ * starting with '#' are ignored. Requests that name no user, such as those
+ * of ALLJOYN_SRP_KEYX, use the entry of the user "*". The file is read on
+ * every lookup, so edits apply to the next peer that misses the cache.
+ */
+#ifndef _AJ_AUTHPOOL_H
+#define _AJ_AUTHPOOL_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusAttachment.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Mechanisms enabled when the config names none. */
+#define AJ_AUTHPOOL_MECHANISMS  "ALLJOYN_SRP_LOGON ALLJOYN_SRP_KEYX"
+
+/** Listener handle */
+typedef struct _aj_authpool_handle* aj_authpool;
+
+/** Tuning parameters. Zero fields take the defaults noted below. */
+typedef struct {
+    const char* mechanisms;     /**< Space-separated mechanisms (#AJ_AUTHPOOL_MECHANISMS) */
+    uint32_t numWorkers;        /**< Worker threads (4) */
+    uint32_t maxQueued;         /**< Requests waiting for a worker before new ones are rejected (256) */
+    uint32_t cacheTtlMs;        /**< Lifetime of a cached user (60000) */
+    uint32_t keyExpiration;     /**< Lifetime of a master secret in seconds (3600) */
+    QCC_BOOL isShared;          /**< Key store shared with other processes (QCC_FALSE) */
+} aj_authpool_config;
+
+/** Counters. */
+typedef struct {
+    uint32_t requests;          /**< Credential requests and verifications */
+    uint32_t cacheHits;         /**< Answered from the cache on the dispatcher thread */
+    uint32_t queued;            /**< Handed to a worker */
+    uint32_t rejected;          /**< Rejected because the queue was full or the pool stopping */
+    uint32_t notFound;          /**< Lookups that found no entry for the user */
+    uint32_t maxDepth;          /**< Highest queue depth seen */
+    uint32_t completed;         /**< Successful authentications */
+    uint32_t failed;            /**< Failed authentications */
+} aj_authpool_stats;
+
+/**
+ * Start the workers and enable peer security on a started bus.
+ *
+ * @param bus           The bus; alljoyn_busattachment_start() must have been called.
+ * @param passwordFile  The password file.
+ * @param keyStore      Key store file name; see alljoyn_busattachment_enablepeersecurity().
+ * @param config        Tuning parameters, or NULL for the defaults.
+ *
+ * @return the handle, or NULL on failure.
+ */
+aj_authpool aj_authpool_create(alljoyn_busattachment bus, const char* passwordFile, const char* keyStore,
+                               const aj_authpool_config* config);
+
+/**
+ * Reject the requests still queued, stop the workers, disable peer
+ * security and free the handle. Call before the bus is destroyed.
+ */
+void aj_authpool_destroy(aj_authpool pool);
+
+/** Copy the counters. */
+void aj_authpool_getstats(aj_authpool pool, aj_authpool_stats* stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,917 @@
+/**
+ * @file
+ * @brief Client-side load balancer across service instances that advertise
+ * unique names under a common prefix.
+ */
+#include <qcc/platform.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alljoyn_c/BusListener.h>
+#include <alljoyn_c/ProxyBusObject.h>
+#include <alljoyn_c/SessionListener.h>
+
+#include "aj_balancer.h"
+#include "aj_disccache.h"
+#include "aj_linkmon.h"
+#include "aj_time.h"
+
+#define DEFAULT_EWMA_ALPHA          0.2
+#define DEFAULT_EJECT_FACTOR        3.0
+#define DEFAULT_EJECT_MIN_SAMPLES   10
+#define DEFAULT_EJECT_MS            10000
+#define DEFAULT_HOLDOFF_MS          3000
+#define DEFAULT_PING_INTERVAL_MS    2000
+#define DISCOVERY_TTL_MS            60000
+#define REJOIN_DELAY_MS             1000    /* before a dropped instance that still advertises is joined again */
+
+#define HEDGE_WINDOW                256     /* latency samples kept per hedged method */
+#define HEDGE_MIN_SAMPLES           20      /* no hedging until the percentile means something */
+#define HEDGE_REFRESH               16      /* recompute the percentile every this many samples */
+#define HEDGE_GRACE_MS              1000    /* extra wait past the timeout for the reply handler */
+
+typedef struct _bal_instance {
+    char* name;
+    alljoyn_sessionid sessionId;
+    alljoyn_proxybusobject proxy;
+    uint32_t outstanding;
+    uint32_t refs;              /* the pool's reference plus one per call in flight */
+    double ewmaMs;
+    uint32_t samples;
+    uint32_t calls;
+    uint32_t errors;
+    uint64_t ejectedUntil;
+    QCC_BOOL suspect;           /* missing health pings, avoided like an ejected instance */
+    QCC_BOOL removed;
+} bal_instance;
+
+typedef struct {
+    char* methodName;
+    double percentile;
+    double samples[HEDGE_WINDOW];
+    uint32_t numSamples;
+    uint32_t next;
+    uint32_t sinceRefresh;
+    uint32_t delayMs;           /* cached percentile, 0 while warming up */
+} bal_hedge;
+
+struct _hedge_call;
+
+typedef struct {
+    struct _hedge_call* call;
+    bal_instance* inst;
+    uint64_t start;
+    int index;
+} hedge_leg;
+
+typedef struct _hedge_call {
+    aj_balancer balancer;
+    bal_hedge* hedge;
+    pthread_cond_t done;
+    uint32_t refs;              /* the caller plus one per leg in flight */
+    int legsIssued;
+    int legsDone;
+    int winner;                 /* leg whose reply is used, -1 while none */
+    QCC_BOOL complete;
+    QCC_BOOL orphaned;          /* the caller gave up; late replies are only accounted */
+    QStatus status;
+    alljoyn_msgarg replyArgs;
+    size_t numReplyArgs;
+    hedge_leg legs[2];
+} hedge_call;
+
+struct _aj_balancer_handle {
+    alljoyn_busattachment bus;
+    char* namePrefix;
+    alljoyn_sessionport port;
+    char* path;
+    char* ifaceName;
+    aj_balancer_config config;
+    aj_balancer_callbacks callbacks;
+    const void* context;
+
+    aj_disccache discCache;
+    aj_linkmon linkMon;
+    alljoyn_buslistener busListener;
+    alljoyn_sessionlistener sessionListener;
+    QCC_BOOL started;
+    QCC_BOOL stopping;          /* the discovery cache is going away */
+
+    pthread_mutex_t lock;
+    bal_instance** instances;
+    size_t numInstances;
+    size_t capInstances;
+
+    bal_hedge** hedges;         /* stable pointers, in-flight calls keep using them */
+    size_t numHedges;
+    aj_balancer_hedgestats hedgeStats;
+    uint32_t legsInFlight;      /* hedge legs whose reply handler has not run yet */
+    pthread_cond_t legsDrained;
+};
+
+static void release_instance(bal_instance* inst)
+{
+    /* Called with the balancer lock held */
+    if (--inst->refs == 0) {
+        if (inst->proxy) {
+            alljoyn_proxybusobject_destroy(inst->proxy);
+        }
+        free(inst->name);
+        free(inst);
+    }
+}
+
+/* Detach an instance from the pool. Called with the lock held; returns the name for notification. */
+static char* detach_instance(aj_balancer balancer, size_t index)
+{
+    bal_instance* inst = balancer->instances[index];
+    char* name = strdup(inst->name);
+
+    balancer->instances[index] = balancer->instances[--balancer->numInstances];
+    inst->removed = QCC_TRUE;
+    release_instance(inst);
+    return name;
+}
+
+/*
+ * Have discovery offer an instance again shortly; it is joined anew if it
+ * still advertises by then. Called with the lock held.
+ */
+static void schedule_rejoin(aj_balancer balancer, const char* name)
+{
+    if (name && !balancer->stopping) {
+        aj_disccache_redeliver(balancer->discCache, name, REJOIN_DELAY_MS);
+    }
+}
+
+static void notify_left(aj_balancer balancer, char* name)
+{
+    if (name && balancer->callbacks.instance_left) {
+        balancer->callbacks.instance_left(balancer->context, name);
+    }
+    free(name);
+}
+
+static void instance_available(const void* context, const char* name, alljoyn_transportmask transports)
+{
+    aj_balancer balancer = (aj_balancer) context;
+    alljoyn_sessionopts opts;
+    alljoyn_sessionid sessionId = 0;
+    alljoyn_proxybusobject proxy;
+    bal_instance* inst;
+    QStatus status;
+
+    opts = alljoyn_sessionopts_create(ALLJOYN_TRAFFIC_TYPE_MESSAGES, QCC_FALSE, ALLJOYN_PROXIMITY_ANY, ALLJOYN_TRANSPORT_ANY);
+    status = alljoyn_busattachment_joinsession(balancer->bus, name, balancer->port, balancer->sessionListener,
+                                               &sessionId, opts);
+    alljoyn_sessionopts_destroy(opts);
+    if (ER_OK != status) {
+        printf("aj_balancer: joinsession(%s) failed (%s)\n", name, QCC_StatusText(status));
+        pthread_mutex_lock(&balancer->lock);
+        schedule_rejoin(balancer, name);
+        pthread_mutex_unlock(&balancer->lock);
+        return;
+    }
+
+    proxy = alljoyn_proxybusobject_create(balancer->bus, name, balancer->path, sessionId);
+    status = proxy ? alljoyn_proxybusobject_addinterface_by_name(proxy, balancer->ifaceName) : ER_OUT_OF_MEMORY;
+    inst = (ER_OK == status) ? (bal_instance*) calloc(1, sizeof(bal_instance)) : NULL;
+    if (inst) {
+        inst->name = strdup(name);
+    }
+    if (!inst || !inst->name) {
+        printf("aj_balancer: cannot add instance %s (%s)\n", name, QCC_StatusText(status));
+        free(inst);
+        if (proxy) {
+            alljoyn_proxybusobject_destroy(proxy);
+        }
+        alljoyn_busattachment_leavesession(balancer->bus, sessionId);
+        return;
+    }
+    inst->sessionId = sessionId;
+    inst->proxy = proxy;
+    inst->refs = 1;
+
+    pthread_mutex_lock(&balancer->lock);
+    if (balancer->numInstances == balancer->capInstances) {
+        size_t newCap = balancer->capInstances ? balancer->capInstances * 2 : 4;
+        bal_instance** grown = (bal_instance**) realloc(balancer->instances, newCap * sizeof(bal_instance*));
+        if (!grown) {
+            release_instance(inst);
+            pthread_mutex_unlock(&balancer->lock);
+            alljoyn_busattachment_leavesession(balancer->bus, sessionId);
+            return;
+        }
+        balancer->instances = grown;
+        balancer->capInstances = newCap;
+    }
+    balancer->instances[balancer->numInstances++] = inst;
+    pthread_mutex_unlock(&balancer->lock);
+
+    aj_linkmon_add(balancer->linkMon, sessionId, name);
+
+    if (balancer->callbacks.instance_joined) {
+        balancer->callbacks.instance_joined(balancer->context, name, sessionId);
+    }
+}
+
+static void instance_unavailable(const void* context, const char* name)
+{
+    aj_balancer balancer = (aj_balancer) context;
+    alljoyn_sessionid sessionId = 0;
+    char* left = NULL;
+    size_t i;
+
+    pthread_mutex_lock(&balancer->lock);
+    for (i = 0; i < balancer->numInstances; ++i) {
+        if (0 == strcmp(balancer->instances[i]->name, name)) {
+            sessionId = balancer->instances[i]->sessionId;
+            left = detach_instance(balancer, i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&balancer->lock);
+
+    if (left) {
+        aj_linkmon_remove(balancer->linkMon, sessionId);
+        alljoyn_busattachment_leavesession(balancer->bus, sessionId);
+        notify_left(balancer, left);
+    }
+}
+
+static void session_lost(const void* context, alljoyn_sessionid sessionId, alljoyn_sessionlostreason reason)
+{
+    aj_balancer balancer = (aj_balancer) context;
+    char* left = NULL;
+    size_t i;
+
+    pthread_mutex_lock(&balancer->lock);
+    for (i = 0; i < balancer->numInstances; ++i) {
+        if (balancer->instances[i]->sessionId == sessionId) {
+            left = detach_instance(balancer, i);
+            schedule_rejoin(balancer, left);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&balancer->lock);
+
+    if (left) {
+        aj_linkmon_remove(balancer->linkMon, sessionId);
+    }
+    notify_left(balancer, left);
+}
+
+/* Runs on the monitor thread */
+static void link_state_changed(const void* context, alljoyn_sessionid sessionId, const char* peer, aj_linkmon_state state)
+{
+    aj_balancer balancer = (aj_balancer) context;
+    char* left = NULL;
+    size_t i;
+
+    pthread_mutex_lock(&balancer->lock);
+    for (i = 0; i < balancer->numInstances; ++i) {
+        bal_instance* inst = balancer->instances[i];
+        if (inst->sessionId != sessionId) {
+            continue;
+        }
+        if (state == AJ_LINKMON_DEAD) {
+            left = detach_instance(balancer, i);
+            schedule_rejoin(balancer, left);
+        } else {
+            inst->suspect = (state == AJ_LINKMON_SUSPECT) ? QCC_TRUE : QCC_FALSE;
+        }
+        break;
+    }
+    pthread_mutex_unlock(&balancer->lock);
+
+    if (state != AJ_LINKMON_ALIVE) {
+        printf("aj_balancer: instance %s is %s\n", peer, (state == AJ_LINKMON_DEAD) ? "not responding, dropped" : "missing pings");
+    }
+    /* Fail over now rather than when the router gives up on the link */
+    if (left) {
+        aj_linkmon_remove(balancer->linkMon, sessionId);
+        alljoyn_busattachment_leavesession(balancer->bus, sessionId);
+        notify_left(balancer, left);
+    }
+}
+
+/*
+ * Least outstanding requests wins; ties go to the lower latency. @p exclude
+ * is skipped so a hedge lands on a different instance. Called with the lock held.
+ */
+static bal_instance* pick_instance(aj_balancer balancer, uint64_t now, const bal_instance* exclude)
+{
+    bal_instance* best = NULL;
+    bal_instance* fallback = NULL;
+    size_t i;
+
+    for (i = 0; i < balancer->numInstances; ++i) {
+        bal_instance* inst = balancer->instances[i];
+        if (inst == exclude) {
+            continue;
+        }
+        if (inst->ejectedUntil > now || inst->suspect) {
+            if (!fallback || inst->ewmaMs < fallback->ewmaMs) {
+                fallback = inst;
+            }
+            continue;
+        }
+        if (!best || inst->outstanding < best->outstanding ||
+            (inst->outstanding == best->outstanding && inst->ewmaMs < best->ewmaMs)) {
+            best = inst;
+        }
+    }
+    /* Every instance is ejected: degrade to the least slow one rather than fail */
+    return best ? best : fallback;
+}
+
+/* Fold a latency sample into the EWMA and eject the instance if it lags. Called with the lock held. */
+static void record_latency(aj_balancer balancer, bal_instance* inst, double ms, uint64_t now)
+{
+    double bestMs = 0;
+    size_t healthy = 0;
+    size_t i;
+
+    if (inst->samples == 0) {
+        inst->ewmaMs = ms;
+    } else {
+        inst->ewmaMs += balancer->config.ewmaAlpha * (ms - inst->ewmaMs);
+    }
+    inst->samples++;
+
+    if (inst->removed || inst->samples < balancer->config.ejectMinSamples) {
+        return;
+    }
+    for (i = 0; i < balancer->numInstances; ++i) {
+        bal_instance* other = balancer->instances[i];
+        if (other == inst || other->ejectedUntil > now || other->suspect || other->samples < balancer->config.ejectMinSamples) {
+            continue;
+        }
+        if (!healthy || other->ewmaMs < bestMs) {
+            bestMs = other->ewmaMs;
+        }
+        healthy++;
+    }
+    /* Never eject the last healthy instance */
+    if (healthy && inst->ewmaMs > balancer->config.ejectFactor * bestMs) {
+        inst->ejectedUntil = now + balancer->config.ejectMs;
+        /* Re-admit on probation: it starts from the best latency and must prove itself again */
+        inst->ewmaMs = bestMs;
+        inst->samples = 0;
+        printf("aj_balancer: ejected slow instance %s for %u ms\n", inst->name, balancer->config.ejectMs);
+    }
+}
+
+aj_balancer aj_balancer_create(alljoyn_busattachment bus, const char* namePrefix, alljoyn_sessionport port,
+                               const char* path, const char* ifaceName, const aj_balancer_config* config,
+                               const aj_balancer_callbacks* callbacks, const void* context)
+{
+    aj_disccache_callbacks discCallbacks = {
+        &instance_available,
+        &instance_unavailable
+    };
+    alljoyn_sessionlistener_callbacks slCallbacks = {
+        &session_lost,
+        NULL,
+        NULL
+    };
+    aj_linkmon_callbacks lmCallbacks = {
+        &link_state_changed,
+        NULL
+    };
+    aj_linkmon_config lmConfig;
+    aj_balancer balancer = (aj_balancer) calloc(1, sizeof(struct _aj_balancer_handle));
+
+    if (!balancer) {
+        return NULL;
+    }
+    balancer->bus = bus;
+    balancer->port = port;
+    balancer->namePrefix = strdup(namePrefix);
+    balancer->path = strdup(path);
+    balancer->ifaceName = strdup(ifaceName);
+    if (config) {
+        balancer->config = *config;
+    }
+    if (balancer->config.ewmaAlpha <= 0) {
+        balancer->config.ewmaAlpha = DEFAULT_EWMA_ALPHA;
+    }
+    if (balancer->config.ejectFactor <= 0) {
+        balancer->config.ejectFactor = DEFAULT_EJECT_FACTOR;
+    }
+    if (!balancer->config.ejectMinSamples) {
+        balancer->config.ejectMinSamples = DEFAULT_EJECT_MIN_SAMPLES;
+    }
+    if (!balancer->config.ejectMs) {
+        balancer->config.ejectMs = DEFAULT_EJECT_MS;
+    }
+    if (!balancer->config.holdoffMs) {
+        balancer->config.holdoffMs = DEFAULT_HOLDOFF_MS;
+    }
+    if (!balancer->config.pingIntervalMs) {
+        balancer->config.pingIntervalMs = DEFAULT_PING_INTERVAL_MS;
+    }
+    if (callbacks) {
+        balancer->callbacks = *callbacks;
+    }
+    balancer->context = context;
+    pthread_mutex_init(&balancer->lock, NULL);
+    pthread_cond_init(&balancer->legsDrained, NULL);
+
+    memset(&lmConfig, 0, sizeof(lmConfig));
+    lmConfig.pingIntervalMs = balancer->config.pingIntervalMs;
+    balancer->linkMon = aj_linkmon_create(bus, &lmConfig, &lmCallbacks, balancer);
+
+    balancer->sessionListener = alljoyn_sessionlistener_create(&slCallbacks, balancer);
+    balancer->discCache = aj_disccache_create(&discCallbacks, balancer, balancer->config.holdoffMs, DISCOVERY_TTL_MS);
+    if (!balancer->namePrefix || !balancer->path || !balancer->ifaceName ||
+        !balancer->sessionListener || !balancer->discCache || !balancer->linkMon) {
+        aj_balancer_destroy(balancer);
+        return NULL;
+    }
+    return balancer;
+}
+
+QStatus aj_balancer_start(aj_balancer balancer)
+{
+    /* Discovery events go straight into the cache; joins happen on its thread */
+    alljoyn_buslistener_callbacks callbacks = {
+        NULL,
+        NULL,
+        &aj_disccache_found_advertised_name,
+        &aj_disccache_lost_advertised_name,
+        NULL,
+        NULL,
+        NULL,
+        NULL
+    };
+    QStatus status;
+
+    balancer->busListener = alljoyn_buslistener_create(&callbacks, balancer->discCache);
+    if (!balancer->busListener) {
+        return ER_OUT_OF_MEMORY;
+    }
+    alljoyn_busattachment_registerbuslistener(balancer->bus, balancer->busListener);
+
+    status = alljoyn_busattachment_findadvertisedname(balancer->bus, balancer->namePrefix);
+    if (ER_OK != status) {
+        printf("aj_balancer: findadvertisedname(%s) failed (%s)\n", balancer->namePrefix, QCC_StatusText(status));
+    } else {
+        balancer->started = QCC_TRUE;
+    }
+    return status;
+}
+
+void aj_balancer_destroy(aj_balancer balancer)
+{
+    if (!balancer) {
+        return;
+    }
+    if (balancer->started) {
+        alljoyn_busattachment_cancelfindadvertisedname(balancer->bus, balancer->namePrefix);
+    }
+    if (balancer->busListener) {
+        alljoyn_busattachment_unregisterbuslistener(balancer->bus, balancer->busListener);
+    }
+    pthread_mutex_lock(&balancer->lock);
+    balancer->stopping = QCC_TRUE;
+    pthread_mutex_unlock(&balancer->lock);
+    /* No join can be in progress once the cache thread is gone */
+    aj_disccache_destroy(balancer->discCache);
+    aj_linkmon_destroy(balancer->linkMon);
+
+    pthread_mutex_lock(&balancer->lock);
+    while (balancer->numInstances) {
+        alljoyn_sessionid sessionId = balancer->instances[0]->sessionId;
+        free(detach_instance(balancer, 0));
+        pthread_mutex_unlock(&balancer->lock);
+        alljoyn_busattachment_leavesession(balancer->bus, sessionId);
+        pthread_mutex_lock(&balancer->lock);
+    }
+    /* Reply handlers of abandoned hedge legs still use the balancer; each runs by its call timeout */
+    if (balancer->legsInFlight) {
+        printf("aj_balancer: waiting for %u outstanding hedge legs\n", balancer->legsInFlight);
+    }
+    while (balancer->legsInFlight) {
+        pthread_cond_wait(&balancer->legsDrained, &balancer->lock);
+    }
+    pthread_mutex_unlock(&balancer->lock);
+
+    if (balancer->busListener) {
+        alljoyn_buslistener_destroy(balancer->busListener);
+    }
+    if (balancer->sessionListener) {
+        alljoyn_sessionlistener_destroy(balancer->sessionListener);
+    }
+    pthread_cond_destroy(&balancer->legsDrained);
+    pthread_mutex_destroy(&balancer->lock);
+    while (balancer->numHedges) {
+        bal_hedge* hedge = balancer->hedges[--balancer->numHedges];
+        free(hedge->methodName);
+        free(hedge);
+    }
+    free(balancer->hedges);
+    free(balancer->instances);
+    free(balancer->namePrefix);
+    free(balancer->path);
+    free(balancer->ifaceName);
+    free(balancer);
+}
+
+QStatus aj_balancer_methodcall(aj_balancer balancer, const char* methodName, const alljoyn_msgarg args, size_t numArgs,
+                               alljoyn_message replyMsg, uint32_t timeout, uint8_t flags)
+{
+    bal_instance* inst;
+    uint64_t start;
+    uint64_t end;
+    QStatus status;
+
+    pthread_mutex_lock(&balancer->lock);
+    start = aj_time_now_ns();
+    inst = pick_instance(balancer, start / 1000000, NULL);
+    if (!inst) {
+        pthread_mutex_unlock(&balancer->lock);
+        return ER_BUS_NO_SESSION;
+    }
+    inst->outstanding++;
+    inst->refs++;
+    pthread_mutex_unlock(&balancer->lock);
+
+    status = alljoyn_proxybusobject_methodcall(inst->proxy, balancer->ifaceName, methodName, args, numArgs,
+                                               replyMsg, timeout, flags);
+    end = aj_time_now_ns();
+
+    pthread_mutex_lock(&balancer->lock);
+    inst->outstanding--;
+    inst->calls++;
+    if (ER_OK != status) {
+        inst->errors++;
+    }
+    /* A timeout counts as a sample of the full wait so a stalled instance is ejected */
+    if (ER_OK == status || ER_TIMEOUT == status || ER_BUS_REPLY_IS_ERROR_MESSAGE == status) {
+        record_latency(balancer, inst, (double) (end - start) / 1e6, end / 1000000);
+    }
+    release_instance(inst);
+    pthread_mutex_unlock(&balancer->lock);
+    return status;
+}
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+/* Called with the lock held */
+static bal_hedge* find_hedge(aj_balancer balancer, const char* methodName)
+{
+    size_t i;
+    for (i = 0; i < balancer->numHedges; ++i) {
+        if (0 == strcmp(balancer->hedges[i]->methodName, methodName)) {
+            return balancer->hedges[i];
+        }
+    }
+    return NULL;
+}
+
+/* Add a latency sample and refresh the cached hedge delay. Called with the lock held. */
+static void record_hedge_sample(bal_hedge* hedge, double ms)
+{
+    double sorted[HEDGE_WINDOW];
+    size_t rank;
+
+    hedge->samples[hedge->next] = ms;
+    hedge->next = (hedge->next + 1) % HEDGE_WINDOW;
+    if (hedge->numSamples < HEDGE_WINDOW) {
+        hedge->numSamples++;
+    }
+    if (hedge->numSamples < HEDGE_MIN_SAMPLES || ++hedge->sinceRefresh < HEDGE_REFRESH) {
+        return;
+    }
+    hedge->sinceRefresh = 0;
+    memcpy(sorted, hedge->samples, hedge->numSamples * sizeof(double));
+    qsort(sorted, hedge->numSamples, sizeof(double), compare_double);
+    rank = (size_t) (hedge->percentile / 100.0 * (hedge->numSamples - 1) + 0.5);
+    hedge->delayMs = (uint32_t) sorted[rank] + 1;
+}
+
+/* Stable copy of a reply's arguments that outlives the message */
+static alljoyn_msgarg copy_reply_args(alljoyn_message message, size_t* numArgs)
+{
+    alljoyn_msgarg args = NULL;
+    alljoyn_msgarg copy;
+    size_t i;
+
+    alljoyn_message_getargs(message, numArgs, &args);
+    if (*numArgs == 0) {
+        return NULL;
+    }
+    copy = alljoyn_msgarg_array_create(*numArgs);
+    for (i = 0; i < *numArgs; ++i) {
+        alljoyn_msgarg_clone(alljoyn_msgarg_array_element(copy, i), alljoyn_msgarg_array_element(args, i));
+    }
+    return copy;
+}
+
+static QStatus reply_status(alljoyn_message message)
+{
+    const char* errorName;
+    size_t errorSize = 0;
+
+    if (alljoyn_message_gettype(message) == ALLJOYN_MESSAGE_METHOD_RET) {
+        return ER_OK;
+    }
+    /* The library always writes the message size, so it needs somewhere to put it */
+    errorName = alljoyn_message_geterrorname(message, NULL, &errorSize);
+    if (errorName && 0 == strcmp(errorName, "org.alljoyn.Bus.Timeout")) {
+        return ER_TIMEOUT;
+    }
+    return ER_BUS_REPLY_IS_ERROR_MESSAGE;
+}
+
+/* Complete a call that has no winner once every issued leg is done. Called with the lock held. */
+static void check_call_done(hedge_call* call)
+{
+    if (call->winner < 0 && call->legsIssued > 0 && call->legsDone == call->legsIssued) {
+        call->complete = QCC_TRUE;
+    }
+}
+
+/* Called with the lock held */
+static void release_call(hedge_call* call)
+{
+    if (--call->refs == 0) {
+        if (call->replyArgs) {
+            alljoyn_msgarg_destroy(call->replyArgs);
+        }
+        pthread_cond_destroy(&call->done);
+        free(call);
+    }
+}
+
+static void hedge_reply(alljoyn_message message, void* context)
+{
+    hedge_leg* leg = (hedge_leg*) context;
+    hedge_call* call = leg->call;
+    aj_balancer balancer = call->balancer;
+    uint64_t end = aj_time_now_ns();
+    double ms = (double) (end - leg->start) / 1e6;
+    QStatus status = reply_status(message);
+    QCC_BOOL claimed = QCC_FALSE;
+    alljoyn_msgarg replyArgs = NULL;
+    size_t numReplyArgs = 0;
+
+    pthread_mutex_lock(&balancer->lock);
+    leg->inst->outstanding--;
+    leg->inst->calls++;
+    if (ER_OK != status) {
+        leg->inst->errors++;
+    }
+    record_latency(balancer, leg->inst, ms, end / 1000000);
+    if (ER_OK == status) {
+        record_hedge_sample(call->hedge, ms);
+        if (call->winner < 0 && !call->orphaned) {
+            call->winner = leg->index;
+            claimed = QCC_TRUE;
+        }
+    }
+    release_instance(leg->inst);
+    pthread_mutex_unlock(&balancer->lock);
+
+    /* The losing reply is simply dropped; only the winner pays for the copy */
+    if (claimed) {
+        replyArgs = copy_reply_args(message, &numReplyArgs);
+    }
+
+    pthread_mutex_lock(&balancer->lock);
+    call->legsDone++;
+    if (claimed) {
+        call->replyArgs = replyArgs;
+        call->numReplyArgs = numReplyArgs;
+        call->status = ER_OK;
+        call->complete = QCC_TRUE;
+    } else if (call->winner < 0) {
+        call->status = status;
+        check_call_done(call);
+    }
+    pthread_cond_signal(&call->done);
+    release_call(call);
+    if (--balancer->legsInFlight == 0) {
+        pthread_cond_broadcast(&balancer->legsDrained);
+    }
+    pthread_mutex_unlock(&balancer->lock);
+}
+
+/* Send one leg of a hedged call. Called with the lock held; drops it around the send. */
+static QStatus issue_leg(hedge_call* call, bal_instance* inst, const char* methodName,
+                         const alljoyn_msgarg args, size_t numArgs, uint32_t timeout, uint8_t flags)
+{
+    aj_balancer balancer = call->balancer;
+    hedge_leg* leg = &call->legs[call->legsIssued];
+    QStatus status;
+
+    leg->call = call;
+    leg->inst = inst;
+    leg->index = call->legsIssued;
+    leg->start = aj_time_now_ns();
+    inst->outstanding++;
+    inst->refs++;
+    call->refs++;
+    call->legsIssued++;
+    balancer->legsInFlight++;
+    pthread_mutex_unlock(&balancer->lock);
+
+    status = alljoyn_proxybusobject_methodcallasync(inst->proxy, balancer->ifaceName, methodName, &hedge_reply,
+                                                    args, numArgs, leg, timeout, flags);
+
+    pthread_mutex_lock(&balancer->lock);
+    if (ER_OK != status) {
+        /* The reply handler will never run for this leg */
+        inst->outstanding--;
+        release_instance(inst);
+        call->legsIssued--;
+        call->refs--;
+        balancer->legsInFlight--;
+        /* The other leg may have failed while this one was being sent */
+        check_call_done(call);
+    }
+    return status;
+}
+
+static QStatus hedged_methodcall(aj_balancer balancer, bal_hedge* hedge, const char* methodName,
+                                 const alljoyn_msgarg args, size_t numArgs,
+                                 alljoyn_msgarg* replyArgs, size_t* numReplyArgs, uint32_t timeout, uint8_t flags)
+{
+    hedge_call* call = (hedge_call*) calloc(1, sizeof(hedge_call));
+    uint64_t now = aj_time_now_ms();
+    uint64_t giveUp = now + timeout + HEDGE_GRACE_MS;
+    uint32_t delayMs;
+    bal_instance* inst;
+    QStatus status;
+
+    if (!call) {
+        return ER_OUT_OF_MEMORY;
+    }
+    call->balancer = balancer;
+    call->hedge = hedge;
+    call->refs = 1;
+    call->winner = -1;
+    call->status = ER_TIMEOUT;
+    pthread_cond_init(&call->done, NULL);
+
+    balancer->hedgeStats.calls++;
+    delayMs = hedge->delayMs;
+    inst = pick_instance(balancer, now, NULL);
+    status = inst ? issue_leg(call, inst, methodName, args, numArgs, timeout, flags) : ER_BUS_NO_SESSION;
+    if (ER_OK != status) {
+        release_call(call);
+        return status;
+    }
+
+    if (delayMs && delayMs < timeout) {
+        struct timespec deadline;
+        aj_time_deadline(&deadline, delayMs);
+        while (!call->complete) {
+            if (pthread_cond_timedwait(&call->done, &balancer->lock, &deadline) != 0) {
+                break;
+            }
+        }
+        if (!call->complete) {
+            bal_instance* second = pick_instance(balancer, aj_time_now_ms(), call->legs[0].inst);
+            if (second && ER_OK == issue_leg(call, second, methodName, args, numArgs, timeout, flags)) {
+                balancer->hedgeStats.hedges++;
+            }
+        }
+    }
+
+    while (!call->complete) {
+        struct timespec deadline;
+        uint64_t left;
+        now = aj_time_now_ms();
+        if (now >= giveUp) {
+            break;
+        }
+        left = giveUp - now;
+        aj_time_deadline(&deadline, (uint32_t) left);
+        pthread_cond_timedwait(&call->done, &balancer->lock, &deadline);
+    }
+
+    if (!call->complete) {
+        /* Legs still out keep the call alive until their handlers run; mark them so they claim nothing */
+        call->orphaned = QCC_TRUE;
+    }
+    status = call->status;
+    if (call->complete && ER_OK == status) {
+        if (call->winner == 1) {
+            balancer->hedgeStats.wins++;
+        }
+        *replyArgs = call->replyArgs;
+        *numReplyArgs = call->numReplyArgs;
+        call->replyArgs = NULL;
+    }
+    release_call(call);
+    return status;
+}
+
+QStatus aj_balancer_sethedging(aj_balancer balancer, const char* methodName, double percentile)
+{
+    bal_hedge* hedge;
+    QStatus status = ER_OK;
+
+    if (percentile < 0 || percentile > 100) {
+        return ER_BAD_ARG_3;
+    }
+    pthread_mutex_lock(&balancer->lock);
+    hedge = find_hedge(balancer, methodName);
+    if (hedge) {
+        hedge->percentile = percentile;
+        hedge->sinceRefresh = HEDGE_REFRESH;
+    } else if (percentile > 0) {
+        bal_hedge** grown = (bal_hedge**) realloc(balancer->hedges, (balancer->numHedges + 1) * sizeof(bal_hedge*));
+        hedge = (bal_hedge*) calloc(1, sizeof(bal_hedge));
+        if (grown) {
+            balancer->hedges = grown;
+        }
+        if (grown && hedge && (hedge->methodName = strdup(methodName))) {
+            hedge->percentile = percentile;
+            balancer->hedges[balancer->numHedges++] = hedge;
+        } else {
+            free(hedge);
+            status = ER_OUT_OF_MEMORY;
+        }
+    }
+    pthread_mutex_unlock(&balancer->lock);
+    return status;
+}
+
+QStatus aj_balancer_methodcall_args(aj_balancer balancer, const char* methodName, const alljoyn_msgarg args, size_t numArgs,
+                                    alljoyn_msgarg* replyArgs, size_t* numReplyArgs, uint32_t timeout, uint8_t flags)
+{
+    alljoyn_message reply;
+    bal_hedge* hedge;
+    QStatus status;
+
+    *replyArgs = NULL;
+    *numReplyArgs = 0;
+
+    pthread_mutex_lock(&balancer->lock);
+    hedge = find_hedge(balancer, methodName);
+    if (hedge && hedge->percentile > 0) {
+        status = hedged_methodcall(balancer, hedge, methodName, args, numArgs, replyArgs, numReplyArgs, timeout, flags);
+        pthread_mutex_unlock(&balancer->lock);
+        return status;
+    }
+    pthread_mutex_unlock(&balancer->lock);
+
+    reply = alljoyn_message_create(balancer->bus);
+    status = aj_balancer_methodcall(balancer, methodName, args, numArgs, reply, timeout, flags);
+    if (ER_OK == status) {
+        *replyArgs = copy_reply_args(reply, numReplyArgs);
+    }
+    alljoyn_message_destroy(reply);
+    return status;
+}
+
+void aj_balancer_gethedgestats(aj_balancer balancer, aj_balancer_hedgestats* stats)
+{
+    pthread_mutex_lock(&balancer->lock);
+    *stats = balancer->hedgeStats;
+    pthread_mutex_unlock(&balancer->lock);
+}
+
+size_t aj_balancer_getinstancecount(aj_balancer balancer)
+{
+    size_t count;
+
+    pthread_mutex_lock(&balancer->lock);
+    count = balancer->numInstances;
+    pthread_mutex_unlock(&balancer->lock);
+    return count;
+}
+
+size_t aj_balancer_getinstances(aj_balancer balancer, aj_balancer_instanceinfo* infos, size_t numInfos)
+{
+    uint64_t now = aj_time_now_ms();
+    size_t count;
+    size_t i;
+
+    pthread_mutex_lock(&balancer->lock);
+    count = balancer->numInstances;
+    for (i = 0; i < count && i < numInfos; ++i) {
+        bal_instance* inst = balancer->instances[i];
+        snprintf(infos[i].name, sizeof(infos[i].name), "%s", inst->name);
+        infos[i].sessionId = inst->sessionId;
+        infos[i].outstanding = inst->outstanding;
+        infos[i].ewmaMs = inst->ewmaMs;
+        infos[i].calls = inst->calls;
+        infos[i].errors = inst->errors;
+        infos[i].ejected = (inst->ejectedUntil > now) ? QCC_TRUE : QCC_FALSE;
+        infos[i].suspect = inst->suspect;
+    }
+    pthread_mutex_unlock(&balancer->lock);
+    return count;
+}
@@ -0,0 +1,174 @@
+/**
+ * @file
+ * @brief Client-side load balancer across service instances that advertise
+ * unique names under a common prefix.
+ *
+ * The balancer discovers instances with a prefix findadvertisedname, joins a
+ * session with every one of them and routes each method call to the instance
+ * with the fewest outstanding requests. Per-instance reply latency is tracked
+ * as an EWMA; an instance whose EWMA grows well beyond the fastest healthy
+ * instance is ejected for a while and then re-admitted on probation.
+ *
+ * Every joined session is also watched by an aj_linkmon: an instance that
+ * misses pings is avoided like an ejected one, and one that stops answering
+ * altogether is dropped from the pool without waiting for session loss.
+ *
+ * Idempotent methods can opt in to hedging with aj_balancer_sethedging().
+ * When no reply has arrived after the configured percentile of that method's
+ * observed latency, a duplicate is sent to a second instance and whichever
+ * reply comes first is used; the other one is discarded.
+ */
+#ifndef _AJ_BALANCER_H
+#define _AJ_BALANCER_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/Message.h>
+#include <alljoyn_c/MsgArg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Load balancer handle */
+typedef struct _aj_balancer_handle* aj_balancer;
+
+/**
+ * Called after a session with a newly discovered instance has been joined.
+ * Runs on the discovery thread.
+ */
+typedef void (*aj_balancer_instance_joined_ptr)(const void* context, const char* name, alljoyn_sessionid sessionId);
+
+/** Called when an instance leaves the pool (lost name or lost session). */
+typedef void (*aj_balancer_instance_left_ptr)(const void* context, const char* name);
+
+/** Instance membership callbacks. Either may be NULL. */
+typedef struct {
+    aj_balancer_instance_joined_ptr instance_joined;
+    aj_balancer_instance_left_ptr instance_left;
+} aj_balancer_callbacks;
+
+/** Tuning parameters. Zero fields take the defaults noted below. */
+typedef struct {
+    double ewmaAlpha;           /**< Weight of a new latency sample (0.2) */
+    double ejectFactor;         /**< Eject when EWMA exceeds this multiple of the best instance (3.0) */
+    uint32_t ejectMinSamples;   /**< Samples needed before an instance can be ejected (10) */
+    uint32_t ejectMs;           /**< How long an ejected instance stays out (10000) */
+    uint32_t holdoffMs;         /**< Discovery lost hold-off, see aj_disccache (3000) */
+    uint32_t pingIntervalMs;    /**< Session health ping interval, see aj_linkmon (2000) */
+} aj_balancer_config;
+
+/** Snapshot of one instance, see aj_balancer_getinstances(). */
+typedef struct {
+    char name[128];
+    alljoyn_sessionid sessionId;
+    uint32_t outstanding;
+    double ewmaMs;
+    uint32_t calls;
+    uint32_t errors;
+    QCC_BOOL ejected;
+    QCC_BOOL suspect;           /**< Missing health pings */
+} aj_balancer_instanceinfo;
+
+/** Hedging counters, see aj_balancer_gethedgestats(). */
+typedef struct {
+    uint32_t calls;         /**< Calls made on hedged methods */
+    uint32_t hedges;        /**< Duplicates sent to a second instance */
+    uint32_t wins;          /**< Calls answered first by the duplicate */
+} aj_balancer_hedgestats;
+
+/**
+ * Create a balancer.
+ *
+ * @param bus         A started and connected bus attachment.
+ * @param namePrefix  Well-known name prefix shared by every instance.
+ * @param port        Session port the instances bind.
+ * @param path        Object path implementing @p ifaceName on every instance.
+ * @param ifaceName   Interface the balanced methods belong to; it must already
+ *                    exist on @p bus.
+ * @param config      Tuning parameters, or NULL for the defaults.
+ * @param callbacks   Membership callbacks, or NULL.
+ * @param context     Context passed to the callbacks.
+ */
+aj_balancer aj_balancer_create(alljoyn_busattachment bus, const char* namePrefix, alljoyn_sessionport port,
+                               const char* path, const char* ifaceName, const aj_balancer_config* config,
+                               const aj_balancer_callbacks* callbacks, const void* context);
+
+/** Register the balancer's bus listener and start prefix discovery. */
+QStatus aj_balancer_start(aj_balancer balancer);
+
+/**
+ * Stop discovery, leave every session and free the balancer. Waits for the
+ * replies to hedge legs whose callers have given up, at most the timeout
+ * of those calls. Call before the bus is stopped.
+ */
+void aj_balancer_destroy(aj_balancer balancer);
+
+/**
+ * Call a method on the least loaded instance.
+ *
+ * @param balancer    The balancer.
+ * @param methodName  Method of the balanced interface.
+ * @param args        Arguments (can be NULL).
+ * @param numArgs     Number of arguments.
+ * @param replyMsg    Receives the reply, as for alljoyn_proxybusobject_methodcall().
+ * @param timeout     Reply timeout in milliseconds.
+ * @param flags       Message flags.
+ *
+ * @return
+ *      - #ER_OK on a method return
+ *      - #ER_BUS_NO_SESSION if no instance is currently joined
+ *      - The status of the underlying method call otherwise
+ */
+QStatus aj_balancer_methodcall(aj_balancer balancer, const char* methodName, const alljoyn_msgarg args, size_t numArgs,
+                               alljoyn_message replyMsg, uint32_t timeout, uint8_t flags);
+
+/**
+ * Enable hedging for an idempotent method.
+ *
+ * @param balancer    The balancer.
+ * @param methodName  Method of the balanced interface. Only use methods that
+ *                    can safely run twice.
+ * @param percentile  Latency percentile (for example 95.0) after which the
+ *                    duplicate is sent. Zero disables hedging for the method.
+ */
+QStatus aj_balancer_sethedging(aj_balancer balancer, const char* methodName, double percentile);
+
+/**
+ * Call a method and return copies of the reply arguments. Hedged methods
+ * (see aj_balancer_sethedging()) go through the hedging path; others behave
+ * like aj_balancer_methodcall().
+ *
+ * @param balancer          The balancer.
+ * @param methodName        Method of the balanced interface.
+ * @param args              Arguments (can be NULL).
+ * @param numArgs           Number of arguments.
+ * @param[out] replyArgs    Receives a stable copy of the reply arguments, to be
+ *                          freed with alljoyn_msgarg_destroy(). NULL if the
+ *                          reply has no arguments.
+ * @param[out] numReplyArgs Receives the number of reply arguments.
+ * @param timeout           Reply timeout in milliseconds.
+ * @param flags             Message flags.
+ */
+QStatus aj_balancer_methodcall_args(aj_balancer balancer, const char* methodName, const alljoyn_msgarg args, size_t numArgs,
+                                    alljoyn_msgarg* replyArgs, size_t* numReplyArgs, uint32_t timeout, uint8_t flags);
+
+/** Copy the hedging counters. */
+void aj_balancer_gethedgestats(aj_balancer balancer, aj_balancer_hedgestats* stats);
+
+/** Number of joined instances, including ejected ones. */
+size_t aj_balancer_getinstancecount(aj_balancer balancer);
+
+/**
+ * Copy per-instance statistics.
+ *
+ * @return the number of joined instances, which may exceed @p numInfos.
+ */
+size_t aj_balancer_getinstances(aj_balancer balancer, aj_balancer_instanceinfo* infos, size_t numInfos);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
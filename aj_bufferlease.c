@@ -0,0 +1,215 @@
+/**
+ * @file
+ * @brief Buffer leases that let MsgArgs reference large scalar arrays
+ * without copying them.
+ */
+#include <qcc/platform.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "aj_bufferlease.h"
+
+struct _aj_lease_handle {
+    uint32_t refs;              /* updated atomically */
+    uint8_t* data;
+    size_t size;
+
+    /* Pool buffers */
+    struct _aj_bufpool_handle* pool;
+    struct _aj_lease_handle* nextFree;
+
+    /* File mappings: the mapping starts before data when the offset was not page aligned */
+    void* mapBase;
+    size_t mapLength;
+};
+
+struct _aj_bufpool_handle {
+    pthread_mutex_t lock;
+    size_t bufferSize;
+    size_t numBuffers;
+    struct _aj_lease_handle* leases;
+    struct _aj_lease_handle* freeList;
+    uint8_t* memory;
+};
+
+aj_bufpool aj_bufpool_create(size_t bufferSize, size_t numBuffers)
+{
+    aj_bufpool pool = (aj_bufpool) calloc(1, sizeof(struct _aj_bufpool_handle));
+    size_t i;
+
+    if (!pool || !bufferSize || !numBuffers) {
+        free(pool);
+        return NULL;
+    }
+    pool->bufferSize = bufferSize;
+    pool->numBuffers = numBuffers;
+    pool->leases = (struct _aj_lease_handle*) calloc(numBuffers, sizeof(struct _aj_lease_handle));
+    /* One anonymous mapping: page aligned, and untouched pages cost nothing */
+    pool->memory = (uint8_t*) mmap(NULL, bufferSize * numBuffers, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (!pool->leases || pool->memory == MAP_FAILED) {
+        if (pool->memory != MAP_FAILED) {
+            munmap(pool->memory, bufferSize * numBuffers);
+        }
+        free(pool->leases);
+        free(pool);
+        return NULL;
+    }
+    for (i = numBuffers; i-- > 0;) {
+        struct _aj_lease_handle* lease = &pool->leases[i];
+        lease->pool = pool;
+        lease->data = pool->memory + i * bufferSize;
+        lease->size = bufferSize;
+        lease->nextFree = pool->freeList;
+        pool->freeList = lease;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+void aj_bufpool_destroy(aj_bufpool pool)
+{
+    if (!pool) {
+        return;
+    }
+    munmap(pool->memory, pool->bufferSize * pool->numBuffers);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->leases);
+    free(pool);
+}
+
+aj_lease aj_bufpool_acquire(aj_bufpool pool)
+{
+    struct _aj_lease_handle* lease;
+
+    pthread_mutex_lock(&pool->lock);
+    lease = pool->freeList;
+    if (lease) {
+        pool->freeList = lease->nextFree;
+        lease->nextFree = NULL;
+        lease->refs = 1;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return lease;
+}
+
+aj_lease aj_lease_mapfile(const char* path, off_t offset, size_t length)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    off_t mapOffset = offset - (offset % page);
+    struct stat st;
+    aj_lease lease;
+    void* base;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || offset > st.st_size) {
+        close(fd);
+        return NULL;
+    }
+    if (length == 0 || (off_t) length > st.st_size - offset) {
+        length = (size_t) (st.st_size - offset);
+    }
+    if (length == 0) {
+        close(fd);
+        return NULL;
+    }
+    base = mmap(NULL, length + (size_t) (offset - mapOffset), PROT_READ, MAP_PRIVATE, fd, mapOffset);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    lease = (aj_lease) calloc(1, sizeof(struct _aj_lease_handle));
+    if (!lease) {
+        munmap(base, length + (size_t) (offset - mapOffset));
+        return NULL;
+    }
+    lease->refs = 1;
+    lease->mapBase = base;
+    lease->mapLength = length + (size_t) (offset - mapOffset);
+    lease->data = (uint8_t*) base + (offset - mapOffset);
+    lease->size = length;
+    return lease;
+}
+
+aj_lease aj_lease_retain(aj_lease lease)
+{
+    __sync_fetch_and_add(&lease->refs, 1);
+    return lease;
+}
+
+void aj_lease_release(aj_lease lease)
+{
+    if (!lease || __sync_sub_and_fetch(&lease->refs, 1) != 0) {
+        return;
+    }
+    if (lease->pool) {
+        aj_bufpool pool = lease->pool;
+        pthread_mutex_lock(&pool->lock);
+        lease->nextFree = pool->freeList;
+        pool->freeList = lease;
+        pthread_mutex_unlock(&pool->lock);
+    } else {
+        munmap(lease->mapBase, lease->mapLength);
+        free(lease);
+    }
+}
+
+void* aj_lease_data(aj_lease lease)
+{
+    return lease->data;
+}
+
+size_t aj_lease_size(aj_lease lease)
+{
+    return lease->size;
+}
+
+QStatus aj_lease_bind_uint8(aj_lease lease, alljoyn_msgarg arg, size_t offset, size_t count)
+{
+    QStatus status;
+
+    if (offset > lease->size || count > lease->size - offset) {
+        return ER_BAD_ARG_3;
+    }
+    status = alljoyn_msgarg_set_uint8_array(arg, count, lease->data + offset);
+    if (ER_OK == status) {
+        aj_lease_retain(lease);
+    }
+    return status;
+}
+
+QStatus aj_lease_bind_int32(aj_lease lease, alljoyn_msgarg arg, size_t offset, size_t count)
+{
+    QStatus status;
+
+    if ((offset % sizeof(int32_t)) != 0 || offset > lease->size ||
+        count > (lease->size - offset) / sizeof(int32_t)) {
+        return ER_BAD_ARG_3;
+    }
+    status = alljoyn_msgarg_set_int32_array(arg, count, (int32_t*) (lease->data + offset));
+    if (ER_OK == status) {
+        aj_lease_retain(lease);
+    }
+    return status;
+}
+
+void aj_lease_unbind(aj_lease lease, alljoyn_msgarg arg, QCC_BOOL keepArg)
+{
+    /* The send has returned, so the message no longer needs the lease; only a kept arg does */
+    if (keepArg) {
+        alljoyn_msgarg_stabilize(arg);
+    }
+    aj_lease_release(lease);
+}
@@ -0,0 +1,119 @@
+/**
+ * @file
+ * @brief Buffer leases that let MsgArgs reference large scalar arrays
+ * without copying them.
+ *
+ * alljoyn_msgarg_set_uint8_array() and the other array setters only store a
+ * pointer to the caller's memory; the bytes are read when the message is
+ * marshalled, which all AllJoyn send calls do before they return. A lease is
+ * a reference counted region, either a mapping of a file or a buffer from a
+ * pool. aj_lease_bind_*() points an arg at a region of a lease and takes a
+ * reference for it; aj_lease_unbind() drops that reference once the send has
+ * returned. Only when the arg itself is kept beyond that point is it
+ * stabilized, which is the one case where the data has to be copied.
+ *
+ * @code
+ * aj_lease lease = aj_bufpool_acquire(pool);
+ * fill(aj_lease_data(lease), len);
+ * aj_lease_bind_uint8(lease, arg, 0, len);
+ * status = alljoyn_proxybusobject_methodcall(proxy, iface, "Put", arg, 1, reply, timeout, 0);
+ * aj_lease_unbind(lease, arg, QCC_FALSE);     // nothing copied
+ * aj_lease_release(lease);
+ * @endcode
+ */
+#ifndef _AJ_BUFFERLEASE_H
+#define _AJ_BUFFERLEASE_H
+
+#include <qcc/platform.h>
+
+#include <sys/types.h>
+
+#include <alljoyn_c/MsgArg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Reference counted memory region */
+typedef struct _aj_lease_handle* aj_lease;
+
+/** Pool of equally sized buffers */
+typedef struct _aj_bufpool_handle* aj_bufpool;
+
+/**
+ * Create a buffer pool.
+ *
+ * @param bufferSize  Size of every buffer.
+ * @param numBuffers  Buffers allocated up front; the pool never grows.
+ */
+aj_bufpool aj_bufpool_create(size_t bufferSize, size_t numBuffers);
+
+/**
+ * Free the pool. Every lease acquired from it must have been released.
+ */
+void aj_bufpool_destroy(aj_bufpool pool);
+
+/**
+ * Lease a buffer from the pool, or NULL if all of them are leased out. The
+ * buffer goes back to the pool when the last reference is released.
+ */
+aj_lease aj_bufpool_acquire(aj_bufpool pool);
+
+/**
+ * Map part of a file read-only.
+ *
+ * @param path    The file.
+ * @param offset  Start of the region; need not be page aligned.
+ * @param length  Length of the region, or 0 for the rest of the file.
+ *
+ * @return the lease, or NULL if the file cannot be mapped.
+ */
+aj_lease aj_lease_mapfile(const char* path, off_t offset, size_t length);
+
+/** Take another reference. */
+aj_lease aj_lease_retain(aj_lease lease);
+
+/** Drop a reference; the region is unmapped or returned to its pool with the last one. */
+void aj_lease_release(aj_lease lease);
+
+/** Start of the region. Pool buffers are writable, file mappings are not. */
+void* aj_lease_data(aj_lease lease);
+
+/** Length of the region in bytes. */
+size_t aj_lease_size(aj_lease lease);
+
+/**
+ * Make @p arg an 'ay' referencing @p count bytes of the lease at @p offset,
+ * holding a reference to the lease for it.
+ *
+ * @return #ER_OK, or #ER_BAD_ARG_3 if the range is outside the lease.
+ */
+QStatus aj_lease_bind_uint8(aj_lease lease, alljoyn_msgarg arg, size_t offset, size_t count);
+
+/**
+ * Make @p arg an 'ai' referencing @p count int32 values of the lease at byte
+ * @p offset, holding a reference to the lease for it.
+ *
+ * @return #ER_OK, or #ER_BAD_ARG_3 if the range is outside the lease or not
+ *         4-byte aligned.
+ */
+QStatus aj_lease_bind_int32(aj_lease lease, alljoyn_msgarg arg, size_t offset, size_t count);
+
+/**
+ * Drop the reference taken by a bind, after the message carrying @p arg
+ * has been sent.
+ *
+ * @param lease    The lease @p arg was bound to.
+ * @param arg      The bound arg.
+ * @param keepArg  QCC_TRUE if @p arg will still be used after this call; it is
+ *                 then stabilized (its data copied) so it no longer depends on
+ *                 the lease. QCC_FALSE copies nothing; @p arg must then be
+ *                 cleared or destroyed without being read again.
+ */
+void aj_lease_unbind(aj_lease lease, alljoyn_msgarg arg, QCC_BOOL keepArg);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
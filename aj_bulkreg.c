@@ -0,0 +1,283 @@
+/**
+ * @file
+ * @brief Registration of many bus objects sharing one interface set as a
+ * unit.
+ */
+#include <qcc/platform.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alljoyn_c/InterfaceDescription.h>
+
+#include "aj_bulkreg.h"
+
+/* Paths are packed into blocks that never move, so entries can point at them */
+#define POOL_BLOCK_SIZE (64 * 1024)
+
+typedef struct _pool_block {
+    struct _pool_block* next;
+    size_t used;
+    char data[POOL_BLOCK_SIZE];
+} pool_block;
+
+typedef struct {
+    const char* path;
+    alljoyn_busobject obj;
+} bulk_entry;
+
+struct _aj_bulkreg_handle {
+    alljoyn_busattachment bus;
+    char** ifaceNames;
+    size_t numIfaces;
+    alljoyn_busobject_callbacks callbacks;
+    const void* context;
+
+    pool_block* pool;
+    bulk_entry* entries;
+    size_t numEntries;
+    size_t capacity;
+    QCC_BOOL sorted;
+    QCC_BOOL registered;
+};
+
+static QCC_BOOL valid_path(const char* path)
+{
+    const char* p;
+
+    if (!path || path[0] != '/') {
+        return QCC_FALSE;
+    }
+    if (path[1] == '\0') {
+        return QCC_TRUE;
+    }
+    for (p = path + 1; *p; ++p) {
+        if (*p == '/') {
+            if (p[-1] == '/' || p[1] == '\0') {
+                return QCC_FALSE;
+            }
+        } else if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_')) {
+            return QCC_FALSE;
+        }
+    }
+    return QCC_TRUE;
+}
+
+static const char* pool_strdup(aj_bulkreg reg, const char* s)
+{
+    size_t len = strlen(s) + 1;
+    char* copy;
+
+    if (len > POOL_BLOCK_SIZE) {
+        return NULL;
+    }
+    if (!reg->pool || reg->pool->used + len > POOL_BLOCK_SIZE) {
+        pool_block* block = (pool_block*) malloc(sizeof(pool_block));
+        if (!block) {
+            return NULL;
+        }
+        block->next = reg->pool;
+        block->used = 0;
+        reg->pool = block;
+    }
+    copy = reg->pool->data + reg->pool->used;
+    memcpy(copy, s, len);
+    reg->pool->used += len;
+    return copy;
+}
+
+static int compare_entries(const void* a, const void* b)
+{
+    return strcmp(((const bulk_entry*) a)->path, ((const bulk_entry*) b)->path);
+}
+
+aj_bulkreg aj_bulkreg_create(alljoyn_busattachment bus, const char** ifaceNames, size_t numIfaces,
+                             const alljoyn_busobject_callbacks* callbacks, const void* context)
+{
+    aj_bulkreg reg = (aj_bulkreg) calloc(1, sizeof(struct _aj_bulkreg_handle));
+    size_t i;
+
+    if (!reg) {
+        return NULL;
+    }
+    reg->bus = bus;
+    reg->context = context;
+    if (callbacks) {
+        reg->callbacks = *callbacks;
+    }
+    reg->ifaceNames = (char**) calloc(numIfaces ? numIfaces : 1, sizeof(char*));
+    if (!reg->ifaceNames) {
+        free(reg);
+        return NULL;
+    }
+    for (i = 0; i < numIfaces; ++i) {
+        reg->ifaceNames[i] = strdup(ifaceNames[i]);
+        reg->numIfaces++;
+        if (!reg->ifaceNames[i]) {
+            aj_bulkreg_destroy(reg);
+            return NULL;
+        }
+    }
+    reg->sorted = QCC_TRUE;
+    return reg;
+}
+
+void aj_bulkreg_destroy(aj_bulkreg reg)
+{
+    size_t i;
+
+    if (!reg) {
+        return;
+    }
+    aj_bulkreg_unregister(reg);
+    while (reg->pool) {
+        pool_block* next = reg->pool->next;
+        free(reg->pool);
+        reg->pool = next;
+    }
+    for (i = 0; i < reg->numIfaces; ++i) {
+        free(reg->ifaceNames[i]);
+    }
+    free(reg->ifaceNames);
+    free(reg->entries);
+    free(reg);
+}
+
+QStatus aj_bulkreg_add(aj_bulkreg reg, const char* path)
+{
+    bulk_entry* entry;
+
+    if (reg->registered) {
+        return ER_FAIL;
+    }
+    if (!valid_path(path)) {
+        return ER_BUS_BAD_OBJ_PATH;
+    }
+    if (reg->numEntries == reg->capacity) {
+        size_t capacity = reg->capacity ? reg->capacity * 2 : 1024;
+        bulk_entry* entries = (bulk_entry*) realloc(reg->entries, capacity * sizeof(bulk_entry));
+        if (!entries) {
+            return ER_OUT_OF_MEMORY;
+        }
+        reg->entries = entries;
+        reg->capacity = capacity;
+    }
+    entry = &reg->entries[reg->numEntries];
+    entry->path = pool_strdup(reg, path);
+    entry->obj = NULL;
+    if (!entry->path) {
+        return ER_OUT_OF_MEMORY;
+    }
+    if (reg->numEntries && reg->sorted && strcmp(reg->entries[reg->numEntries - 1].path, path) >= 0) {
+        reg->sorted = QCC_FALSE;
+    }
+    reg->numEntries++;
+    return ER_OK;
+}
+
+/* Unregister entries [0, count) children first, then destroy every object */
+static void take_down(aj_bulkreg reg, size_t count)
+{
+    size_t i;
+
+    for (i = count; i > 0; --i) {
+        alljoyn_busattachment_unregisterbusobject(reg->bus, reg->entries[i - 1].obj);
+    }
+    for (i = 0; i < reg->numEntries; ++i) {
+        if (reg->entries[i].obj) {
+            alljoyn_busobject_destroy(reg->entries[i].obj);
+            reg->entries[i].obj = NULL;
+        }
+    }
+}
+
+QStatus aj_bulkreg_register(aj_bulkreg reg)
+{
+    alljoyn_interfacedescription* ifaces = NULL;
+    QStatus status = ER_OK;
+    size_t i;
+    size_t j;
+
+    if (reg->registered) {
+        return ER_OK;
+    }
+    if (!reg->sorted) {
+        qsort(reg->entries, reg->numEntries, sizeof(bulk_entry), compare_entries);
+        reg->sorted = QCC_TRUE;
+    }
+    for (i = 1; i < reg->numEntries; ++i) {
+        if (0 == strcmp(reg->entries[i - 1].path, reg->entries[i].path)) {
+            printf("aj_bulkreg: %s added twice\n", reg->entries[i].path);
+            return ER_BUS_OBJ_ALREADY_EXISTS;
+        }
+    }
+
+    /* Looked up once for the whole set rather than once per object */
+    ifaces = (alljoyn_interfacedescription*) calloc(reg->numIfaces ? reg->numIfaces : 1,
+                                                    sizeof(alljoyn_interfacedescription));
+    if (!ifaces) {
+        return ER_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < reg->numIfaces && ER_OK == status; ++i) {
+        ifaces[i] = alljoyn_busattachment_getinterface(reg->bus, reg->ifaceNames[i]);
+        if (!ifaces[i]) {
+            printf("aj_bulkreg: no interface %s\n", reg->ifaceNames[i]);
+            status = ER_BUS_NO_SUCH_INTERFACE;
+        }
+    }
+
+    for (i = 0; i < reg->numEntries && ER_OK == status; ++i) {
+        bulk_entry* entry = &reg->entries[i];
+        entry->obj = alljoyn_busobject_create(entry->path, QCC_FALSE, &reg->callbacks, reg->context);
+        if (!entry->obj) {
+            status = ER_OUT_OF_MEMORY;
+        }
+        for (j = 0; j < reg->numIfaces && ER_OK == status; ++j) {
+            status = alljoyn_busobject_addinterface(entry->obj, ifaces[j]);
+        }
+    }
+    free(ifaces);
+
+    for (i = 0; i < reg->numEntries && ER_OK == status; ++i) {
+        status = alljoyn_busattachment_registerbusobject(reg->bus, reg->entries[i].obj);
+        if (ER_OK != status) {
+            printf("aj_bulkreg: cannot register %s (%s)\n", reg->entries[i].path, QCC_StatusText(status));
+        }
+    }
+    if (ER_OK != status) {
+        /* i is one past the failed entry, or 0 if creation failed */
+        take_down(reg, i ? i - 1 : 0);
+        return status;
+    }
+    reg->registered = QCC_TRUE;
+    return ER_OK;
+}
+
+QStatus aj_bulkreg_unregister(aj_bulkreg reg)
+{
+    if (!reg->registered) {
+        return ER_OK;
+    }
+    take_down(reg, reg->numEntries);
+    reg->registered = QCC_FALSE;
+    return ER_OK;
+}
+
+size_t aj_bulkreg_getnumobjects(aj_bulkreg reg)
+{
+    return reg->numEntries;
+}
+
+alljoyn_busobject aj_bulkreg_getbusobject(aj_bulkreg reg, const char* path)
+{
+    bulk_entry key;
+    bulk_entry* found;
+
+    if (!reg->registered) {
+        return NULL;
+    }
+    key.path = path;
+    found = (bulk_entry*) bsearch(&key, reg->entries, reg->numEntries, sizeof(bulk_entry), compare_entries);
+    return found ? found->obj : NULL;
+}
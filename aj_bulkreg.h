@@ -0,0 +1,83 @@
+/**
+ * @file
+ * @brief Registration of many bus objects sharing one interface set as a
+ * unit.
+ *
+ * A simulated hub exposes thousands of objects that differ only in their
+ * path. Paths are collected first with aj_bulkreg_add(), which does no bus
+ * work. aj_bulkreg_register() then looks the interfaces up once, creates
+ * every object and registers them in path order, parents before children,
+ * so no placeholder parent is created only to be replaced.
+ * aj_bulkreg_unregister() takes them down children first, so no call has to
+ * walk a subtree that is about to be unregistered anyway.
+ *
+ * Every object gets the same callbacks and context; a property_get that
+ * needs to know which object it serves must find out from its context.
+ */
+#ifndef _AJ_BULKREG_H
+#define _AJ_BULKREG_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/BusObject.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Bulk registration handle */
+typedef struct _aj_bulkreg_handle* aj_bulkreg;
+
+/**
+ * Create an empty set of objects.
+ *
+ * @param bus         The attachment to register on.
+ * @param ifaceNames  Interfaces every object implements; they must exist on
+ *                    @p bus by the time aj_bulkreg_register() is called.
+ * @param numIfaces   Number of interfaces.
+ * @param callbacks   Callbacks for every object, or NULL.
+ * @param context     Context for every object's callbacks.
+ *
+ * @return the set, or NULL on failure.
+ */
+aj_bulkreg aj_bulkreg_create(alljoyn_busattachment bus, const char** ifaceNames, size_t numIfaces,
+                             const alljoyn_busobject_callbacks* callbacks, const void* context);
+
+/** Unregister the objects if registered, and free the set. */
+void aj_bulkreg_destroy(aj_bulkreg reg);
+
+/**
+ * Add an object path. Nothing is created until aj_bulkreg_register().
+ *
+ * @return #ER_OK, #ER_BUS_BAD_OBJ_PATH, #ER_OUT_OF_MEMORY, or #ER_FAIL if
+ *         the set is registered.
+ */
+QStatus aj_bulkreg_add(aj_bulkreg reg, const char* path);
+
+/**
+ * Create and register every object. If one fails, the ones already
+ * registered are unregistered again and its status is returned.
+ *
+ * @return #ER_OK, #ER_BUS_NO_SUCH_INTERFACE, #ER_BUS_OBJ_ALREADY_EXISTS for
+ *         a path added twice, or the registration error.
+ */
+QStatus aj_bulkreg_register(aj_bulkreg reg);
+
+/**
+ * Unregister and destroy every object. The paths are kept, so the set can
+ * be registered again.
+ */
+QStatus aj_bulkreg_unregister(aj_bulkreg reg);
+
+/** Number of paths in the set. */
+size_t aj_bulkreg_getnumobjects(aj_bulkreg reg);
+
+/** The registered object at @p path, or NULL. */
+alljoyn_busobject aj_bulkreg_getbusobject(aj_bulkreg reg, const char* path);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,267 @@
+/**
+ * @file
+ * @brief Sharded pool of bus attachments.
+ */
+#include <qcc/platform.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <alljoyn_c/BusListener.h>
+
+#include "aj_buspool.h"
+
+#define DEFAULT_CONNECT_SPEC    "unix:abstract=alljoyn"
+#define MAX_SHARDS              64
+
+typedef struct {
+    struct _aj_buspool_handle* pool;
+    size_t index;
+    alljoyn_busattachment bus;
+    alljoyn_buslistener listener;
+    QCC_BOOL connected;
+} pool_shard;
+
+struct _aj_buspool_handle {
+    pool_shard* shards;
+    size_t numShards;
+    char* connectSpec;
+    aj_buspool_callbacks callbacks;
+    const void* context;
+};
+
+static void shard_found_advertised_name(const void* context, const char* name, alljoyn_transportmask transport, const char* namePrefix)
+{
+    const pool_shard* shard = (const pool_shard*) context;
+    if (shard->pool->callbacks.found_advertised_name) {
+        shard->pool->callbacks.found_advertised_name(shard->pool->context, name, transport, namePrefix);
+    }
+}
+
+static void shard_lost_advertised_name(const void* context, const char* name, alljoyn_transportmask transport, const char* namePrefix)
+{
+    const pool_shard* shard = (const pool_shard*) context;
+    if (shard->pool->callbacks.lost_advertised_name) {
+        shard->pool->callbacks.lost_advertised_name(shard->pool->context, name, transport, namePrefix);
+    }
+}
+
+static void shard_name_owner_changed(const void* context, const char* busName, const char* previousOwner, const char* newOwner)
+{
+    const pool_shard* shard = (const pool_shard*) context;
+    /* Every shard sees the same broadcast; report it once */
+    if (shard->index == 0 && shard->pool->callbacks.name_owner_changed) {
+        shard->pool->callbacks.name_owner_changed(shard->pool->context, busName, previousOwner, newOwner);
+    }
+}
+
+static void shard_bus_stopping(const void* context)
+{
+    const pool_shard* shard = (const pool_shard*) context;
+    if (shard->pool->callbacks.bus_stopping) {
+        shard->pool->callbacks.bus_stopping(shard->pool->context, shard->index);
+    }
+}
+
+static void shard_bus_disconnected(const void* context)
+{
+    const pool_shard* shard = (const pool_shard*) context;
+    if (shard->pool->callbacks.bus_disconnected) {
+        shard->pool->callbacks.bus_disconnected(shard->pool->context, shard->index);
+    }
+}
+
+aj_buspool aj_buspool_create(const char* applicationName, size_t numShards, QCC_BOOL allowRemote, uint32_t concurrency)
+{
+    aj_buspool pool;
+    size_t i;
+
+    if (numShards == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numShards = (cpus > 0) ? (size_t) cpus : 1;
+    }
+    if (numShards > MAX_SHARDS) {
+        numShards = MAX_SHARDS;
+    }
+
+    pool = (aj_buspool) calloc(1, sizeof(struct _aj_buspool_handle));
+    if (!pool) {
+        return NULL;
+    }
+    pool->shards = (pool_shard*) calloc(numShards, sizeof(pool_shard));
+    if (!pool->shards) {
+        free(pool);
+        return NULL;
+    }
+
+    for (i = 0; i < numShards; ++i) {
+        pool_shard* shard = &pool->shards[i];
+        QStatus status;
+
+        shard->pool = pool;
+        shard->index = i;
+        shard->bus = concurrency ?
+                     alljoyn_busattachment_create_concurrency(applicationName, allowRemote, concurrency) :
+                     alljoyn_busattachment_create(applicationName, allowRemote);
+        if (!shard->bus) {
+            break;
+        }
+        pool->numShards++;
+        status = alljoyn_busattachment_start(shard->bus);
+        if (ER_OK != status) {
+            printf("aj_buspool: start of shard %u failed (%s)\n", (unsigned) i, QCC_StatusText(status));
+            break;
+        }
+    }
+    if (pool->numShards != numShards || !alljoyn_busattachment_isstarted(pool->shards[numShards - 1].bus)) {
+        aj_buspool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+QStatus aj_buspool_connect(aj_buspool pool, const char* connectSpec)
+{
+    size_t i;
+
+    if (!connectSpec) {
+        connectSpec = DEFAULT_CONNECT_SPEC;
+    }
+    free(pool->connectSpec);
+    pool->connectSpec = strdup(connectSpec);
+    if (!pool->connectSpec) {
+        return ER_OUT_OF_MEMORY;
+    }
+
+    for (i = 0; i < pool->numShards; ++i) {
+        pool_shard* shard = &pool->shards[i];
+        QStatus status;
+
+        if (shard->connected) {
+            continue;
+        }
+        status = alljoyn_busattachment_connect(shard->bus, pool->connectSpec);
+        if (ER_OK != status) {
+            printf("aj_buspool: connect of shard %u to %s failed (%s)\n", (unsigned) i, pool->connectSpec, QCC_StatusText(status));
+            return status;
+        }
+        shard->connected = QCC_TRUE;
+    }
+    return ER_OK;
+}
+
+QStatus aj_buspool_registerbuslistener(aj_buspool pool, const aj_buspool_callbacks* callbacks, const void* context)
+{
+    alljoyn_buslistener_callbacks shardCallbacks = {
+        NULL,
+        NULL,
+        &shard_found_advertised_name,
+        &shard_lost_advertised_name,
+        &shard_name_owner_changed,
+        &shard_bus_stopping,
+        &shard_bus_disconnected,
+        NULL
+    };
+    size_t i;
+
+    pool->callbacks = *callbacks;
+    pool->context = context;
+
+    for (i = 0; i < pool->numShards; ++i) {
+        pool_shard* shard = &pool->shards[i];
+        if (shard->listener) {
+            continue;
+        }
+        shard->listener = alljoyn_buslistener_create(&shardCallbacks, shard);
+        if (!shard->listener) {
+            return ER_OUT_OF_MEMORY;
+        }
+        alljoyn_busattachment_registerbuslistener(shard->bus, shard->listener);
+    }
+    return ER_OK;
+}
+
+QStatus aj_buspool_findadvertisedname(aj_buspool pool, const char* namePrefix)
+{
+    /* Discovery results would otherwise arrive once per shard */
+    return alljoyn_busattachment_findadvertisedname(pool->shards[0].bus, namePrefix);
+}
+
+QStatus aj_buspool_foreach(aj_buspool pool, aj_buspool_visit_ptr visit, void* context)
+{
+    size_t i;
+
+    for (i = 0; i < pool->numShards; ++i) {
+        QStatus status = visit(context, i, pool->shards[i].bus);
+        if (ER_OK != status) {
+            return status;
+        }
+    }
+    return ER_OK;
+}
+
+size_t aj_buspool_getcount(aj_buspool pool)
+{
+    return pool->numShards;
+}
+
+alljoyn_busattachment aj_buspool_get(aj_buspool pool, size_t index)
+{
+    return (index < pool->numShards) ? pool->shards[index].bus : NULL;
+}
+
+size_t aj_buspool_shardindex(aj_buspool pool, const void* key, size_t keyLen)
+{
+    const unsigned char* p = (const unsigned char*) key;
+    uint32_t h = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < keyLen; ++i) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h % pool->numShards;
+}
+
+alljoyn_busattachment aj_buspool_shard(aj_buspool pool, const char* key)
+{
+    return pool->shards[aj_buspool_shardindex(pool, key, strlen(key))].bus;
+}
+
+void aj_buspool_destroy(aj_buspool pool)
+{
+    size_t i;
+
+    if (!pool) {
+        return;
+    }
+
+    for (i = 0; i < pool->numShards; ++i) {
+        pool_shard* shard = &pool->shards[i];
+        if (shard->listener) {
+            alljoyn_busattachment_unregisterbuslistener(shard->bus, shard->listener);
+        }
+        if (shard->connected) {
+            alljoyn_busattachment_disconnect(shard->bus, pool->connectSpec);
+        }
+    }
+
+    /* Stop every shard before joining any so their threads wind down in parallel */
+    for (i = 0; i < pool->numShards; ++i) {
+        alljoyn_busattachment_stop(pool->shards[i].bus);
+    }
+    for (i = 0; i < pool->numShards; ++i) {
+        pool_shard* shard = &pool->shards[i];
+        alljoyn_busattachment_join(shard->bus);
+        alljoyn_busattachment_destroy(shard->bus);
+        if (shard->listener) {
+            alljoyn_buslistener_destroy(shard->listener);
+        }
+    }
+
+    free(pool->connectSpec);
+    free(pool->shards);
+    free(pool);
+}
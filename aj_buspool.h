@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @brief Sharded pool of bus attachments.
+ *
+ * A single alljoyn_busattachment has one daemon connection and one
+ * dispatcher, so every message a program sends or receives is serialized
+ * through it. The pool creates several attachments (by default one per
+ * online CPU), connects all of them to the same daemon and maps work onto
+ * them by key, so that independent streams of calls run in parallel while
+ * calls for the same key stay ordered on one attachment.
+ *
+ * Objects, interfaces and signal handlers belong to one attachment; use
+ * aj_buspool_foreach() to set them up on every shard.
+ */
+#ifndef _AJ_BUSPOOL_H
+#define _AJ_BUSPOOL_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/TransportMask.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Bus attachment pool handle */
+typedef struct _aj_buspool_handle* aj_buspool;
+
+/**
+ * Aggregated bus listener. Discovery and name owner events are delivered
+ * once, from shard 0; stopping and disconnect events are delivered for every
+ * shard. Any member may be NULL.
+ */
+typedef struct {
+    void (*found_advertised_name)(const void* context, const char* name, alljoyn_transportmask transport, const char* namePrefix);
+    void (*lost_advertised_name)(const void* context, const char* name, alljoyn_transportmask transport, const char* namePrefix);
+    void (*name_owner_changed)(const void* context, const char* busName, const char* previousOwner, const char* newOwner);
+    void (*bus_stopping)(const void* context, size_t shard);
+    void (*bus_disconnected)(const void* context, size_t shard);
+} aj_buspool_callbacks;
+
+/** Per-shard visitor used by aj_buspool_foreach(). */
+typedef QStatus (*aj_buspool_visit_ptr)(void* context, size_t shard, alljoyn_busattachment bus);
+
+/**
+ * Create and start a pool.
+ *
+ * @param applicationName  Name passed to every attachment.
+ * @param numShards        Number of attachments, or 0 for one per online CPU.
+ * @param allowRemote      As for alljoyn_busattachment_create().
+ * @param concurrency      Callback threads per attachment, or 0 for the default.
+ *
+ * @return the pool, or NULL on failure.
+ */
+aj_buspool aj_buspool_create(const char* applicationName, size_t numShards, QCC_BOOL allowRemote, uint32_t concurrency);
+
+/**
+ * Connect every attachment.
+ *
+ * @param pool         The pool.
+ * @param connectSpec  Daemon connect spec, or NULL for "unix:abstract=alljoyn".
+ *
+ * @return #ER_OK once all shards are connected, else the first failure.
+ */
+QStatus aj_buspool_connect(aj_buspool pool, const char* connectSpec);
+
+/**
+ * Register the aggregated bus listener on every shard. Only one listener can
+ * be registered per pool; a second call replaces the first.
+ */
+QStatus aj_buspool_registerbuslistener(aj_buspool pool, const aj_buspool_callbacks* callbacks, const void* context);
+
+/** Start discovery for a prefix, once for the whole pool. */
+QStatus aj_buspool_findadvertisedname(aj_buspool pool, const char* namePrefix);
+
+/**
+ * Call @p visit for every shard in order, stopping at the first failure.
+ * Typically used to create interfaces and register bus objects.
+ */
+QStatus aj_buspool_foreach(aj_buspool pool, aj_buspool_visit_ptr visit, void* context);
+
+/** Number of attachments in the pool. */
+size_t aj_buspool_getcount(aj_buspool pool);
+
+/** The attachment of shard @p index, or NULL if out of range. */
+alljoyn_busattachment aj_buspool_get(aj_buspool pool, size_t index);
+
+/** Shard a key maps to. Equal keys always map to the same shard. */
+size_t aj_buspool_shardindex(aj_buspool pool, const void* key, size_t keyLen);
+
+/** Attachment a key maps to; a NUL-terminated string key. */
+alljoyn_busattachment aj_buspool_shard(aj_buspool pool, const char* key);
+
+/**
+ * Unregister the listener, disconnect and stop every attachment, wait for
+ * their threads and free the pool.
+ */
+void aj_buspool_destroy(aj_buspool pool);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
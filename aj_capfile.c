@@ -0,0 +1,975 @@
+/**
+ * @file
+ * @brief Append-only capture file of bus messages, designed to be read
+ * back through a read-only mapping.
+ */
+#include <qcc/platform.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "aj_capfile.h"
+
+#define CAP_MAGIC       "AJCAP\0\0\0"
+#define CAP_VERSION     1
+#define CAP_BYTE_ORDER  0x01020304
+
+#define CAP_NUM_STRINGS 6
+
+/* Arrays and structs may each nest 32 deep on the wire, 64 levels in all; bound the recursion the same way */
+#define CAP_MAX_DEPTH   64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;         /* CAP_BYTE_ORDER as written by the capturing host */
+} cap_filehdr;
+
+typedef struct {
+    uint32_t length;            /* whole record, padded to 8 */
+    uint8_t type;
+    uint8_t msgFlags;
+    uint8_t recFlags;
+    uint8_t reserved;
+    uint64_t timestamp;
+    uint32_t sessionId;
+    uint32_t bodyLength;
+} cap_rechdr;
+
+struct _aj_capwriter_handle {
+    pthread_mutex_t lock;
+    int fd;
+    uint32_t count;
+
+    /* Record being built, reused between records */
+    uint8_t* buf;
+    size_t len;
+    size_t cap;
+};
+
+struct _aj_capreader_handle {
+    const uint8_t* base;
+    size_t size;
+    size_t pos;
+};
+
+/* Length of the complete type at the start of sig, 0 if it is not valid */
+static size_t sig_type_len(const char* sig, int depth)
+{
+    size_t i;
+    size_t n;
+
+    if (depth > CAP_MAX_DEPTH) {
+        return 0;
+    }
+    switch (*sig) {
+    case 'y': case 'b': case 'n': case 'q': case 'i': case 'u': case 'x': case 't':
+    case 'd': case 's': case 'o': case 'g': case 'h': case 'v':
+        return 1;
+
+    case 'a':
+        n = sig_type_len(sig + 1, depth + 1);
+        return n ? n + 1 : 0;
+
+    case '(':
+        for (i = 1; sig[i] != ')'; i += n) {
+            n = sig_type_len(sig + i, depth + 1);
+            if (!n) {
+                return 0;
+            }
+        }
+        return i > 1 ? i + 1 : 0;
+
+    case '{':
+        i = 1;
+        n = sig_type_len(sig + i, depth + 1);
+        if (n != 1) {
+            return 0;           /* keys are basic types */
+        }
+        i += n;
+        n = sig_type_len(sig + i, depth + 1);
+        if (!n || sig[i + n] != '}') {
+            return 0;
+        }
+        return i + n + 1;
+
+    default:
+        return 0;
+    }
+}
+
+/* Size and alignment of a scalar stored inline, 0 for anything else */
+static size_t scalar_size(char type)
+{
+    switch (type) {
+    case 'y':
+        return 1;
+
+    case 'n': case 'q':
+        return 2;
+
+    case 'b': case 'i': case 'u': case 'h':
+        return 4;
+
+    case 'x': case 't': case 'd':
+        return 8;
+
+    default:
+        return 0;
+    }
+}
+
+static uint64_t now_realtime_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/*
+ * Writer
+ */
+
+static QStatus buf_reserve(aj_capwriter w, size_t extra)
+{
+    if (w->len + extra > w->cap) {
+        size_t cap = w->cap ? w->cap : 4096;
+        uint8_t* buf;
+        while (cap < w->len + extra) {
+            cap *= 2;
+        }
+        buf = (uint8_t*) realloc(w->buf, cap);
+        if (!buf) {
+            return ER_OUT_OF_MEMORY;
+        }
+        w->buf = buf;
+        w->cap = cap;
+    }
+    return ER_OK;
+}
+
+static QStatus buf_align(aj_capwriter w, size_t align)
+{
+    size_t pad = (align - (w->len & (align - 1))) & (align - 1);
+    QStatus status = buf_reserve(w, pad);
+    if (ER_OK == status) {
+        memset(w->buf + w->len, 0, pad);
+        w->len += pad;
+    }
+    return status;
+}
+
+static QStatus buf_put(aj_capwriter w, const void* data, size_t size)
+{
+    QStatus status = buf_reserve(w, size);
+    if (ER_OK == status) {
+        memcpy(w->buf + w->len, data, size);
+        w->len += size;
+    }
+    return status;
+}
+
+/* Strings are a 32 bit length, the bytes and a NUL */
+static QStatus put_string(aj_capwriter w, const char* str)
+{
+    uint32_t len = str ? (uint32_t) strlen(str) : 0;
+    QStatus status = buf_align(w, 4);
+    if (ER_OK == status) {
+        status = buf_put(w, &len, sizeof(len));
+    }
+    if (ER_OK == status) {
+        status = buf_put(w, str ? str : "", len + 1);
+    }
+    return status;
+}
+
+static QStatus encode_arg(aj_capwriter w, alljoyn_msgarg arg, const char* sig, size_t sigLen, int depth);
+
+static QStatus encode_scalar_array(aj_capwriter w, alljoyn_msgarg arg, char elemType)
+{
+    size_t elemSize = scalar_size(elemType);
+    size_t n = 0;
+    void* data = NULL;
+    uint32_t count;
+    QStatus status;
+
+    switch (elemType) {
+    case 'y': status = alljoyn_msgarg_get_uint8_array(arg, &n, (uint8_t*) &data); break;
+    case 'b': status = alljoyn_msgarg_get_bool_array(arg, &n, (QCC_BOOL*) &data); break;
+    case 'n': status = alljoyn_msgarg_get_int16_array(arg, &n, (int16_t*) &data); break;
+    case 'q': status = alljoyn_msgarg_get_uint16_array(arg, &n, (uint16_t*) &data); break;
+    case 'i': status = alljoyn_msgarg_get_int32_array(arg, &n, (int32_t*) &data); break;
+    case 'u': status = alljoyn_msgarg_get_uint32_array(arg, &n, (uint32_t*) &data); break;
+    case 'x': status = alljoyn_msgarg_get_int64_array(arg, &n, (int64_t*) &data); break;
+    case 't': status = alljoyn_msgarg_get_uint64_array(arg, &n, (uint64_t*) &data); break;
+    case 'd': status = alljoyn_msgarg_get_double_array(arg, &n, (double*) &data); break;
+    default: return ER_BUS_BAD_SIGNATURE;
+    }
+    if (ER_OK != status) {
+        return status;
+    }
+    count = (uint32_t) n;
+    status = buf_align(w, 4);
+    if (ER_OK == status) {
+        status = buf_put(w, &count, sizeof(count));
+    }
+    /* The elements start at their own alignment so the reader can point an array arg at them */
+    if (ER_OK == status) {
+        status = buf_align(w, elemSize);
+    }
+    if (ER_OK == status && n) {
+        status = buf_put(w, data, n * elemSize);
+    }
+    return status;
+}
+
+static QStatus encode_arg(aj_capwriter w, alljoyn_msgarg arg, const char* sig, size_t sigLen, int depth)
+{
+    QStatus status = ER_OK;
+    size_t size = scalar_size(sig[0]);
+
+    if (depth > CAP_MAX_DEPTH) {
+        return ER_BUS_BAD_SIGNATURE;
+    }
+    if (size) {
+        union { uint8_t y; QCC_BOOL b; int16_t n; uint16_t q; int32_t i; uint32_t u; int64_t x; uint64_t t; double d; } v;
+        switch (sig[0]) {
+        case 'y': status = alljoyn_msgarg_get_uint8(arg, &v.y); break;
+        case 'b': status = alljoyn_msgarg_get_bool(arg, &v.b); break;
+        case 'n': status = alljoyn_msgarg_get_int16(arg, &v.n); break;
+        case 'q': status = alljoyn_msgarg_get_uint16(arg, &v.q); break;
+        case 'i': status = alljoyn_msgarg_get_int32(arg, &v.i); break;
+        case 'u': status = alljoyn_msgarg_get_uint32(arg, &v.u); break;
+        case 'x': status = alljoyn_msgarg_get_int64(arg, &v.x); break;
+        case 't': status = alljoyn_msgarg_get_uint64(arg, &v.t); break;
+        case 'd': status = alljoyn_msgarg_get_double(arg, &v.d); break;
+        default: return ER_NOT_IMPLEMENTED;    /* 'h' */
+        }
+        if (ER_OK == status) {
+            status = buf_align(w, size);
+        }
+        if (ER_OK == status) {
+            status = buf_put(w, &v, size);
+        }
+        return status;
+    }
+
+    switch (sig[0]) {
+    case 's':
+    case 'o':
+    case 'g': {
+            char* str = NULL;
+            if (sig[0] == 's') {
+                status = alljoyn_msgarg_get_string(arg, (char*) &str);
+            } else if (sig[0] == 'o') {
+                status = alljoyn_msgarg_get_objectpath(arg, (char*) &str);
+            } else {
+                status = alljoyn_msgarg_get_signature(arg, (char*) &str);
+            }
+            if (ER_OK == status) {
+                status = put_string(w, str);
+            }
+            break;
+        }
+
+    case 'v': {
+            alljoyn_msgarg inner = NULL;
+            char innerSig[256];
+            status = alljoyn_msgarg_get(arg, "v", &inner);
+            if (ER_OK == status) {
+                alljoyn_msgarg_signature(inner, innerSig, sizeof(innerSig));
+                status = put_string(w, innerSig);
+            }
+            if (ER_OK == status) {
+                status = encode_arg(w, inner, innerSig, strlen(innerSig), depth + 1);
+            }
+            break;
+        }
+
+    case 'a': {
+            size_t n;
+            size_t i;
+            uint32_t count;
+            if (scalar_size(sig[1]) && sig[1] != 'h') {
+                return encode_scalar_array(w, arg, sig[1]);
+            }
+            n = alljoyn_msgarg_get_array_numberofelements(arg);
+            count = (uint32_t) n;
+            status = buf_align(w, 4);
+            if (ER_OK == status) {
+                status = buf_put(w, &count, sizeof(count));
+            }
+            for (i = 0; i < n && ER_OK == status; ++i) {
+                alljoyn_msgarg elem = NULL;
+                alljoyn_msgarg_get_array_element(arg, i, &elem);
+                status = elem ? encode_arg(w, elem, sig + 1, sigLen - 1, depth + 1) : ER_INVALID_DATA;
+            }
+            break;
+        }
+
+    case '(': {
+            size_t numMembers = alljoyn_msgarg_getnummembers(arg);
+            size_t pos = 1;
+            size_t i;
+            status = buf_align(w, 8);
+            for (i = 0; ER_OK == status && sig[pos] != ')'; ++i) {
+                size_t n = sig_type_len(sig + pos, depth + 1);
+                if (!n || i >= numMembers) {
+                    return ER_BUS_SIGNATURE_MISMATCH;
+                }
+                status = encode_arg(w, alljoyn_msgarg_getmember(arg, i), sig + pos, n, depth + 1);
+                pos += n;
+            }
+            break;
+        }
+
+    case '{': {
+            size_t keyLen = sig_type_len(sig + 1, depth + 1);
+            status = buf_align(w, 8);
+            if (ER_OK == status) {
+                status = encode_arg(w, alljoyn_msgarg_getkey(arg), sig + 1, keyLen, depth + 1);
+            }
+            if (ER_OK == status) {
+                status = encode_arg(w, alljoyn_msgarg_getvalue(arg), sig + 1 + keyLen, sigLen - keyLen - 2, depth + 1);
+            }
+            break;
+        }
+
+    default:
+        status = ER_BUS_BAD_SIGNATURE;
+        break;
+    }
+    return status;
+}
+
+/* Drop a torn record left at the end of the file by a writer that died mid-write */
+static QStatus trim_file(int fd, off_t size)
+{
+    off_t pos = sizeof(cap_filehdr);
+
+    while (pos + (off_t) sizeof(cap_rechdr) <= size) {
+        cap_rechdr hdr;
+        if (pread(fd, &hdr, sizeof(hdr), pos) != (ssize_t) sizeof(hdr)) {
+            return ER_OS_ERROR;
+        }
+        if (hdr.length < sizeof(hdr) || (hdr.length & 7) || pos + (off_t) hdr.length > size) {
+            break;
+        }
+        pos += hdr.length;
+    }
+    if (pos != size && ftruncate(fd, pos) != 0) {
+        return ER_OS_ERROR;
+    }
+    return ER_OK;
+}
+
+aj_capwriter aj_capwriter_open(const char* path)
+{
+    aj_capwriter writer;
+    struct stat st;
+    cap_filehdr hdr;
+    int fd;
+
+    fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        printf("aj_capfile: cannot open %s\n", path);
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size == 0) {
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, CAP_MAGIC, sizeof(hdr.magic));
+        hdr.version = CAP_VERSION;
+        hdr.byteOrder = CAP_BYTE_ORDER;
+        if (write(fd, &hdr, sizeof(hdr)) != (ssize_t) sizeof(hdr)) {
+            close(fd);
+            return NULL;
+        }
+    } else if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr) ||
+               memcmp(hdr.magic, CAP_MAGIC, sizeof(hdr.magic)) != 0 ||
+               hdr.version != CAP_VERSION || hdr.byteOrder != CAP_BYTE_ORDER ||
+               trim_file(fd, st.st_size) != ER_OK) {
+        printf("aj_capfile: %s is not a capture file of this host\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    writer = (aj_capwriter) calloc(1, sizeof(struct _aj_capwriter_handle));
+    if (!writer) {
+        close(fd);
+        return NULL;
+    }
+    writer->fd = fd;
+    pthread_mutex_init(&writer->lock, NULL);
+    return writer;
+}
+
+void aj_capwriter_close(aj_capwriter writer)
+{
+    if (!writer) {
+        return;
+    }
+    close(writer->fd);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer->buf);
+    free(writer);
+}
+
+/* Build the record for @p message in the writer's buffer */
+static QStatus build_record(aj_capwriter w, alljoyn_message message)
+{
+    const char* strings[CAP_NUM_STRINGS];
+    const char* sig = alljoyn_message_getsignature(message);
+    alljoyn_msgarg args = NULL;
+    size_t numArgs = 0;
+    cap_rechdr hdr;
+    size_t bodyStart;
+    size_t pos;
+    size_t i;
+    QStatus status;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.type = (uint8_t) alljoyn_message_gettype(message);
+    hdr.msgFlags = alljoyn_message_getflags(message);
+    hdr.timestamp = now_realtime_ns();
+    hdr.sessionId = alljoyn_message_getsessionid(message);
+
+    strings[0] = alljoyn_message_getsender(message);
+    strings[1] = alljoyn_message_getdestination(message);
+    strings[2] = alljoyn_message_getobjectpath(message);
+    strings[3] = alljoyn_message_getinterface(message);
+    strings[4] = alljoyn_message_getmembername(message);
+    strings[5] = sig;
+
+    w->len = 0;
+    status = buf_put(w, &hdr, sizeof(hdr));
+    for (i = 0; i < CAP_NUM_STRINGS && ER_OK == status; ++i) {
+        status = put_string(w, strings[i]);
+    }
+    if (ER_OK == status) {
+        status = buf_align(w, 8);
+    }
+    if (ER_OK != status) {
+        return status;
+    }
+
+    /* The body starts 8-byte aligned, so alignment within the buffer is alignment within the body */
+    bodyStart = w->len;
+    alljoyn_message_getargs(message, &numArgs, &args);
+    for (i = 0, pos = 0; i < numArgs && ER_OK == status; ++i) {
+        size_t n = sig ? sig_type_len(sig + pos, 0) : 0;
+        if (!n) {
+            status = ER_BUS_BAD_SIGNATURE;
+            break;
+        }
+        status = encode_arg(w, alljoyn_msgarg_array_element(args, i), sig + pos, n, 0);
+        pos += n;
+    }
+    if (ER_NOT_IMPLEMENTED == status) {
+        /* A socket handle somewhere in the body: keep the header, drop the body */
+        w->len = bodyStart;
+        ((cap_rechdr*) w->buf)->recFlags |= AJ_CAPRECORD_NO_BODY;
+        status = ER_OK;
+    }
+    if (ER_OK == status) {
+        ((cap_rechdr*) w->buf)->bodyLength = (uint32_t) (w->len - bodyStart);
+        status = buf_align(w, 8);
+    }
+    if (ER_OK == status) {
+        ((cap_rechdr*) w->buf)->length = (uint32_t) w->len;
+    }
+    return status;
+}
+
+QStatus aj_capwriter_record(aj_capwriter writer, alljoyn_message message)
+{
+    QStatus status;
+
+    pthread_mutex_lock(&writer->lock);
+    status = build_record(writer, message);
+    if (ER_OK == status && write(writer->fd, writer->buf, writer->len) != (ssize_t) writer->len) {
+        status = ER_OS_ERROR;
+    }
+    if (ER_OK == status) {
+        writer->count++;
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return status;
+}
+
+uint32_t aj_capwriter_getcount(aj_capwriter writer)
+{
+    uint32_t count;
+
+    pthread_mutex_lock(&writer->lock);
+    count = writer->count;
+    pthread_mutex_unlock(&writer->lock);
+    return count;
+}
+
+/*
+ * Reader
+ */
+
+aj_capreader aj_capreader_open(const char* path)
+{
+    aj_capreader reader;
+    const cap_filehdr* hdr;
+    struct stat st;
+    void* base;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("aj_capfile: cannot open %s\n", path);
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(cap_filehdr)) {
+        printf("aj_capfile: %s is not a capture file\n", path);
+        close(fd);
+        return NULL;
+    }
+    base = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        printf("aj_capfile: cannot map %s\n", path);
+        return NULL;
+    }
+    /* Replay reads front to back */
+    madvise(base, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+    hdr = (const cap_filehdr*) base;
+    if (memcmp(hdr->magic, CAP_MAGIC, sizeof(hdr->magic)) != 0 || hdr->version != CAP_VERSION ||
+        hdr->byteOrder != CAP_BYTE_ORDER) {
+        printf("aj_capfile: %s is not a capture file of this host\n", path);
+        munmap(base, (size_t) st.st_size);
+        return NULL;
+    }
+
+    reader = (aj_capreader) calloc(1, sizeof(struct _aj_capreader_handle));
+    if (!reader) {
+        munmap(base, (size_t) st.st_size);
+        return NULL;
+    }
+    reader->base = (const uint8_t*) base;
+    reader->size = (size_t) st.st_size;
+    reader->pos = sizeof(cap_filehdr);
+    return reader;
+}
+
+void aj_capreader_close(aj_capreader reader)
+{
+    if (!reader) {
+        return;
+    }
+    munmap((void*) reader->base, reader->size);
+    free(reader);
+}
+
+void aj_capreader_rewind(aj_capreader reader)
+{
+    reader->pos = sizeof(cap_filehdr);
+}
+
+/* Read a string at *pos, not going past end */
+static const char* get_string(const uint8_t* base, size_t* pos, size_t end)
+{
+    size_t p = (*pos + 3) & ~(size_t) 3;
+    uint32_t len;
+
+    if (p + sizeof(len) > end) {
+        return NULL;
+    }
+    memcpy(&len, base + p, sizeof(len));
+    p += sizeof(len);
+    if (len >= end - p || base[p + len] != '\0') {
+        return NULL;
+    }
+    *pos = p + len + 1;
+    return (const char*) base + p;
+}
+
+QStatus aj_capreader_next(aj_capreader reader, aj_caprecord* record)
+{
+    const char* strings[CAP_NUM_STRINGS];
+    const cap_rechdr* hdr;
+    size_t start = reader->pos;
+    size_t end;
+    size_t pos;
+    int i;
+
+    if (start == reader->size) {
+        return ER_NONE;
+    }
+    if (reader->size - start < sizeof(cap_rechdr)) {
+        return ER_INVALID_DATA;
+    }
+    hdr = (const cap_rechdr*) (reader->base + start);
+    if (hdr->length < sizeof(cap_rechdr) || (hdr->length & 7) || hdr->length > reader->size - start) {
+        return ER_INVALID_DATA;
+    }
+    end = start + hdr->length;
+
+    pos = start + sizeof(cap_rechdr);
+    for (i = 0; i < CAP_NUM_STRINGS; ++i) {
+        strings[i] = get_string(reader->base, &pos, end);
+        if (!strings[i]) {
+            return ER_INVALID_DATA;
+        }
+    }
+    pos = (pos + 7) & ~(size_t) 7;
+    if (pos > end || hdr->bodyLength > end - pos) {
+        return ER_INVALID_DATA;
+    }
+
+    record->timestamp = hdr->timestamp;
+    record->type = (alljoyn_messagetype) hdr->type;
+    record->msgFlags = hdr->msgFlags;
+    record->recFlags = hdr->recFlags;
+    record->sessionId = hdr->sessionId;
+    record->sender = strings[0];
+    record->destination = strings[1];
+    record->path = strings[2];
+    record->iface = strings[3];
+    record->member = strings[4];
+    record->signature = strings[5];
+    record->body = reader->base + pos;
+    record->bodyLength = hdr->bodyLength;
+
+    reader->pos = end;
+    return ER_OK;
+}
+
+/*
+ * Body decoder
+ */
+
+typedef struct {
+    const uint8_t* body;
+    size_t pos;
+    size_t end;
+    aj_argarena arena;
+} cap_decoder;
+
+/* Align and claim @p size bytes, NULL if the body is too short */
+static const uint8_t* dec_take(cap_decoder* dec, size_t align, size_t size)
+{
+    size_t p = (dec->pos + align - 1) & ~(align - 1);
+    if (p > dec->end || size > dec->end - p) {
+        return NULL;
+    }
+    dec->pos = p + size;
+    return dec->body + p;
+}
+
+static const char* dec_string(cap_decoder* dec)
+{
+    return get_string(dec->body, &dec->pos, dec->end);
+}
+
+static QStatus decode_arg(cap_decoder* dec, alljoyn_msgarg out, const char* sig, size_t sigLen, int depth);
+
+static QStatus decode_scalar_array(cap_decoder* dec, alljoyn_msgarg out, char elemType)
+{
+    size_t elemSize = scalar_size(elemType);
+    const uint8_t* p = dec_take(dec, 4, sizeof(uint32_t));
+    uint32_t count;
+    void* data;
+
+    if (!p) {
+        return ER_INVALID_DATA;
+    }
+    memcpy(&count, p, sizeof(count));
+    if ((size_t) count > (dec->end - dec->pos) / elemSize) {
+        return ER_INVALID_DATA;
+    }
+    data = (void*) dec_take(dec, elemSize, (size_t) count * elemSize);
+    if (!data) {
+        return ER_INVALID_DATA;
+    }
+    /* The setters only keep the pointer; the mapping is never written through it */
+    switch (elemType) {
+    case 'y': return alljoyn_msgarg_set_uint8_array(out, count, (uint8_t*) data);
+    case 'b': return alljoyn_msgarg_set_bool_array(out, count, (QCC_BOOL*) data);
+    case 'n': return alljoyn_msgarg_set_int16_array(out, count, (int16_t*) data);
+    case 'q': return alljoyn_msgarg_set_uint16_array(out, count, (uint16_t*) data);
+    case 'i': return alljoyn_msgarg_set_int32_array(out, count, (int32_t*) data);
+    case 'u': return alljoyn_msgarg_set_uint32_array(out, count, (uint32_t*) data);
+    case 'x': return alljoyn_msgarg_set_int64_array(out, count, (int64_t*) data);
+    case 't': return alljoyn_msgarg_set_uint64_array(out, count, (uint64_t*) data);
+    case 'd': return alljoyn_msgarg_set_double_array(out, count, (double*) data);
+    default: return ER_INVALID_DATA;
+    }
+}
+
+static QStatus decode_array(cap_decoder* dec, alljoyn_msgarg out, const char* sig, size_t sigLen, int depth)
+{
+    const uint8_t* p = dec_take(dec, 4, sizeof(uint32_t));
+    alljoyn_msgarg elems;
+    uint32_t count;
+    uint32_t i;
+    char* arraySig;
+    QStatus status = ER_OK;
+
+    if (!p) {
+        return ER_INVALID_DATA;
+    }
+    memcpy(&count, p, sizeof(count));
+    /* Every element takes at least one byte, which bounds the count before allocating */
+    if (count > dec->end - dec->pos) {
+        return ER_INVALID_DATA;
+    }
+
+    if (sig[1] == 's' || sig[1] == 'o' || sig[1] == 'g') {
+        const char** strs = (const char**) aj_argarena_alloc(dec->arena, (count ? count : 1) * sizeof(char*));
+        if (!strs) {
+            return ER_OUT_OF_MEMORY;
+        }
+        for (i = 0; i < count; ++i) {
+            strs[i] = dec_string(dec);
+            if (!strs[i]) {
+                return ER_INVALID_DATA;
+            }
+        }
+        if (sig[1] == 's') {
+            return alljoyn_msgarg_set_string_array(out, count, strs);
+        } else if (sig[1] == 'o') {
+            return alljoyn_msgarg_set_objectpath_array(out, count, strs);
+        }
+        return alljoyn_msgarg_set_signature_array(out, count, strs);
+    }
+
+    elems = count ? aj_argarena_msgargs(dec->arena, count) : NULL;
+    arraySig = (char*) aj_argarena_alloc(dec->arena, sigLen + 1);
+    if ((count && !elems) || !arraySig) {
+        return ER_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < count && ER_OK == status; ++i) {
+        status = decode_arg(dec, alljoyn_msgarg_array_element(elems, i), sig + 1, sigLen - 1, depth + 1);
+    }
+    if (ER_OK == status) {
+        memcpy(arraySig, sig, sigLen);
+        arraySig[sigLen] = '\0';
+        status = alljoyn_msgarg_set(out, arraySig, (size_t) count, elems);
+    }
+    return status;
+}
+
+static QStatus decode_arg(cap_decoder* dec, alljoyn_msgarg out, const char* sig, size_t sigLen, int depth)
+{
+    size_t size = scalar_size(sig[0]);
+    const uint8_t* p;
+
+    if (depth > CAP_MAX_DEPTH) {
+        return ER_INVALID_DATA;
+    }
+    if (size) {
+        union { uint8_t y; QCC_BOOL b; int16_t n; uint16_t q; int32_t i; uint32_t u; int64_t x; uint64_t t; double d; } v;
+        p = dec_take(dec, size, size);
+        if (!p) {
+            return ER_INVALID_DATA;
+        }
+        memcpy(&v, p, size);
+        switch (sig[0]) {
+        case 'y': return alljoyn_msgarg_set_uint8(out, v.y);
+        case 'b': return alljoyn_msgarg_set_bool(out, v.b);
+        case 'n': return alljoyn_msgarg_set_int16(out, v.n);
+        case 'q': return alljoyn_msgarg_set_uint16(out, v.q);
+        case 'i': return alljoyn_msgarg_set_int32(out, v.i);
+        case 'u': return alljoyn_msgarg_set_uint32(out, v.u);
+        case 'x': return alljoyn_msgarg_set_int64(out, v.x);
+        case 't': return alljoyn_msgarg_set_uint64(out, v.t);
+        case 'd': return alljoyn_msgarg_set_double(out, v.d);
+        default: return ER_NOT_IMPLEMENTED;
+        }
+    }
+
+    switch (sig[0]) {
+    case 's':
+    case 'o':
+    case 'g': {
+            const char* str = dec_string(dec);
+            if (!str) {
+                return ER_INVALID_DATA;
+            }
+            if (sig[0] == 's') {
+                return alljoyn_msgarg_set_string(out, str);
+            } else if (sig[0] == 'o') {
+                return alljoyn_msgarg_set_objectpath(out, str);
+            }
+            return alljoyn_msgarg_set_signature(out, str);
+        }
+
+    case 'v': {
+            const char* innerSig = dec_string(dec);
+            size_t innerLen = innerSig ? sig_type_len(innerSig, depth + 1) : 0;
+            alljoyn_msgarg inner;
+            QStatus status;
+            if (!innerLen || innerSig[innerLen] != '\0') {
+                return ER_INVALID_DATA;
+            }
+            inner = aj_argarena_msgargs(dec->arena, 1);
+            if (!inner) {
+                return ER_OUT_OF_MEMORY;
+            }
+            status = decode_arg(dec, inner, innerSig, innerLen, depth + 1);
+            if (ER_OK == status) {
+                status = alljoyn_msgarg_set(out, "v", inner);
+            }
+            return status;
+        }
+
+    case 'a':
+        if (scalar_size(sig[1]) && sig[1] != 'h') {
+            return decode_scalar_array(dec, out, sig[1]);
+        }
+        return decode_array(dec, out, sig, sigLen, depth);
+
+    case '(': {
+            alljoyn_msgarg members;
+            size_t numMembers = 0;
+            size_t pos;
+            size_t i;
+            QStatus status = ER_OK;
+
+            for (pos = 1; sig[pos] != ')'; pos += sig_type_len(sig + pos, depth + 1)) {
+                numMembers++;
+            }
+            members = aj_argarena_msgargs(dec->arena, numMembers);
+            if (!members) {
+                return ER_OUT_OF_MEMORY;
+            }
+            if (!dec_take(dec, 8, 0)) {
+                return ER_INVALID_DATA;
+            }
+            for (i = 0, pos = 1; i < numMembers && ER_OK == status; ++i) {
+                size_t n = sig_type_len(sig + pos, depth + 1);
+                status = decode_arg(dec, alljoyn_msgarg_array_element(members, i), sig + pos, n, depth + 1);
+                pos += n;
+            }
+            if (ER_OK == status) {
+                status = alljoyn_msgarg_setstruct(out, members, numMembers);
+            }
+            return status;
+        }
+
+    case '{': {
+            size_t keyLen = sig_type_len(sig + 1, depth + 1);
+            alljoyn_msgarg kv = aj_argarena_msgargs(dec->arena, 2);
+            QStatus status;
+            if (!kv) {
+                return ER_OUT_OF_MEMORY;
+            }
+            if (!dec_take(dec, 8, 0)) {
+                return ER_INVALID_DATA;
+            }
+            status = decode_arg(dec, alljoyn_msgarg_array_element(kv, 0), sig + 1, keyLen, depth + 1);
+            if (ER_OK == status) {
+                status = decode_arg(dec, alljoyn_msgarg_array_element(kv, 1), sig + 1 + keyLen, sigLen - keyLen - 2, depth + 1);
+            }
+            if (ER_OK == status) {
+                status = alljoyn_msgarg_setdictentry(out, alljoyn_msgarg_array_element(kv, 0), alljoyn_msgarg_array_element(kv, 1));
+            }
+            return status;
+        }
+
+    default:
+        return ER_INVALID_DATA;
+    }
+}
+
+QStatus aj_capfile_decodebody(const aj_caprecord* record, aj_argarena arena, alljoyn_msgarg* args, size_t* numArgs)
+{
+    const char* sig = record->signature;
+    cap_decoder dec;
+    size_t count = 0;
+    size_t pos;
+    size_t i;
+    QStatus status = ER_OK;
+
+    *args = NULL;
+    *numArgs = 0;
+    if (record->recFlags & AJ_CAPRECORD_NO_BODY) {
+        return ER_NOT_IMPLEMENTED;
+    }
+    for (pos = 0; sig[pos]; ++count) {
+        size_t n = sig_type_len(sig + pos, 0);
+        if (!n) {
+            return ER_INVALID_DATA;
+        }
+        pos += n;
+    }
+    if (!count) {
+        return ER_OK;
+    }
+
+    dec.body = record->body;
+    dec.pos = 0;
+    dec.end = record->bodyLength;
+    dec.arena = arena;
+    *args = aj_argarena_msgargs(arena, count);
+    if (!*args) {
+        return ER_OUT_OF_MEMORY;
+    }
+    for (i = 0, pos = 0; i < count && ER_OK == status; ++i) {
+        size_t n = sig_type_len(sig + pos, 0);
+        status = decode_arg(&dec, alljoyn_msgarg_array_element(*args, i), sig + pos, n, 0);
+        pos += n;
+    }
+    if (ER_OK == status && dec.pos != dec.end) {
+        status = ER_INVALID_DATA;
+    }
+    if (ER_OK == status) {
+        *numArgs = count;
+    }
+    return status;
+}
+
+static char* read_text(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    char* data = NULL;
+    long size;
+
+    if (!f) {
+        return NULL;
+    }
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = (char*) malloc((size_t) size + 1);
+        if (data && fread(data, 1, (size_t) size, f) != (size_t) size) {
+            free(data);
+            data = NULL;
+        } else if (data) {
+            data[size] = '\0';
+        }
+    }
+    fclose(f);
+    return data;
+}
+
+QStatus aj_capfile_loadinterfaces(alljoyn_busattachment bus, const char* path)
+{
+    char* xml = read_text(path);
+    QStatus status;
+
+    if (!xml) {
+        printf("aj_capfile: cannot read %s\n", path);
+        return ER_OPEN_FAILED;
+    }
+    status = alljoyn_busattachment_createinterfacesfromxml(bus, xml);
+    if (ER_OK != status) {
+        printf("aj_capfile: bad interface XML in %s (%s)\n", path, QCC_StatusText(status));
+    }
+    free(xml);
+    return status;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file
+ * @brief Append-only capture file of bus messages, designed to be read
+ * back through a read-only mapping.
+ *
+ * The file starts with a 16 byte header followed by records. Every record is
+ * 8-byte aligned and self-describing: a fixed header (length, message type
+ * and flags, timestamp, session id), the sender, destination, object path,
+ * interface, member and signature as NUL-terminated strings, and the body.
+ *
+ * The body is encoded by walking the signature, not in AllJoyn wire format,
+ * so that it can be turned back into MsgArgs without copying. Scalars are
+ * stored at their natural alignment, strings are NUL-terminated, and arrays
+ * of scalars are stored as raw element runs. The decoder points MsgArgs
+ * straight into the mapping. Values of type 'h' (socket handles) cannot be
+ * replayed; such bodies are recorded as empty and flagged.
+ */
+#ifndef _AJ_CAPFILE_H
+#define _AJ_CAPFILE_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/Message.h>
+#include <alljoyn_c/MsgArg.h>
+
+#include "aj_argarena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Record flag: the body was not recorded because it holds a socket handle. */
+#define AJ_CAPRECORD_NO_BODY    0x01
+
+/** Capture file writer */
+typedef struct _aj_capwriter_handle* aj_capwriter;
+
+/** Capture file reader */
+typedef struct _aj_capreader_handle* aj_capreader;
+
+/** One record as seen through aj_capreader_next(). Pointers are into the mapping. */
+typedef struct {
+    uint64_t timestamp;         /**< Capture time, nanoseconds since the epoch */
+    alljoyn_messagetype type;
+    uint8_t msgFlags;           /**< alljoyn_message_getflags() at capture time */
+    uint8_t recFlags;           /**< AJ_CAPRECORD_* flags */
+    alljoyn_sessionid sessionId;
+    const char* sender;
+    const char* destination;
+    const char* path;
+    const char* iface;
+    const char* member;
+    const char* signature;
+    const uint8_t* body;
+    size_t bodyLength;
+} aj_caprecord;
+
+/**
+ * Open a capture file for appending, creating it if needed.
+ *
+ * @return the writer, or NULL if the file cannot be opened or is not a
+ *         capture file.
+ */
+aj_capwriter aj_capwriter_open(const char* path);
+
+/** Close the writer. */
+void aj_capwriter_close(aj_capwriter writer);
+
+/**
+ * Append a message. Safe to call from several threads; each record is
+ * written with a single write() so concurrent writers never interleave.
+ */
+QStatus aj_capwriter_record(aj_capwriter writer, alljoyn_message message);
+
+/** Number of records appended through this writer. */
+uint32_t aj_capwriter_getcount(aj_capwriter writer);
+
+/**
+ * Map a capture file for reading.
+ *
+ * @return the reader, or NULL if the file cannot be mapped or is not a
+ *         capture file.
+ */
+aj_capreader aj_capreader_open(const char* path);
+
+/** Unmap the file. Records and args decoded from it become invalid. */
+void aj_capreader_close(aj_capreader reader);
+
+/**
+ * Read the next record.
+ *
+ * @return #ER_OK, #ER_NONE at the end of the file, or #ER_INVALID_DATA for a
+ *         truncated or corrupt record.
+ */
+QStatus aj_capreader_next(aj_capreader reader, aj_caprecord* record);
+
+/** Go back to the first record. */
+void aj_capreader_rewind(aj_capreader reader);
+
+/**
+ * Rebuild the arguments of a record. Strings and scalar arrays reference the
+ * mapping; containers are built from arena args.
+ *
+ * @param record       A record from aj_capreader_next().
+ * @param arena        Arena the args are allocated from; they are valid until
+ *                     its next reset.
+ * @param[out] args    Receives the argument array, NULL if there are none.
+ * @param[out] numArgs Receives the number of arguments.
+ *
+ * @return #ER_OK, #ER_NOT_IMPLEMENTED if the body was not recorded, or
+ *         #ER_INVALID_DATA if it does not match the signature.
+ */
+QStatus aj_capfile_decodebody(const aj_caprecord* record, aj_argarena arena, alljoyn_msgarg* args, size_t* numArgs);
+
+/**
+ * Create the interfaces described in an introspection XML file, so that
+ * messages on them can be captured or replayed.
+ *
+ * @return #ER_OK, #ER_OPEN_FAILED if the file cannot be read, or the status
+ *         of alljoyn_busattachment_createinterfacesfromxml().
+ */
+QStatus aj_capfile_loadinterfaces(alljoyn_busattachment bus, const char* path);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -9,16 +9,26 @@ Author : lester_hu@bandrich.com
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 
 #include <alljoyn_c/DBusStdDefines.h>
 #include <alljoyn_c/BusAttachment.h>
 #include <alljoyn_c/BusObject.h>
 #include <alljoyn_c/MsgArg.h>
 #include <alljoyn_c/InterfaceDescription.h>
+#include <alljoyn_c/ProxyBusObject.h>
 #include <alljoyn_c/version.h>
 
 #include <alljoyn_c/Status.h>
 
+#include "aj_balancer.h"
+#include "aj_disccache.h"
+#include "aj_keystore.h"
+#include "aj_peersec.h"
+#include "aj_shmchan.h"
+#include "aj_sigdesc.h"
+#include "aj_time.h"
+
 /* top level object responsible for connecting to and managing an AllJoyn message bus */
 alljoyn_busattachment g_msgBus;
 
@@ -42,8 +52,16 @@ static volatile sig_atomic_t g_interrupt = QCC_FALSE;
 static const alljoyn_sessionport SERVICE_PORT = 25;
 static alljoyn_sessionid s_sessionId = 0;
 
+static char s_joinedName[256];
+
+/* With -s <password> the interface is secure and every call is encrypted */
+#define KEY_EXPIRATION_SECONDS 3600
+static const char* KEYSTORE_PATH = "aj_c_client.ks";
+static aj_keystore s_keyStore = NULL;
+static const char* s_sharedKeyStore = NULL;
+static aj_peersec s_security = NULL;
+
 static QCC_BOOL s_joinComplete = QCC_FALSE;
-static QCC_BOOL s_found = QCC_FALSE;
 static QCC_BOOL s_lost  = QCC_FALSE;
 
 static void SigIntHandler(int sig)
@@ -51,83 +69,47 @@ static void SigIntHandler(int sig)
     g_interrupt = QCC_TRUE;
 }
 
-static char * convert_transport(alljoyn_transportmask transport)
+/* Input signature of add(), compiled from the interface member once */
+static aj_sigdesc s_addSig = NULL;
+
+/* Spreads calls over every instance advertised under OBJECT_NAME */
+static aj_balancer s_balancer = NULL;
+
+/* Called from the balancer's discovery thread once a session with an instance is up */
+void instance_joined(const void* context, const char* name, alljoyn_sessionid sessionId)
 {
-	char *transport_str = (char*) malloc (sizeof(char) * 32);
-	
-	switch (transport & 0xFFFF)
-	{
-		case 0x0000:
-			sprintf(transport_str, "NONE");
-			break;
-		case 0x0001:
-			sprintf(transport_str, "LOCAL");
-			break;
-		case 0x0002:
-			sprintf(transport_str, "BLUETOOTH");
-			break;
-		case 0xFFFF:
-			sprintf(transport_str, "ANY");
-			break;
-		default:
-			break;
-	}
-	return transport_str;
+	printf("[INFO] Joined instance %s (Session id=%d)\n", name, sessionId);
+	s_sessionId = sessionId;
+	snprintf(s_joinedName, sizeof(s_joinedName), "%s", name);
+	s_joinComplete = QCC_TRUE;
+	return;
+}
+
+/* Called when an instance went away for longer than the discovery hold-off */
+void instance_left(const void* context, const char* name)
+{
+	printf("[INFO] Instance %s left\n", name);
+	s_lost = (aj_balancer_getinstancecount(s_balancer) == 0) ? QCC_TRUE : QCC_FALSE;
+	return;
 }
 
 void found_advertised_name(const void* context, const char* name, alljoyn_transportmask transport, const char* namePrefix)
 {
 #ifdef DEBUG
-	char *transport_cov = convert_transport(transport);
 	printf("[CALLBACK] found_advertised_name - name %s\n", name);
 	printf("[CALLBACK] found_advertised_name - namePrefix %s\n", namePrefix);
-	printf("[CALLBACK] found_advertised_name - transport %s\n", transport_cov);
-	
-	if (transport_cov)	free(transport_cov);
+	printf("[CALLBACK] found_advertised_name - transport %s\n", aj_disccache_transportname(transport));
 #endif
-
-	if (0 == strcmp(name, OBJECT_NAME))
-	{	
-		/* Create session options */
-		alljoyn_sessionopts opts = alljoyn_sessionopts_create(ALLJOYN_TRAFFIC_TYPE_MESSAGES, QCC_FALSE, ALLJOYN_PROXIMITY_ANY, ALLJOYN_TRANSPORT_ANY);
-
-		/* enable concurrent callbacks so joinsession can be called */
-        alljoyn_busattachment_enableconcurrentcallbacks(g_msgBus);
-
-		// Request to join session owner
-		QStatus status = alljoyn_busattachment_joinsession(g_msgBus,
-												   		   name,
-												   		   SERVICE_PORT,
-												   		   NULL,
-												   		   &s_sessionId,
-												   		   opts);
-
-		if (ER_OK != status)
-		{
-	        printf("[INFO] alljoyn_busattachment_joinsession failed (status=%s)\n", QCC_StatusText(status));
-		}
-		else
-		{
-			printf("[INFO] alljoyn_busattachment_joinsession SUCCESS (Session id=%d)\n", s_sessionId);
-		}
-
-		alljoyn_sessionopts_destroy(opts);
-	}
-	s_joinComplete = QCC_TRUE;
 	return;
 }
 
 void lost_advertised_name(const void* context, const char* name, alljoyn_transportmask transport, const char* namePrefix)
 {
 #ifdef DEBUG
-	char *transport_cov = convert_transport(transport);
 	printf("[CALLBACK] lost_advertised_name - name %s\n", name);
 	printf("[CALLBACK] lost_advertised_name - namePrefix %s\n", namePrefix);
-	printf("[CALLBACK] lost_advertised_name - transport %s\n", transport_cov);
-	
-	if (transport_cov)	free(transport_cov);
+	printf("[CALLBACK] lost_advertised_name - transport %s\n", aj_disccache_transportname(transport));
 #endif
-	s_lost = QCC_TRUE;
 	return;
 }
 
@@ -182,6 +164,218 @@ void property_changed(const void *context, const char *prop_name, alljoyn_msgarg
 #endif
 }
 
+static uint64_t cpu_us(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return (uint64_t) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+		   (uint64_t) (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+}
+
+/*
+ * Time the handshake with the joined instance: first as a new connection
+ * would do it, resuming from stored keys when an earlier run left some, then
+ * forced to run the full key exchange.
+ */
+static void bench_handshake(void)
+{
+	alljoyn_proxybusobject proxy = alljoyn_proxybusobject_create(g_msgBus, s_joinedName, OBJECT_PATH, s_sessionId);
+	aj_peersec_stats before;
+	aj_peersec_stats after;
+	uint64_t start;
+	QStatus status;
+
+	aj_peersec_getstats(s_security, &before);
+	start = aj_time_now_ns();
+	status = alljoyn_proxybusobject_secureconnection(proxy, QCC_FALSE);
+	aj_peersec_getstats(s_security, &after);
+	printf("[INFO] Handshake: %.1f ms, %s (%s)\n", (double) (aj_time_now_ns() - start) / 1e6,
+		   after.fullExchanges > before.fullExchanges ? "full key exchange" : "resumed from stored keys",
+		   QCC_StatusText(status));
+
+	start = aj_time_now_ns();
+	status = alljoyn_proxybusobject_secureconnection(proxy, QCC_TRUE);
+	printf("[INFO] Forced re-authentication: %.1f ms (%s)\n", (double) (aj_time_now_ns() - start) / 1e6,
+		   QCC_StatusText(status));
+
+	/* The forced exchange replaced the stored keys; keep them for the next run */
+	if (ER_OK == status)
+	{
+		aj_peersec_setkeyexpiration(s_security, s_joinedName);
+	}
+	alljoyn_proxybusobject_destroy(proxy);
+}
+
+/*
+ * Back-to-back add() calls to the joined instance; CPU is this process only.
+ * The calls bypass the balancer so that no hedged duplicates are counted.
+ */
+static QStatus bench_calls(uint32_t calls)
+{
+	alljoyn_proxybusobject proxy = alljoyn_proxybusobject_create(g_msgBus, s_joinedName, OBJECT_PATH, s_sessionId);
+	alljoyn_message reply = alljoyn_message_create(g_msgBus);
+	alljoyn_msgarg inArgs = alljoyn_msgarg_array_create(2);
+	size_t sz = 2;
+	uint64_t startNs;
+	uint64_t startCpu;
+	uint64_t elapsedNs;
+	uint32_t done;
+	QStatus status = aj_sigdesc_encode(s_addSig, inArgs, sz, "1", "2");
+
+	if (ER_OK == status)
+	{
+		status = alljoyn_proxybusobject_addinterface(proxy, g_iface);
+	}
+
+	startNs = aj_time_now_ns();
+	startCpu = cpu_us();
+	for (done = 0; done < calls && ER_OK == status && g_interrupt == QCC_FALSE; ++done)
+	{
+		status = alljoyn_proxybusobject_methodcall(proxy, INTERFACE_NAME, "add", inArgs, sz, reply,
+												   ALLJOYN_MESSAGE_DEFAULT_TIMEOUT, 0);
+	}
+	elapsedNs = aj_time_now_ns() - startNs;
+	if (ER_OK == status && done)
+	{
+		printf("[INFO] %u %s calls: %.0f calls/s, %.1f us CPU per call\n", done, s_security ? "encrypted" : "plain",
+			   (double) done * 1e9 / (double) elapsedNs, (double) (cpu_us() - startCpu) / (double) done);
+	}
+	else
+	{
+		printf("[INFO] add failed after %u calls (status=%s)\n", done, QCC_StatusText(status));
+	}
+	alljoyn_msgarg_destroy(inArgs);
+	alljoyn_message_destroy(reply);
+	alljoyn_proxybusobject_destroy(proxy);
+	return status;
+}
+
+/* What the service counted over the calls of one payload */
+typedef struct
+{
+	uint64_t bytes;
+	uint32_t sum;
+} put_totals;
+
+/* Makes each put/putsegment call for aj_shmchan_send() */
+static QStatus put_call(void* context, const char* method, const alljoyn_msgarg args, size_t numArgs)
+{
+	put_totals* totals = (put_totals*) context;
+	alljoyn_msgarg outArgs = NULL;
+	size_t numOut = 0;
+	uint64_t n = 0;
+	uint32_t s = 0;
+	QStatus status = aj_balancer_methodcall_args(s_balancer, method, args, numArgs, &outArgs, &numOut,
+												 ALLJOYN_MESSAGE_DEFAULT_TIMEOUT, 0);
+
+	if (ER_OK == status && numOut == 2)
+	{
+		status = alljoyn_msgarg_get(alljoyn_msgarg_array_element(outArgs, 0), "t", &n);
+		if (ER_OK == status)
+		{
+			status = alljoyn_msgarg_get(alljoyn_msgarg_array_element(outArgs, 1), "u", &s);
+		}
+		totals->bytes += n;
+		totals->sum += s;
+	}
+	if (outArgs)
+	{
+		alljoyn_msgarg_destroy(outArgs);
+	}
+	return status;
+}
+
+/*
+ * Send one payload to the joined instance; *sum is the byte sum the service
+ * saw. Payloads of at least @p threshold bytes go through shared memory
+ * when the instance can take handles.
+ */
+static QStatus put_payload(const uint8_t* data, size_t length, size_t threshold, uint64_t* bytes, uint32_t* sum,
+						   aj_shmchan_path* path)
+{
+	put_totals totals = { 0, 0 };
+	QStatus status = aj_shmchan_send(data, length, threshold, "put", "putsegment", put_call, &totals, path);
+
+	*bytes = totals.bytes;
+	*sum = totals.sum;
+	return status;
+}
+
+static QStatus bench_transfer(uint32_t maxMb)
+{
+	static const uint32_t sizesMb[] = { 1, 10, 100 };
+	QCC_BOOL segments = QCC_TRUE;
+	QStatus status = ER_OK;
+	size_t i;
+
+	printf("%8s %10s %12s %12s\n", "MB", "path", "MB/s", "ms/payload");
+	for (i = 0; i < sizeof(sizesMb) / sizeof(sizesMb[0]) && sizesMb[i] <= maxMb && ER_OK == status; ++i)
+	{
+		size_t length = (size_t) sizesMb[i] * 1024 * 1024;
+		uint32_t reps = sizesMb[i] >= 100 ? 1 : 100 / sizesMb[i];
+		uint8_t* data = (uint8_t*) malloc(length);
+		uint32_t expected = 0;
+		int viaSegment;
+		size_t k;
+
+		if (!data)
+		{
+			return ER_OUT_OF_MEMORY;
+		}
+		for (k = 0; k < length; ++k)
+		{
+			data[k] = (uint8_t) (k * 31 + 7);
+			expected += data[k];
+		}
+		for (viaSegment = 0; viaSegment < 2 && ER_OK == status; ++viaSegment)
+		{
+			aj_shmchan_path expectedPath = viaSegment ? AJ_SHMCHAN_SENT_SEGMENT : AJ_SHMCHAN_SENT_INLINE;
+			aj_shmchan_path path = expectedPath;
+			uint64_t start;
+			double elapsedMs;
+			uint32_t r;
+
+			if (viaSegment && !segments)
+			{
+				break;
+			}
+			start = aj_time_now_ns();
+			for (r = 0; r < reps && ER_OK == status && path == expectedPath; ++r)
+			{
+				uint64_t bytes;
+				uint32_t sum;
+
+				/* The inline pass never tries a segment; the other uses the normal threshold */
+				status = put_payload(data, length, viaSegment ? AJ_SHMCHAN_THRESHOLD : SIZE_MAX, &bytes, &sum, &path);
+				if (ER_OK == status && (bytes != length || sum != expected))
+				{
+					printf("[INFO] The service received %llu bytes with a different sum\n", (unsigned long long) bytes);
+					status = ER_BUS_BAD_VALUE;
+				}
+			}
+			elapsedMs = (double) (aj_time_now_ns() - start) / 1e6;
+			if (ER_OK == status && path != expectedPath)
+			{
+				/* The instance is not on this host, or its connection cannot carry handles */
+				printf("[INFO] Handles cannot reach %s, shared memory skipped\n", s_joinedName);
+				segments = QCC_FALSE;
+			}
+			else if (ER_OK == status)
+			{
+				printf("%8u %10s %12.1f %12.2f\n", sizesMb[i], viaSegment ? "shm" : "inline",
+					   (double) sizesMb[i] * reps * 1000.0 / elapsedMs, elapsedMs / reps);
+			}
+			else
+			{
+				printf("[INFO] put failed (status=%s)\n", QCC_StatusText(status));
+			}
+		}
+		free(data);
+	}
+	return status;
+}
+
 int main(int argc, char** argv, char** envArg)
 {
 	printf("AllJoyn Library version: %s\n", alljoyn_getversion());
@@ -206,6 +400,48 @@ int main(int argc, char** argv, char** envArg)
 		&property_changed			// property_changed
 	};
 
+	/* Instance membership reported by the load balancer */
+	aj_balancer_callbacks bal_callback =
+	{
+		&instance_joined,			// instance_joined
+		&instance_left				// instance_left
+	};
+	int call_count = 0;
+	const char* password = NULL;
+	uint32_t keyExpiration = KEY_EXPIRATION_SECONDS;
+	uint32_t benchCalls = 0;
+	uint32_t benchMb = 0;
+	alljoyn_interfacedescription_member addMember;
+	int i;
+
+	/*
+	 * -s <password>: secure interface; -k <seconds>: key lifetime; -b <calls>: benchmark and exit;
+	 * -K <file>: key store shared with other processes; -t <MB>: payload throughput up to MB and exit
+	 */
+	for (i = 1; i < argc; ++i)
+	{
+		if (0 == strcmp(argv[i], "-s") && i + 1 < argc)
+		{
+			password = argv[++i];
+		}
+		else if (0 == strcmp(argv[i], "-k") && i + 1 < argc)
+		{
+			keyExpiration = (uint32_t) atoi(argv[++i]);
+		}
+		else if (0 == strcmp(argv[i], "-b") && i + 1 < argc)
+		{
+			benchCalls = (uint32_t) atoi(argv[++i]);
+		}
+		else if (0 == strcmp(argv[i], "-K") && i + 1 < argc)
+		{
+			s_sharedKeyStore = argv[++i];
+		}
+		else if (0 == strcmp(argv[i], "-t") && i + 1 < argc)
+		{
+			benchMb = (uint32_t) atoi(argv[++i]);
+		}
+	}
+
 	// 1. Create a BusAttachment
 	g_msgBus = alljoyn_busattachment_create("myApp", QCC_TRUE);
 
@@ -214,19 +450,49 @@ int main(int argc, char** argv, char** envArg)
 	alljoyn_busattachment_registerbuslistener(g_msgBus, g_busListener);
 
 	// 3. Create a BusInterterface
-	status = alljoyn_busattachment_createinterface(g_msgBus, INTERFACE_NAME, &g_iface);
+	if (password)
+	{
+		status = alljoyn_busattachment_createinterface_secure(g_msgBus, INTERFACE_NAME, &g_iface, AJ_IFC_SECURITY_REQUIRED);
+	}
+	else
+	{
+		status = alljoyn_busattachment_createinterface(g_msgBus, INTERFACE_NAME, &g_iface);
+	}
 
 	/* Add interface */
 	if (status == ER_OK) {
 		alljoyn_interfacedescription_addmember(g_iface,
 											   ALLJOYN_MESSAGE_METHOD_CALL,
-											   "cat",
+											   "add",
 											   "ss",
 											   "s",
 											   "inStr1,inStr2,outStr",
 											   0);
+		alljoyn_interfacedescription_addmember(g_iface,
+											   ALLJOYN_MESSAGE_METHOD_CALL,
+											   "put",
+											   "ay",
+											   "tu",
+											   "data,bytes,sum",
+											   0);
+		alljoyn_interfacedescription_addmember(g_iface,
+											   ALLJOYN_MESSAGE_METHOD_CALL,
+											   "putsegment",
+											   AJ_SHMCHAN_SIGNATURE,
+											   "tu",
+											   "segment,length,bytes,sum",
+											   0);
 		
 		alljoyn_interfacedescription_activate(g_iface);
+		if (alljoyn_interfacedescription_getmember(g_iface, "add", &addMember))
+		{
+			s_addSig = aj_sigdesc_compile(addMember.signature);
+		}
+		if (!s_addSig)
+		{
+			printf("[INFO] Cannot compile the signature of add\n");
+			goto oops;
+		}
 	}
 	else
 	{
@@ -249,6 +515,41 @@ int main(int argc, char** argv, char** envArg)
 	}
 	printf("[INFO] Bus Started\n");
 
+	if (password)
+	{
+		QCC_BOOL shared = s_sharedKeyStore ? QCC_TRUE : QCC_FALSE;
+		const char* keyStorePath = shared ? s_sharedKeyStore : KEYSTORE_PATH;
+
+		/* Keys are persisted incrementally instead of rewriting the whole store */
+		if (shared)
+		{
+			s_keyStore = aj_keystore_open_shared(keyStorePath, keyStorePath);
+		}
+		else
+		{
+			s_keyStore = aj_keystore_open(keyStorePath, keyStorePath);
+		}
+		if (s_keyStore)
+		{
+			alljoyn_busattachment_registerkeystorelistener(g_msgBus, aj_keystore_getlistener(s_keyStore));
+			s_security = aj_peersec_create(g_msgBus, password, keyExpiration, keyStorePath, shared);
+		}
+		if (!s_security)
+		{
+			status = ER_FAIL;
+			goto oops;
+		}
+		if (shared)
+		{
+			/* A peer another process authenticated needs no handshake here */
+			status = aj_keystore_watch(s_keyStore, g_msgBus);
+			if (ER_OK != status)
+			{
+				goto oops;
+			}
+		}
+	}
+
 	// Connect to Bus
 	status = alljoyn_busattachment_connect(g_msgBus, connectArgs);
 	if (ER_OK != status)
@@ -258,11 +559,21 @@ int main(int argc, char** argv, char** envArg)
 	}
 
 	printf("[INFO] Start to find advertised name\n");
-	status = alljoyn_busattachment_findadvertisedname(g_msgBus, OBJECT_NAME);
+	s_balancer = aj_balancer_create(g_msgBus, OBJECT_NAME, SERVICE_PORT, OBJECT_PATH, INTERFACE_NAME,
+									NULL, &bal_callback, NULL);
+	if (!s_balancer)
+	{
+		printf("[INFO] Failed to create load balancer\n");
+		status = ER_FAIL;
+		goto oops;
+	}
+	/* add() has no side effects, so a slow instance can be hedged against */
+	aj_balancer_sethedging(s_balancer, "add", 95.0);
+	status = aj_balancer_start(s_balancer);
 #ifdef DEBUG
 	if (status != ER_OK)
 	{
-    	printf("alljoyn_busattachment_findadvertisedname failed (%s))\n", QCC_StatusText(status));
+    	printf("aj_balancer_start failed (%s))\n", QCC_StatusText(status));
 		goto oops;
 	}
 #endif
@@ -272,7 +583,90 @@ int main(int argc, char** argv, char** envArg)
 		usleep(100 * 1000);
 	}
 
+	if (benchCalls > 0 && s_joinComplete == QCC_TRUE)
+	{
+		if (s_security)
+		{
+			bench_handshake();
+		}
+		status = bench_calls(benchCalls);
+		goto oops;
+	}
+
+	if (benchMb > 0 && s_joinComplete == QCC_TRUE)
+	{
+		status = bench_transfer(benchMb);
+		goto oops;
+	}
+
+	/* Each call goes to the instance with the fewest outstanding requests */
+	while (g_interrupt == QCC_FALSE)
+	{
+		char in1[16];
+		char in2[16];
+		char* result = NULL;
+		size_t sz = 2;
+		alljoyn_msgarg inArgs = alljoyn_msgarg_array_create(sz);
+		alljoyn_msgarg outArgs = NULL;
+		size_t numOut = 0;
+
+		snprintf(in1, sizeof(in1), "%d", call_count);
+		snprintf(in2, sizeof(in2), "%d", call_count + 1);
+		status = aj_sigdesc_encode(s_addSig, inArgs, sz, in1, in2);
+		if (ER_OK == status)
+		{
+			status = aj_balancer_methodcall_args(s_balancer, "add", inArgs, sz, &outArgs, &numOut,
+												 ALLJOYN_MESSAGE_DEFAULT_TIMEOUT, 0);
+		}
+		if (ER_OK == status && numOut > 0 && ER_OK == alljoyn_msgarg_get(alljoyn_msgarg_array_element(outArgs, 0), "s", &result))
+		{
+			printf("[INFO] add(%s, %s) = %s\n", in1, in2, result);
+		}
+		else
+		{
+			printf("[INFO] add failed (status=%s)\n", QCC_StatusText(status));
+		}
+		if (outArgs)
+		{
+			alljoyn_msgarg_destroy(outArgs);
+		}
+		alljoyn_msgarg_destroy(inArgs);
+		call_count++;
+#ifdef DEBUG
+		if (call_count % 10 == 0)
+		{
+			aj_balancer_hedgestats hs;
+			aj_balancer_gethedgestats(s_balancer, &hs);
+			printf("[INFO] hedging: %u calls, %u hedged, %u won by the hedge\n", hs.calls, hs.hedges, hs.wins);
+		}
+#endif
+		usleep(1000 * 1000);
+	}
+
 oops:
+	/* Leave every instance session before the bus goes away */
+	if (s_balancer)
+	{
+		aj_balancer_destroy(s_balancer);
+		s_balancer = NULL;
+	}
+
+	/* The watcher reloads through the bus, so it stops first */
+	if (s_keyStore)
+	{
+		aj_keystore_unwatch(s_keyStore);
+	}
+
+	if (s_security)
+	{
+		aj_peersec_stats ss;
+		aj_peersec_getstats(s_security, &ss);
+		printf("[INFO] Peer security: %u authentications, %u with a full key exchange, %u failed\n",
+			   ss.completed, ss.fullExchanges, ss.failed);
+		aj_peersec_destroy(s_security);
+		s_security = NULL;
+	}
+
 	/* Deallocate bus */
 	if (g_msgBus)
 	{
@@ -281,6 +675,13 @@ oops:
 		alljoyn_busattachment_destroy(deleteMe);
 	}
 
+	/* Only once the bus is gone, since the listener cannot be unregistered */
+	if (s_keyStore)
+	{
+		aj_keystore_close(s_keyStore);
+		s_keyStore = NULL;
+	}
+
 	/* Deallocate listener */
 	if (g_busListener)
 	{
@@ -0,0 +1,243 @@
+/**
+ * @file
+ * @brief Emitter-side policy deciding when to ask for header compression.
+ */
+#include <qcc/platform.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alljoyn_c/Message.h>
+
+#include "aj_compresspolicy.h"
+#include "aj_time.h"
+
+#define NUM_WAYS            4
+#define DEFAULT_MAX_TUPLES  256
+#define KEY_BUFFER_SIZE     256
+
+typedef enum {
+    TUPLE_COUNTING,
+    TUPLE_COMPRESSED,
+    TUPLE_REJECTED
+} tuple_state;
+
+typedef struct {
+    char* key;                  /* "dest\0iface\0member\0path", NULL if the way is empty */
+    size_t keyLen;
+    uint32_t hash;
+    tuple_state state;
+    uint32_t count;
+    uint64_t lastMs;
+} tuple;
+
+struct _aj_compresspolicy_handle {
+    pthread_mutex_t lock;
+    uint32_t threshold;
+    uint32_t idleMs;
+    size_t setMask;
+    tuple* tuples;              /* (setMask + 1) * NUM_WAYS */
+    aj_compresspolicy_stats stats;
+};
+
+aj_compresspolicy aj_compresspolicy_create(uint32_t threshold, uint32_t idleMs, size_t maxTuples)
+{
+    aj_compresspolicy policy = (aj_compresspolicy) calloc(1, sizeof(struct _aj_compresspolicy_handle));
+    size_t numSets = 1;
+
+    if (!policy) {
+        return NULL;
+    }
+    if (!maxTuples) {
+        maxTuples = DEFAULT_MAX_TUPLES;
+    }
+    while (numSets * NUM_WAYS < maxTuples) {
+        numSets *= 2;
+    }
+    policy->tuples = (tuple*) calloc(numSets * NUM_WAYS, sizeof(tuple));
+    if (!policy->tuples) {
+        free(policy);
+        return NULL;
+    }
+    pthread_mutex_init(&policy->lock, NULL);
+    policy->threshold = threshold ? threshold : 1;
+    policy->idleMs = idleMs;
+    policy->setMask = numSets - 1;
+    return policy;
+}
+
+void aj_compresspolicy_destroy(aj_compresspolicy policy)
+{
+    size_t i;
+
+    if (!policy) {
+        return;
+    }
+    for (i = 0; i < (policy->setMask + 1) * NUM_WAYS; ++i) {
+        free(policy->tuples[i].key);
+    }
+    pthread_mutex_destroy(&policy->lock);
+    free(policy->tuples);
+    free(policy);
+}
+
+/* Lay the tuple out as one key; returns its length, or 0 if it does not fit */
+static size_t make_key(char* buf, size_t size, const char* destination, const char* iface,
+                       const char* member, const char* path)
+{
+    const char* parts[4];
+    size_t len = 0;
+    size_t i;
+
+    parts[0] = destination ? destination : "";
+    parts[1] = iface ? iface : "";
+    parts[2] = member ? member : "";
+    parts[3] = path ? path : "";
+    for (i = 0; i < 4; ++i) {
+        size_t n = strlen(parts[i]) + 1;
+        if (len + n > size) {
+            return 0;
+        }
+        memcpy(buf + len, parts[i], n);
+        len += n;
+    }
+    return len;
+}
+
+static uint32_t hash_key(const char* key, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        hash = (hash ^ (uint8_t) key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/* Find or insert the tuple's entry; called with the lock held. NULL on allocation failure. */
+static tuple* lookup(aj_compresspolicy policy, const char* key, size_t keyLen, uint64_t now)
+{
+    uint32_t hash = hash_key(key, keyLen);
+    tuple* set = &policy->tuples[(hash & policy->setMask) * NUM_WAYS];
+    tuple* victim = &set[0];
+    size_t i;
+
+    for (i = 0; i < NUM_WAYS; ++i) {
+        tuple* t = &set[i];
+        if (t->key && t->hash == hash && t->keyLen == keyLen && 0 == memcmp(t->key, key, keyLen)) {
+            return t;
+        }
+        if (!t->key) {
+            victim = t;
+        } else if (victim->key && t->lastMs < victim->lastMs) {
+            victim = t;
+        }
+    }
+
+    if (victim->key) {
+        /* A rejected tuple is forgotten too; it will fail and be rejected again */
+        free(victim->key);
+        policy->stats.evicted++;
+        policy->stats.tuples--;
+    }
+    memset(victim, 0, sizeof(*victim));
+    victim->key = (char*) malloc(keyLen);
+    if (!victim->key) {
+        return NULL;
+    }
+    memcpy(victim->key, key, keyLen);
+    victim->keyLen = keyLen;
+    victim->hash = hash;
+    victim->state = TUPLE_COUNTING;
+    victim->lastMs = now;
+    policy->stats.tuples++;
+    return victim;
+}
+
+uint8_t aj_compresspolicy_flags(aj_compresspolicy policy, const char* destination, const char* iface,
+                                const char* member, const char* path)
+{
+    char key[KEY_BUFFER_SIZE];
+    size_t keyLen = make_key(key, sizeof(key), destination, iface, member, path);
+    uint64_t now = aj_time_now_ms();
+    uint8_t flags = 0;
+    tuple* t;
+
+    /* Tuples too long for the key buffer are simply never compressed */
+    if (!keyLen) {
+        return 0;
+    }
+    pthread_mutex_lock(&policy->lock);
+    policy->stats.sent++;
+    t = lookup(policy, key, keyLen, now);
+    if (t && t->state != TUPLE_REJECTED) {
+        if (t->count && now - t->lastMs > policy->idleMs) {
+            t->state = TUPLE_COUNTING;
+            t->count = 0;
+        }
+        t->count++;
+        if (t->state == TUPLE_COUNTING && t->count >= policy->threshold) {
+            t->state = TUPLE_COMPRESSED;
+        }
+        if (t->state == TUPLE_COMPRESSED) {
+            flags = ALLJOYN_MESSAGE_FLAG_COMPRESSED;
+            policy->stats.compressed++;
+        }
+    }
+    if (t) {
+        t->lastMs = now;
+    }
+    pthread_mutex_unlock(&policy->lock);
+    return flags;
+}
+
+void aj_compresspolicy_reject(aj_compresspolicy policy, const char* destination, const char* iface,
+                              const char* member, const char* path)
+{
+    char key[KEY_BUFFER_SIZE];
+    size_t keyLen = make_key(key, sizeof(key), destination, iface, member, path);
+    tuple* t;
+
+    if (!keyLen) {
+        return;
+    }
+    pthread_mutex_lock(&policy->lock);
+    t = lookup(policy, key, keyLen, aj_time_now_ms());
+    if (t && t->state != TUPLE_REJECTED) {
+        t->state = TUPLE_REJECTED;
+        policy->stats.rejected++;
+    }
+    pthread_mutex_unlock(&policy->lock);
+}
+
+QStatus aj_compresspolicy_signal(aj_compresspolicy policy, alljoyn_busobject busObject, const char* destination,
+                                 alljoyn_sessionid sessionId, const alljoyn_interfacedescription_member member,
+                                 const alljoyn_msgarg args, size_t numArgs, uint16_t timeToLive, uint8_t flags,
+                                 alljoyn_message msg)
+{
+    const char* iface = alljoyn_interfacedescription_getname(member.iface);
+    const char* path = alljoyn_busobject_getpath(busObject);
+    uint8_t extra = aj_compresspolicy_flags(policy, destination, iface, member.name, path);
+    QStatus status;
+
+    status = alljoyn_busobject_signal(busObject, destination, sessionId, member, args, numArgs, timeToLive,
+                                      flags | extra, msg);
+    if (ER_OK != status && extra && !(flags & ALLJOYN_MESSAGE_FLAG_COMPRESSED)) {
+        printf("aj_compresspolicy: compressed %s.%s on %s failed (%s), sending uncompressed\n",
+               iface, member.name, path, QCC_StatusText(status));
+        aj_compresspolicy_reject(policy, destination, iface, member.name, path);
+        status = alljoyn_busobject_signal(busObject, destination, sessionId, member, args, numArgs, timeToLive,
+                                          flags, msg);
+    }
+    return status;
+}
+
+void aj_compresspolicy_getstats(aj_compresspolicy policy, aj_compresspolicy_stats* stats)
+{
+    pthread_mutex_lock(&policy->lock);
+    *stats = policy->stats;
+    pthread_mutex_unlock(&policy->lock);
+}
@@ -0,0 +1,89 @@
+/**
+ * @file
+ * @brief Emitter-side policy deciding when to ask for header compression.
+ *
+ * With #ALLJOYN_MESSAGE_FLAG_COMPRESSED the header fields that repeat from
+ * message to message (destination, interface, member, path and signature)
+ * are replaced by a token. The first message with a new combination still
+ * carries the full header, and the receiving side has to learn the
+ * expansion for the token, so compression only pays off for combinations
+ * that are sent again and again.
+ *
+ * The policy counts sends per (destination, interface, member, path) tuple.
+ * A tuple is compressed once it has been sent @c threshold times without a
+ * gap longer than the idle time; after such a gap it starts counting again.
+ * A tuple whose compressed send fails is never compressed again. Tuples are
+ * kept in a small set-associative table; when a set is full the least
+ * recently sent tuple in it is forgotten.
+ */
+#ifndef _AJ_COMPRESSPOLICY_H
+#define _AJ_COMPRESSPOLICY_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusObject.h>
+#include <alljoyn_c/InterfaceDescription.h>
+#include <alljoyn_c/MsgArg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Compression policy handle */
+typedef struct _aj_compresspolicy_handle* aj_compresspolicy;
+
+/** Counters. */
+typedef struct {
+    uint64_t sent;          /**< Sends counted */
+    uint64_t compressed;    /**< Sends the policy compressed */
+    uint32_t tuples;        /**< Tuples currently tracked */
+    uint32_t evicted;       /**< Tuples forgotten to make room */
+    uint32_t rejected;      /**< Tuples whose compressed send failed */
+} aj_compresspolicy_stats;
+
+/**
+ * Create a policy.
+ *
+ * @param threshold  Sends of a tuple after which it is compressed; 1
+ *                   compresses from the first send.
+ * @param idleMs     A tuple not sent for this long starts counting again.
+ * @param maxTuples  Tuples tracked at most, or 0 for 256.
+ *
+ * @return the policy, or NULL on allocation failure.
+ */
+aj_compresspolicy aj_compresspolicy_create(uint32_t threshold, uint32_t idleMs, size_t maxTuples);
+
+/** Destroy the policy. */
+void aj_compresspolicy_destroy(aj_compresspolicy policy);
+
+/**
+ * Count a send of the tuple and return the flags to add to it:
+ * #ALLJOYN_MESSAGE_FLAG_COMPRESSED or 0. Thread safe.
+ *
+ * @param destination  Destination, or NULL for a broadcast.
+ */
+uint8_t aj_compresspolicy_flags(aj_compresspolicy policy, const char* destination, const char* iface,
+                                const char* member, const char* path);
+
+/** Never compress the tuple again. Thread safe. */
+void aj_compresspolicy_reject(aj_compresspolicy policy, const char* destination, const char* iface,
+                              const char* member, const char* path);
+
+/**
+ * alljoyn_busobject_signal() with the compression flag chosen by the policy.
+ * If the compressed send fails, the tuple is rejected and the signal is sent
+ * again uncompressed.
+ */
+QStatus aj_compresspolicy_signal(aj_compresspolicy policy, alljoyn_busobject busObject, const char* destination,
+                                 alljoyn_sessionid sessionId, const alljoyn_interfacedescription_member member,
+                                 const alljoyn_msgarg args, size_t numArgs, uint16_t timeToLive, uint8_t flags,
+                                 alljoyn_message msg);
+
+/** Copy the counters. */
+void aj_compresspolicy_getstats(aj_compresspolicy policy, aj_compresspolicy_stats* stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
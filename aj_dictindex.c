@@ -0,0 +1,149 @@
+/**
+ * @file
+ * @brief Read-only hash index over a string keyed dictionary MsgArg.
+ */
+#include <qcc/platform.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "aj_dictindex.h"
+
+typedef struct {
+    const char* key;            /* NULL for an empty slot */
+    size_t keyLen;
+    uint32_t hash;
+    alljoyn_msgarg value;
+} dict_slot;
+
+struct _aj_dictindex_handle {
+    dict_slot* slots;
+    size_t mask;                /* number of slots - 1 */
+    size_t count;
+};
+
+static uint32_t hash_key(const char* key, size_t* len)
+{
+    const char* p = key;
+    uint32_t hash = 2166136261u;
+
+    while (*p) {
+        hash = (hash ^ (uint8_t) *p++) * 16777619u;
+    }
+    *len = (size_t) (p - key);
+    return hash;
+}
+
+static const char* entry_key(alljoyn_msgarg entry)
+{
+    alljoyn_msgarg key = alljoyn_msgarg_getkey(entry);
+    char* str = NULL;
+
+    if (!key) {
+        return NULL;
+    }
+    /* The string getters fill in a pointer to the arg's own string */
+    switch (alljoyn_msgarg_gettype(key)) {
+    case ALLJOYN_STRING:
+        alljoyn_msgarg_get_string(key, (char*) &str);
+        break;
+
+    case ALLJOYN_OBJECT_PATH:
+        alljoyn_msgarg_get_objectpath(key, (char*) &str);
+        break;
+
+    case ALLJOYN_SIGNATURE:
+        alljoyn_msgarg_get_signature(key, (char*) &str);
+        break;
+
+    default:
+        break;
+    }
+    return str;
+}
+
+aj_dictindex aj_dictindex_create(const alljoyn_msgarg dict)
+{
+    aj_dictindex index;
+    size_t numEntries;
+    size_t numSlots = 8;
+    size_t i;
+
+    if (!dict || alljoyn_msgarg_gettype(dict) != ALLJOYN_ARRAY) {
+        return NULL;
+    }
+    numEntries = alljoyn_msgarg_get_array_numberofelements(dict);
+    /* At most half full keeps linear probe sequences short */
+    while (numSlots < 2 * numEntries) {
+        numSlots *= 2;
+    }
+
+    index = (aj_dictindex) calloc(1, sizeof(struct _aj_dictindex_handle));
+    if (!index) {
+        return NULL;
+    }
+    index->slots = (dict_slot*) calloc(numSlots, sizeof(dict_slot));
+    if (!index->slots) {
+        free(index);
+        return NULL;
+    }
+    index->mask = numSlots - 1;
+
+    for (i = 0; i < numEntries; ++i) {
+        alljoyn_msgarg entry = NULL;
+        const char* key;
+        size_t keyLen;
+        uint32_t hash;
+        size_t slot;
+
+        alljoyn_msgarg_get_array_element(dict, i, &entry);
+        if (!entry || alljoyn_msgarg_gettype(entry) != ALLJOYN_DICT_ENTRY || !(key = entry_key(entry))) {
+            aj_dictindex_destroy(index);
+            return NULL;
+        }
+        hash = hash_key(key, &keyLen);
+        for (slot = hash & index->mask; index->slots[slot].key; slot = (slot + 1) & index->mask) {
+            if (index->slots[slot].hash == hash && index->slots[slot].keyLen == keyLen &&
+                0 == memcmp(index->slots[slot].key, key, keyLen)) {
+                break;
+            }
+        }
+        if (!index->slots[slot].key) {
+            index->slots[slot].key = key;
+            index->slots[slot].keyLen = keyLen;
+            index->slots[slot].hash = hash;
+            index->slots[slot].value = alljoyn_msgarg_getvalue(entry);
+            index->count++;
+        }
+    }
+    return index;
+}
+
+void aj_dictindex_destroy(aj_dictindex index)
+{
+    if (!index) {
+        return;
+    }
+    free(index->slots);
+    free(index);
+}
+
+alljoyn_msgarg aj_dictindex_lookup(aj_dictindex index, const char* key)
+{
+    size_t keyLen;
+    uint32_t hash = hash_key(key, &keyLen);
+    size_t slot;
+
+    for (slot = hash & index->mask; index->slots[slot].key; slot = (slot + 1) & index->mask) {
+        const dict_slot* s = &index->slots[slot];
+        if (s->hash == hash && s->keyLen == keyLen && 0 == memcmp(s->key, key, keyLen)) {
+            return s->value;
+        }
+    }
+    return NULL;
+}
+
+size_t aj_dictindex_getcount(aj_dictindex index)
+{
+    return index->count;
+}
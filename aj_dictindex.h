@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @brief Read-only hash index over a string keyed dictionary MsgArg.
+ *
+ * alljoyn_msgarg_getdictelement() compares the key against every entry, so
+ * reading k fields out of an n entry a{sv}, for example the result of
+ * alljoyn_proxybusobject_getallproperties(), costs O(n * k). An index is
+ * built once in O(n) and answers each lookup in O(1) on average. It stores
+ * pointers into the dictionary, so the dictionary must outlive the index and
+ * must not be modified while the index is in use.
+ *
+ * @code
+ * aj_dictindex idx = aj_dictindex_create(props);
+ * alljoyn_msgarg v = aj_dictindex_lookup(idx, "Volume");
+ * if (v) {
+ *     status = alljoyn_msgarg_get(v, "i", &volume);     // variants unwrap in get
+ * }
+ * aj_dictindex_destroy(idx);
+ * @endcode
+ */
+#ifndef _AJ_DICTINDEX_H
+#define _AJ_DICTINDEX_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/MsgArg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Index over one dictionary */
+typedef struct _aj_dictindex_handle* aj_dictindex;
+
+/**
+ * Index an array of dict entries whose keys are strings ('s', 'o' or 'g'),
+ * such as an a{sv}. When a key occurs more than once the first entry wins,
+ * as with alljoyn_msgarg_getdictelement().
+ *
+ * @return the index, or NULL if @p dict is not a string keyed dictionary or
+ *         memory runs out.
+ */
+aj_dictindex aj_dictindex_create(const alljoyn_msgarg dict);
+
+/** Free the index. The dictionary is not touched. */
+void aj_dictindex_destroy(aj_dictindex index);
+
+/**
+ * Find the value stored under @p key.
+ *
+ * @return the value arg inside the dictionary, or NULL if there is none.
+ */
+alljoyn_msgarg aj_dictindex_lookup(aj_dictindex index, const char* key);
+
+/** Number of distinct keys indexed. */
+size_t aj_dictindex_getcount(aj_dictindex index);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
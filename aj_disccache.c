@@ -0,0 +1,452 @@
+/**
+ * @file
+ * @brief Discovery cache that folds found/lost advertised name storms into
+ * consolidated available/unavailable notifications.
+ */
+#include <qcc/platform.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aj_disccache.h"
+#include "aj_time.h"
+
+#define TRANSPORT_BITS   16
+#define INITIAL_BUCKETS  64
+#define MAX_WAIT_MS      1000
+
+typedef struct _disc_entry {
+    struct _disc_entry* next;
+    uint32_t hash;
+    char* name;
+    alljoyn_transportmask found;            /* transports currently advertising */
+    alljoyn_transportmask pending;          /* transports lost but still inside the hold-off */
+    uint64_t lostAt[TRANSPORT_BITS];
+    QCC_BOOL notified;                      /* name_available delivered, name_unavailable not yet */
+    uint64_t goneAt;
+    uint64_t redeliverAt;                   /* name_available held back until then, see aj_disccache_redeliver() */
+} disc_entry;
+
+typedef enum {
+    DISC_EVENT_AVAILABLE,
+    DISC_EVENT_UNAVAILABLE
+} disc_event_type;
+
+typedef struct {
+    disc_event_type type;
+    char* name;
+    alljoyn_transportmask transports;
+} disc_event;
+
+struct _aj_disccache_handle {
+    aj_disccache_callbacks callbacks;
+    const void* context;
+    uint32_t holdoffMs;
+    uint32_t ttlMs;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    QCC_BOOL stopping;
+
+    disc_entry** buckets;
+    size_t numBuckets;
+    size_t numEntries;
+
+    aj_disccache_stats stats;
+};
+
+static uint32_t hash_name(const char* name)
+{
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (uint8_t) *name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static disc_entry* find_entry(aj_disccache cache, const char* name, uint32_t hash)
+{
+    disc_entry* e = cache->buckets[hash & (cache->numBuckets - 1)];
+    while (e && (e->hash != hash || strcmp(e->name, name))) {
+        e = e->next;
+    }
+    return e;
+}
+
+static void grow_buckets(aj_disccache cache)
+{
+    size_t newCount = cache->numBuckets * 2;
+    disc_entry** newBuckets = (disc_entry**) calloc(newCount, sizeof(disc_entry*));
+    size_t i;
+
+    if (!newBuckets) {
+        return;
+    }
+    for (i = 0; i < cache->numBuckets; ++i) {
+        disc_entry* e = cache->buckets[i];
+        while (e) {
+            disc_entry* next = e->next;
+            e->next = newBuckets[e->hash & (newCount - 1)];
+            newBuckets[e->hash & (newCount - 1)] = e;
+            e = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = newBuckets;
+    cache->numBuckets = newCount;
+}
+
+static disc_entry* add_entry(aj_disccache cache, const char* name, uint32_t hash)
+{
+    disc_entry* e = (disc_entry*) calloc(1, sizeof(disc_entry));
+    size_t b;
+
+    if (!e) {
+        return NULL;
+    }
+    e->name = strdup(name);
+    if (!e->name) {
+        free(e);
+        return NULL;
+    }
+    e->hash = hash;
+    if (cache->numEntries >= cache->numBuckets) {
+        grow_buckets(cache);
+    }
+    b = hash & (cache->numBuckets - 1);
+    e->next = cache->buckets[b];
+    cache->buckets[b] = e;
+    cache->numEntries++;
+    return e;
+}
+
+static QCC_BOOL push_event(disc_event** events, size_t* count, size_t* capacity,
+                           disc_event_type type, const char* name, alljoyn_transportmask transports)
+{
+    if (*count == *capacity) {
+        size_t newCap = *capacity ? *capacity * 2 : 8;
+        disc_event* grown = (disc_event*) realloc(*events, newCap * sizeof(disc_event));
+        if (!grown) {
+            return QCC_FALSE;
+        }
+        *events = grown;
+        *capacity = newCap;
+    }
+    (*events)[*count].type = type;
+    (*events)[*count].name = strdup(name);
+    (*events)[*count].transports = transports;
+    if (!(*events)[*count].name) {
+        return QCC_FALSE;
+    }
+    (*count)++;
+    return QCC_TRUE;
+}
+
+/*
+ * Walk every entry, retire expired hold-offs and TTLs, and collect the
+ * notifications that are due. Returns how long the thread may sleep before
+ * the next deadline. Called with the lock held.
+ */
+static uint32_t sweep(aj_disccache cache, disc_event** events, size_t* count, size_t* capacity)
+{
+    uint64_t now = aj_time_now_ms();
+    uint64_t next = now + MAX_WAIT_MS;
+    size_t i;
+    int bit;
+
+    for (i = 0; i < cache->numBuckets; ++i) {
+        disc_entry** link = &cache->buckets[i];
+        while (*link) {
+            disc_entry* e = *link;
+            alljoyn_transportmask live;
+
+            for (bit = 0; bit < TRANSPORT_BITS; ++bit) {
+                alljoyn_transportmask m = (alljoyn_transportmask) (1u << bit);
+                if (e->pending & m) {
+                    uint64_t expires = e->lostAt[bit] + cache->holdoffMs;
+                    if (expires <= now) {
+                        e->pending &= (alljoyn_transportmask) ~m;
+                    } else if (expires < next) {
+                        next = expires;
+                    }
+                }
+            }
+
+            live = e->found | e->pending;
+            if (live && !e->notified && e->redeliverAt > now) {
+                if (e->redeliverAt < next) {
+                    next = e->redeliverAt;
+                }
+            } else if (live && !e->notified) {
+                if (push_event(events, count, capacity, DISC_EVENT_AVAILABLE, e->name, live)) {
+                    e->notified = QCC_TRUE;
+                    cache->stats.available++;
+                }
+            } else if (!live && e->notified) {
+                if (push_event(events, count, capacity, DISC_EVENT_UNAVAILABLE, e->name, 0)) {
+                    e->notified = QCC_FALSE;
+                    e->goneAt = now;
+                    cache->stats.unavailable++;
+                }
+            }
+
+            if (!live && !e->notified) {
+                uint64_t expires = e->goneAt + cache->ttlMs;
+                if (expires <= now) {
+                    *link = e->next;
+                    cache->numEntries--;
+                    free(e->name);
+                    free(e);
+                    continue;
+                }
+                if (expires < next) {
+                    next = expires;
+                }
+            }
+            link = &e->next;
+        }
+    }
+    return (uint32_t) (next > now ? next - now : 0);
+}
+
+static void* notify_thread(void* arg)
+{
+    aj_disccache cache = (aj_disccache) arg;
+    disc_event* events = NULL;
+    size_t capacity = 0;
+
+    pthread_mutex_lock(&cache->lock);
+    while (!cache->stopping) {
+        size_t count = 0;
+        size_t i;
+        uint32_t waitMs = sweep(cache, &events, &count, &capacity);
+
+        if (count) {
+            /* Deliver without the lock so callbacks may query the cache */
+            pthread_mutex_unlock(&cache->lock);
+            for (i = 0; i < count; ++i) {
+                if (events[i].type == DISC_EVENT_AVAILABLE) {
+                    if (cache->callbacks.name_available) {
+                        cache->callbacks.name_available(cache->context, events[i].name, events[i].transports);
+                    }
+                } else if (cache->callbacks.name_unavailable) {
+                    cache->callbacks.name_unavailable(cache->context, events[i].name);
+                }
+                free(events[i].name);
+            }
+            pthread_mutex_lock(&cache->lock);
+            continue;
+        }
+
+        if (waitMs) {
+            struct timespec deadline;
+            aj_time_deadline(&deadline, waitMs);
+            pthread_cond_timedwait(&cache->wake, &cache->lock, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    free(events);
+    return NULL;
+}
+
+aj_disccache aj_disccache_create(const aj_disccache_callbacks* callbacks, const void* context,
+                                 uint32_t holdoffMs, uint32_t ttlMs)
+{
+    aj_disccache cache = (aj_disccache) calloc(1, sizeof(struct _aj_disccache_handle));
+    if (!cache) {
+        return NULL;
+    }
+    if (callbacks) {
+        cache->callbacks = *callbacks;
+    }
+    cache->context = context;
+    cache->holdoffMs = holdoffMs;
+    cache->ttlMs = ttlMs;
+    cache->numBuckets = INITIAL_BUCKETS;
+    cache->buckets = (disc_entry**) calloc(cache->numBuckets, sizeof(disc_entry*));
+    if (!cache->buckets) {
+        free(cache);
+        return NULL;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_cond_init(&cache->wake, NULL);
+    if (pthread_create(&cache->thread, NULL, notify_thread, cache) != 0) {
+        pthread_cond_destroy(&cache->wake);
+        pthread_mutex_destroy(&cache->lock);
+        free(cache->buckets);
+        free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void aj_disccache_destroy(aj_disccache cache)
+{
+    size_t i;
+
+    if (!cache) {
+        return;
+    }
+    pthread_mutex_lock(&cache->lock);
+    cache->stopping = QCC_TRUE;
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->lock);
+    pthread_join(cache->thread, NULL);
+
+    for (i = 0; i < cache->numBuckets; ++i) {
+        disc_entry* e = cache->buckets[i];
+        while (e) {
+            disc_entry* next = e->next;
+            free(e->name);
+            free(e);
+            e = next;
+        }
+    }
+    free(cache->buckets);
+    pthread_cond_destroy(&cache->wake);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+void aj_disccache_found_advertised_name(const void* context, const char* name,
+                                        alljoyn_transportmask transport, const char* namePrefix)
+{
+    aj_disccache cache = (aj_disccache) context;
+    uint32_t hash;
+    disc_entry* e;
+
+    if (!cache || !name) {
+        return;
+    }
+    hash = hash_name(name);
+    pthread_mutex_lock(&cache->lock);
+    cache->stats.found++;
+    e = find_entry(cache, name, hash);
+    if (!e) {
+        e = add_entry(cache, name, hash);
+    }
+    if (e) {
+        alljoyn_transportmask live = e->found | e->pending;
+        /* A loss still inside the hold-off, or one reported less than a TTL ago */
+        if ((e->pending & transport) ||
+            (!live && e->goneAt && aj_time_now_ms() - e->goneAt < cache->ttlMs)) {
+            cache->stats.flaps++;
+        }
+        e->pending &= (alljoyn_transportmask) ~transport;
+        e->found |= transport;
+        if (!e->notified) {
+            pthread_cond_signal(&cache->wake);
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void aj_disccache_lost_advertised_name(const void* context, const char* name,
+                                       alljoyn_transportmask transport, const char* namePrefix)
+{
+    aj_disccache cache = (aj_disccache) context;
+    disc_entry* e;
+
+    if (!cache || !name) {
+        return;
+    }
+    pthread_mutex_lock(&cache->lock);
+    cache->stats.lost++;
+    e = find_entry(cache, name, hash_name(name));
+    if (e && (e->found & transport)) {
+        uint64_t now = aj_time_now_ms();
+        int bit;
+        for (bit = 0; bit < TRANSPORT_BITS; ++bit) {
+            alljoyn_transportmask m = (alljoyn_transportmask) (1u << bit);
+            if (e->found & transport & m) {
+                e->lostAt[bit] = now;
+            }
+        }
+        e->pending |= e->found & transport;
+        e->found &= (alljoyn_transportmask) ~transport;
+        /* Wake the thread so it picks up the new hold-off deadline */
+        pthread_cond_signal(&cache->wake);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void aj_disccache_redeliver(aj_disccache cache, const char* name, uint32_t delayMs)
+{
+    disc_entry* e;
+
+    pthread_mutex_lock(&cache->lock);
+    e = find_entry(cache, name, hash_name(name));
+    if (e) {
+        e->notified = QCC_FALSE;
+        e->redeliverAt = aj_time_now_ms() + delayMs;
+        pthread_cond_signal(&cache->wake);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+QCC_BOOL aj_disccache_isavailable(aj_disccache cache, const char* name, alljoyn_transportmask* transports)
+{
+    QCC_BOOL available = QCC_FALSE;
+    disc_entry* e;
+
+    pthread_mutex_lock(&cache->lock);
+    e = find_entry(cache, name, hash_name(name));
+    if (e && (e->found | e->pending)) {
+        available = QCC_TRUE;
+        if (transports) {
+            *transports = e->found | e->pending;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return available;
+}
+
+size_t aj_disccache_foreach(aj_disccache cache, const char* prefix, aj_disccache_visit_ptr visit, void* context)
+{
+    size_t prefixLen = prefix ? strlen(prefix) : 0;
+    size_t visited = 0;
+    size_t i;
+
+    pthread_mutex_lock(&cache->lock);
+    for (i = 0; i < cache->numBuckets; ++i) {
+        disc_entry* e;
+        for (e = cache->buckets[i]; e; e = e->next) {
+            alljoyn_transportmask live = e->found | e->pending;
+            if (live && strncmp(e->name, prefix ? prefix : "", prefixLen) == 0) {
+                if (visit) {
+                    visit(context, e->name, live);
+                }
+                visited++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return visited;
+}
+
+void aj_disccache_getstats(aj_disccache cache, aj_disccache_stats* stats)
+{
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+const char* aj_disccache_transportname(alljoyn_transportmask transport)
+{
+    switch (transport) {
+    case 0x0000: return "NONE";
+    case 0x0001: return "LOCAL";
+    case 0x0002: return "BLUETOOTH";
+    case 0x0004: return "TCP";
+    case 0x0008: return "WWAN";
+    case 0x0010: return "LAN";
+    case 0x0020: return "ICE";
+    case 0x0040: return "PROXIMITY";
+    case 0x0080: return "WFD";
+    case 0xFFFF: return "ANY";
+    default:     return "MIXED";
+    }
+}
@@ -0,0 +1,138 @@
+/**
+ * @file
+ * @brief Discovery cache that folds found/lost advertised name storms into
+ * consolidated available/unavailable notifications.
+ *
+ * Entries are keyed by well-known name and transport. A lost advertisement
+ * only takes effect after it has persisted for the hold-off period, so a name
+ * that flaps on a lossy link is reported once as available and never as
+ * unavailable. Names that did go away are remembered for the TTL so that
+ * re-appearances inside that window are counted as flaps. All notifications
+ * are delivered in order from the cache's own thread, never from the AllJoyn
+ * dispatcher, so it is safe to call blocking functions such as
+ * alljoyn_busattachment_joinsession() from them.
+ */
+#ifndef _AJ_DISCCACHE_H
+#define _AJ_DISCCACHE_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/TransportMask.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Discovery cache handle */
+typedef struct _aj_disccache_handle* aj_disccache;
+
+/**
+ * Called once when a name becomes reachable over at least one transport.
+ *
+ * @param context     Context passed to aj_disccache_create().
+ * @param name        The well-known name.
+ * @param transports  Transports the name is currently reachable over.
+ */
+typedef void (*aj_disccache_available_ptr)(const void* context, const char* name, alljoyn_transportmask transports);
+
+/**
+ * Called once when a name has been unreachable over every transport for the
+ * whole hold-off period.
+ *
+ * @param context  Context passed to aj_disccache_create().
+ * @param name     The well-known name.
+ */
+typedef void (*aj_disccache_unavailable_ptr)(const void* context, const char* name);
+
+/**
+ * Visitor used by aj_disccache_foreach(). Called with the cache locked; it
+ * must not call back into the cache.
+ */
+typedef void (*aj_disccache_visit_ptr)(void* context, const char* name, alljoyn_transportmask transports);
+
+/** Notification callbacks. Either may be NULL. */
+typedef struct {
+    aj_disccache_available_ptr name_available;
+    aj_disccache_unavailable_ptr name_unavailable;
+} aj_disccache_callbacks;
+
+/** Event counters. */
+typedef struct {
+    uint32_t found;         /**< Raw found_advertised_name events */
+    uint32_t lost;          /**< Raw lost_advertised_name events */
+    uint32_t available;     /**< name_available notifications delivered */
+    uint32_t unavailable;   /**< name_unavailable notifications delivered */
+    uint32_t flaps;         /**< Found events inside the hold-off or TTL of a loss */
+} aj_disccache_stats;
+
+/**
+ * Create a discovery cache.
+ *
+ * @param callbacks  Notification callbacks.
+ * @param context    Context passed to the callbacks.
+ * @param holdoffMs  How long a lost advertisement must persist before the
+ *                   name is reported unavailable.
+ * @param ttlMs      How long an unavailable name is kept for flap accounting.
+ *
+ * @return the cache, or NULL on failure.
+ */
+aj_disccache aj_disccache_create(const aj_disccache_callbacks* callbacks, const void* context,
+                                 uint32_t holdoffMs, uint32_t ttlMs);
+
+/**
+ * Stop the notification thread and free the cache. No callback runs after
+ * this returns.
+ */
+void aj_disccache_destroy(aj_disccache cache);
+
+/**
+ * Feed a found advertisement into the cache. Has the same signature as
+ * alljoyn_buslistener_found_advertised_name_ptr so it can be used directly
+ * in alljoyn_buslistener_callbacks with the cache as listener context.
+ */
+void aj_disccache_found_advertised_name(const void* context, const char* name,
+                                        alljoyn_transportmask transport, const char* namePrefix);
+
+/**
+ * Feed a lost advertisement into the cache. Has the same signature as
+ * alljoyn_buslistener_lost_advertised_name_ptr.
+ */
+void aj_disccache_lost_advertised_name(const void* context, const char* name,
+                                       alljoyn_transportmask transport, const char* namePrefix);
+
+/**
+ * Deliver name_available for @p name again once @p delayMs have passed, if
+ * it is still available then. Used to rejoin a service whose session was
+ * lost while it kept advertising. Nothing happens for a name not in the
+ * cache.
+ */
+void aj_disccache_redeliver(aj_disccache cache, const char* name, uint32_t delayMs);
+
+/**
+ * Check whether a name is currently available according to the cache.
+ *
+ * @param cache       The cache.
+ * @param name        The well-known name.
+ * @param[out] transports  If non-NULL, receives the transports it is reachable over.
+ */
+QCC_BOOL aj_disccache_isavailable(aj_disccache cache, const char* name, alljoyn_transportmask* transports);
+
+/**
+ * Visit every available name that starts with @p prefix, without a new
+ * alljoyn_busattachment_findadvertisedname() round-trip.
+ *
+ * @return the number of names visited.
+ */
+size_t aj_disccache_foreach(aj_disccache cache, const char* prefix, aj_disccache_visit_ptr visit, void* context);
+
+/** Copy the event counters. */
+void aj_disccache_getstats(aj_disccache cache, aj_disccache_stats* stats);
+
+/** Short printable name of a transport mask, e.g. "TCP". */
+const char* aj_disccache_transportname(alljoyn_transportmask transport);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,760 @@
+/**
+ * @file
+ * @brief Key store listener keeping the key store in a memory-mapped,
+ * append-only file.
+ */
+#include <qcc/platform.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "aj_keystore.h"
+
+#define KS_MAGIC        "AJKS"
+#define KS_VERSION      1
+#define SLOT_SIZE       64
+#define DATA_START      (2 * SLOT_SIZE)
+#define BLOCK_SIZE      512
+/* Compact when superseded data exceeds the live data by this much */
+#define COMPACT_SLACK   (64 * 1024)
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t generation;
+    uint64_t tableOffset;
+    uint64_t length;            /* blob bytes */
+    uint32_t numBlocks;
+    uint32_t tableChecksum;
+    uint32_t checksum;          /* of the fields above */
+} ks_slot;
+
+typedef struct {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t checksum;
+} ks_block;
+
+struct _aj_keystore_handle {
+    pthread_mutex_t lock;
+    char* path;
+    char* password;
+    alljoyn_keystorelistener listener;
+
+    int fd;
+    const uint8_t* map;
+    size_t mapSize;
+    uint64_t end;               /* where the next append goes */
+
+    ks_slot current;            /* generation 0: empty store */
+    ks_block* blocks;           /* table of the current version */
+    aj_keystore_stats stats;
+
+    /* Shared mode */
+    int lockFd;                 /* flock()ed <path>.lock, -1 unless shared */
+    uint64_t loadedGeneration;  /* version AllJoyn last loaded or stored */
+    alljoyn_busattachment bus;
+    int inotifyFd;
+    int wakeFds[2];
+    pthread_t watcher;
+    QCC_BOOL watching;
+};
+
+static uint32_t fnv1a(const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*) data;
+    uint32_t h = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+static QStatus write_all(int fd, const void* data, size_t len, uint64_t offset)
+{
+    const uint8_t* p = (const uint8_t*) data;
+
+    while (len) {
+        ssize_t n = pwrite(fd, p, len, (off_t) offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("aj_keystore: write failed (%s)\n", strerror(errno));
+            return ER_OS_ERROR;
+        }
+        p += n;
+        len -= (size_t) n;
+        offset += (uint64_t) n;
+    }
+    return ER_OK;
+}
+
+/* Make sure the mapping covers [0, size) */
+static QStatus remap(aj_keystore ks, uint64_t size)
+{
+    void* map;
+
+    if (size <= ks->mapSize) {
+        return ER_OK;
+    }
+    if (ks->map) {
+        munmap((void*) ks->map, ks->mapSize);
+        ks->map = NULL;
+        ks->mapSize = 0;
+    }
+    map = mmap(NULL, (size_t) size, PROT_READ, MAP_SHARED, ks->fd, 0);
+    if (map == MAP_FAILED) {
+        printf("aj_keystore: cannot map %s (%s)\n", ks->path, strerror(errno));
+        return ER_OS_ERROR;
+    }
+    ks->map = (const uint8_t*) map;
+    ks->mapSize = (size_t) size;
+    return ER_OK;
+}
+
+static QCC_BOOL slot_valid(const ks_slot* slot)
+{
+    return 0 == memcmp(slot->magic, KS_MAGIC, 4) && slot->version == KS_VERSION &&
+           slot->checksum == fnv1a(slot, offsetof(ks_slot, checksum));
+}
+
+/* Copy and check the table a slot names; NULL if it does not fit the file */
+static ks_block* load_table(aj_keystore ks, const ks_slot* slot, uint64_t fileSize)
+{
+    size_t bytes = (size_t) slot->numBlocks * sizeof(ks_block);
+    ks_block* blocks;
+    uint32_t i;
+
+    if (slot->tableOffset < DATA_START || slot->tableOffset + bytes > fileSize) {
+        return NULL;
+    }
+    blocks = (ks_block*) malloc(bytes ? bytes : 1);
+    if (!blocks) {
+        return NULL;
+    }
+    memcpy(blocks, ks->map + slot->tableOffset, bytes);
+    if (fnv1a(blocks, bytes) != slot->tableChecksum) {
+        free(blocks);
+        return NULL;
+    }
+    for (i = 0; i < slot->numBlocks; ++i) {
+        if (blocks[i].offset < DATA_START || blocks[i].offset + blocks[i].length > fileSize) {
+            free(blocks);
+            return NULL;
+        }
+    }
+    return blocks;
+}
+
+/*
+ * Find the valid slot with the highest generation whose table checks out.
+ * Returns 1 if found, 0 if the file has a slot magic but no usable slot,
+ * -1 if it has no slot magic at all.
+ */
+static int read_slots(aj_keystore ks, uint64_t fileSize, ks_slot* slot, ks_block** blocks)
+{
+    ks_slot slots[2];
+    int best = -1;
+    int i;
+
+    *blocks = NULL;
+    memcpy(slots, ks->map, sizeof(slots[0]));
+    memcpy(&slots[1], ks->map + SLOT_SIZE, sizeof(slots[1]));
+    for (i = 0; i < 2; ++i) {
+        if (slot_valid(&slots[i]) && (best < 0 || slots[i].generation > slots[best].generation)) {
+            ks_block* table = load_table(ks, &slots[i], fileSize);
+            if (table) {
+                free(*blocks);
+                *blocks = table;
+                best = i;
+            }
+        }
+    }
+    if (best >= 0) {
+        *slot = slots[best];
+        return 1;
+    }
+    return (0 == memcmp(slots[0].magic, KS_MAGIC, 4) || 0 == memcmp(slots[1].magic, KS_MAGIC, 4)) ? 0 : -1;
+}
+
+/*
+ * Shared mode: pick up what other processes committed since this process
+ * last looked. Called with the mutex and the file lock held.
+ */
+static QStatus refresh(aj_keystore ks)
+{
+    struct stat onDisk;
+    struct stat st;
+    ks_slot slot;
+    ks_block* blocks;
+    QStatus status;
+
+    if (0 != stat(ks->path, &onDisk) || 0 != fstat(ks->fd, &st)) {
+        printf("aj_keystore: cannot stat %s (%s)\n", ks->path, strerror(errno));
+        return ER_OS_ERROR;
+    }
+    if (onDisk.st_ino != st.st_ino || onDisk.st_dev != st.st_dev) {
+        /* Another process compacted the store into a new file */
+        int fd = open(ks->path, O_RDWR);
+        if (fd < 0 || 0 != fstat(fd, &st)) {
+            printf("aj_keystore: cannot reopen %s (%s)\n", ks->path, strerror(errno));
+            if (fd >= 0) {
+                close(fd);
+            }
+            return ER_OS_ERROR;
+        }
+        if (ks->map) {
+            munmap((void*) ks->map, ks->mapSize);
+            ks->map = NULL;
+            ks->mapSize = 0;
+        }
+        close(ks->fd);
+        ks->fd = fd;
+    }
+    if (st.st_size < DATA_START) {
+        return ER_BUS_CORRUPT_KEYSTORE;
+    }
+    status = remap(ks, (uint64_t) st.st_size);
+    if (ER_OK != status) {
+        return status;
+    }
+    ks->end = (uint64_t) st.st_size;
+    if (read_slots(ks, ks->end, &slot, &blocks) > 0 && slot.generation != ks->current.generation) {
+        ks->current = slot;
+        free(ks->blocks);
+        ks->blocks = blocks;
+    } else {
+        free(blocks);
+    }
+    return ER_OK;
+}
+
+/* Take the mutex and, in shared mode, the file lock, and catch up with the file */
+static QStatus lock_store(aj_keystore ks, int op)
+{
+    QStatus status = ER_OK;
+
+    pthread_mutex_lock(&ks->lock);
+    if (ks->lockFd >= 0) {
+        while (0 != flock(ks->lockFd, op)) {
+            if (errno != EINTR) {
+                printf("aj_keystore: cannot lock %s (%s)\n", ks->path, strerror(errno));
+                pthread_mutex_unlock(&ks->lock);
+                return ER_OS_ERROR;
+            }
+        }
+        status = refresh(ks);
+        if (ER_OK != status) {
+            flock(ks->lockFd, LOCK_UN);
+            pthread_mutex_unlock(&ks->lock);
+        }
+    }
+    return status;
+}
+
+static void unlock_store(aj_keystore ks)
+{
+    if (ks->lockFd >= 0) {
+        flock(ks->lockFd, LOCK_UN);
+    }
+    pthread_mutex_unlock(&ks->lock);
+}
+
+/*
+ * Append a new version of the blob and commit it. Blocks equal to the
+ * current version's are referenced rather than written again.
+ */
+static QStatus append_version(aj_keystore ks, const uint8_t* data, size_t len, QCC_BOOL* unchanged)
+{
+    uint32_t n = (uint32_t) ((len + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    size_t tableBytes = (size_t) n * sizeof(ks_block);
+    ks_block* blocks = (ks_block*) malloc(tableBytes ? tableBytes : 1);
+    uint8_t* out = (uint8_t*) malloc(len + tableBytes);
+    size_t outLen = 0;
+    uint32_t reused = 0;
+    uint8_t slotBuf[SLOT_SIZE];
+    ks_slot slot;
+    QStatus status;
+    uint32_t i;
+
+    *unchanged = QCC_FALSE;
+    if (!blocks || !out) {
+        free(blocks);
+        free(out);
+        return ER_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < n; ++i) {
+        const uint8_t* chunk = data + (size_t) i * BLOCK_SIZE;
+        uint32_t clen = (uint32_t) (len - (size_t) i * BLOCK_SIZE < BLOCK_SIZE ? len - (size_t) i * BLOCK_SIZE : BLOCK_SIZE);
+        uint32_t sum = fnv1a(chunk, clen);
+
+        if (i < ks->current.numBlocks && ks->blocks[i].length == clen && ks->blocks[i].checksum == sum &&
+            0 == memcmp(ks->map + ks->blocks[i].offset, chunk, clen)) {
+            blocks[i] = ks->blocks[i];
+            reused++;
+        } else {
+            blocks[i].offset = ks->end + outLen;
+            blocks[i].length = clen;
+            blocks[i].checksum = sum;
+            memcpy(out + outLen, chunk, clen);
+            outLen += clen;
+        }
+    }
+    if (ks->current.generation && reused == n && n == ks->current.numBlocks && len == ks->current.length) {
+        *unchanged = QCC_TRUE;
+        free(blocks);
+        free(out);
+        return ER_OK;
+    }
+
+    memset(&slot, 0, sizeof(slot));
+    memcpy(slot.magic, KS_MAGIC, 4);
+    slot.version = KS_VERSION;
+    slot.generation = ks->current.generation + 1;
+    slot.tableOffset = ks->end + outLen;
+    slot.length = len;
+    slot.numBlocks = n;
+    slot.tableChecksum = fnv1a(blocks, tableBytes);
+    slot.checksum = fnv1a(&slot, offsetof(ks_slot, checksum));
+    memcpy(out + outLen, blocks, tableBytes);
+    outLen += tableBytes;
+
+    /* Data first, then the slot naming it: a crash in between keeps the old version */
+    status = write_all(ks->fd, out, outLen, ks->end);
+    if (ER_OK == status && 0 != fdatasync(ks->fd)) {
+        status = ER_OS_ERROR;
+    }
+    if (ER_OK == status) {
+        memset(slotBuf, 0, sizeof(slotBuf));
+        memcpy(slotBuf, &slot, sizeof(slot));
+        status = write_all(ks->fd, slotBuf, SLOT_SIZE, (slot.generation & 1) * SLOT_SIZE);
+    }
+    if (ER_OK == status && 0 != fdatasync(ks->fd)) {
+        status = ER_OS_ERROR;
+    }
+    free(out);
+    if (ER_OK != status) {
+        free(blocks);
+        return status;
+    }
+
+    ks->end += outLen;
+    ks->current = slot;
+    free(ks->blocks);
+    ks->blocks = blocks;
+    ks->stats.blocksWritten += n - reused;
+    ks->stats.blocksReused += reused;
+    ks->stats.bytesWritten += outLen + SLOT_SIZE;
+    return remap(ks, ks->end);
+}
+
+/* Write the current blob alone into a new file and put it in place of the old one */
+static QStatus compact(aj_keystore ks, const uint8_t* data, size_t len)
+{
+    char* tmpPath = (char*) malloc(strlen(ks->path) + 5);
+    uint8_t zeros[DATA_START];
+    int oldFd = ks->fd;
+    const uint8_t* oldMap = ks->map;
+    size_t oldMapSize = ks->mapSize;
+    uint64_t oldEnd = ks->end;
+    ks_slot oldCurrent = ks->current;
+    ks_block* oldBlocks = ks->blocks;
+    QCC_BOOL unchanged;
+    QStatus status;
+    int fd;
+
+    if (!tmpPath) {
+        return ER_OUT_OF_MEMORY;
+    }
+    sprintf(tmpPath, "%s.tmp", ks->path);
+    fd = open(tmpPath, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        printf("aj_keystore: cannot create %s (%s)\n", tmpPath, strerror(errno));
+        free(tmpPath);
+        return ER_OS_ERROR;
+    }
+    memset(zeros, 0, sizeof(zeros));
+    status = write_all(fd, zeros, sizeof(zeros), 0);
+
+    /* Nothing to reuse in the new file; the generation carries on */
+    ks->fd = fd;
+    ks->map = NULL;
+    ks->mapSize = 0;
+    ks->end = DATA_START;
+    ks->current.numBlocks = 0;
+    ks->blocks = NULL;
+    if (ER_OK == status) {
+        status = append_version(ks, data, len, &unchanged);
+    }
+    if (ER_OK == status) {
+        /* Both slots name the one version, so a damaged slot still leaves it */
+        uint8_t slotBuf[SLOT_SIZE];
+        memset(slotBuf, 0, sizeof(slotBuf));
+        memcpy(slotBuf, &ks->current, sizeof(ks->current));
+        status = write_all(fd, slotBuf, SLOT_SIZE, ((ks->current.generation + 1) & 1) * SLOT_SIZE);
+    }
+    if (ER_OK == status && 0 != fsync(fd)) {
+        status = ER_OS_ERROR;
+    }
+    if (ER_OK == status && 0 != rename(tmpPath, ks->path)) {
+        status = ER_OS_ERROR;
+    }
+    if (ER_OK != status) {
+        printf("aj_keystore: compaction of %s failed (%s)\n", ks->path, QCC_StatusText(status));
+        if (ks->map) {
+            munmap((void*) ks->map, ks->mapSize);
+        }
+        close(fd);
+        remove(tmpPath);
+        ks->fd = oldFd;
+        ks->map = oldMap;
+        ks->mapSize = oldMapSize;
+        ks->end = oldEnd;
+        ks->current = oldCurrent;
+        free(ks->blocks);
+        ks->blocks = oldBlocks;
+        free(tmpPath);
+        return status;
+    }
+    munmap((void*) oldMap, oldMapSize);
+    close(oldFd);
+    free(oldBlocks);
+    ks->stats.compactions++;
+    free(tmpPath);
+    return ER_OK;
+}
+
+static QStatus load_request(const void* context, alljoyn_keystorelistener listener, alljoyn_keystore keyStore)
+{
+    aj_keystore ks = (aj_keystore) context;
+    char* blob;
+    size_t pos = 0;
+    QStatus status = ER_OK;
+    uint32_t i;
+
+    status = lock_store(ks, LOCK_SH);
+    if (ER_OK != status) {
+        return status;
+    }
+    blob = (char*) malloc((size_t) ks->current.length + 1);
+    if (!blob) {
+        unlock_store(ks);
+        return ER_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < ks->current.numBlocks && ER_OK == status; ++i) {
+        const ks_block* b = &ks->blocks[i];
+        if (fnv1a(ks->map + b->offset, b->length) != b->checksum) {
+            printf("aj_keystore: %s block %u is corrupt\n", ks->path, i);
+            status = ER_BUS_CORRUPT_KEYSTORE;
+        } else {
+            memcpy(blob + pos, ks->map + b->offset, b->length);
+            pos += b->length;
+        }
+    }
+    blob[pos] = '\0';
+    ks->stats.loads++;
+    ks->loadedGeneration = ks->current.generation;
+    unlock_store(ks);
+
+    /* An empty blob gives AllJoyn an empty key store, as for a missing file */
+    if (ER_OK == status) {
+        status = alljoyn_keystorelistener_putkeys(listener, keyStore, blob, ks->password);
+    }
+    free(blob);
+    return status;
+}
+
+static QStatus store_request(const void* context, alljoyn_keystorelistener listener, alljoyn_keystore keyStore)
+{
+    aj_keystore ks = (aj_keystore) context;
+    size_t size = 0;
+    char* blob;
+    QCC_BOOL unchanged = QCC_FALSE;
+    QStatus status;
+
+    alljoyn_keystorelistener_getkeys(listener, keyStore, NULL, &size);
+    blob = (char*) malloc(size ? size : 1);
+    if (!blob) {
+        return ER_OUT_OF_MEMORY;
+    }
+    status = alljoyn_keystorelistener_getkeys(listener, keyStore, blob, &size);
+    if (ER_OK != status) {
+        free(blob);
+        return status;
+    }
+
+    status = lock_store(ks, LOCK_EX);
+    if (ER_OK != status) {
+        free(blob);
+        return status;
+    }
+    if (ks->current.generation != ks->loadedGeneration) {
+        /*
+         * Another process committed after AllJoyn reloaded to merge. Its keys
+         * are overwritten here and come back with its next handshake.
+         */
+        ks->stats.conflicts++;
+    }
+    /* size counts the terminating NUL */
+    status = append_version(ks, (const uint8_t*) blob, size ? size - 1 : 0, &unchanged);
+    if (ER_OK == status) {
+        if (unchanged) {
+            ks->stats.unchanged++;
+        } else {
+            uint64_t live = ks->current.length + (uint64_t) ks->current.numBlocks * sizeof(ks_block);
+            ks->stats.stores++;
+            if (ks->end - DATA_START > 2 * live + COMPACT_SLACK) {
+                compact(ks, (const uint8_t*) blob, size ? size - 1 : 0);
+            }
+        }
+        ks->loadedGeneration = ks->current.generation;
+    }
+    unlock_store(ks);
+    free(blob);
+    return status;
+}
+
+static aj_keystore open_store(const char* path, const char* password, QCC_BOOL shared)
+{
+    alljoyn_keystorelistener_callbacks callbacks = { &load_request, &store_request };
+    aj_keystore ks = (aj_keystore) calloc(1, sizeof(struct _aj_keystore_handle));
+    struct stat st;
+    int found;
+
+    if (!ks) {
+        return NULL;
+    }
+    ks->fd = -1;
+    ks->lockFd = -1;
+    ks->path = strdup(path);
+    ks->password = strdup(password);
+    if (!ks->path || !ks->password) {
+        goto oops;
+    }
+    if (shared) {
+        /* A separate lock file, since compaction replaces the store file */
+        char* lockPath = (char*) malloc(strlen(path) + 6);
+        if (!lockPath) {
+            goto oops;
+        }
+        sprintf(lockPath, "%s.lock", path);
+        ks->lockFd = open(lockPath, O_RDWR | O_CREAT, 0600);
+        if (ks->lockFd < 0) {
+            printf("aj_keystore: cannot open %s (%s)\n", lockPath, strerror(errno));
+            free(lockPath);
+            goto oops;
+        }
+        free(lockPath);
+        /* Another process may be initializing the file */
+        while (0 != flock(ks->lockFd, LOCK_EX) && errno == EINTR) {
+        }
+    }
+    ks->fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (ks->fd < 0 || 0 != fstat(ks->fd, &st)) {
+        printf("aj_keystore: cannot open %s (%s)\n", path, strerror(errno));
+        goto oops;
+    }
+    if (st.st_size == 0) {
+        uint8_t zeros[DATA_START];
+        memset(zeros, 0, sizeof(zeros));
+        if (ER_OK != write_all(ks->fd, zeros, sizeof(zeros), 0)) {
+            goto oops;
+        }
+        st.st_size = DATA_START;
+    }
+    if (st.st_size < DATA_START || ER_OK != remap(ks, (uint64_t) st.st_size)) {
+        printf("aj_keystore: %s is not a key store\n", path);
+        goto oops;
+    }
+    ks->end = (uint64_t) st.st_size;
+
+    found = read_slots(ks, ks->end, &ks->current, &ks->blocks);
+    if (found == 0) {
+        /* As AllJoyn does with a corrupt key store: start empty, peers pair again */
+        printf("aj_keystore: %s is corrupt, starting with no keys\n", path);
+    } else if (found < 0 && ks->end > DATA_START) {
+        printf("aj_keystore: %s is not a key store\n", path);
+        goto oops;
+    }
+
+    ks->listener = alljoyn_keystorelistener_create(&callbacks, ks);
+    if (!ks->listener) {
+        goto oops;
+    }
+    if (ks->lockFd >= 0) {
+        flock(ks->lockFd, LOCK_UN);
+    }
+    pthread_mutex_init(&ks->lock, NULL);
+    return ks;
+
+oops:
+    if (ks->lockFd >= 0) {
+        close(ks->lockFd);
+    }
+    if (ks->map) {
+        munmap((void*) ks->map, ks->mapSize);
+    }
+    if (ks->fd >= 0) {
+        close(ks->fd);
+    }
+    free(ks->blocks);
+    free(ks->password);
+    free(ks->path);
+    free(ks);
+    return NULL;
+}
+
+aj_keystore aj_keystore_open(const char* path, const char* password)
+{
+    return open_store(path, password, QCC_FALSE);
+}
+
+aj_keystore aj_keystore_open_shared(const char* path, const char* password)
+{
+    return open_store(path, password, QCC_TRUE);
+}
+
+void aj_keystore_close(aj_keystore ks)
+{
+    if (!ks) {
+        return;
+    }
+    aj_keystore_unwatch(ks);
+    alljoyn_keystorelistener_destroy(ks->listener);
+    if (ks->lockFd >= 0) {
+        close(ks->lockFd);
+    }
+    if (ks->map) {
+        munmap((void*) ks->map, ks->mapSize);
+    }
+    close(ks->fd);
+    free(ks->blocks);
+    free(ks->password);
+    free(ks->path);
+    pthread_mutex_destroy(&ks->lock);
+    free(ks);
+}
+
+static QCC_BOOL names_store(aj_keystore ks, const struct inotify_event* ev)
+{
+    const char* base = strrchr(ks->path, '/');
+
+    base = base ? base + 1 : ks->path;
+    return ev->len && 0 == strcmp(ev->name, base);
+}
+
+/* Reload AllJoyn's key store whenever another process commits a new version */
+static void* watch_thread(void* arg)
+{
+    aj_keystore ks = (aj_keystore) arg;
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        struct pollfd fds[2] = { { ks->inotifyFd, POLLIN, 0 }, { ks->wakeFds[0], POLLIN, 0 } };
+        QCC_BOOL touched = QCC_FALSE;
+        QCC_BOOL foreign;
+        ssize_t n;
+        char* p;
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        n = read(ks->inotifyFd, buf, sizeof(buf));
+        for (p = buf; n > 0 && p < buf + n; p += sizeof(struct inotify_event) + ((struct inotify_event*) p)->len) {
+            touched |= names_store(ks, (const struct inotify_event*) p);
+        }
+        if (!touched || ER_OK != lock_store(ks, LOCK_SH)) {
+            continue;
+        }
+        /* Our own commits and uncommitted appends leave the generation AllJoyn holds */
+        foreign = ks->current.generation != ks->loadedGeneration;
+        unlock_store(ks);
+        if (foreign) {
+            QStatus status = alljoyn_busattachment_reloadkeystore(ks->bus);
+            if (ER_OK == status) {
+                __sync_fetch_and_add(&ks->stats.reloads, 1);
+            } else {
+                printf("aj_keystore: cannot reload %s (%s)\n", ks->path, QCC_StatusText(status));
+            }
+        }
+    }
+    return NULL;
+}
+
+QStatus aj_keystore_watch(aj_keystore ks, alljoyn_busattachment bus)
+{
+    const char* slash = strrchr(ks->path, '/');
+    char* dir;
+
+    if (ks->lockFd < 0 || ks->watching) {
+        return ER_FAIL;
+    }
+    /* Watch the directory, since compaction renames a new file over the store */
+    dir = slash ? strndup(ks->path, (size_t) (slash - ks->path) + 1) : strdup(".");
+    if (!dir) {
+        return ER_OUT_OF_MEMORY;
+    }
+    ks->bus = bus;
+    ks->wakeFds[0] = ks->wakeFds[1] = -1;
+    ks->inotifyFd = inotify_init1(IN_CLOEXEC);
+    if (ks->inotifyFd < 0 || inotify_add_watch(ks->inotifyFd, dir, IN_MODIFY | IN_MOVED_TO) < 0 ||
+        0 != pipe(ks->wakeFds) || 0 != pthread_create(&ks->watcher, NULL, watch_thread, ks)) {
+        printf("aj_keystore: cannot watch %s (%s)\n", dir, strerror(errno));
+        if (ks->inotifyFd >= 0) {
+            close(ks->inotifyFd);
+        }
+        if (ks->wakeFds[0] >= 0) {
+            close(ks->wakeFds[0]);
+            close(ks->wakeFds[1]);
+        }
+        free(dir);
+        return ER_OS_ERROR;
+    }
+    free(dir);
+    ks->watching = QCC_TRUE;
+    return ER_OK;
+}
+
+void aj_keystore_unwatch(aj_keystore ks)
+{
+    if (!ks->watching) {
+        return;
+    }
+    close(ks->wakeFds[1]);
+    pthread_join(ks->watcher, NULL);
+    close(ks->wakeFds[0]);
+    close(ks->inotifyFd);
+    ks->watching = QCC_FALSE;
+}
+
+alljoyn_keystorelistener aj_keystore_getlistener(aj_keystore ks)
+{
+    return ks->listener;
+}
+
+void aj_keystore_getstats(aj_keystore ks, aj_keystore_stats* stats)
+{
+    pthread_mutex_lock(&ks->lock);
+    *stats = ks->stats;
+    pthread_mutex_unlock(&ks->lock);
+}
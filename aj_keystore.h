@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @brief Key store listener keeping the key store in a memory-mapped,
+ * append-only file.
+ *
+ * The default key store listener rewrites its whole file after every
+ * change. The C binding hands a key store listener the store only as one
+ * encrypted blob (alljoyn_keystorelistener_getkeys/putkeys), so entries
+ * cannot be written individually. Instead the blob is cut into fixed-size
+ * blocks. A store appends only the blocks that differ from the current
+ * version, then a table listing the blocks of the new version, and then
+ * commits by rewriting one of two small header slots. A store that changes
+ * nothing writes nothing. A load assembles the blob from the mapping
+ * without reading the file. When the superseded blocks outweigh the live
+ * ones, the file is compacted into a new file.
+ *
+ * File layout: two 64-byte header slots, then blocks and tables in append
+ * order. The valid slot with the highest generation names the current
+ * table. Each slot, table and block carries an FNV-1a checksum. A torn
+ * commit leaves the previous slot in force.
+ *
+ * A store opened with aj_keystore_open_shared() can be used by several
+ * processes at once. Loads and stores take an flock() on <path>.lock and
+ * first pick up whatever other processes committed. aj_keystore_watch()
+ * watches the file with inotify and calls
+ * alljoyn_busattachment_reloadkeystore() only when another process
+ * committed a version this process has not loaded yet. A peer
+ * authenticated by one process is then known to all of them without
+ * another handshake. Enable peer security with isShared set, so that
+ * AllJoyn reloads and merges before every store.
+ */
+#ifndef _AJ_KEYSTORE_H
+#define _AJ_KEYSTORE_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/KeyStoreListener.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Key store handle */
+typedef struct _aj_keystore_handle* aj_keystore;
+
+/** Counters. */
+typedef struct {
+    uint32_t loads;             /**< load_request calls served */
+    uint32_t stores;            /**< store_request calls that committed a new version */
+    uint32_t unchanged;         /**< store_request calls that found nothing to write */
+    uint32_t compactions;
+    uint64_t blocksWritten;
+    uint64_t blocksReused;      /**< Blocks of a new version found unchanged in the file */
+    uint64_t bytesWritten;      /**< Blocks, tables and header slots */
+    uint32_t reloads;           /**< Shared: reloads after another process committed */
+    uint32_t conflicts;         /**< Shared: stores that overwrote a commit AllJoyn had not merged */
+} aj_keystore_stats;
+
+/**
+ * Open or create a key store file.
+ *
+ * @param path      The file.
+ * @param password  Password the key data is encrypted with, handed to
+ *                  alljoyn_keystorelistener_putkeys(). The default key store
+ *                  uses its file name.
+ *
+ * @return the key store, or NULL if the file cannot be opened or is not a
+ *         key store.
+ */
+aj_keystore aj_keystore_open(const char* path, const char* password);
+
+/** As aj_keystore_open(), for a file shared with other processes. */
+aj_keystore aj_keystore_open_shared(const char* path, const char* password);
+
+/**
+ * Reload @p bus's key store whenever another process commits to a shared
+ * store. Call after peer security is enabled.
+ *
+ * @return #ER_OK, #ER_FAIL if the store is not shared or already watched,
+ *         or #ER_OS_ERROR if the watch cannot be set up.
+ */
+QStatus aj_keystore_watch(aj_keystore ks, alljoyn_busattachment bus);
+
+/** Stop watching. Call before the bus is destroyed; safe if not watching. */
+void aj_keystore_unwatch(aj_keystore ks);
+
+/** Close the file. The listener cannot be unregistered, so destroy its bus first. */
+void aj_keystore_close(aj_keystore ks);
+
+/**
+ * The listener to pass to alljoyn_busattachment_registerkeystorelistener()
+ * before alljoyn_busattachment_enablepeersecurity().
+ */
+alljoyn_keystorelistener aj_keystore_getlistener(aj_keystore ks);
+
+/** Copy the counters. */
+void aj_keystore_getstats(aj_keystore ks, aj_keystore_stats* stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * @file
+ * @brief Sessionless "latest value" publisher that supersedes its previous
+ * emission.
+ */
+#include <qcc/platform.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/Message.h>
+
+#include "aj_lastvalue.h"
+
+struct _aj_lastvalue_handle {
+    pthread_mutex_t lock;
+    alljoyn_busobject busObject;
+    alljoyn_interfacedescription_member member;
+    uint16_t ttlSeconds;
+    aj_compresspolicy policy;
+    alljoyn_message msg;        /* receives each sent signal, for its serial */
+    uint32_t serial;            /* current value, 0 if none */
+};
+
+aj_lastvalue aj_lastvalue_create(alljoyn_busobject busObject, const alljoyn_interfacedescription_member* member,
+                                 uint16_t ttlSeconds)
+{
+    alljoyn_busattachment bus = alljoyn_busobject_getbusattachment(busObject);
+    aj_lastvalue publisher;
+
+    if (!bus) {
+        printf("aj_lastvalue: bus object %s is not registered\n", alljoyn_busobject_getpath(busObject));
+        return NULL;
+    }
+    publisher = (aj_lastvalue) calloc(1, sizeof(struct _aj_lastvalue_handle));
+    if (!publisher) {
+        return NULL;
+    }
+    publisher->msg = alljoyn_message_create(bus);
+    if (!publisher->msg) {
+        free(publisher);
+        return NULL;
+    }
+    pthread_mutex_init(&publisher->lock, NULL);
+    publisher->busObject = busObject;
+    publisher->member = *member;
+    publisher->ttlSeconds = ttlSeconds;
+    return publisher;
+}
+
+void aj_lastvalue_destroy(aj_lastvalue publisher)
+{
+    if (!publisher) {
+        return;
+    }
+    alljoyn_message_destroy(publisher->msg);
+    pthread_mutex_destroy(&publisher->lock);
+    free(publisher);
+}
+
+void aj_lastvalue_setcompresspolicy(aj_lastvalue publisher, aj_compresspolicy policy)
+{
+    pthread_mutex_lock(&publisher->lock);
+    publisher->policy = policy;
+    pthread_mutex_unlock(&publisher->lock);
+}
+
+QStatus aj_lastvalue_publish(aj_lastvalue publisher, const alljoyn_msgarg args, size_t numArgs, uint8_t flags)
+{
+    uint32_t previous;
+    QStatus status;
+
+    flags |= ALLJOYN_MESSAGE_FLAG_SESSIONLESS;
+
+    /* Held across the emit so concurrent publishers cannot cancel each other's newest value */
+    pthread_mutex_lock(&publisher->lock);
+    if (publisher->policy) {
+        status = aj_compresspolicy_signal(publisher->policy, publisher->busObject, NULL, 0, publisher->member,
+                                          args, numArgs, publisher->ttlSeconds, flags, publisher->msg);
+    } else {
+        status = alljoyn_busobject_signal(publisher->busObject, NULL, 0, publisher->member, args, numArgs,
+                                          publisher->ttlSeconds, flags, publisher->msg);
+    }
+    if (ER_OK != status) {
+        pthread_mutex_unlock(&publisher->lock);
+        return status;
+    }
+    previous = publisher->serial;
+    publisher->serial = alljoyn_message_getcallserial(publisher->msg);
+    if (previous && previous != publisher->serial) {
+        QStatus cancel = alljoyn_busobject_cancelsessionlessmessage_serial(publisher->busObject, previous);
+        if (ER_OK != cancel) {
+            printf("aj_lastvalue: cannot cancel serial %u on %s (%s)\n", previous,
+                   alljoyn_busobject_getpath(publisher->busObject), QCC_StatusText(cancel));
+        }
+    }
+    pthread_mutex_unlock(&publisher->lock);
+    return status;
+}
+
+QStatus aj_lastvalue_withdraw(aj_lastvalue publisher)
+{
+    QStatus status = ER_OK;
+
+    pthread_mutex_lock(&publisher->lock);
+    if (publisher->serial) {
+        status = alljoyn_busobject_cancelsessionlessmessage_serial(publisher->busObject, publisher->serial);
+        publisher->serial = 0;
+    }
+    pthread_mutex_unlock(&publisher->lock);
+    return status;
+}
+
+uint32_t aj_lastvalue_getserial(aj_lastvalue publisher)
+{
+    uint32_t serial;
+
+    pthread_mutex_lock(&publisher->lock);
+    serial = publisher->serial;
+    pthread_mutex_unlock(&publisher->lock);
+    return serial;
+}
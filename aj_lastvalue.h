@@ -0,0 +1,82 @@
+/**
+ * @file
+ * @brief Sessionless "latest value" publisher that supersedes its previous
+ * emission.
+ *
+ * The routing node keeps every sessionless signal in its store-and-forward
+ * cache until the signal's TTL runs out, or forever with a TTL of 0, and a
+ * late joiner is sent all of them. For a signal that carries current state
+ * only the newest one is worth anything. A publisher remembers the serial of
+ * the signal it sent last and, once a newer value is out, cancels the old one
+ * with alljoyn_busobject_cancelsessionlessmessage_serial(). The cache then
+ * holds one entry per publisher, and a new subscriber catches up with a
+ * single fetch. The TTL bounds how long a value outlives a publisher that
+ * stopped without withdrawing it.
+ */
+#ifndef _AJ_LASTVALUE_H
+#define _AJ_LASTVALUE_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusObject.h>
+#include <alljoyn_c/InterfaceDescription.h>
+#include <alljoyn_c/MsgArg.h>
+
+#include "aj_compresspolicy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Latest value publisher handle */
+typedef struct _aj_lastvalue_handle* aj_lastvalue;
+
+/**
+ * Create a publisher for one signal of one registered bus object.
+ *
+ * @param busObject   The emitting object; must be registered with its bus.
+ * @param member      The signal.
+ * @param ttlSeconds  Lifetime of each value in the sessionless cache, or 0
+ *                    for no limit.
+ *
+ * @return the publisher, or NULL on failure.
+ */
+aj_lastvalue aj_lastvalue_create(alljoyn_busobject busObject, const alljoyn_interfacedescription_member* member,
+                                 uint16_t ttlSeconds);
+
+/**
+ * Destroy the publisher. The last value stays in the cache until its TTL
+ * expires; call aj_lastvalue_withdraw() first to remove it.
+ */
+void aj_lastvalue_destroy(aj_lastvalue publisher);
+
+/**
+ * Send the signal through @p policy, which may add header compression. The
+ * policy must outlive the publisher. NULL sends without one.
+ */
+void aj_lastvalue_setcompresspolicy(aj_lastvalue publisher, aj_compresspolicy policy);
+
+/**
+ * Publish a new value as a sessionless signal, then cancel the previous
+ * one. The new value is sent first, so the cache is never empty in between.
+ * Thread safe.
+ *
+ * @param flags  Extra message flags; #ALLJOYN_MESSAGE_FLAG_SESSIONLESS is
+ *               always set.
+ *
+ * @return the status of the emit. Failing to cancel the previous value is
+ *         logged but not returned; it then expires with its TTL.
+ */
+QStatus aj_lastvalue_publish(aj_lastvalue publisher, const alljoyn_msgarg args, size_t numArgs, uint8_t flags);
+
+/** Cancel the current value, if any. Thread safe. */
+QStatus aj_lastvalue_withdraw(aj_lastvalue publisher);
+
+/** Serial of the current value, or 0 if none is published. */
+uint32_t aj_lastvalue_getserial(aj_lastvalue publisher);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
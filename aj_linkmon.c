@@ -0,0 +1,570 @@
+/**
+ * @file
+ * @brief Session health monitor that tunes the AllJoyn link timeout from
+ * measured round-trip times.
+ */
+#include <qcc/platform.h>
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alljoyn_c/Message.h>
+#include <alljoyn_c/ProxyBusObject.h>
+
+#include "aj_linkmon.h"
+#include "aj_time.h"
+
+#define DEFAULT_PING_INTERVAL_MS    2000
+#define DEFAULT_SUSPECT_AFTER       2
+#define DEFAULT_DEAD_AFTER          4
+#define DEFAULT_TIMEOUT_FACTOR      4.0
+#define DEFAULT_MIN_LINK_TIMEOUT    10
+#define DEFAULT_MAX_LINK_TIMEOUT    120
+
+#define PEER_INTERFACE              "org.freedesktop.DBus.Peer"
+#define PEER_PATH                   "/"
+#define RTT_WINDOW                  64      /* samples kept for the percentile */
+#define LINK_TIMEOUT_MIN_SAMPLES    8       /* samples before the link timeout is derived */
+#define MIN_PING_TIMEOUT_MS         500
+#define TICK_MS                     100
+
+typedef struct {
+    alljoyn_sessionid sessionId;
+    char* peer;
+    alljoyn_proxybusobject proxy;
+    uint32_t refs;              /* the monitor's reference plus one per unlocked user */
+    QCC_BOOL removed;
+
+    uint32_t seq;               /* matches replies to the ping in flight */
+    QCC_BOOL pingOutstanding;
+    uint64_t nextPingAt;
+
+    double srttMs;
+    double rttvarMs;
+    double rtt[RTT_WINDOW];
+    uint32_t numRtt;
+    uint32_t nextRtt;
+
+    uint32_t pings;
+    uint32_t replies;
+    uint32_t missed;
+    aj_linkmon_state state;
+    QCC_BOOL stateDirty;        /* state changed, callback not delivered yet */
+
+    uint32_t linkTimeout;       /* accepted by the router, possibly raised by it */
+    uint32_t requestedTimeout;  /* last value asked for; not asked again until it changes */
+    QCC_BOOL timeoutPending;
+} lm_session;
+
+struct _aj_linkmon_handle {
+    alljoyn_busattachment bus;
+    aj_linkmon_config config;
+    aj_linkmon_callbacks callbacks;
+    const void* context;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    QCC_BOOL stopping;
+    uint32_t pending;           /* async calls whose callback has not run yet */
+
+    lm_session** sessions;
+    size_t numSessions;
+    size_t capSessions;
+};
+
+/* Context of one async call; freed by its callback */
+typedef struct {
+    aj_linkmon monitor;
+    lm_session* session;
+    uint32_t seq;
+    uint64_t start;
+} lm_call;
+
+/* Called with the lock held */
+static void release_session(lm_session* session)
+{
+    if (--session->refs == 0) {
+        if (session->proxy) {
+            alljoyn_proxybusobject_destroy(session->proxy);
+        }
+        free(session->peer);
+        free(session);
+    }
+}
+
+/* Called with the lock held */
+static void finish_call(aj_linkmon monitor, lm_call* call)
+{
+    release_session(call->session);
+    if (--monitor->pending == 0) {
+        pthread_cond_broadcast(&monitor->wake);
+    }
+    free(call);
+}
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+/* Called with the lock held */
+static double rtt_percentile(const lm_session* session, double percentile)
+{
+    double sorted[RTT_WINDOW];
+    size_t rank;
+
+    if (session->numRtt == 0) {
+        return 0;
+    }
+    memcpy(sorted, session->rtt, session->numRtt * sizeof(double));
+    qsort(sorted, session->numRtt, sizeof(double), compare_double);
+    rank = (size_t) (percentile / 100.0 * (session->numRtt - 1) + 0.5);
+    return sorted[rank];
+}
+
+/* Retransmission-style timeout: srtt + 4 * rttvar. Called with the lock held. */
+static double rto_ms(const lm_session* session)
+{
+    return session->srttMs + 4 * session->rttvarMs;
+}
+
+/* Called with the lock held */
+static uint32_t ping_timeout(aj_linkmon monitor, const lm_session* session)
+{
+    double ms;
+
+    if (session->numRtt == 0) {
+        return monitor->config.pingIntervalMs;
+    }
+    ms = 2 * rto_ms(session);
+    if (ms < MIN_PING_TIMEOUT_MS) {
+        ms = MIN_PING_TIMEOUT_MS;
+    }
+    if (ms > monitor->config.pingIntervalMs) {
+        ms = monitor->config.pingIntervalMs;
+    }
+    return (uint32_t) ms;
+}
+
+/* Link timeout the RTT distribution calls for, 0 while warming up. Called with the lock held. */
+static uint32_t wanted_link_timeout(aj_linkmon monitor, const lm_session* session)
+{
+    double tailMs;
+    uint32_t seconds;
+
+    if (session->numRtt < LINK_TIMEOUT_MIN_SAMPLES) {
+        return 0;
+    }
+    tailMs = rtt_percentile(session, 99.0);
+    if (rto_ms(session) > tailMs) {
+        tailMs = rto_ms(session);
+    }
+    seconds = (uint32_t) ceil(tailMs * monitor->config.timeoutFactor / 1000.0);
+    if (seconds < monitor->config.minLinkTimeout) {
+        seconds = monitor->config.minLinkTimeout;
+    }
+    if (seconds > monitor->config.maxLinkTimeout) {
+        seconds = monitor->config.maxLinkTimeout;
+    }
+    return seconds;
+}
+
+/* Called with the lock held */
+static void set_state(lm_session* session, aj_linkmon_state state)
+{
+    if (session->state != state) {
+        session->state = state;
+        session->stateDirty = QCC_TRUE;
+    }
+}
+
+/* Called with the lock held */
+static void record_rtt(lm_session* session, double ms)
+{
+    if (session->numRtt == 0) {
+        session->srttMs = ms;
+        session->rttvarMs = ms / 2;
+    } else {
+        session->rttvarMs += 0.25 * (fabs(session->srttMs - ms) - session->rttvarMs);
+        session->srttMs += 0.125 * (ms - session->srttMs);
+    }
+    session->rtt[session->nextRtt] = ms;
+    session->nextRtt = (session->nextRtt + 1) % RTT_WINDOW;
+    if (session->numRtt < RTT_WINDOW) {
+        session->numRtt++;
+    }
+    session->replies++;
+    session->missed = 0;
+    set_state(session, AJ_LINKMON_ALIVE);
+}
+
+/* Called with the lock held */
+static void record_miss(aj_linkmon monitor, lm_session* session)
+{
+    session->missed++;
+    if (session->missed >= monitor->config.deadAfter) {
+        set_state(session, AJ_LINKMON_DEAD);
+    } else if (session->missed >= monitor->config.suspectAfter) {
+        set_state(session, AJ_LINKMON_SUSPECT);
+    }
+}
+
+static void ping_reply(alljoyn_message message, void* context)
+{
+    lm_call* call = (lm_call*) context;
+    aj_linkmon monitor = call->monitor;
+    lm_session* session = call->session;
+    uint64_t end = aj_time_now_ns();
+    QCC_BOOL timedOut = QCC_FALSE;
+
+    if (alljoyn_message_gettype(message) == ALLJOYN_MESSAGE_ERROR) {
+        size_t errorSize = 0;
+        const char* errorName = alljoyn_message_geterrorname(message, NULL, &errorSize);
+        /* Any other error still came back from the peer, so the link is alive */
+        timedOut = (errorName && 0 == strcmp(errorName, "org.alljoyn.Bus.Timeout")) ? QCC_TRUE : QCC_FALSE;
+    }
+
+    pthread_mutex_lock(&monitor->lock);
+    if (!session->removed && session->seq == call->seq) {
+        session->pingOutstanding = QCC_FALSE;
+        if (timedOut) {
+            record_miss(monitor, session);
+        } else {
+            record_rtt(session, (double) (end - call->start) / 1e6);
+        }
+        if (session->stateDirty) {
+            pthread_cond_signal(&monitor->wake);
+        }
+    }
+    finish_call(monitor, call);
+    pthread_mutex_unlock(&monitor->lock);
+}
+
+static void linktimeout_reply(QStatus status, uint32_t timeout, void* context)
+{
+    lm_call* call = (lm_call*) context;
+    aj_linkmon monitor = call->monitor;
+    lm_session* session = call->session;
+    QCC_BOOL changed = QCC_FALSE;
+
+    pthread_mutex_lock(&monitor->lock);
+    session->timeoutPending = QCC_FALSE;
+    if (ER_OK == status && !session->removed && session->linkTimeout != timeout) {
+        session->linkTimeout = timeout;
+        changed = QCC_TRUE;
+    } else if (ER_OK != status) {
+        printf("aj_linkmon: setlinktimeout(%u) failed (%s)\n", (unsigned) session->sessionId, QCC_StatusText(status));
+    }
+    /* Keep the session alive until the callback is delivered */
+    session->refs++;
+    finish_call(monitor, call);
+    pthread_mutex_unlock(&monitor->lock);
+
+    if (changed && monitor->callbacks.linktimeout_changed) {
+        monitor->callbacks.linktimeout_changed(monitor->context, session->sessionId, timeout);
+    }
+
+    pthread_mutex_lock(&monitor->lock);
+    release_session(session);
+    pthread_mutex_unlock(&monitor->lock);
+}
+
+/* Called with the lock held; drops it around the async call. */
+static void send_ping(aj_linkmon monitor, lm_session* session, uint64_t now)
+{
+    lm_call* call = (lm_call*) malloc(sizeof(lm_call));
+    uint32_t timeout = ping_timeout(monitor, session);
+    QStatus status;
+
+    session->nextPingAt = now + monitor->config.pingIntervalMs;
+    if (!call) {
+        return;
+    }
+    call->monitor = monitor;
+    call->session = session;
+    call->seq = ++session->seq;
+    session->pingOutstanding = QCC_TRUE;
+    session->pings++;
+    session->refs++;
+    monitor->pending++;
+    pthread_mutex_unlock(&monitor->lock);
+
+    call->start = aj_time_now_ns();
+    status = alljoyn_proxybusobject_methodcallasync(session->proxy, PEER_INTERFACE, "Ping", &ping_reply,
+                                                    NULL, 0, call, timeout, 0);
+
+    pthread_mutex_lock(&monitor->lock);
+    if (ER_OK != status) {
+        /* The message never left; that is as good as a miss */
+        session->pingOutstanding = QCC_FALSE;
+        record_miss(monitor, session);
+        finish_call(monitor, call);
+    }
+}
+
+/* Called with the lock held; drops it around the async call. */
+static void send_linktimeout(aj_linkmon monitor, lm_session* session, uint32_t seconds)
+{
+    lm_call* call = (lm_call*) malloc(sizeof(lm_call));
+    QStatus status;
+
+    if (!call) {
+        return;
+    }
+    call->monitor = monitor;
+    call->session = session;
+    call->seq = 0;
+    session->requestedTimeout = seconds;
+    session->timeoutPending = QCC_TRUE;
+    session->refs++;
+    monitor->pending++;
+    pthread_mutex_unlock(&monitor->lock);
+
+    status = alljoyn_busattachment_setlinktimeoutasync(monitor->bus, session->sessionId, seconds, &linktimeout_reply, call);
+
+    pthread_mutex_lock(&monitor->lock);
+    if (ER_OK != status) {
+        printf("aj_linkmon: setlinktimeoutasync(%u) failed (%s)\n", (unsigned) session->sessionId, QCC_StatusText(status));
+        session->timeoutPending = QCC_FALSE;
+        finish_call(monitor, call);
+    }
+}
+
+/*
+ * Snapshot the sessions with a reference each so the lock can be dropped
+ * while pinging and notifying. Called with the lock held.
+ */
+static lm_session** snapshot_sessions(aj_linkmon monitor, size_t* count)
+{
+    lm_session** snapshot;
+    size_t i;
+
+    *count = 0;
+    if (monitor->numSessions == 0) {
+        return NULL;
+    }
+    snapshot = (lm_session**) malloc(monitor->numSessions * sizeof(lm_session*));
+    if (!snapshot) {
+        return NULL;
+    }
+    for (i = 0; i < monitor->numSessions; ++i) {
+        snapshot[i] = monitor->sessions[i];
+        snapshot[i]->refs++;
+    }
+    *count = monitor->numSessions;
+    return snapshot;
+}
+
+static void* monitor_thread(void* arg)
+{
+    aj_linkmon monitor = (aj_linkmon) arg;
+
+    pthread_mutex_lock(&monitor->lock);
+    while (!monitor->stopping) {
+        size_t count;
+        lm_session** snapshot = snapshot_sessions(monitor, &count);
+        struct timespec deadline;
+        size_t i;
+
+        for (i = 0; i < count && !monitor->stopping; ++i) {
+            lm_session* session = snapshot[i];
+            uint64_t now = aj_time_now_ms();
+            uint32_t wanted;
+
+            if (session->removed) {
+                continue;
+            }
+            if (session->stateDirty) {
+                aj_linkmon_state state = session->state;
+                session->stateDirty = QCC_FALSE;
+                if (monitor->callbacks.state_changed) {
+                    pthread_mutex_unlock(&monitor->lock);
+                    monitor->callbacks.state_changed(monitor->context, session->sessionId, session->peer, state);
+                    pthread_mutex_lock(&monitor->lock);
+                }
+            }
+            if (!session->removed && !session->pingOutstanding && now >= session->nextPingAt) {
+                send_ping(monitor, session, now);
+            }
+            wanted = wanted_link_timeout(monitor, session);
+            if (!session->removed && wanted && wanted != session->requestedTimeout && !session->timeoutPending) {
+                send_linktimeout(monitor, session, wanted);
+            }
+        }
+        for (i = 0; i < count; ++i) {
+            release_session(snapshot[i]);
+        }
+        free(snapshot);
+
+        if (!monitor->stopping) {
+            aj_time_deadline(&deadline, TICK_MS);
+            pthread_cond_timedwait(&monitor->wake, &monitor->lock, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&monitor->lock);
+    return NULL;
+}
+
+aj_linkmon aj_linkmon_create(alljoyn_busattachment bus, const aj_linkmon_config* config,
+                             const aj_linkmon_callbacks* callbacks, const void* context)
+{
+    aj_linkmon monitor = (aj_linkmon) calloc(1, sizeof(struct _aj_linkmon_handle));
+
+    if (!monitor) {
+        return NULL;
+    }
+    monitor->bus = bus;
+    if (config) {
+        monitor->config = *config;
+    }
+    if (!monitor->config.pingIntervalMs) {
+        monitor->config.pingIntervalMs = DEFAULT_PING_INTERVAL_MS;
+    }
+    if (!monitor->config.suspectAfter) {
+        monitor->config.suspectAfter = DEFAULT_SUSPECT_AFTER;
+    }
+    if (!monitor->config.deadAfter) {
+        monitor->config.deadAfter = DEFAULT_DEAD_AFTER;
+    }
+    if (monitor->config.timeoutFactor <= 0) {
+        monitor->config.timeoutFactor = DEFAULT_TIMEOUT_FACTOR;
+    }
+    if (!monitor->config.minLinkTimeout) {
+        monitor->config.minLinkTimeout = DEFAULT_MIN_LINK_TIMEOUT;
+    }
+    if (!monitor->config.maxLinkTimeout) {
+        monitor->config.maxLinkTimeout = DEFAULT_MAX_LINK_TIMEOUT;
+    }
+    if (callbacks) {
+        monitor->callbacks = *callbacks;
+    }
+    monitor->context = context;
+
+    pthread_mutex_init(&monitor->lock, NULL);
+    pthread_cond_init(&monitor->wake, NULL);
+    if (pthread_create(&monitor->thread, NULL, monitor_thread, monitor) != 0) {
+        pthread_cond_destroy(&monitor->wake);
+        pthread_mutex_destroy(&monitor->lock);
+        free(monitor);
+        return NULL;
+    }
+    return monitor;
+}
+
+void aj_linkmon_destroy(aj_linkmon monitor)
+{
+    if (!monitor) {
+        return;
+    }
+    pthread_mutex_lock(&monitor->lock);
+    monitor->stopping = QCC_TRUE;
+    pthread_cond_signal(&monitor->wake);
+    pthread_mutex_unlock(&monitor->lock);
+    pthread_join(monitor->thread, NULL);
+
+    /* Every async call is bounded by its own timeout */
+    pthread_mutex_lock(&monitor->lock);
+    while (monitor->numSessions) {
+        lm_session* session = monitor->sessions[--monitor->numSessions];
+        session->removed = QCC_TRUE;
+        release_session(session);
+    }
+    while (monitor->pending) {
+        pthread_cond_wait(&monitor->wake, &monitor->lock);
+    }
+    pthread_mutex_unlock(&monitor->lock);
+
+    pthread_cond_destroy(&monitor->wake);
+    pthread_mutex_destroy(&monitor->lock);
+    free(monitor->sessions);
+    free(monitor);
+}
+
+QStatus aj_linkmon_add(aj_linkmon monitor, alljoyn_sessionid sessionId, const char* peer)
+{
+    lm_session* session = (lm_session*) calloc(1, sizeof(lm_session));
+    QStatus status;
+
+    if (!session) {
+        return ER_OUT_OF_MEMORY;
+    }
+    session->sessionId = sessionId;
+    session->peer = strdup(peer);
+    session->proxy = alljoyn_proxybusobject_create(monitor->bus, peer, PEER_PATH, sessionId);
+    status = session->proxy ? alljoyn_proxybusobject_addinterface_by_name(session->proxy, PEER_INTERFACE) : ER_OUT_OF_MEMORY;
+    if (ER_OK == status && !session->peer) {
+        status = ER_OUT_OF_MEMORY;
+    }
+    session->refs = 1;
+
+    pthread_mutex_lock(&monitor->lock);
+    if (ER_OK == status && monitor->numSessions == monitor->capSessions) {
+        size_t newCap = monitor->capSessions ? monitor->capSessions * 2 : 4;
+        lm_session** grown = (lm_session**) realloc(monitor->sessions, newCap * sizeof(lm_session*));
+        if (grown) {
+            monitor->sessions = grown;
+            monitor->capSessions = newCap;
+        } else {
+            status = ER_OUT_OF_MEMORY;
+        }
+    }
+    if (ER_OK != status) {
+        release_session(session);
+    } else {
+        monitor->sessions[monitor->numSessions++] = session;
+        pthread_cond_signal(&monitor->wake);
+    }
+    pthread_mutex_unlock(&monitor->lock);
+    return status;
+}
+
+QStatus aj_linkmon_remove(aj_linkmon monitor, alljoyn_sessionid sessionId)
+{
+    QStatus status = ER_BUS_NO_SESSION;
+    size_t i;
+
+    pthread_mutex_lock(&monitor->lock);
+    for (i = 0; i < monitor->numSessions; ++i) {
+        lm_session* session = monitor->sessions[i];
+        if (session->sessionId == sessionId) {
+            monitor->sessions[i] = monitor->sessions[--monitor->numSessions];
+            session->removed = QCC_TRUE;
+            release_session(session);
+            status = ER_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&monitor->lock);
+    return status;
+}
+
+QStatus aj_linkmon_getinfo(aj_linkmon monitor, alljoyn_sessionid sessionId, aj_linkmon_info* info)
+{
+    QStatus status = ER_BUS_NO_SESSION;
+    size_t i;
+
+    pthread_mutex_lock(&monitor->lock);
+    for (i = 0; i < monitor->numSessions; ++i) {
+        const lm_session* session = monitor->sessions[i];
+        if (session->sessionId == sessionId) {
+            info->srttMs = session->srttMs;
+            info->rttvarMs = session->rttvarMs;
+            info->p99Ms = rtt_percentile(session, 99.0);
+            info->pings = session->pings;
+            info->replies = session->replies;
+            info->missed = session->missed;
+            info->linkTimeout = session->linkTimeout;
+            info->state = session->state;
+            status = ER_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&monitor->lock);
+    return status;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @brief Session health monitor that tunes the AllJoyn link timeout from
+ * measured round-trip times.
+ *
+ * Every monitored session is pinged periodically with
+ * org.freedesktop.DBus.Peer.Ping. Any reply, including an error reply, proves
+ * the peer and the link are alive and gives an RTT sample; a ping that times
+ * out is a miss. From the RTT distribution the monitor derives the link
+ * timeout and applies it with alljoyn_busattachment_setlinktimeoutasync(), so
+ * the router declares a dead link lost in seconds rather than never. Liveness
+ * changes are reported well before that from the ping misses themselves.
+ */
+#ifndef _AJ_LINKMON_H
+#define _AJ_LINKMON_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/Session.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Session health monitor handle */
+typedef struct _aj_linkmon_handle* aj_linkmon;
+
+/** Liveness of a monitored session */
+typedef enum {
+    AJ_LINKMON_ALIVE = 0,       /**< Last ping answered */
+    AJ_LINKMON_SUSPECT = 1,     /**< suspectAfter consecutive pings missed */
+    AJ_LINKMON_DEAD = 2         /**< deadAfter consecutive pings missed */
+} aj_linkmon_state;
+
+/**
+ * Called when a session changes liveness. Runs on the monitor thread, so it
+ * may block (for example to leave the session).
+ */
+typedef void (*aj_linkmon_state_changed_ptr)(const void* context, alljoyn_sessionid sessionId, const char* peer,
+                                             aj_linkmon_state state);
+
+/**
+ * Called with the link timeout, in seconds, the router accepted for a
+ * session. Runs on the AllJoyn dispatcher and must not block.
+ */
+typedef void (*aj_linkmon_linktimeout_changed_ptr)(const void* context, alljoyn_sessionid sessionId, uint32_t linkTimeout);
+
+/** Monitor callbacks. Either may be NULL. */
+typedef struct {
+    aj_linkmon_state_changed_ptr state_changed;
+    aj_linkmon_linktimeout_changed_ptr linktimeout_changed;
+} aj_linkmon_callbacks;
+
+/** Tuning parameters. Zero fields take the defaults noted below. */
+typedef struct {
+    uint32_t pingIntervalMs;    /**< Time between pings on a session (2000) */
+    uint32_t suspectAfter;      /**< Consecutive misses before SUSPECT (2) */
+    uint32_t deadAfter;         /**< Consecutive misses before DEAD (4) */
+    double timeoutFactor;       /**< Link timeout as a multiple of the tail RTT (4.0) */
+    uint32_t minLinkTimeout;    /**< Lower bound on the link timeout in seconds (10) */
+    uint32_t maxLinkTimeout;    /**< Upper bound on the link timeout in seconds (120) */
+} aj_linkmon_config;
+
+/** Snapshot of one session, see aj_linkmon_getinfo(). */
+typedef struct {
+    double srttMs;              /**< Smoothed RTT */
+    double rttvarMs;            /**< RTT mean deviation */
+    double p99Ms;               /**< 99th percentile of recent RTT samples */
+    uint32_t pings;
+    uint32_t replies;
+    uint32_t missed;            /**< Consecutive misses */
+    uint32_t linkTimeout;       /**< Link timeout in effect, 0 if not set yet */
+    aj_linkmon_state state;
+} aj_linkmon_info;
+
+/**
+ * Create a monitor and start its thread.
+ *
+ * @param bus        A connected bus attachment the sessions belong to.
+ * @param config     Tuning parameters, or NULL for the defaults.
+ * @param callbacks  Callbacks, or NULL.
+ * @param context    Context passed to the callbacks.
+ */
+aj_linkmon aj_linkmon_create(alljoyn_busattachment bus, const aj_linkmon_config* config,
+                             const aj_linkmon_callbacks* callbacks, const void* context);
+
+/** Stop the monitor, wait for pings in flight and free it. No callback runs after this returns. */
+void aj_linkmon_destroy(aj_linkmon monitor);
+
+/**
+ * Start monitoring a joined session.
+ *
+ * @param monitor    The monitor.
+ * @param sessionId  The session.
+ * @param peer       Unique or well-known name of the peer on the other end.
+ */
+QStatus aj_linkmon_add(aj_linkmon monitor, alljoyn_sessionid sessionId, const char* peer);
+
+/** Stop monitoring a session, typically from the session_lost callback. */
+QStatus aj_linkmon_remove(aj_linkmon monitor, alljoyn_sessionid sessionId);
+
+/**
+ * Copy a session's statistics.
+ *
+ * @return #ER_OK, or #ER_BUS_NO_SESSION if the session is not monitored.
+ */
+QStatus aj_linkmon_getinfo(aj_linkmon monitor, alljoyn_sessionid sessionId, aj_linkmon_info* info);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,594 @@
+/**
+ * @file
+ * @brief Bulk snapshot of the paths, interfaces and properties of an object
+ * tree in one method call, after the D-Bus ObjectManager pattern.
+ */
+#include <qcc/platform.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alljoyn_c/InterfaceDescription.h>
+#include <alljoyn_c/Message.h>
+
+#include "aj_objmanager.h"
+
+#define REPLY_SIGNATURE "a{oa{sa{sv}}}"
+
+/*
+ * The cache is a tree of MsgArgs that only point at each other: a dict entry
+ * or a variant holds a pointer to its key and value, not a copy. Updating a
+ * value in place therefore updates every reply built from the cache.
+ */
+
+typedef struct {
+    char* name;
+    alljoyn_msgarg value;       /* owned, updated in place */
+} om_prop;
+
+typedef struct {
+    char* name;
+    om_prop* props;
+    size_t numProps;
+    alljoyn_msgarg propEntries; /* {sv} per property */
+} om_iface;
+
+typedef struct {
+    char* path;
+    om_iface* ifaces;
+    size_t numIfaces;
+    alljoyn_msgarg pathArg;     /* o */
+    alljoyn_msgarg ifacesArg;   /* a{sa{sv}} */
+    alljoyn_msgarg ifaceEntries;
+} om_object;
+
+struct _aj_objmanager_handle {
+    pthread_rwlock_t lock;
+    alljoyn_busattachment bus;
+    alljoyn_busobject busObject;
+
+    om_object** objects;        /* sorted by path */
+    size_t numObjects;
+    size_t capacity;
+
+    alljoyn_msgarg entries;     /* {oa{sa{sv}}} per object, in path order */
+    QCC_BOOL entriesValid;
+
+    struct _aj_objmanager_handle* next;
+};
+
+/* Method handlers have no context, so they find their manager here */
+static pthread_mutex_t s_managersLock = PTHREAD_MUTEX_INITIALIZER;
+static aj_objmanager s_managers = NULL;
+
+static QCC_BOOL valid_path(const char* path)
+{
+    const char* p;
+
+    if (!path || path[0] != '/') {
+        return QCC_FALSE;
+    }
+    if (path[1] == '\0') {
+        return QCC_TRUE;
+    }
+    for (p = path + 1; *p; ++p) {
+        if (*p == '/') {
+            if (p[-1] == '/' || p[1] == '\0') {
+                return QCC_FALSE;
+            }
+        } else if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_')) {
+            return QCC_FALSE;
+        }
+    }
+    return QCC_TRUE;
+}
+
+/*
+ * Objects
+ */
+
+static void free_iface_args(om_iface* iface)
+{
+    if (iface->propEntries) {
+        alljoyn_msgarg_destroy(iface->propEntries);
+        iface->propEntries = NULL;
+    }
+}
+
+static void free_object(om_object* obj)
+{
+    size_t i;
+    size_t j;
+
+    if (obj->ifacesArg) {
+        alljoyn_msgarg_destroy(obj->ifacesArg);
+    }
+    if (obj->pathArg) {
+        alljoyn_msgarg_destroy(obj->pathArg);
+    }
+    if (obj->ifaceEntries) {
+        alljoyn_msgarg_destroy(obj->ifaceEntries);
+    }
+    for (i = 0; i < obj->numIfaces; ++i) {
+        om_iface* iface = &obj->ifaces[i];
+        free_iface_args(iface);
+        for (j = 0; j < iface->numProps; ++j) {
+            alljoyn_msgarg_destroy(iface->props[j].value);
+            free(iface->props[j].name);
+        }
+        free(iface->props);
+        free(iface->name);
+    }
+    free(obj->ifaces);
+    free(obj->path);
+    free(obj);
+}
+
+/* Rebuild an object's a{sa{sv}} after an interface or property was added */
+static QStatus rebuild_object(om_object* obj)
+{
+    QStatus status = ER_OK;
+    size_t i;
+    size_t j;
+
+    alljoyn_msgarg_clear(obj->ifacesArg);
+    if (obj->ifaceEntries) {
+        alljoyn_msgarg_destroy(obj->ifaceEntries);
+    }
+    obj->ifaceEntries = alljoyn_msgarg_array_create(obj->numIfaces);
+    if (!obj->ifaceEntries) {
+        return ER_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < obj->numIfaces && ER_OK == status; ++i) {
+        om_iface* iface = &obj->ifaces[i];
+        free_iface_args(iface);
+        iface->propEntries = alljoyn_msgarg_array_create(iface->numProps);
+        if (!iface->propEntries) {
+            return ER_OUT_OF_MEMORY;
+        }
+        for (j = 0; j < iface->numProps && ER_OK == status; ++j) {
+            status = alljoyn_msgarg_set(alljoyn_msgarg_array_element(iface->propEntries, j), "{sv}",
+                                        iface->props[j].name, iface->props[j].value);
+        }
+        if (ER_OK == status) {
+            status = alljoyn_msgarg_set(alljoyn_msgarg_array_element(obj->ifaceEntries, i), "{sa{sv}}",
+                                        iface->name, iface->numProps, iface->propEntries);
+        }
+    }
+    if (ER_OK == status) {
+        status = alljoyn_msgarg_set(obj->ifacesArg, "a{sa{sv}}", obj->numIfaces, obj->ifaceEntries);
+    }
+    return status;
+}
+
+/* Index of the first object whose path is not less than @p path */
+static size_t lower_bound(aj_objmanager om, const char* path)
+{
+    size_t lo = 0;
+    size_t hi = om->numObjects;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(om->objects[mid]->path, path) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static om_object* find_object(aj_objmanager om, const char* path, size_t* index)
+{
+    size_t i = lower_bound(om, path);
+
+    *index = i;
+    return (i < om->numObjects && 0 == strcmp(om->objects[i]->path, path)) ? om->objects[i] : NULL;
+}
+
+static om_object* insert_object(aj_objmanager om, const char* path, size_t index)
+{
+    om_object* obj;
+
+    if (om->numObjects == om->capacity) {
+        size_t capacity = om->capacity ? om->capacity * 2 : 64;
+        om_object** objects = (om_object**) realloc(om->objects, capacity * sizeof(om_object*));
+        if (!objects) {
+            return NULL;
+        }
+        om->objects = objects;
+        om->capacity = capacity;
+    }
+    obj = (om_object*) calloc(1, sizeof(om_object));
+    if (!obj) {
+        return NULL;
+    }
+    obj->path = strdup(path);
+    obj->pathArg = alljoyn_msgarg_create();
+    obj->ifacesArg = alljoyn_msgarg_create();
+    if (!obj->path || !obj->pathArg || !obj->ifacesArg ||
+        ER_OK != alljoyn_msgarg_set_objectpath(obj->pathArg, obj->path)) {
+        free_object(obj);
+        return NULL;
+    }
+    memmove(&om->objects[index + 1], &om->objects[index], (om->numObjects - index) * sizeof(om_object*));
+    om->objects[index] = obj;
+    om->numObjects++;
+    om->entriesValid = QCC_FALSE;
+    return obj;
+}
+
+/* Called with the write lock held */
+static QStatus rebuild_entries(aj_objmanager om)
+{
+    QStatus status = ER_OK;
+    size_t i;
+
+    if (om->entries) {
+        alljoyn_msgarg_destroy(om->entries);
+    }
+    om->entries = alljoyn_msgarg_array_create(om->numObjects ? om->numObjects : 1);
+    if (!om->entries) {
+        return ER_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < om->numObjects && ER_OK == status; ++i) {
+        status = alljoyn_msgarg_setdictentry(alljoyn_msgarg_array_element(om->entries, i),
+                                             om->objects[i]->pathArg, om->objects[i]->ifacesArg);
+    }
+    om->entriesValid = (ER_OK == status);
+    return status;
+}
+
+QStatus aj_objmanager_setproperty(aj_objmanager om, const char* path, const char* iface, const char* prop,
+                                  const alljoyn_msgarg value)
+{
+    om_object* obj;
+    om_iface* ifc = NULL;
+    om_prop* p = NULL;
+    QCC_BOOL added = QCC_FALSE;
+    QStatus status = ER_OK;
+    size_t index;
+    size_t i;
+
+    if (!valid_path(path)) {
+        return ER_BUS_BAD_OBJ_PATH;
+    }
+    pthread_rwlock_wrlock(&om->lock);
+    obj = find_object(om, path, &index);
+    if (!obj) {
+        obj = insert_object(om, path, index);
+        if (!obj) {
+            status = ER_OUT_OF_MEMORY;
+            goto done;
+        }
+    }
+
+    for (i = 0; i < obj->numIfaces && !ifc; ++i) {
+        if (0 == strcmp(obj->ifaces[i].name, iface)) {
+            ifc = &obj->ifaces[i];
+        }
+    }
+    if (!ifc) {
+        om_iface* ifaces = (om_iface*) realloc(obj->ifaces, (obj->numIfaces + 1) * sizeof(om_iface));
+        if (!ifaces) {
+            status = ER_OUT_OF_MEMORY;
+            goto done;
+        }
+        obj->ifaces = ifaces;
+        ifc = &obj->ifaces[obj->numIfaces];
+        memset(ifc, 0, sizeof(*ifc));
+        ifc->name = strdup(iface);
+        if (!ifc->name) {
+            status = ER_OUT_OF_MEMORY;
+            goto done;
+        }
+        obj->numIfaces++;
+        added = QCC_TRUE;
+    }
+
+    for (i = 0; i < ifc->numProps && !p; ++i) {
+        if (0 == strcmp(ifc->props[i].name, prop)) {
+            p = &ifc->props[i];
+        }
+    }
+    if (!p) {
+        om_prop* props = (om_prop*) realloc(ifc->props, (ifc->numProps + 1) * sizeof(om_prop));
+        if (!props) {
+            status = ER_OUT_OF_MEMORY;
+            goto done;
+        }
+        ifc->props = props;
+        p = &ifc->props[ifc->numProps];
+        p->name = strdup(prop);
+        p->value = alljoyn_msgarg_create();
+        if (!p->name || !p->value) {
+            free(p->name);
+            if (p->value) {
+                alljoyn_msgarg_destroy(p->value);
+            }
+            status = ER_OUT_OF_MEMORY;
+            goto done;
+        }
+        ifc->numProps++;
+        added = QCC_TRUE;
+    }
+
+    /* Same handle, new contents: replies built from the cache pick it up */
+    alljoyn_msgarg_clear(p->value);
+    alljoyn_msgarg_clone(p->value, value);
+    if (added) {
+        status = rebuild_object(obj);
+        om->entriesValid = QCC_FALSE;
+    }
+
+done:
+    pthread_rwlock_unlock(&om->lock);
+    return status;
+}
+
+QStatus aj_objmanager_removeobject(aj_objmanager om, const char* path)
+{
+    om_object* obj;
+    size_t index;
+
+    pthread_rwlock_wrlock(&om->lock);
+    obj = find_object(om, path, &index);
+    if (!obj) {
+        pthread_rwlock_unlock(&om->lock);
+        return ER_BUS_OBJ_NOT_FOUND;
+    }
+    memmove(&om->objects[index], &om->objects[index + 1], (om->numObjects - index - 1) * sizeof(om_object*));
+    om->numObjects--;
+    om->entriesValid = QCC_FALSE;
+    free_object(obj);
+    pthread_rwlock_unlock(&om->lock);
+    return ER_OK;
+}
+
+size_t aj_objmanager_getnumobjects(aj_objmanager om)
+{
+    size_t n;
+
+    pthread_rwlock_rdlock(&om->lock);
+    n = om->numObjects;
+    pthread_rwlock_unlock(&om->lock);
+    return n;
+}
+
+/*
+ * Replies
+ */
+
+/* Take the read lock with the reply entries up to date */
+static QStatus lock_entries(aj_objmanager om)
+{
+    QStatus status = ER_OK;
+
+    pthread_rwlock_rdlock(&om->lock);
+    while (!om->entriesValid) {
+        pthread_rwlock_unlock(&om->lock);
+        pthread_rwlock_wrlock(&om->lock);
+        if (!om->entriesValid) {
+            status = rebuild_entries(om);
+        }
+        pthread_rwlock_unlock(&om->lock);
+        if (ER_OK != status) {
+            return status;
+        }
+        pthread_rwlock_rdlock(&om->lock);
+    }
+    return ER_OK;
+}
+
+/*
+ * Set @p out to the reply for @p prefix, with the read lock held. The reply
+ * is a slice of the cached entries: '/' sorts before every character allowed
+ * in a path, so an object is immediately followed by the objects below it.
+ */
+/*
+ * Length of @p prefix without a trailing '/', or ER_BUS_BAD_OBJ_PATH unless it
+ * is a valid object path. Empty and "/" have length 0, meaning every object.
+ */
+static QStatus prefix_length(const char* prefix, size_t* len)
+{
+    size_t i;
+
+    *len = prefix ? strlen(prefix) : 0;
+    if (!*len) {
+        return ER_OK;
+    }
+    if (prefix[0] != '/') {
+        return ER_BUS_BAD_OBJ_PATH;
+    }
+    for (i = 1; i < *len; ++i) {
+        char c = prefix[i];
+        if (c == '/' ? prefix[i - 1] == '/' :
+            !((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_')) {
+            return ER_BUS_BAD_OBJ_PATH;
+        }
+    }
+    if (prefix[*len - 1] == '/') {
+        --*len;
+    }
+    return ER_OK;
+}
+
+static QStatus build_reply(aj_objmanager om, const char* prefix, alljoyn_msgarg out)
+{
+    size_t first = 0;
+    size_t count = om->numObjects;
+    size_t len;
+    QStatus status = prefix_length(prefix, &len);
+
+    if (ER_OK != status) {
+        return status;
+    }
+    if (len) {
+        char* bound = (char*) malloc(len + 2);
+
+        if (!bound) {
+            return ER_OUT_OF_MEMORY;
+        }
+        /* The subtree is [P, P + "0"), '0' being the character after '/' */
+        memcpy(bound, prefix, len);
+        bound[len] = '\0';
+        first = lower_bound(om, bound);
+        bound[len] = '0';
+        bound[len + 1] = '\0';
+        count = lower_bound(om, bound) - first;
+        free(bound);
+    }
+    if (!count) {
+        first = 0;
+    }
+    return alljoyn_msgarg_set(out, REPLY_SIGNATURE, count, alljoyn_msgarg_array_element(om->entries, first));
+}
+
+QStatus aj_objmanager_snapshot(aj_objmanager om, const char* prefix, alljoyn_msgarg out)
+{
+    QStatus status = lock_entries(om);
+
+    if (ER_OK != status) {
+        return status;
+    }
+    status = build_reply(om, prefix, out);
+    if (ER_OK == status) {
+        alljoyn_msgarg_stabilize(out);
+    }
+    pthread_rwlock_unlock(&om->lock);
+    return status;
+}
+
+static void get_managed_objects(alljoyn_busobject busObject, const alljoyn_interfacedescription_member* member,
+                                alljoyn_message msg)
+{
+    aj_objmanager om;
+    alljoyn_msgarg reply = NULL;
+    char* prefix = NULL;
+    QStatus status;
+
+    pthread_mutex_lock(&s_managersLock);
+    for (om = s_managers; om && om->busObject != busObject; om = om->next) {
+    }
+    pthread_mutex_unlock(&s_managersLock);
+    if (!om) {
+        alljoyn_busobject_methodreply_status(busObject, msg, ER_BUS_OBJ_NOT_FOUND);
+        return;
+    }
+
+    status = alljoyn_msgarg_get_string(alljoyn_message_getarg(msg, 0), (char*) &prefix);
+    if (ER_OK != status) {
+        alljoyn_busobject_methodreply_status(busObject, msg, status);
+        return;
+    }
+    reply = alljoyn_msgarg_create();
+    status = reply ? lock_entries(om) : ER_OUT_OF_MEMORY;
+    if (ER_OK == status) {
+        /* Marshalled before methodreply returns, so the cache only has to stay put until then */
+        status = build_reply(om, prefix, reply);
+        if (ER_OK == status) {
+            status = alljoyn_busobject_methodreply_args(busObject, msg, reply, 1);
+        }
+        pthread_rwlock_unlock(&om->lock);
+    }
+    if (ER_OK != status) {
+        printf("aj_objmanager: GetManagedObjects(\"%s\") failed (%s)\n", prefix ? prefix : "", QCC_StatusText(status));
+        alljoyn_busobject_methodreply_status(busObject, msg, status);
+    }
+    if (reply) {
+        alljoyn_msgarg_destroy(reply);
+    }
+}
+
+static QStatus create_interface(alljoyn_busattachment bus, alljoyn_interfacedescription* iface)
+{
+    QStatus status;
+
+    *iface = alljoyn_busattachment_getinterface(bus, AJ_OBJMANAGER_INTERFACE);
+    if (*iface) {
+        return ER_OK;
+    }
+    status = alljoyn_busattachment_createinterface(bus, AJ_OBJMANAGER_INTERFACE, iface);
+    if (ER_OK == status) {
+        status = alljoyn_interfacedescription_addmember(*iface, ALLJOYN_MESSAGE_METHOD_CALL, "GetManagedObjects",
+                                                        "s", REPLY_SIGNATURE, "prefix,objects", 0);
+        alljoyn_interfacedescription_activate(*iface);
+    }
+    return status;
+}
+
+aj_objmanager aj_objmanager_create(alljoyn_busattachment bus, const char* path)
+{
+    alljoyn_busobject_callbacks busObjCbs = { NULL, NULL, NULL, NULL };
+    alljoyn_interfacedescription iface = NULL;
+    alljoyn_interfacedescription_member member;
+    aj_objmanager om;
+    QStatus status;
+
+    if (!valid_path(path)) {
+        return NULL;
+    }
+    status = create_interface(bus, &iface);
+    if (ER_OK != status || !alljoyn_interfacedescription_getmember(iface, "GetManagedObjects", &member)) {
+        printf("aj_objmanager: cannot create interface %s (%s)\n", AJ_OBJMANAGER_INTERFACE, QCC_StatusText(status));
+        return NULL;
+    }
+    om = (aj_objmanager) calloc(1, sizeof(struct _aj_objmanager_handle));
+    if (!om) {
+        return NULL;
+    }
+    pthread_rwlock_init(&om->lock, NULL);
+    om->bus = bus;
+    om->busObject = alljoyn_busobject_create(path, QCC_FALSE, &busObjCbs, NULL);
+    status = alljoyn_busobject_addinterface(om->busObject, iface);
+    if (ER_OK == status) {
+        status = alljoyn_busobject_addmethodhandler(om->busObject, member, &get_managed_objects, NULL);
+    }
+
+    pthread_mutex_lock(&s_managersLock);
+    om->next = s_managers;
+    s_managers = om;
+    pthread_mutex_unlock(&s_managersLock);
+
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_registerbusobject(bus, om->busObject);
+    }
+    if (ER_OK != status) {
+        printf("aj_objmanager: cannot register %s (%s)\n", path, QCC_StatusText(status));
+        aj_objmanager_destroy(om);
+        return NULL;
+    }
+    return om;
+}
+
+void aj_objmanager_destroy(aj_objmanager om)
+{
+    aj_objmanager* link;
+    size_t i;
+
+    if (!om) {
+        return;
+    }
+    alljoyn_busattachment_unregisterbusobject(om->bus, om->busObject);
+    pthread_mutex_lock(&s_managersLock);
+    for (link = &s_managers; *link; link = &(*link)->next) {
+        if (*link == om) {
+            *link = om->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_managersLock);
+    alljoyn_busobject_destroy(om->busObject);
+
+    for (i = 0; i < om->numObjects; ++i) {
+        free_object(om->objects[i]);
+    }
+    if (om->entries) {
+        alljoyn_msgarg_destroy(om->entries);
+    }
+    free(om->objects);
+    pthread_rwlock_destroy(&om->lock);
+    free(om);
+}
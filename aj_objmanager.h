@@ -0,0 +1,86 @@
+/**
+ * @file
+ * @brief Bulk snapshot of the paths, interfaces and properties of an object
+ * tree in one method call, after the D-Bus ObjectManager pattern.
+ *
+ * Reading the state of every object otherwise takes an introspection and a
+ * GetAll call per object. The owner of the objects instead reports property
+ * values to an aj_objmanager as they change. The manager keeps them in a
+ * path-sorted cache of ready-made MsgArgs, and serves them from a bus object
+ * implementing
+ *
+ * @code
+ * <interface name="com.BandRich.ObjectManager">
+ *   <method name="GetManagedObjects">
+ *     <arg name="prefix" type="s" direction="in"/>
+ *     <arg name="objects" type="a{oa{sa{sv}}}" direction="out"/>
+ *   </method>
+ * </interface>
+ * @endcode
+ *
+ * An empty prefix or "/" returns every object. Any other prefix returns the
+ * object at that path and the objects below it; a trailing '/' is ignored,
+ * and a prefix that is not a valid object path fails with
+ * ER_BUS_BAD_OBJ_PATH. A changed value is updated in place, so a reply is
+ * assembled from cached args without rebuilding them. The interface is named differently from
+ * org.freedesktop.DBus.ObjectManager because its method takes the prefix.
+ */
+#ifndef _AJ_OBJMANAGER_H
+#define _AJ_OBJMANAGER_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/BusObject.h>
+#include <alljoyn_c/MsgArg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Interface implemented by the manager's bus object. */
+#define AJ_OBJMANAGER_INTERFACE "com.BandRich.ObjectManager"
+
+/** Object manager handle */
+typedef struct _aj_objmanager_handle* aj_objmanager;
+
+/**
+ * Create a manager and register its bus object.
+ *
+ * @param bus   A started attachment.
+ * @param path  Path of the manager's bus object, conventionally the root of
+ *              the tree it describes.
+ *
+ * @return the manager, or NULL on failure.
+ */
+aj_objmanager aj_objmanager_create(alljoyn_busattachment bus, const char* path);
+
+/** Unregister the manager's bus object and free the cache. */
+void aj_objmanager_destroy(aj_objmanager om);
+
+/**
+ * Add or update a property of an object, adding the object and interface as
+ * needed. @p value is copied. Thread safe.
+ *
+ * @return #ER_OK, #ER_BUS_BAD_OBJ_PATH or #ER_OUT_OF_MEMORY.
+ */
+QStatus aj_objmanager_setproperty(aj_objmanager om, const char* path, const char* iface, const char* prop,
+                                  const alljoyn_msgarg value);
+
+/** Remove an object and everything recorded for it. Thread safe. */
+QStatus aj_objmanager_removeobject(aj_objmanager om, const char* path);
+
+/** Number of objects in the cache. */
+size_t aj_objmanager_getnumobjects(aj_objmanager om);
+
+/**
+ * Build the GetManagedObjects reply for @p prefix into @p out, for use in
+ * the same process. @p out is stabilized and does not depend on the cache.
+ */
+QStatus aj_objmanager_snapshot(aj_objmanager om, const char* prefix, alljoyn_msgarg out);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * @file
+ * @brief Password-based peer security for the sample service and client.
+ */
+#include <qcc/platform.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alljoyn_c/AuthListener.h>
+
+#include "aj_peersec.h"
+
+struct _aj_peersec_handle {
+    alljoyn_busattachment bus;
+    alljoyn_authlistener listener;
+    char* password;
+    uint32_t keyExpiration;
+    aj_peersec_stats stats;
+};
+
+static QCC_BOOL request_credentials(const void* context, const char* authMechanism, const char* peerName,
+                                    uint16_t authCount, const char* userName, uint16_t credMask,
+                                    alljoyn_credentials credentials)
+{
+    aj_peersec sec = (aj_peersec) context;
+
+    if (authCount > 3 || 0 != strcmp(authMechanism, AJ_PEERSEC_MECHANISM)) {
+        return QCC_FALSE;
+    }
+    /* Asked only when there is no stored master secret to resume from */
+    __sync_fetch_and_add(&sec->stats.fullExchanges, 1);
+    if (credMask & ALLJOYN_CRED_PASSWORD) {
+        alljoyn_credentials_setpassword(credentials, sec->password);
+    }
+    alljoyn_credentials_setexpiration(credentials, sec->keyExpiration);
+    return QCC_TRUE;
+}
+
+static void authentication_complete(const void* context, const char* authMechanism, const char* peerName,
+                                    QCC_BOOL success)
+{
+    aj_peersec sec = (aj_peersec) context;
+
+    if (success) {
+        __sync_fetch_and_add(&sec->stats.completed, 1);
+    } else {
+        __sync_fetch_and_add(&sec->stats.failed, 1);
+        printf("aj_peersec: authentication with %s failed\n", peerName ? peerName : "<unknown>");
+    }
+}
+
+aj_peersec aj_peersec_create(alljoyn_busattachment bus, const char* password, uint32_t keyExpiration,
+                             const char* keyStore, QCC_BOOL isShared)
+{
+    alljoyn_authlistener_callbacks callbacks = {
+        &request_credentials,
+        NULL,
+        NULL,
+        &authentication_complete
+    };
+    aj_peersec sec = (aj_peersec) calloc(1, sizeof(struct _aj_peersec_handle));
+    QStatus status;
+
+    if (!sec) {
+        return NULL;
+    }
+    sec->bus = bus;
+    sec->keyExpiration = keyExpiration;
+    sec->password = strdup(password);
+    sec->listener = alljoyn_authlistener_create(&callbacks, sec);
+    if (!sec->password || !sec->listener) {
+        aj_peersec_destroy(sec);
+        return NULL;
+    }
+    status = alljoyn_busattachment_enablepeersecurity(bus, AJ_PEERSEC_MECHANISM, sec->listener, keyStore, isShared);
+    if (ER_OK != status) {
+        printf("aj_peersec: cannot enable peer security (%s)\n", QCC_StatusText(status));
+        alljoyn_authlistener_destroy(sec->listener);
+        sec->listener = NULL;
+        aj_peersec_destroy(sec);
+        return NULL;
+    }
+    return sec;
+}
+
+void aj_peersec_destroy(aj_peersec sec)
+{
+    if (!sec) {
+        return;
+    }
+    if (sec->listener) {
+        /* The bus must stop calling the listener before it goes */
+        alljoyn_busattachment_enablepeersecurity(sec->bus, NULL, NULL, NULL, QCC_FALSE);
+        alljoyn_authlistener_destroy(sec->listener);
+    }
+    free(sec->password);
+    free(sec);
+}
+
+QStatus aj_peersec_setkeyexpiration(aj_peersec sec, const char* name)
+{
+    char guid[64];
+    size_t guidSz = sizeof(guid);
+    QStatus status = alljoyn_busattachment_getpeerguid(sec->bus, name, guid, &guidSz);
+
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_setkeyexpiration(sec->bus, guid, sec->keyExpiration);
+    }
+    if (ER_OK != status) {
+        printf("aj_peersec: cannot set key expiration for %s (%s)\n", name, QCC_StatusText(status));
+    }
+    return status;
+}
+
+void aj_peersec_getstats(aj_peersec sec, aj_peersec_stats* stats)
+{
+    stats->fullExchanges = __sync_fetch_and_add(&sec->stats.fullExchanges, 0);
+    stats->completed = __sync_fetch_and_add(&sec->stats.completed, 0);
+    stats->failed = __sync_fetch_and_add(&sec->stats.failed, 0);
+}
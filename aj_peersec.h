@@ -0,0 +1,75 @@
+/**
+ * @file
+ * @brief Password-based peer security for the sample service and client.
+ *
+ * Enables ALLJOYN_SRP_KEYX on a bus attachment with a shared password.
+ * Methods and signals of interfaces created with
+ * alljoyn_busattachment_createinterface_secure() are then encrypted between
+ * the two peers.
+ *
+ * The first connection between two peers runs the full SRP exchange and
+ * leaves a master secret in each side's key store. The secret is valid for
+ * keyExpiration seconds. A later connection within that time, even from a
+ * new process, derives its session keys from the stored secret and never
+ * asks for the password. The fullexchanges and completed counters tell the
+ * two kinds of handshake apart.
+ */
+#ifndef _AJ_PEERSEC_H
+#define _AJ_PEERSEC_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusAttachment.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Authentication mechanism enabled by aj_peersec_create(). */
+#define AJ_PEERSEC_MECHANISM    "ALLJOYN_SRP_KEYX"
+
+/** Peer security handle */
+typedef struct _aj_peersec_handle* aj_peersec;
+
+/** Counters. */
+typedef struct {
+    uint32_t fullExchanges;     /**< Password requests, i.e. handshakes without a usable stored secret */
+    uint32_t completed;         /**< Successful authentications */
+    uint32_t failed;            /**< Failed authentications */
+} aj_peersec_stats;
+
+/**
+ * Enable peer security on a started bus.
+ *
+ * @param bus            The bus; alljoyn_busattachment_start() must have been called.
+ * @param password       Password shared by both peers.
+ * @param keyExpiration  Lifetime of a master secret in seconds.
+ * @param keyStore       Key store file name, distinct per application; see
+ *                       alljoyn_busattachment_enablepeersecurity().
+ * @param isShared       Whether the key store is shared with other processes.
+ *
+ * @return the handle, or NULL on failure.
+ */
+aj_peersec aj_peersec_create(alljoyn_busattachment bus, const char* password, uint32_t keyExpiration,
+                             const char* keyStore, QCC_BOOL isShared);
+
+/** Disable peer security and free the handle. Call before the bus is destroyed. */
+void aj_peersec_destroy(aj_peersec sec);
+
+/**
+ * Set the expiration of the keys shared with the authenticated peer @p name
+ * to the handle's keyExpiration, e.g. after a forced re-authentication.
+ *
+ * @return #ER_OK, or the error from alljoyn_busattachment_getpeerguid() or
+ *         alljoyn_busattachment_setkeyexpiration().
+ */
+QStatus aj_peersec_setkeyexpiration(aj_peersec sec, const char* name);
+
+/** Copy the counters. */
+void aj_peersec_getstats(aj_peersec sec, aj_peersec_stats* stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <alljoyn_c/DBusStdDefines.h>
 #include <alljoyn_c/BusAttachment.h>
@@ -38,6 +39,14 @@
 
 #include <alljoyn_c/Status.h>
 
+#include "aj_argarena.h"
+#include "aj_authpool.h"
+#include "aj_capfile.h"
+#include "aj_keystore.h"
+#include "aj_peersec.h"
+#include "aj_shmchan.h"
+#include "aj_sigdesc.h"
+
 /** Static top level message bus object */
 static alljoyn_busattachment g_msgBus = NULL;
 
@@ -53,8 +62,32 @@ static const char* OBJECT_NAME = "com.bandrich.Bus.sample";
 static const char* OBJECT_PATH = "/sample";
 static const alljoyn_sessionport SERVICE_PORT = 25;
 
+/* Unique per-process name under OBJECT_NAME so several instances can be balanced */
+static char s_instanceName[64];
+
 static volatile sig_atomic_t g_interrupt = QCC_FALSE;
 
+/* Arguments of "add", compiled before the method handler is registered */
+static aj_sigdesc s_addSig = NULL;
+
+/* Incoming method calls are recorded here when started with -c <file> */
+static aj_capwriter g_capture = NULL;
+
+/* With -s <password> the interface is secure and every call is encrypted */
+#define KEY_EXPIRATION_SECONDS 3600
+static char s_keyStorePath[64];
+static aj_keystore g_keyStore = NULL;
+
+/* -K <file> shares a key store with other processes instead of one per instance */
+static const char* g_sharedKeyStore = NULL;
+static aj_peersec g_security = NULL;
+
+/* -p <file> takes the passwords from a file, looked up off the dispatcher thread */
+static aj_authpool g_authPool = NULL;
+
+/* -q drops the per-call output, which would otherwise dominate a benchmark */
+static QCC_BOOL g_quiet = QCC_FALSE;
+
 static void SigIntHandler(int sig)
 {
     g_interrupt = QCC_TRUE;
@@ -71,7 +104,7 @@ void busobject_object_registered(const void* context)
 /* NameOwnerChanged callback */
 void name_owner_changed(const void* context, const char* busName, const char* previousOwner, const char* newOwner)
 {
-    if (newOwner && (0 == strcmp(busName, OBJECT_NAME))) {
+    if (newOwner && (0 == strcmp(busName, s_instanceName))) {
         printf("[INFO] name_owner_changed: name=%s\n", busName);
 		printf("[INFO] name_owner_changed: noldOwner=%s\n", previousOwner ? previousOwner : "<none>");
 		printf("[INFO] name_owner_changed: nnewOwner=%s\n", newOwner ? newOwner : "<none>");
@@ -129,37 +162,108 @@ void add_method(alljoyn_busobject bus, const alljoyn_interfacedescription_member
 {
 	QStatus status;
     alljoyn_msgarg outArg;
-    char* str1;
-    char* str2;
+    const char* str1;
+    const char* str2;
+    const char* result;
     int ret;
-		
-    /* Concatenate the two input strings and reply with the result. */
-    char result[256] = { 0 };
+    /* Reply args and their strings come from this dispatcher thread's arena */
+    aj_argarena arena = aj_argarena_forthread();
 
-    status = alljoyn_msgarg_get(alljoyn_message_getarg(msg, 0), "s", &str1);
-    if (ER_OK != status) {
-        printf("Ping: Error reading alljoyn_message\n");
+    if (!arena) {
+        alljoyn_busobject_methodreply_status(bus, msg, ER_OUT_OF_MEMORY);
+        return;
     }
-    status = alljoyn_msgarg_get(alljoyn_message_getarg(msg, 1), "s", &str2);
+    if (g_capture) {
+        aj_capwriter_record(g_capture, msg);
+    }
+
+    status = aj_sigdesc_decodemessage(s_addSig, msg, &str1, &str2);
     if (ER_OK != status) {
         printf("Ping: Error reading alljoyn_message\n");
+        alljoyn_busobject_methodreply_status(bus, msg, status);
+        return;
     }
 	
-	printf("------------------------------\n");
-	printf("[INFO] Received %d and %d\n", atoi(str1), atoi(str2));
-	printf("------------------------------\n");
+	if (!g_quiet) {
+		printf("------------------------------\n");
+		printf("[INFO] Received %d and %d\n", atoi(str1), atoi(str2));
+		printf("------------------------------\n");
+	}
 	
     ret = atoi(str1) + atoi(str2);
-    int2str(ret, result);
-    outArg = alljoyn_msgarg_create_and_set("s", result);
-    status = alljoyn_busobject_methodreply_args(bus, msg, outArg, 1);
+    outArg = aj_argarena_msgargs(arena, 1);
+    result = outArg ? aj_argarena_printf(arena, "%d", ret) : NULL;
+    if (!result) {
+        /* The arena is exhausted */
+        alljoyn_busobject_methodreply_status(bus, msg, ER_OUT_OF_MEMORY);
+        aj_argarena_reset(arena);
+        return;
+    }
+    status = alljoyn_msgarg_set(outArg, "s", result);
+    if (ER_OK == status) {
+        status = alljoyn_busobject_methodreply_args(bus, msg, outArg, 1);
+    }
     if (ER_OK != status) {
         printf("Ping: Error sending reply\n");
     }
-    alljoyn_msgarg_destroy(outArg);
+    /* The reply is marshalled, so everything it referenced can go */
+    aj_argarena_reset(arena);
 }
 #endif
 
+static uint32_t byte_sum(const uint8_t* data, size_t length)
+{
+    uint32_t sum = 0;
+    while (length--) {
+        sum += *data++;
+    }
+    return sum;
+}
+
+/* Both payload methods reply with the byte count and byte sum, so the sender can check what arrived */
+static void reply_received(alljoyn_busobject bus, alljoyn_message msg, const uint8_t* data, size_t length)
+{
+    alljoyn_msgarg outArgs = alljoyn_msgarg_array_create(2);
+    size_t numArgs = 2;
+    QStatus status = alljoyn_msgarg_array_set(outArgs, &numArgs, "tu", (uint64_t) length, byte_sum(data, length));
+
+    if (ER_OK == status) {
+        status = alljoyn_busobject_methodreply_args(bus, msg, outArgs, numArgs);
+    }
+    if (ER_OK != status) {
+        printf("Put: Error sending reply\n");
+    }
+    alljoyn_msgarg_destroy(outArgs);
+}
+
+/* A payload chunk sent inline, at most AJ_SHMCHAN_MAX_INLINE bytes */
+void put_method(alljoyn_busobject bus, const alljoyn_interfacedescription_member* member, alljoyn_message msg)
+{
+    uint8_t* data = NULL;
+    size_t length = 0;
+    QStatus status = alljoyn_msgarg_get(alljoyn_message_getarg(msg, 0), "ay", &length, &data);
+
+    if (ER_OK != status) {
+        alljoyn_busobject_methodreply_status(bus, msg, status);
+        return;
+    }
+    reply_received(bus, msg, data, length);
+}
+
+/* A whole payload in a shared-memory segment from a peer on this host */
+void putsegment_method(alljoyn_busobject bus, const alljoyn_interfacedescription_member* member, alljoyn_message msg)
+{
+    aj_shmchan_view view;
+    QStatus status = aj_shmchan_map(msg, 0, &view);
+
+    if (ER_OK != status) {
+        alljoyn_busobject_methodreply_status(bus, msg, status);
+        return;
+    }
+    reply_received(bus, msg, view.data, view.length);
+    aj_shmchan_unmap(&view);
+}
+
 /** Main entry point */
 int main(int argc, char** argv, char** envArg)
 {
@@ -174,11 +278,14 @@ int main(int argc, char** argv, char** envArg)
     };
     alljoyn_busobject testObj;
     alljoyn_interfacedescription exampleIntf;
-    alljoyn_interfacedescription_member cat_member;
 
 #if 1
     alljoyn_interfacedescription_member add_member;
+#else
+    alljoyn_interfacedescription_member cat_member;
 #endif
+    alljoyn_interfacedescription_member put_member;
+    alljoyn_interfacedescription_member putsegment_member;
 
     QCC_BOOL foundMember = QCC_FALSE;
     alljoyn_busobject_methodentry methodEntries[] = {
@@ -188,12 +295,18 @@ int main(int argc, char** argv, char** envArg)
 #else
 	{ &cat_member, cat_method },
 #endif
+        { &put_member, put_method },
+        { &putsegment_member, putsegment_method }
     };
     alljoyn_sessionportlistener_callbacks spl_cbs = {
         accept_session_joiner,
         NULL
     };
     alljoyn_sessionopts opts;
+    const char* password = NULL;
+    const char* passwordFile = NULL;
+    uint32_t keyExpiration = KEY_EXPIRATION_SECONDS;
+    int i;
 
     printf("AllJoyn Library version: %s\n", alljoyn_getversion());
     printf("AllJoyn Library build info: %s\n", alljoyn_getbuildinfo());
@@ -201,17 +314,44 @@ int main(int argc, char** argv, char** envArg)
     /* Install SIGINT handler */
     signal(SIGINT, SigIntHandler);
 
+    snprintf(s_instanceName, sizeof(s_instanceName), "%s.i%d", OBJECT_NAME, (int) getpid());
+    snprintf(s_keyStorePath, sizeof(s_keyStorePath), "aj_c_service.%d.ks", (int) getpid());
+
+    for (i = 1; i < argc; ++i) {
+        if (0 == strcmp(argv[i], "-c") && i + 1 < argc) {
+            g_capture = aj_capwriter_open(argv[++i]);
+        } else if (0 == strcmp(argv[i], "-s") && i + 1 < argc) {
+            password = argv[++i];
+        } else if (0 == strcmp(argv[i], "-p") && i + 1 < argc) {
+            passwordFile = argv[++i];
+        } else if (0 == strcmp(argv[i], "-K") && i + 1 < argc) {
+            g_sharedKeyStore = argv[++i];
+        } else if (0 == strcmp(argv[i], "-k") && i + 1 < argc) {
+            keyExpiration = (uint32_t) atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "-q")) {
+            g_quiet = QCC_TRUE;
+        }
+    }
+
     /* Create message bus */
     g_msgBus = alljoyn_busattachment_create("myApp", QCC_TRUE);
 
     /* Add org.alljoyn.Bus.method_sample interface */
-    status = alljoyn_busattachment_createinterface(g_msgBus, INTERFACE_NAME, &testIntf);
+    if (password || passwordFile) {
+        status = alljoyn_busattachment_createinterface_secure(g_msgBus, INTERFACE_NAME, &testIntf, AJ_IFC_SECURITY_REQUIRED);
+    } else {
+        status = alljoyn_busattachment_createinterface(g_msgBus, INTERFACE_NAME, &testIntf);
+    }
     if (status == ER_OK) {
 #if 1
 	alljoyn_interfacedescription_addmember(testIntf, ALLJOYN_MESSAGE_METHOD_CALL, "add", "ss",  "s", "inStr1,inStr2,outStr", 0);
 #else
       alljoyn_interfacedescription_addmember(testIntf, ALLJOYN_MESSAGE_METHOD_CALL, "cat", "ss",  "s", "inStr1,inStr2,outStr", 0);
 #endif
+        /* Payload transfer, inline or through a shared-memory segment */
+        alljoyn_interfacedescription_addmember(testIntf, ALLJOYN_MESSAGE_METHOD_CALL, "put", "ay", "tu", "data,bytes,sum", 0);
+        alljoyn_interfacedescription_addmember(testIntf, ALLJOYN_MESSAGE_METHOD_CALL, "putsegment", AJ_SHMCHAN_SIGNATURE, "tu",
+                                               "segment,length,bytes,sum", 0);
         alljoyn_interfacedescription_activate(testIntf);
 #ifdef _DEBUG_       
 	   printf("Interface Created.\n");
@@ -249,6 +389,13 @@ int main(int argc, char** argv, char** envArg)
     foundMember = alljoyn_interfacedescription_getmember(exampleIntf, "cat", &cat_member);
 #endif
     assert(foundMember == QCC_TRUE);
+    foundMember = alljoyn_interfacedescription_getmember(exampleIntf, "put", &put_member) &&
+                  alljoyn_interfacedescription_getmember(exampleIntf, "putsegment", &putsegment_member);
+    assert(foundMember == QCC_TRUE);
+#if 1
+    s_addSig = aj_sigdesc_compile(add_member.signature);
+    assert(s_addSig);
+#endif
 
     status = alljoyn_busobject_addmethodhandlers(testObj, methodEntries, sizeof(methodEntries) / sizeof(methodEntries[0]));
     if (ER_OK != status) {
@@ -261,8 +408,36 @@ int main(int argc, char** argv, char** envArg)
 #ifdef _DEBUG_
         printf("alljoyn_busattachment started.\n");
 #endif
+        /* Security has to be on before the first peer can call in */
+        if (password || passwordFile) {
+            /* Keys are persisted incrementally instead of rewriting the whole store */
+            QCC_BOOL shared = g_sharedKeyStore ? QCC_TRUE : QCC_FALSE;
+            const char* keyStorePath = shared ? g_sharedKeyStore : s_keyStorePath;
+            if (shared) {
+                g_keyStore = aj_keystore_open_shared(keyStorePath, keyStorePath);
+            } else {
+                g_keyStore = aj_keystore_open(keyStorePath, keyStorePath);
+            }
+            if (g_keyStore) {
+                alljoyn_busattachment_registerkeystorelistener(g_msgBus, aj_keystore_getlistener(g_keyStore));
+                if (passwordFile) {
+                    aj_authpool_config authConfig = { NULL, 0, 0, 0, keyExpiration, shared };
+                    g_authPool = aj_authpool_create(g_msgBus, passwordFile, keyStorePath, &authConfig);
+                } else {
+                    g_security = aj_peersec_create(g_msgBus, password, keyExpiration, keyStorePath, shared);
+                }
+            }
+            if (!g_security && !g_authPool) {
+                status = ER_FAIL;
+            } else if (shared) {
+                /* Keys another process commits are picked up without a handshake */
+                status = aj_keystore_watch(g_keyStore, g_msgBus);
+            }
+        }
         /* Register  local objects and connect to the daemon */
-        status = alljoyn_busattachment_registerbusobject(g_msgBus, testObj);
+        if (ER_OK == status) {
+            status = alljoyn_busattachment_registerbusobject(g_msgBus, testObj);
+        }
 
         /* Create the client-side endpoint */
         if (ER_OK == status) {
@@ -291,9 +466,9 @@ int main(int argc, char** argv, char** envArg)
     /* Request name */
     if (ER_OK == status) {
         uint32_t flags = DBUS_NAME_FLAG_REPLACE_EXISTING | DBUS_NAME_FLAG_DO_NOT_QUEUE;
-        QStatus status = alljoyn_busattachment_requestname(g_msgBus, OBJECT_NAME, flags);
+        QStatus status = alljoyn_busattachment_requestname(g_msgBus, s_instanceName, flags);
         if (ER_OK != status) {
-            printf("alljoyn_busattachment_requestname(%s) failed (status=%s)\n", OBJECT_NAME, QCC_StatusText(status));
+            printf("alljoyn_busattachment_requestname(%s) failed (status=%s)\n", s_instanceName, QCC_StatusText(status));
         }
     }
 
@@ -312,9 +487,9 @@ int main(int argc, char** argv, char** envArg)
 
     /* Advertise name */
     if (ER_OK == status) {
-        status = alljoyn_busattachment_advertisename(g_msgBus, OBJECT_NAME, alljoyn_sessionopts_get_transports(opts));
+        status = alljoyn_busattachment_advertisename(g_msgBus, s_instanceName, alljoyn_sessionopts_get_transports(opts));
         if (status != ER_OK) {
-            printf("Failed to advertise name %s (%s)\n", OBJECT_NAME, QCC_StatusText(status));
+            printf("Failed to advertise name %s (%s)\n", s_instanceName, QCC_StatusText(status));
         }
     }
 
@@ -332,6 +507,31 @@ int main(int argc, char** argv, char** envArg)
     if (opts) {
         alljoyn_sessionopts_destroy(opts);
     }
+    if (g_keyStore) {
+        aj_keystore_stats ks;
+        aj_keystore_unwatch(g_keyStore);
+        aj_keystore_getstats(g_keyStore, &ks);
+        printf("[INFO] Key store: %u stores, %u unchanged, %u reloads, %u conflicts\n",
+               ks.stores, ks.unchanged, ks.reloads, ks.conflicts);
+    }
+    if (g_security) {
+        aj_peersec_stats ss;
+        aj_peersec_getstats(g_security, &ss);
+        printf("[INFO] Peer security: %u authentications, %u with a full key exchange, %u failed\n",
+               ss.completed, ss.fullExchanges, ss.failed);
+        aj_peersec_destroy(g_security);
+        g_security = NULL;
+    }
+    if (g_authPool) {
+        aj_authpool_stats as;
+        aj_authpool_getstats(g_authPool, &as);
+        printf("[INFO] Auth pool: %u requests, %u from cache, %u queued (max depth %u), %u rejected, %u unknown users\n",
+               as.requests, as.cacheHits, as.queued, as.maxDepth, as.rejected, as.notFound);
+        printf("[INFO] Auth pool: %u authentications, %u failed\n", as.completed, as.failed);
+        aj_authpool_destroy(g_authPool);
+        g_authPool = NULL;
+    }
+
     /* Deallocate bus */
     if (g_msgBus) {
         alljoyn_busattachment deleteMe = g_msgBus;
@@ -339,6 +539,12 @@ int main(int argc, char** argv, char** envArg)
         alljoyn_busattachment_destroy(deleteMe);
     }
 
+    /* Only once the bus is gone, since the listener cannot be unregistered */
+    if (g_keyStore) {
+        aj_keystore_close(g_keyStore);
+        g_keyStore = NULL;
+    }
+
     /* Deallocate bus listener */
     if (g_busListener) {
         alljoyn_buslistener_destroy(g_busListener);
@@ -354,6 +560,11 @@ int main(int argc, char** argv, char** envArg)
         alljoyn_busobject_destroy(testObj);
     }
 
+    if (g_capture) {
+        printf("Captured %u method calls\n", aj_capwriter_getcount(g_capture));
+        aj_capwriter_close(g_capture);
+    }
+
     return (int) status;
 }
 
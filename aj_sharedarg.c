@@ -0,0 +1,103 @@
+/**
+ * @file
+ * @brief Frozen, reference counted signal arguments for emitting one payload
+ * many times.
+ */
+#include <qcc/platform.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "aj_sharedarg.h"
+
+struct _aj_sharedarg_handle {
+    uint32_t refs;              /* updated atomically */
+    alljoyn_msgarg args;        /* from alljoyn_msgarg_array_create() */
+    size_t numArgs;
+};
+
+aj_sharedarg aj_sharedarg_create(const alljoyn_msgarg args, size_t numArgs)
+{
+    alljoyn_msgarg copy = alljoyn_msgarg_array_create(numArgs);
+    size_t i;
+
+    if (!copy) {
+        return NULL;
+    }
+    /* Clone copies everything the source references, so the copy is already stable */
+    for (i = 0; i < numArgs; ++i) {
+        alljoyn_msgarg_clone(alljoyn_msgarg_array_element(copy, i), alljoyn_msgarg_array_element(args, i));
+    }
+    return aj_sharedarg_adopt(copy, numArgs);
+}
+
+aj_sharedarg aj_sharedarg_adopt(alljoyn_msgarg args, size_t numArgs)
+{
+    aj_sharedarg shared = (aj_sharedarg) calloc(1, sizeof(struct _aj_sharedarg_handle));
+    size_t i;
+
+    if (!shared) {
+        alljoyn_msgarg_destroy(args);
+        return NULL;
+    }
+    for (i = 0; i < numArgs; ++i) {
+        alljoyn_msgarg_stabilize(alljoyn_msgarg_array_element(args, i));
+    }
+    shared->refs = 1;
+    shared->args = args;
+    shared->numArgs = numArgs;
+    return shared;
+}
+
+aj_sharedarg aj_sharedarg_retain(aj_sharedarg shared)
+{
+    __sync_fetch_and_add(&shared->refs, 1);
+    return shared;
+}
+
+void aj_sharedarg_release(aj_sharedarg shared)
+{
+    if (!shared || __sync_sub_and_fetch(&shared->refs, 1) != 0) {
+        return;
+    }
+    alljoyn_msgarg_destroy(shared->args);
+    free(shared);
+}
+
+const alljoyn_msgarg aj_sharedarg_getargs(aj_sharedarg shared)
+{
+    return shared->args;
+}
+
+size_t aj_sharedarg_getnumargs(aj_sharedarg shared)
+{
+    return shared->numArgs;
+}
+
+QStatus aj_sharedarg_signal(aj_sharedarg shared, alljoyn_busobject busObject, const char* destination,
+                            alljoyn_sessionid sessionId, const alljoyn_interfacedescription_member member,
+                            uint16_t timeToLive, uint8_t flags, alljoyn_message msg)
+{
+    return alljoyn_busobject_signal(busObject, destination, sessionId, member, shared->args, shared->numArgs,
+                                    timeToLive, flags, msg);
+}
+
+QStatus aj_sharedarg_signalsessions(aj_sharedarg shared, alljoyn_busobject busObject,
+                                    const alljoyn_interfacedescription_member member,
+                                    const alljoyn_sessionid* sessionIds, size_t numSessions,
+                                    uint16_t timeToLive, uint8_t flags)
+{
+    QStatus result = ER_OK;
+    size_t i;
+
+    for (i = 0; i < numSessions; ++i) {
+        QStatus status = alljoyn_busobject_signal(busObject, NULL, sessionIds[i], member, shared->args,
+                                                  shared->numArgs, timeToLive, flags, NULL);
+        if (ER_OK != status) {
+            printf("aj_sharedarg: signal to session %u failed (%s)\n", (unsigned) sessionIds[i],
+                   QCC_StatusText(status));
+            result = status;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file
+ * @brief Frozen, reference counted signal arguments for emitting one payload
+ * many times.
+ *
+ * Emitting the same payload from many objects or into many sessions usually
+ * means building (or cloning) the args for every alljoyn_busobject_signal()
+ * call. Marshalling only reads its args, so one stabilized copy can be
+ * handed to every emit instead, from any number of threads at once. A
+ * shared arg owns that copy; holders take references and the copy is freed
+ * with the last release.
+ *
+ * The args must not be modified once shared. Build a new shared arg for a
+ * new payload and release the old one; emits still holding it are not
+ * affected.
+ *
+ * @code
+ * aj_sharedarg snapshot = aj_sharedarg_create(args, numArgs);  // one copy
+ * for (i = 0; i < numObjects; ++i) {
+ *     aj_sharedarg_signal(snapshot, objects[i], NULL, 0, member, 0, flags, NULL);
+ * }
+ * aj_sharedarg_release(snapshot);
+ * @endcode
+ */
+#ifndef _AJ_SHAREDARG_H
+#define _AJ_SHAREDARG_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusObject.h>
+#include <alljoyn_c/MsgArg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Immutable, reference counted array of MsgArgs */
+typedef struct _aj_sharedarg_handle* aj_sharedarg;
+
+/**
+ * Share a stabilized copy of @p numArgs args. The caller keeps ownership of
+ * @p args.
+ *
+ * @return the shared arg with one reference, or NULL on allocation failure.
+ */
+aj_sharedarg aj_sharedarg_create(const alljoyn_msgarg args, size_t numArgs);
+
+/**
+ * Share args without copying the array. @p args must come from
+ * alljoyn_msgarg_array_create() and is owned by the shared arg afterwards,
+ * also on failure. Each arg is stabilized, so data the args only pointed to
+ * is copied once here.
+ *
+ * @return the shared arg with one reference, or NULL on allocation failure.
+ */
+aj_sharedarg aj_sharedarg_adopt(alljoyn_msgarg args, size_t numArgs);
+
+/** Take another reference. Thread safe. */
+aj_sharedarg aj_sharedarg_retain(aj_sharedarg shared);
+
+/** Drop a reference; the args are destroyed with the last one. Thread safe. */
+void aj_sharedarg_release(aj_sharedarg shared);
+
+/** The shared args. Read only. */
+const alljoyn_msgarg aj_sharedarg_getargs(aj_sharedarg shared);
+
+/** Number of shared args. */
+size_t aj_sharedarg_getnumargs(aj_sharedarg shared);
+
+/** alljoyn_busobject_signal() with the shared args. */
+QStatus aj_sharedarg_signal(aj_sharedarg shared, alljoyn_busobject busObject, const char* destination,
+                            alljoyn_sessionid sessionId, const alljoyn_interfacedescription_member member,
+                            uint16_t timeToLive, uint8_t flags, alljoyn_message msg);
+
+/**
+ * Emit the shared args as the same signal into each of @p numSessions
+ * sessions. Every session is tried even if an emit fails.
+ *
+ * @return #ER_OK, or the status of the last emit that failed.
+ */
+QStatus aj_sharedarg_signalsessions(aj_sharedarg shared, alljoyn_busobject busObject,
+                                    const alljoyn_interfacedescription_member member,
+                                    const alljoyn_sessionid* sessionIds, size_t numSessions,
+                                    uint16_t timeToLive, uint8_t flags);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,202 @@
+/**
+ * @file
+ * @brief Shared-memory side channel for large payloads between peers on
+ * the same host.
+ */
+#include <qcc/platform.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "aj_shmchan.h"
+
+/* Older C libraries lack memfd_create() and the seal constants */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC         0x0001U
+#define MFD_ALLOW_SEALING   0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS         1033
+#define F_GET_SEALS         1034
+#define F_SEAL_SEAL         0x0001
+#define F_SEAL_SHRINK       0x0002
+#define F_SEAL_GROW         0x0004
+#define F_SEAL_WRITE        0x0008
+#endif
+
+#define REQUIRED_SEALS      (F_SEAL_SHRINK | F_SEAL_WRITE)
+
+QStatus aj_shmchan_alloc(aj_shmchan_segment* seg, size_t length)
+{
+    seg->data = NULL;
+    seg->length = 0;
+    seg->fd = (int) syscall(SYS_memfd_create, "aj_shmchan", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (seg->fd < 0) {
+        printf("aj_shmchan: memfd_create failed (%s)\n", strerror(errno));
+        seg->fd = -1;
+        return ER_OS_ERROR;
+    }
+    if (0 != ftruncate(seg->fd, (off_t) length)) {
+        printf("aj_shmchan: cannot size a segment of %lu bytes (%s)\n", (unsigned long) length, strerror(errno));
+        aj_shmchan_free(seg);
+        return ER_OS_ERROR;
+    }
+    seg->length = length;
+    if (length) {
+        void* map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+        if (map == MAP_FAILED) {
+            printf("aj_shmchan: cannot map a segment (%s)\n", strerror(errno));
+            aj_shmchan_free(seg);
+            return ER_OS_ERROR;
+        }
+        seg->data = (uint8_t*) map;
+    }
+    return ER_OK;
+}
+
+QStatus aj_shmchan_seal(aj_shmchan_segment* seg)
+{
+    /* F_SEAL_WRITE is refused while a writable shared mapping exists */
+    if (seg->data) {
+        munmap(seg->data, seg->length);
+        seg->data = NULL;
+    }
+    if (0 != fcntl(seg->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)) {
+        printf("aj_shmchan: cannot seal a segment (%s)\n", strerror(errno));
+        return ER_OS_ERROR;
+    }
+    return ER_OK;
+}
+
+QStatus aj_shmchan_setargs(alljoyn_msgarg args, const aj_shmchan_segment* seg)
+{
+    size_t numArgs = 2;
+    return alljoyn_msgarg_array_set(args, &numArgs, AJ_SHMCHAN_SIGNATURE, seg->fd, (uint64_t) seg->length);
+}
+
+void aj_shmchan_free(aj_shmchan_segment* seg)
+{
+    if (seg->data) {
+        munmap(seg->data, seg->length);
+    }
+    if (seg->fd >= 0) {
+        close(seg->fd);
+    }
+    seg->fd = -1;
+    seg->data = NULL;
+    seg->length = 0;
+}
+
+/* Copy the payload into a sealed segment and make one call with it */
+static QStatus send_segment(const uint8_t* data, size_t length, alljoyn_msgarg args, const char* method,
+                            aj_shmchan_call_ptr call, void* context)
+{
+    aj_shmchan_segment seg = AJ_SHMCHAN_SEGMENT_INIT;
+    QStatus status = aj_shmchan_alloc(&seg, length);
+
+    /* The one copy the sender makes; the receiver maps the segment as it is */
+    if (ER_OK == status) {
+        if (length) {
+            memcpy(seg.data, data, length);
+        }
+        status = aj_shmchan_seal(&seg);
+    }
+    if (ER_OK == status) {
+        status = aj_shmchan_setargs(args, &seg);
+    }
+    if (ER_OK == status) {
+        status = call(context, method, args, 2);
+    } else {
+        /* No usable segment on this host; the inline path still works */
+        status = ER_BUS_HANDLES_NOT_ENABLED;
+    }
+    aj_shmchan_free(&seg);
+    return status;
+}
+
+QStatus aj_shmchan_send(const uint8_t* data, size_t length, size_t threshold, const char* inlineMethod,
+                        const char* segmentMethod, aj_shmchan_call_ptr call, void* context, aj_shmchan_path* path)
+{
+    alljoyn_msgarg args = alljoyn_msgarg_array_create(2);
+    size_t offset = 0;
+    QStatus status = ER_BUS_HANDLES_NOT_ENABLED;
+
+    if (length >= threshold) {
+        status = send_segment(data, length, args, segmentMethod, call, context);
+        if (ER_BUS_HANDLES_NOT_ENABLED == status) {
+            printf("aj_shmchan: no segment for %lu bytes, sending inline\n", (unsigned long) length);
+        }
+    }
+    if (path) {
+        *path = (ER_BUS_HANDLES_NOT_ENABLED == status) ? AJ_SHMCHAN_SENT_INLINE : AJ_SHMCHAN_SENT_SEGMENT;
+    }
+    if (ER_BUS_HANDLES_NOT_ENABLED == status) {
+        /* An empty payload still makes one call */
+        do {
+            size_t chunk = length - offset < AJ_SHMCHAN_MAX_INLINE ? length - offset : AJ_SHMCHAN_MAX_INLINE;
+            status = alljoyn_msgarg_set(args, "ay", chunk, data + offset);
+            if (ER_OK == status) {
+                status = call(context, inlineMethod, args, 1);
+            }
+            offset += chunk;
+        } while (ER_OK == status && offset < length);
+    }
+    alljoyn_msgarg_destroy(args);
+    return status;
+}
+
+QStatus aj_shmchan_map(alljoyn_message msg, size_t argIndex, aj_shmchan_view* view)
+{
+    int fd = -1;
+    uint64_t length = 0;
+    struct stat st;
+    int seals;
+    QStatus status;
+
+    memset(view, 0, sizeof(*view));
+    status = alljoyn_msgarg_get(alljoyn_message_getarg(msg, argIndex), "h", &fd);
+    if (ER_OK == status) {
+        status = alljoyn_msgarg_get(alljoyn_message_getarg(msg, argIndex + 1), "t", &length);
+    }
+    if (ER_OK != status) {
+        return status;
+    }
+
+    /* Unsealed, the sender could truncate it and fault the reader with SIGBUS */
+    seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & REQUIRED_SEALS) != REQUIRED_SEALS) {
+        printf("aj_shmchan: segment from %s is not sealed\n", alljoyn_message_getsender(msg));
+        return ER_BUS_BAD_VALUE;
+    }
+    if (0 != fstat(fd, &st)) {
+        return ER_OS_ERROR;
+    }
+    if ((uint64_t) st.st_size < length) {
+        printf("aj_shmchan: segment from %s is shorter than stated\n", alljoyn_message_getsender(msg));
+        return ER_BUS_BAD_VALUE;
+    }
+    if (length) {
+        void* map = mmap(NULL, (size_t) length, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            printf("aj_shmchan: cannot map a segment (%s)\n", strerror(errno));
+            return ER_OS_ERROR;
+        }
+        view->data = (const uint8_t*) map;
+    }
+    view->length = (size_t) length;
+    return ER_OK;
+}
+
+void aj_shmchan_unmap(aj_shmchan_view* view)
+{
+    if (view->data) {
+        munmap((void*) view->data, view->length);
+    }
+    memset(view, 0, sizeof(*view));
+}
@@ -0,0 +1,141 @@
+/**
+ * @file
+ * @brief Shared-memory side channel for large payloads between peers on
+ * the same host.
+ *
+ * A payload sent as an array of bytes goes through the daemon socket. It is
+ * copied into the message, through the kernel to the daemon and back, and
+ * out of the message again. AllJoyn also caps an array at
+ * #AJ_SHMCHAN_MAX_INLINE bytes, so a large payload needs many calls.
+ *
+ * With this channel the sender writes the payload once into a memfd
+ * segment, seals it and sends the descriptor and length as "ht" arguments.
+ * The descriptor is passed over the unix socket along with the message.
+ * The receiver maps the segment read-only without copying it. The seals
+ * guarantee that the sender can neither change nor shrink the segment
+ * while it is mapped.
+ *
+ * Handles only travel between endpoints on one host. Sending to a peer
+ * that cannot take them fails with #ER_BUS_HANDLES_NOT_ENABLED.
+ * aj_shmchan_send() picks the path by payload size and falls back to inline
+ * arrays in that case.
+ */
+#ifndef _AJ_SHMCHAN_H
+#define _AJ_SHMCHAN_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/Message.h>
+#include <alljoyn_c/MsgArg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Signature of the segment arguments: the descriptor, then the length. */
+#define AJ_SHMCHAN_SIGNATURE    "ht"
+
+/** Largest byte array worth sending inline; AllJoyn rejects arrays above 128 KiB. */
+#define AJ_SHMCHAN_MAX_INLINE   (120 * 1024)
+
+/** Payload size from which a segment is cheaper than inline arrays. */
+#define AJ_SHMCHAN_THRESHOLD    (64 * 1024)
+
+/** A segment being filled by the sender. */
+typedef struct {
+    int fd;                     /**< -1 when the segment holds no descriptor */
+    uint8_t* data;              /**< Writable until aj_shmchan_seal() */
+    size_t length;
+} aj_shmchan_segment;
+
+/** Initializer for a segment that holds nothing yet. */
+#define AJ_SHMCHAN_SEGMENT_INIT { -1, NULL, 0 }
+
+/** A segment mapped by the receiver. */
+typedef struct {
+    const uint8_t* data;
+    size_t length;
+} aj_shmchan_view;
+
+/**
+ * Create a segment of @p length bytes and map it writable at seg->data.
+ *
+ * @return #ER_OK or #ER_OS_ERROR.
+ */
+QStatus aj_shmchan_alloc(aj_shmchan_segment* seg, size_t length);
+
+/** Unmap the segment and seal it against writes and resizing. Call once it is filled. */
+QStatus aj_shmchan_seal(aj_shmchan_segment* seg);
+
+/**
+ * Set two arguments, args[0] and args[1], to the descriptor and length of
+ * a sealed segment. The message duplicates the descriptor, so free the
+ * segment once the call returns.
+ */
+QStatus aj_shmchan_setargs(alljoyn_msgarg args, const aj_shmchan_segment* seg);
+
+/**
+ * Close the descriptor and unmap the segment if still mapped. Safe on a
+ * segment set to #AJ_SHMCHAN_SEGMENT_INIT, one aj_shmchan_alloc() failed on
+ * and one already freed.
+ */
+void aj_shmchan_free(aj_shmchan_segment* seg);
+
+/** How aj_shmchan_send() delivered a payload. */
+typedef enum {
+    AJ_SHMCHAN_SENT_INLINE,     /**< As "ay" chunks of at most #AJ_SHMCHAN_MAX_INLINE bytes */
+    AJ_SHMCHAN_SENT_SEGMENT     /**< As one sealed segment */
+} aj_shmchan_path;
+
+/**
+ * Make one method call for aj_shmchan_send() and consume its reply.
+ *
+ * @param context  Context passed to aj_shmchan_send().
+ * @param method   The inline or the segment method.
+ * @param args     The arguments: one "ay" chunk, or the segment's "ht".
+ * @param numArgs  1 or 2.
+ *
+ * @return the status of the call; #ER_BUS_HANDLES_NOT_ENABLED makes
+ *         aj_shmchan_send() retry inline.
+ */
+typedef QStatus (*aj_shmchan_call_ptr)(void* context, const char* method, const alljoyn_msgarg args, size_t numArgs);
+
+/**
+ * Send a payload the cheapest way the receiver accepts. A payload of at
+ * least @p threshold bytes is copied into a sealed segment and sent with
+ * one call of @p segmentMethod. Smaller payloads, and any payload whose
+ * segment cannot be created or whose descriptor cannot be passed, are sent
+ * as consecutive calls of @p inlineMethod.
+ *
+ * @param data           The payload.
+ * @param length         Its length.
+ * @param threshold      #AJ_SHMCHAN_THRESHOLD normally; 0 tries a segment for
+ *                       every payload, SIZE_MAX never does.
+ * @param inlineMethod   Method taking one "ay" chunk.
+ * @param segmentMethod  Method taking #AJ_SHMCHAN_SIGNATURE.
+ * @param call           Makes each call.
+ * @param context        Passed to @p call.
+ * @param[out] path      Receives the path used. Can be NULL.
+ *
+ * @return #ER_OK, or the status of the first call that failed.
+ */
+QStatus aj_shmchan_send(const uint8_t* data, size_t length, size_t threshold, const char* inlineMethod,
+                        const char* segmentMethod, aj_shmchan_call_ptr call, void* context, aj_shmchan_path* path);
+
+/**
+ * Map the segment a message carries in arguments @p argIndex and
+ * @p argIndex + 1. The mapping outlives the message.
+ *
+ * @return #ER_OK, #ER_BUS_BAD_VALUE if the segment is not sealed or shorter
+ *         than its stated length, or #ER_OS_ERROR.
+ */
+QStatus aj_shmchan_map(alljoyn_message msg, size_t argIndex, aj_shmchan_view* view);
+
+/** Unmap a view. Safe on a zeroed view. */
+void aj_shmchan_unmap(aj_shmchan_view* view);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
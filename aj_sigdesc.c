@@ -0,0 +1,543 @@
+/**
+ * @file
+ * @brief Signatures compiled once into interned descriptors, with a
+ * validator and decoder that do not parse signature strings per message.
+ */
+#include <qcc/platform.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aj_sigdesc.h"
+
+/* Signatures are at most 255 characters and nest at most 32 containers deep */
+#define SIG_MAX_LENGTH  255
+#define SIG_MAX_DEPTH   32
+
+#define INTERN_BUCKETS  64
+
+typedef struct sig_node {
+    alljoyn_typeid typeId;      /* what alljoyn_msgarg_gettype() reports for a matching arg */
+    char code;                  /* first character of the type */
+    uint8_t align;
+    uint32_t fixedSize;         /* 0 for variable size types */
+    const char* sig;            /* the type within the descriptor's signature */
+    size_t sigLen;
+    size_t numChildren;
+    struct sig_node* children;  /* array element; struct members; dict entry key and value */
+} sig_node;
+
+struct _aj_sigdesc_handle {
+    struct _aj_sigdesc_handle* next;
+    uint32_t hash;
+    char* signature;
+    size_t fixedSize;
+    sig_node root;              /* children are the top level types */
+    sig_node* nodes;            /* storage for every node of the tree */
+    size_t numNodes;
+};
+
+static pthread_mutex_t s_internLock = PTHREAD_MUTEX_INITIALIZER;
+static struct _aj_sigdesc_handle* s_intern[INTERN_BUCKETS];
+
+static uint32_t hash_signature(const char* sig)
+{
+    uint32_t hash = 2166136261u;
+    while (*sig) {
+        hash = (hash ^ (uint8_t) *sig++) * 16777619u;
+    }
+    return hash;
+}
+
+/* Length of the complete type at the start of sig, 0 if it is not valid */
+static size_t type_len(const char* sig, int depth)
+{
+    size_t i;
+    size_t n;
+
+    if (depth > SIG_MAX_DEPTH) {
+        return 0;
+    }
+    switch (*sig) {
+    case 'y': case 'b': case 'n': case 'q': case 'i': case 'u': case 'x': case 't':
+    case 'd': case 's': case 'o': case 'g': case 'h': case 'v':
+        return 1;
+
+    case 'a':
+        if (sig[1] != '{') {
+            n = type_len(sig + 1, depth + 1);
+            return n ? n + 1 : 0;
+        }
+        /* Dict entries only appear as array elements, and their keys are basic types */
+        if (!sig[2] || !strchr("ybnqiuxtdsog", sig[2])) {
+            return 0;
+        }
+        n = type_len(sig + 3, depth + 1);
+        if (!n || sig[3 + n] != '}') {
+            return 0;
+        }
+        return n + 4;
+
+    case '(':
+        for (i = 1; sig[i] != ')'; i += n) {
+            n = type_len(sig + i, depth + 1);
+            if (!n) {
+                return 0;
+            }
+        }
+        return i > 1 ? i + 1 : 0;
+
+    default:
+        return 0;
+    }
+}
+
+static QCC_BOOL is_scalar(char code)
+{
+    return code && strchr("ybnqiuxtd", code) != NULL;
+}
+
+static uint8_t scalar_size(char code)
+{
+    switch (code) {
+    case 'y':
+        return 1;
+
+    case 'n': case 'q':
+        return 2;
+
+    case 'b': case 'i': case 'u': case 'h':
+        return 4;
+
+    default:
+        return 8;
+    }
+}
+
+static size_t align_up(size_t offset, size_t align)
+{
+    return (offset + align - 1) & ~(align - 1);
+}
+
+/* Take @p n consecutive nodes from the descriptor's storage */
+static sig_node* take_nodes(aj_sigdesc desc, size_t n)
+{
+    sig_node* nodes = &desc->nodes[desc->numNodes];
+    desc->numNodes += n;
+    return nodes;
+}
+
+/* Wire size of consecutive fixed-size types, 0 if any of them is variable */
+static uint32_t layout(const sig_node* nodes, size_t n)
+{
+    size_t offset = 0;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        if (!nodes[i].fixedSize) {
+            return 0;
+        }
+        offset = align_up(offset, nodes[i].align) + nodes[i].fixedSize;
+    }
+    return (uint32_t) offset;
+}
+
+/* Fill @p node from the (already validated) complete type at @p sig */
+static void build_node(aj_sigdesc desc, sig_node* node, const char* sig)
+{
+    size_t pos;
+    size_t i;
+
+    node->code = sig[0];
+    node->sig = sig;
+    /* A dict entry is only valid as an array element, so measure it as one */
+    node->sigLen = sig[0] == '{' ? type_len(sig - 1, 0) - 1 : type_len(sig, 0);
+
+    switch (sig[0]) {
+    case 's': case 'o':
+        node->typeId = (alljoyn_typeid) sig[0];
+        node->align = 4;
+        break;
+
+    case 'g': case 'v':
+        node->typeId = (alljoyn_typeid) sig[0];
+        node->align = 1;
+        break;
+
+    case 'a':
+        node->align = 4;
+        node->numChildren = 1;
+        node->children = take_nodes(desc, 1);
+        build_node(desc, node->children, sig + 1);
+        node->typeId = is_scalar(sig[1]) ? (alljoyn_typeid) ((sig[1] << 8) | 'a') : ALLJOYN_ARRAY;
+        break;
+
+    case '(':
+    case '{':
+        for (pos = 1; pos < node->sigLen - 1; pos += type_len(sig + pos, 0)) {
+            node->numChildren++;
+        }
+        node->children = take_nodes(desc, node->numChildren);
+        for (i = 0, pos = 1; i < node->numChildren; ++i) {
+            build_node(desc, &node->children[i], sig + pos);
+            pos += node->children[i].sigLen;
+        }
+        node->typeId = sig[0] == '(' ? ALLJOYN_STRUCT : ALLJOYN_DICT_ENTRY;
+        node->align = 8;
+        node->fixedSize = layout(node->children, node->numChildren);
+        break;
+
+    default:
+        node->typeId = (alljoyn_typeid) sig[0];
+        node->align = scalar_size(sig[0]);
+        node->fixedSize = node->align;
+        break;
+    }
+}
+
+static aj_sigdesc build_desc(const char* signature, uint32_t hash)
+{
+    size_t len = strlen(signature);
+    aj_sigdesc desc;
+    size_t pos;
+    size_t i;
+
+    for (pos = 0; pos < len;) {
+        size_t n = type_len(signature + pos, 0);
+        if (!n) {
+            return NULL;
+        }
+        pos += n;
+    }
+
+    desc = (aj_sigdesc) calloc(1, sizeof(struct _aj_sigdesc_handle));
+    if (!desc) {
+        return NULL;
+    }
+    desc->hash = hash;
+    desc->signature = strdup(signature);
+    /* A signature never has more types than characters */
+    desc->nodes = (sig_node*) calloc(len ? len : 1, sizeof(sig_node));
+    if (!desc->signature || !desc->nodes) {
+        free(desc->signature);
+        free(desc->nodes);
+        free(desc);
+        return NULL;
+    }
+
+    desc->root.sig = desc->signature;
+    desc->root.sigLen = len;
+    for (pos = 0; pos < len; pos += type_len(signature + pos, 0)) {
+        desc->root.numChildren++;
+    }
+    desc->root.children = take_nodes(desc, desc->root.numChildren);
+    for (i = 0, pos = 0; i < desc->root.numChildren; ++i) {
+        build_node(desc, &desc->root.children[i], desc->signature + pos);
+        pos += desc->root.children[i].sigLen;
+    }
+    desc->fixedSize = layout(desc->root.children, desc->root.numChildren);
+    return desc;
+}
+
+aj_sigdesc aj_sigdesc_compile(const char* signature)
+{
+    uint32_t hash;
+    aj_sigdesc desc;
+    aj_sigdesc built;
+
+    if (!signature || strlen(signature) > SIG_MAX_LENGTH) {
+        return NULL;
+    }
+    hash = hash_signature(signature);
+
+    pthread_mutex_lock(&s_internLock);
+    for (desc = s_intern[hash % INTERN_BUCKETS]; desc; desc = desc->next) {
+        if (desc->hash == hash && 0 == strcmp(desc->signature, signature)) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_internLock);
+    if (desc) {
+        return desc;
+    }
+
+    /* Compile outside the lock; if another thread won the race, use its descriptor */
+    built = build_desc(signature, hash);
+    if (!built) {
+        printf("aj_sigdesc: invalid signature \"%s\"\n", signature);
+        return NULL;
+    }
+    pthread_mutex_lock(&s_internLock);
+    for (desc = s_intern[hash % INTERN_BUCKETS]; desc; desc = desc->next) {
+        if (desc->hash == hash && 0 == strcmp(desc->signature, signature)) {
+            break;
+        }
+    }
+    if (!desc) {
+        built->next = s_intern[hash % INTERN_BUCKETS];
+        s_intern[hash % INTERN_BUCKETS] = built;
+        desc = built;
+        built = NULL;
+    }
+    pthread_mutex_unlock(&s_internLock);
+
+    if (built) {
+        free(built->signature);
+        free(built->nodes);
+        free(built);
+    }
+    return desc;
+}
+
+const char* aj_sigdesc_getsignature(aj_sigdesc desc)
+{
+    return desc->signature;
+}
+
+size_t aj_sigdesc_getnumargs(aj_sigdesc desc)
+{
+    return desc->root.numChildren;
+}
+
+size_t aj_sigdesc_getfixedsize(aj_sigdesc desc)
+{
+    return desc->fixedSize;
+}
+
+QStatus aj_sigdesc_checkmessage(aj_sigdesc desc, alljoyn_message message)
+{
+    const char* sig = alljoyn_message_getsignature(message);
+    return (0 == strcmp(sig ? sig : "", desc->signature)) ? ER_OK : ER_BUS_SIGNATURE_MISMATCH;
+}
+
+static QCC_BOOL check_node(const sig_node* node, alljoyn_msgarg arg)
+{
+    size_t i;
+
+    if (!arg || alljoyn_msgarg_gettype(arg) != node->typeId) {
+        return QCC_FALSE;
+    }
+    switch (node->typeId) {
+    case ALLJOYN_STRUCT:
+        if (alljoyn_msgarg_getnummembers(arg) != node->numChildren) {
+            return QCC_FALSE;
+        }
+        for (i = 0; i < node->numChildren; ++i) {
+            if (!check_node(&node->children[i], alljoyn_msgarg_getmember(arg, i))) {
+                return QCC_FALSE;
+            }
+        }
+        return QCC_TRUE;
+
+    case ALLJOYN_DICT_ENTRY:
+        return check_node(&node->children[0], alljoyn_msgarg_getkey(arg)) &&
+               check_node(&node->children[1], alljoyn_msgarg_getvalue(arg));
+
+    case ALLJOYN_ARRAY:
+        /* All elements share one signature; an empty array has nothing to check */
+        if (alljoyn_msgarg_get_array_numberofelements(arg) > 0) {
+            const char* elemSig = alljoyn_msgarg_get_array_elementsignature(arg, 0);
+            const sig_node* elem = node->children;
+            return elemSig && 0 == strncmp(elemSig, elem->sig, elem->sigLen) && elemSig[elem->sigLen] == '\0';
+        }
+        return QCC_TRUE;
+
+    default:
+        return QCC_TRUE;
+    }
+}
+
+QStatus aj_sigdesc_checkargs(aj_sigdesc desc, const alljoyn_msgarg args, size_t numArgs)
+{
+    size_t i;
+
+    if (numArgs != desc->root.numChildren) {
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+    for (i = 0; i < numArgs; ++i) {
+        if (!check_node(&desc->root.children[i], alljoyn_msgarg_array_element(args, i))) {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+    }
+    return ER_OK;
+}
+
+static QStatus get_scalar_array(char code, alljoyn_msgarg arg, size_t* n, void* elems)
+{
+    switch (code) {
+    case 'y': return alljoyn_msgarg_get_uint8_array(arg, n, (uint8_t*) elems);
+    case 'b': return alljoyn_msgarg_get_bool_array(arg, n, (QCC_BOOL*) elems);
+    case 'n': return alljoyn_msgarg_get_int16_array(arg, n, (int16_t*) elems);
+    case 'q': return alljoyn_msgarg_get_uint16_array(arg, n, (uint16_t*) elems);
+    case 'i': return alljoyn_msgarg_get_int32_array(arg, n, (int32_t*) elems);
+    case 'u': return alljoyn_msgarg_get_uint32_array(arg, n, (uint32_t*) elems);
+    case 'x': return alljoyn_msgarg_get_int64_array(arg, n, (int64_t*) elems);
+    case 't': return alljoyn_msgarg_get_uint64_array(arg, n, (uint64_t*) elems);
+    case 'd': return alljoyn_msgarg_get_double_array(arg, n, (double*) elems);
+    default: return ER_BUS_SIGNATURE_MISMATCH;
+    }
+}
+
+/* Extract one arg, already checked, into the next output pointer(s) */
+static QStatus decode_node(const sig_node* node, alljoyn_msgarg arg, va_list* ap)
+{
+    QStatus status = ER_OK;
+    size_t i;
+
+    switch (node->code) {
+    case 'y': return alljoyn_msgarg_get_uint8(arg, va_arg(*ap, uint8_t*));
+    case 'b': return alljoyn_msgarg_get_bool(arg, va_arg(*ap, QCC_BOOL*));
+    case 'n': return alljoyn_msgarg_get_int16(arg, va_arg(*ap, int16_t*));
+    case 'q': return alljoyn_msgarg_get_uint16(arg, va_arg(*ap, uint16_t*));
+    case 'i': return alljoyn_msgarg_get_int32(arg, va_arg(*ap, int32_t*));
+    case 'u': return alljoyn_msgarg_get_uint32(arg, va_arg(*ap, uint32_t*));
+    case 'x': return alljoyn_msgarg_get_int64(arg, va_arg(*ap, int64_t*));
+    case 't': return alljoyn_msgarg_get_uint64(arg, va_arg(*ap, uint64_t*));
+    case 'd': return alljoyn_msgarg_get_double(arg, va_arg(*ap, double*));
+
+    /* The string getters fill in a pointer to the arg's string */
+    case 's': return alljoyn_msgarg_get_string(arg, (char*) va_arg(*ap, const char**));
+    case 'o': return alljoyn_msgarg_get_objectpath(arg, (char*) va_arg(*ap, const char**));
+    case 'g': return alljoyn_msgarg_get_signature(arg, (char*) va_arg(*ap, const char**));
+
+    case 'a':
+        if (node->typeId != ALLJOYN_ARRAY) {
+            size_t* n = va_arg(*ap, size_t*);
+            return get_scalar_array(node->children->code, arg, n, va_arg(*ap, void*));
+        }
+        *va_arg(*ap, alljoyn_msgarg*) = arg;
+        return ER_OK;
+
+    case '(':
+        for (i = 0; i < node->numChildren && ER_OK == status; ++i) {
+            status = decode_node(&node->children[i], alljoyn_msgarg_getmember(arg, i), ap);
+        }
+        return status;
+
+    default:
+        /* Variants and handles are handed back as the arg itself */
+        *va_arg(*ap, alljoyn_msgarg*) = arg;
+        return ER_OK;
+    }
+}
+
+/* Set one top-level arg from the next input value(s) */
+static QStatus encode_node(const sig_node* node, alljoyn_msgarg arg, va_list* ap)
+{
+    size_t n;
+
+    switch (node->code) {
+    /* Types narrower than int are promoted when passed through "..." */
+    case 'y': return alljoyn_msgarg_set_uint8(arg, (uint8_t) va_arg(*ap, int));
+    case 'b': return alljoyn_msgarg_set_bool(arg, (QCC_BOOL) va_arg(*ap, int));
+    case 'n': return alljoyn_msgarg_set_int16(arg, (int16_t) va_arg(*ap, int));
+    case 'q': return alljoyn_msgarg_set_uint16(arg, (uint16_t) va_arg(*ap, int));
+    case 'i': return alljoyn_msgarg_set_int32(arg, va_arg(*ap, int32_t));
+    case 'u': return alljoyn_msgarg_set_uint32(arg, va_arg(*ap, uint32_t));
+    case 'x': return alljoyn_msgarg_set_int64(arg, va_arg(*ap, int64_t));
+    case 't': return alljoyn_msgarg_set_uint64(arg, va_arg(*ap, uint64_t));
+    case 'd': return alljoyn_msgarg_set_double(arg, va_arg(*ap, double));
+    case 's': return alljoyn_msgarg_set_string(arg, va_arg(*ap, const char*));
+    case 'o': return alljoyn_msgarg_set_objectpath(arg, va_arg(*ap, const char*));
+    case 'g': return alljoyn_msgarg_set_signature(arg, va_arg(*ap, const char*));
+
+    case 'a':
+        n = va_arg(*ap, size_t);
+        switch (node->children->code) {
+        case 'y': return alljoyn_msgarg_set_uint8_array(arg, n, va_arg(*ap, uint8_t*));
+        case 'b': return alljoyn_msgarg_set_bool_array(arg, n, va_arg(*ap, QCC_BOOL*));
+        case 'n': return alljoyn_msgarg_set_int16_array(arg, n, va_arg(*ap, int16_t*));
+        case 'q': return alljoyn_msgarg_set_uint16_array(arg, n, va_arg(*ap, uint16_t*));
+        case 'i': return alljoyn_msgarg_set_int32_array(arg, n, va_arg(*ap, int32_t*));
+        case 'u': return alljoyn_msgarg_set_uint32_array(arg, n, va_arg(*ap, uint32_t*));
+        case 'x': return alljoyn_msgarg_set_int64_array(arg, n, va_arg(*ap, int64_t*));
+        case 't': return alljoyn_msgarg_set_uint64_array(arg, n, va_arg(*ap, uint64_t*));
+        case 'd': return alljoyn_msgarg_set_double_array(arg, n, va_arg(*ap, double*));
+        case 's': return alljoyn_msgarg_set_string_array(arg, n, va_arg(*ap, const char**));
+        case 'o': return alljoyn_msgarg_set_objectpath_array(arg, n, va_arg(*ap, const char**));
+        case 'g': return alljoyn_msgarg_set_signature_array(arg, n, va_arg(*ap, const char**));
+        default: return ER_BUS_BAD_SIGNATURE;
+        }
+
+    default:
+        /* Structs, dictionaries, variants and handles: use alljoyn_msgarg_set() */
+        return ER_BUS_BAD_SIGNATURE;
+    }
+}
+
+QStatus aj_sigdesc_encode(aj_sigdesc desc, alljoyn_msgarg args, size_t numArgs, ...)
+{
+    QStatus status = ER_OK;
+    va_list ap;
+    size_t i;
+
+    if (numArgs != desc->root.numChildren) {
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+    va_start(ap, numArgs);
+    for (i = 0; i < numArgs && ER_OK == status; ++i) {
+        status = encode_node(&desc->root.children[i], alljoyn_msgarg_array_element(args, i), &ap);
+    }
+    va_end(ap);
+    return status;
+}
+
+static QStatus decode_args(aj_sigdesc desc, const alljoyn_msgarg args, size_t numArgs, QCC_BOOL check, va_list* ap)
+{
+    QStatus status = ER_OK;
+    size_t i;
+
+    if (numArgs != desc->root.numChildren) {
+        return ER_BUS_SIGNATURE_MISMATCH;
+    }
+    for (i = 0; i < numArgs && ER_OK == status; ++i) {
+        alljoyn_msgarg arg = alljoyn_msgarg_array_element(args, i);
+        if (check && !check_node(&desc->root.children[i], arg)) {
+            return ER_BUS_SIGNATURE_MISMATCH;
+        }
+        status = decode_node(&desc->root.children[i], arg, ap);
+    }
+    return status;
+}
+
+QStatus aj_sigdesc_vdecode(aj_sigdesc desc, const alljoyn_msgarg args, size_t numArgs, va_list ap)
+{
+    QStatus status;
+    va_list copy;
+
+    va_copy(copy, ap);
+    status = decode_args(desc, args, numArgs, QCC_TRUE, &copy);
+    va_end(copy);
+    return status;
+}
+
+QStatus aj_sigdesc_decode(aj_sigdesc desc, const alljoyn_msgarg args, size_t numArgs, ...)
+{
+    QStatus status;
+    va_list ap;
+
+    va_start(ap, numArgs);
+    status = decode_args(desc, args, numArgs, QCC_TRUE, &ap);
+    va_end(ap);
+    return status;
+}
+
+QStatus aj_sigdesc_decodemessage(aj_sigdesc desc, alljoyn_message message, ...)
+{
+    alljoyn_msgarg args = NULL;
+    size_t numArgs = 0;
+    QStatus status;
+    va_list ap;
+
+    status = aj_sigdesc_checkmessage(desc, message);
+    if (ER_OK != status) {
+        return status;
+    }
+    alljoyn_message_getargs(message, &numArgs, &args);
+    va_start(ap, message);
+    status = decode_args(desc, args, numArgs, QCC_FALSE, &ap);
+    va_end(ap);
+    return status;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file
+ * @brief Signatures compiled once into interned descriptors, with a
+ * validator and decoder that do not parse signature strings per message.
+ *
+ * alljoyn_msgarg_get() parses its signature argument on every call, and
+ * handlers usually call it once per argument after checking the count. A
+ * descriptor is compiled from a signature the first time it is seen and
+ * shared by every caller that asks for the same signature afterwards. It
+ * holds the type tree, the type id each arg must have, and the size and
+ * alignment of fixed-size types.
+ *
+ * A message whose signature matches the descriptor has already been checked
+ * by the unmarshaller, so aj_sigdesc_checkmessage() is a single string
+ * compare against the wire signature. Args built locally are walked by type
+ * id instead. Decoding then fetches each field with the getter for its
+ * type, in the same flattened order alljoyn_msgarg_get() uses.
+ *
+ * @code
+ * static aj_sigdesc addSig;                 // aj_sigdesc_compile("ss") at registration
+ *
+ * const char* a;
+ * const char* b;
+ * status = aj_sigdesc_decodemessage(addSig, msg, &a, &b);
+ * @endcode
+ */
+#ifndef _AJ_SIGDESC_H
+#define _AJ_SIGDESC_H
+
+#include <qcc/platform.h>
+
+#include <stdarg.h>
+
+#include <alljoyn_c/Message.h>
+#include <alljoyn_c/MsgArg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Compiled signature. Descriptors are interned and live as long as the process. */
+typedef struct _aj_sigdesc_handle* aj_sigdesc;
+
+/**
+ * Compile a signature, or return the descriptor already compiled for it.
+ * Thread safe.
+ *
+ * @return the descriptor, or NULL if @p signature is not a valid signature.
+ */
+aj_sigdesc aj_sigdesc_compile(const char* signature);
+
+/** The signature the descriptor was compiled from. */
+const char* aj_sigdesc_getsignature(aj_sigdesc desc);
+
+/** Number of complete types at the top level, i.e. the number of args. */
+size_t aj_sigdesc_getnumargs(aj_sigdesc desc);
+
+/**
+ * Whether every type in the signature has a fixed size (no strings, arrays
+ * or variants), and that size as laid out on the wire, including padding.
+ *
+ * @return the size in bytes, or 0 if the signature is not fixed size.
+ */
+size_t aj_sigdesc_getfixedsize(aj_sigdesc desc);
+
+/**
+ * Check that a received message has this signature.
+ *
+ * @return #ER_OK or #ER_BUS_SIGNATURE_MISMATCH.
+ */
+QStatus aj_sigdesc_checkmessage(aj_sigdesc desc, alljoyn_message message);
+
+/**
+ * Check that @p numArgs args, for example built locally, match this
+ * signature, by type id and member count.
+ *
+ * @return #ER_OK or #ER_BUS_SIGNATURE_MISMATCH.
+ */
+QStatus aj_sigdesc_checkargs(aj_sigdesc desc, const alljoyn_msgarg args, size_t numArgs);
+
+/**
+ * Check args against this signature and extract them.
+ *
+ * The variable arguments follow alljoyn_msgarg_get(): a pointer of the
+ * scalar's type for a scalar, a const char** for 's', 'o' and 'g', a size_t*
+ * then a pointer to a const element pointer for an array of scalars, and an
+ * alljoyn_msgarg* for a handle, any other array or a variant. Struct members
+ * are flattened in order.
+ *
+ * @return #ER_OK or #ER_BUS_SIGNATURE_MISMATCH.
+ */
+QStatus aj_sigdesc_decode(aj_sigdesc desc, const alljoyn_msgarg args, size_t numArgs, ...);
+
+/** aj_sigdesc_decode() with a va_list. */
+QStatus aj_sigdesc_vdecode(aj_sigdesc desc, const alljoyn_msgarg args, size_t numArgs, va_list ap);
+
+/**
+ * aj_sigdesc_checkmessage() followed by aj_sigdesc_decode() on the
+ * message's args, skipping the per-arg type checks the signature compare
+ * has made redundant.
+ */
+QStatus aj_sigdesc_decodemessage(aj_sigdesc desc, alljoyn_message message, ...);
+
+/**
+ * Set @p numArgs args from values, with the typed setter for each arg's
+ * type instead of alljoyn_msgarg_array_set(), which parses the signature
+ * on every call.
+ *
+ * The variable arguments follow alljoyn_msgarg_set(): the value for a
+ * scalar, a const char* for 's', 'o' and 'g', and a size_t then a pointer
+ * to the elements for an array of scalars or strings. The args reference
+ * strings and array elements without copying them.
+ *
+ * @return #ER_OK, #ER_BUS_SIGNATURE_MISMATCH if @p numArgs is not the
+ *         number of types in the signature, or #ER_BUS_BAD_SIGNATURE for a
+ *         struct, dictionary, variant or handle, which this does not build.
+ */
+QStatus aj_sigdesc_encode(aj_sigdesc desc, alljoyn_msgarg args, size_t numArgs, ...);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+/**
+ * @file
+ * @brief Startup pipeline that runs independent initialization phases
+ * concurrently and times each of them.
+ */
+#include <qcc/platform.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "aj_startup.h"
+#include "aj_time.h"
+
+typedef struct {
+    uint32_t stage;
+    const char* name;
+    aj_startup_phase_ptr phase;
+    void* context;
+    uint64_t startNs;
+    uint64_t endNs;
+    QStatus status;
+    pthread_t thread;
+    QCC_BOOL threaded;
+} startup_phase;
+
+struct _aj_startup_handle {
+    QCC_BOOL concurrent;
+    uint64_t createdNs;
+    uint64_t readyNs;
+    startup_phase* phases;
+    size_t numPhases;
+    size_t capacity;
+};
+
+static void run_phase(startup_phase* p)
+{
+    p->startNs = aj_time_now_ns();
+    p->status = p->phase(p->context);
+    p->endNs = aj_time_now_ns();
+}
+
+static void* phase_thread(void* arg)
+{
+    run_phase((startup_phase*) arg);
+    return NULL;
+}
+
+/* Run the phases of one stage; the last one on the calling thread */
+static void run_stage(aj_startup startup, uint32_t stage)
+{
+    startup_phase* last = NULL;
+    size_t i;
+
+    for (i = 0; i < startup->numPhases; ++i) {
+        startup_phase* p = &startup->phases[i];
+        if (p->stage != stage) {
+            continue;
+        }
+        if (last) {
+            if (startup->concurrent && 0 == pthread_create(&last->thread, NULL, phase_thread, last)) {
+                last->threaded = QCC_TRUE;
+            } else {
+                run_phase(last);
+            }
+        }
+        last = p;
+    }
+    if (last) {
+        run_phase(last);
+    }
+    for (i = 0; i < startup->numPhases; ++i) {
+        startup_phase* p = &startup->phases[i];
+        if (p->stage == stage && p->threaded) {
+            pthread_join(p->thread, NULL);
+            p->threaded = QCC_FALSE;
+        }
+    }
+}
+
+aj_startup aj_startup_create(QCC_BOOL concurrent)
+{
+    aj_startup startup = (aj_startup) calloc(1, sizeof(struct _aj_startup_handle));
+    if (!startup) {
+        return NULL;
+    }
+    startup->concurrent = concurrent;
+    startup->createdNs = aj_time_now_ns();
+    return startup;
+}
+
+void aj_startup_destroy(aj_startup startup)
+{
+    if (!startup) {
+        return;
+    }
+    free(startup->phases);
+    free(startup);
+}
+
+QStatus aj_startup_add(aj_startup startup, uint32_t stage, const char* name, aj_startup_phase_ptr phase,
+                       void* context)
+{
+    startup_phase* p;
+
+    if (!phase) {
+        return ER_BAD_ARG_4;
+    }
+    if (startup->numPhases == startup->capacity) {
+        size_t capacity = startup->capacity ? startup->capacity * 2 : 8;
+        startup_phase* phases = (startup_phase*) realloc(startup->phases, capacity * sizeof(startup_phase));
+        if (!phases) {
+            return ER_OUT_OF_MEMORY;
+        }
+        startup->phases = phases;
+        startup->capacity = capacity;
+    }
+    p = &startup->phases[startup->numPhases++];
+    p->stage = stage;
+    p->name = name;
+    p->phase = phase;
+    p->context = context;
+    p->startNs = 0;
+    p->endNs = 0;
+    p->status = ER_NONE;
+    p->threaded = QCC_FALSE;
+    return ER_OK;
+}
+
+QStatus aj_startup_run(aj_startup startup)
+{
+    QCC_BOOL haveStage = QCC_FALSE;
+    uint32_t stage = 0;
+
+    for (;;) {
+        QCC_BOOL found = QCC_FALSE;
+        uint32_t next = 0;
+        size_t i;
+
+        /* The lowest stage above the one just run */
+        for (i = 0; i < startup->numPhases; ++i) {
+            uint32_t s = startup->phases[i].stage;
+            if ((!haveStage || s > stage) && (!found || s < next)) {
+                next = s;
+                found = QCC_TRUE;
+            }
+        }
+        if (!found) {
+            break;
+        }
+        stage = next;
+        haveStage = QCC_TRUE;
+        run_stage(startup, stage);
+
+        for (i = 0; i < startup->numPhases; ++i) {
+            startup_phase* p = &startup->phases[i];
+            if (p->stage == stage && ER_OK != p->status) {
+                printf("aj_startup: %s failed (%s)\n", p->name, QCC_StatusText(p->status));
+                return p->status;
+            }
+        }
+    }
+    startup->readyNs = aj_time_now_ns();
+    return ER_OK;
+}
+
+double aj_startup_getreadyms(aj_startup startup)
+{
+    return startup->readyNs ? (double) (startup->readyNs - startup->createdNs) / 1e6 : 0.0;
+}
+
+double aj_startup_getelapsedms(aj_startup startup)
+{
+    return (double) (aj_time_now_ns() - startup->createdNs) / 1e6;
+}
+
+void aj_startup_report(aj_startup startup)
+{
+    double busyMs = 0.0;
+    size_t i;
+
+    for (i = 0; i < startup->numPhases; ++i) {
+        const startup_phase* p = &startup->phases[i];
+        if (!p->startNs) {
+            printf("[INFO] Startup: stage %u %-16s not run\n", p->stage, p->name);
+            continue;
+        }
+        printf("[INFO] Startup: stage %u %-16s %8.2f .. %8.2f ms  %s\n", p->stage, p->name,
+               (double) (p->startNs - startup->createdNs) / 1e6, (double) (p->endNs - startup->createdNs) / 1e6,
+               QCC_StatusText(p->status));
+        busyMs += (double) (p->endNs - p->startNs) / 1e6;
+    }
+    if (startup->readyNs) {
+        /* The sum is roughly what running every phase in sequence would take */
+        printf("[INFO] Startup: ready after %.2f ms (%s, phases add up to %.2f ms)\n", aj_startup_getreadyms(startup),
+               startup->concurrent ? "concurrent" : "sequential", busyMs);
+    }
+}
@@ -0,0 +1,77 @@
+/**
+ * @file
+ * @brief Startup pipeline that runs independent initialization phases
+ * concurrently and times each of them.
+ *
+ * Each phase is added to a stage. Stages run in ascending order. The
+ * phases of one stage run at the same time, one thread per phase, so
+ * daemon round trips that do not depend on each other overlap. A stage
+ * starts only after every phase of the stage before has returned. Local
+ * work, such as building interfaces and bus objects, can share a stage
+ * with the connect to the daemon.
+ *
+ * Every phase is timed from aj_startup_create(). The time to ready is the
+ * time at which the last phase returned, and aj_startup_report() prints it
+ * with the timeline.
+ */
+#ifndef _AJ_STARTUP_H
+#define _AJ_STARTUP_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/Status.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Pipeline handle */
+typedef struct _aj_startup_handle* aj_startup;
+
+/** A phase. Phases of one stage run concurrently and must not share unlocked state. */
+typedef QStatus (*aj_startup_phase_ptr)(void* context);
+
+/**
+ * Create an empty pipeline and start its clock.
+ *
+ * @param concurrent  QCC_FALSE runs every phase on the calling thread in
+ *                    the order added, to compare against.
+ */
+aj_startup aj_startup_create(QCC_BOOL concurrent);
+
+/** Free the pipeline. */
+void aj_startup_destroy(aj_startup startup);
+
+/**
+ * Add a phase.
+ *
+ * @param startup  The pipeline.
+ * @param stage    Stage the phase runs in.
+ * @param name     Name in the report; not copied.
+ * @param phase    The phase.
+ * @param context  Passed to the phase.
+ */
+QStatus aj_startup_add(aj_startup startup, uint32_t stage, const char* name, aj_startup_phase_ptr phase,
+                       void* context);
+
+/**
+ * Run the stages. A stage in which a phase fails is the last one run.
+ *
+ * @return #ER_OK, or the status of the first failed phase in the order added.
+ */
+QStatus aj_startup_run(aj_startup startup);
+
+/** Milliseconds from aj_startup_create() until the last phase returned. */
+double aj_startup_getreadyms(aj_startup startup);
+
+/** Milliseconds from aj_startup_create() until now, e.g. at the first signal. */
+double aj_startup_getelapsedms(aj_startup startup);
+
+/** Print each phase's start, end and status, and the time to ready. */
+void aj_startup_report(aj_startup startup);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
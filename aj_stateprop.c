@@ -0,0 +1,184 @@
+/**
+ * @file
+ * @brief Read-only bus property whose PropertiesChanged notifications are
+ * coalesced over a time window.
+ */
+#include <qcc/platform.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aj_stateprop.h"
+#include "aj_time.h"
+
+struct _aj_stateprop_handle {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    QCC_BOOL stopping;
+
+    alljoyn_busobject busObject;
+    char* ifaceName;
+    char* propName;
+    uint32_t windowMs;
+    alljoyn_sessionid sessionId;
+
+    alljoyn_msgarg current;
+    alljoyn_msgarg announced;   /* value of the last notification */
+    QCC_BOOL pending;           /* a change is held back until windowEnd */
+    uint64_t windowEnd;
+    aj_stateprop_stats stats;
+};
+
+/*
+ * Called with the lock held. Holding it across the emit keeps notifications
+ * in order; emitting does not call back into the property.
+ */
+static void announce(aj_stateprop prop, uint64_t now)
+{
+    alljoyn_busobject_emitpropertychanged(prop->busObject, prop->ifaceName, prop->propName, prop->current,
+                                          prop->sessionId);
+    alljoyn_msgarg_clone(prop->announced, prop->current);
+    prop->windowEnd = now + prop->windowMs;
+    prop->stats.emitted++;
+}
+
+static void* window_thread(void* arg)
+{
+    aj_stateprop prop = (aj_stateprop) arg;
+
+    pthread_mutex_lock(&prop->lock);
+    while (!prop->stopping) {
+        uint64_t now = aj_time_now_ms();
+        struct timespec deadline;
+
+        if (!prop->pending) {
+            pthread_cond_wait(&prop->wake, &prop->lock);
+            continue;
+        }
+        if (now < prop->windowEnd) {
+            aj_time_deadline(&deadline, (uint32_t) (prop->windowEnd - now));
+            pthread_cond_timedwait(&prop->wake, &prop->lock, &deadline);
+            continue;
+        }
+        prop->pending = QCC_FALSE;
+        if (alljoyn_msgarg_equal(prop->current, prop->announced)) {
+            prop->stats.suppressed++;
+        } else {
+            announce(prop, now);
+        }
+    }
+    pthread_mutex_unlock(&prop->lock);
+    return NULL;
+}
+
+aj_stateprop aj_stateprop_create(alljoyn_busobject busObject, const char* ifaceName, const char* propName,
+                                 const alljoyn_msgarg initial, uint32_t windowMs, alljoyn_sessionid sessionId)
+{
+    aj_stateprop prop = (aj_stateprop) calloc(1, sizeof(struct _aj_stateprop_handle));
+
+    if (!prop) {
+        return NULL;
+    }
+    prop->busObject = busObject;
+    prop->ifaceName = strdup(ifaceName);
+    prop->propName = strdup(propName);
+    prop->windowMs = windowMs;
+    prop->sessionId = sessionId;
+    prop->current = alljoyn_msgarg_create();
+    prop->announced = alljoyn_msgarg_create();
+    if (!prop->ifaceName || !prop->propName || !prop->current || !prop->announced) {
+        goto oops;
+    }
+    alljoyn_msgarg_clone(prop->current, initial);
+    alljoyn_msgarg_clone(prop->announced, initial);
+
+    pthread_mutex_init(&prop->lock, NULL);
+    pthread_cond_init(&prop->wake, NULL);
+    if (pthread_create(&prop->thread, NULL, window_thread, prop) != 0) {
+        pthread_cond_destroy(&prop->wake);
+        pthread_mutex_destroy(&prop->lock);
+        goto oops;
+    }
+    return prop;
+
+oops:
+    if (prop->announced) {
+        alljoyn_msgarg_destroy(prop->announced);
+    }
+    if (prop->current) {
+        alljoyn_msgarg_destroy(prop->current);
+    }
+    free(prop->propName);
+    free(prop->ifaceName);
+    free(prop);
+    return NULL;
+}
+
+void aj_stateprop_destroy(aj_stateprop prop)
+{
+    if (!prop) {
+        return;
+    }
+    pthread_mutex_lock(&prop->lock);
+    prop->stopping = QCC_TRUE;
+    pthread_cond_signal(&prop->wake);
+    pthread_mutex_unlock(&prop->lock);
+    pthread_join(prop->thread, NULL);
+
+    alljoyn_msgarg_destroy(prop->announced);
+    alljoyn_msgarg_destroy(prop->current);
+    free(prop->propName);
+    free(prop->ifaceName);
+    pthread_cond_destroy(&prop->wake);
+    pthread_mutex_destroy(&prop->lock);
+    free(prop);
+}
+
+QStatus aj_stateprop_set(aj_stateprop prop, const alljoyn_msgarg value)
+{
+    uint64_t now = aj_time_now_ms();
+
+    pthread_mutex_lock(&prop->lock);
+    if (alljoyn_msgarg_equal(prop->current, value)) {
+        pthread_mutex_unlock(&prop->lock);
+        return ER_OK;
+    }
+    alljoyn_msgarg_clone(prop->current, value);
+    prop->stats.sets++;
+
+    if (!prop->pending && now >= prop->windowEnd) {
+        /* Quiet window: announce now and open a new window */
+        announce(prop, now);
+    } else {
+        if (prop->pending) {
+            prop->stats.coalesced++;
+        }
+        prop->pending = QCC_TRUE;
+        pthread_cond_signal(&prop->wake);
+    }
+    pthread_mutex_unlock(&prop->lock);
+    return ER_OK;
+}
+
+QStatus aj_stateprop_get(aj_stateprop prop, alljoyn_msgarg val)
+{
+    pthread_mutex_lock(&prop->lock);
+    alljoyn_msgarg_clone(val, prop->current);
+    pthread_mutex_unlock(&prop->lock);
+    return ER_OK;
+}
+
+QCC_BOOL aj_stateprop_matches(aj_stateprop prop, const char* ifaceName, const char* propName)
+{
+    return ifaceName && propName && 0 == strcmp(ifaceName, prop->ifaceName) && 0 == strcmp(propName, prop->propName);
+}
+
+void aj_stateprop_getstats(aj_stateprop prop, aj_stateprop_stats* stats)
+{
+    pthread_mutex_lock(&prop->lock);
+    *stats = prop->stats;
+    pthread_mutex_unlock(&prop->lock);
+}
@@ -0,0 +1,81 @@
+/**
+ * @file
+ * @brief Read-only bus property whose PropertiesChanged notifications are
+ * coalesced over a time window.
+ *
+ * The owner updates the value with aj_stateprop_set() as often as it likes;
+ * the bus object's property_get callback answers from aj_stateprop_get(). A
+ * change is announced with alljoyn_busobject_emitpropertychanged() right away
+ * if nothing was announced during the last window. Otherwise it is held back
+ * until the window ends, and only the value current at that point is
+ * announced, or nothing at all if the value has flapped back to the one
+ * last announced. A consumer sees at most one notification per window and
+ * can read the current value at any time.
+ *
+ * The interface should carry the org.freedesktop.DBus.Property.EmitsChangedSignal
+ * annotation on the property, or AllJoyn will not send the notification.
+ */
+#ifndef _AJ_STATEPROP_H
+#define _AJ_STATEPROP_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusObject.h>
+#include <alljoyn_c/MsgArg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Coalesced property handle */
+typedef struct _aj_stateprop_handle* aj_stateprop;
+
+/** Counters. */
+typedef struct {
+    uint32_t sets;          /**< Calls to aj_stateprop_set() that changed the value */
+    uint32_t emitted;       /**< PropertiesChanged notifications sent */
+    uint32_t coalesced;     /**< Changes folded into a later notification */
+    uint32_t suppressed;    /**< Windows that ended with the value already announced */
+} aj_stateprop_stats;
+
+/**
+ * Create a property.
+ *
+ * @param busObject  The object implementing the property.
+ * @param ifaceName  Interface the property belongs to.
+ * @param propName   The property.
+ * @param initial    Initial value; copied.
+ * @param windowMs   Coalescing window; 0 announces every change.
+ * @param sessionId  Session the notifications go to, 0 for all.
+ *
+ * @return the property, or NULL on failure.
+ */
+aj_stateprop aj_stateprop_create(alljoyn_busobject busObject, const char* ifaceName, const char* propName,
+                                 const alljoyn_msgarg initial, uint32_t windowMs, alljoyn_sessionid sessionId);
+
+/** Destroy the property. A change still held back is dropped. */
+void aj_stateprop_destroy(aj_stateprop prop);
+
+/**
+ * Update the value, copying @p value. Setting the current value again does
+ * nothing. Thread safe.
+ */
+QStatus aj_stateprop_set(aj_stateprop prop, const alljoyn_msgarg value);
+
+/**
+ * Copy the current value into @p val, as a property_get callback should.
+ * Thread safe.
+ */
+QStatus aj_stateprop_get(aj_stateprop prop, alljoyn_msgarg val);
+
+/** Whether @p ifaceName and @p propName name this property. */
+QCC_BOOL aj_stateprop_matches(aj_stateprop prop, const char* ifaceName, const char* propName);
+
+/** Copy the counters. */
+void aj_stateprop_getstats(aj_stateprop prop, aj_stateprop_stats* stats);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * @file
+ * @brief Monotonic clock helpers shared by the sample helpers.
+ */
+#ifndef _AJ_TIME_H
+#define _AJ_TIME_H
+
+#include <stdint.h>
+#include <time.h>
+
+/** Milliseconds on the monotonic clock. */
+static inline uint64_t aj_time_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+/** Nanoseconds on the monotonic clock. */
+static inline uint64_t aj_time_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/** Absolute CLOCK_REALTIME deadline @p ms from now, for pthread_cond_timedwait. */
+static inline void aj_time_deadline(struct timespec* ts, uint32_t ms)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long) (ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+#endif
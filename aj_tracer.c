@@ -0,0 +1,448 @@
+/**
+ * @file
+ * @brief Always-on sampling tracer recording compact message metadata into
+ * per-thread rings.
+ */
+#include <qcc/platform.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <alljoyn_c/BusObject.h>
+#include <alljoyn_c/InterfaceDescription.h>
+#include <alljoyn_c/MsgArg.h>
+
+#include "aj_time.h"
+#include "aj_tracer.h"
+
+/*
+ * Each ring has one writer, its thread, and is read by dumps. The writer
+ * fills slot head % size and then publishes head + 1. A dump copies the
+ * published records and reads head again afterwards: the writer may by then
+ * be filling slot head % size, so only records newer than head - size are
+ * known to be intact.
+ */
+typedef struct _trace_ring {
+    struct _trace_ring* next;
+    pthread_t owner;
+    uint32_t thread;
+    uint32_t countdown;         /* messages until the next sample */
+    volatile uint64_t seen;
+    uint64_t head;              /* records written; accessed atomically */
+    aj_tracerecord records[1];
+} trace_ring;
+
+struct _aj_tracer_handle {
+    uint64_t id;
+    uint32_t sampleEvery;
+    uint32_t size;              /* records per ring, a power of two */
+    char* dumpPath;
+
+    pthread_mutex_t lock;       /* ring list and dumps */
+    trace_ring* rings;
+    uint32_t numRings;
+
+    /* Signal dumps */
+    int signum;
+    struct sigaction oldAction;
+    sem_t dumpRequest;
+    pthread_t dumpThread;
+    volatile QCC_BOOL stopping;
+
+    /* Bus method dumps */
+    alljoyn_busattachment bus;
+    alljoyn_busobject busObject;
+};
+
+/* The ring this thread last traced into, and its tracer's id */
+static __thread uint64_t t_tracerId = 0;
+static __thread trace_ring* t_ring = NULL;
+
+static uint64_t s_nextId = 0;
+
+/* Dumped by signal and by bus method; handlers have no context */
+static aj_tracer volatile s_tracer = NULL;
+
+static trace_ring* thread_ring(aj_tracer tracer)
+{
+    pthread_t self = pthread_self();
+    trace_ring* ring;
+
+    pthread_mutex_lock(&tracer->lock);
+    for (ring = tracer->rings; ring && !pthread_equal(ring->owner, self); ring = ring->next) {
+    }
+    if (!ring) {
+        ring = (trace_ring*) calloc(1, sizeof(trace_ring) + (tracer->size - 1) * sizeof(aj_tracerecord));
+        if (ring) {
+            ring->owner = self;
+            ring->thread = tracer->numRings++;
+            ring->countdown = tracer->sampleEvery;
+            ring->next = tracer->rings;
+            tracer->rings = ring;
+        }
+    }
+    pthread_mutex_unlock(&tracer->lock);
+    if (ring) {
+        t_tracerId = tracer->id;
+        t_ring = ring;
+    }
+    return ring;
+}
+
+static inline void copy_field(char* dst, const char* src, size_t size)
+{
+    size_t i = 0;
+
+    if (src) {
+        for (; i < size - 1 && src[i]; ++i) {
+            dst[i] = src[i];
+        }
+    }
+    dst[i] = '\0';
+}
+
+void aj_tracer_trace(aj_tracer tracer, alljoyn_message msg)
+{
+    trace_ring* ring = (t_tracerId == tracer->id) ? t_ring : thread_ring(tracer);
+    aj_tracerecord* record;
+    alljoyn_msgarg args = NULL;
+    size_t numArgs = 0;
+    uint64_t head;
+
+    if (!ring) {
+        return;
+    }
+    ring->seen++;
+    if (--ring->countdown) {
+        return;
+    }
+    ring->countdown = tracer->sampleEvery;
+
+    head = ring->head;
+    record = &ring->records[head & (tracer->size - 1)];
+    /* The slot is reused only after the previous head was published */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    record->timestamp = aj_time_now_ns();
+    record->serial = alljoyn_message_getcallserial(msg);
+    record->replySerial = alljoyn_message_getreplyserial(msg);
+    record->sessionId = alljoyn_message_getsessionid(msg);
+    alljoyn_message_getargs(msg, &numArgs, &args);
+    record->numArgs = numArgs > 0xffff ? 0xffff : (uint16_t) numArgs;
+    record->type = (uint8_t) alljoyn_message_gettype(msg);
+    record->flags = alljoyn_message_getflags(msg);
+    copy_field(record->sender, alljoyn_message_getsender(msg), sizeof(record->sender));
+    copy_field(record->destination, alljoyn_message_getdestination(msg), sizeof(record->destination));
+    copy_field(record->path, alljoyn_message_getobjectpath(msg), sizeof(record->path));
+    copy_field(record->member, alljoyn_message_getmembername(msg), sizeof(record->member));
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+aj_tracer aj_tracer_create(uint32_t sampleEvery, uint32_t ringRecords, const char* dumpPath)
+{
+    aj_tracer tracer = (aj_tracer) calloc(1, sizeof(struct _aj_tracer_handle));
+
+    if (!tracer) {
+        return NULL;
+    }
+    tracer->dumpPath = strdup(dumpPath);
+    if (!tracer->dumpPath) {
+        free(tracer);
+        return NULL;
+    }
+    tracer->id = __sync_add_and_fetch(&s_nextId, 1);
+    tracer->sampleEvery = sampleEvery ? sampleEvery : 1;
+    for (tracer->size = 1; tracer->size < ringRecords; tracer->size <<= 1) {
+    }
+    pthread_mutex_init(&tracer->lock, NULL);
+    return tracer;
+}
+
+void aj_tracer_destroy(aj_tracer tracer)
+{
+    if (!tracer) {
+        return;
+    }
+    if (tracer->busObject) {
+        alljoyn_busattachment_unregisterbusobject(tracer->bus, tracer->busObject);
+        alljoyn_busobject_destroy(tracer->busObject);
+    }
+    if (tracer->signum) {
+        sigaction(tracer->signum, &tracer->oldAction, NULL);
+        tracer->stopping = QCC_TRUE;
+        sem_post(&tracer->dumpRequest);
+        pthread_join(tracer->dumpThread, NULL);
+        sem_destroy(&tracer->dumpRequest);
+    }
+    if (s_tracer == tracer) {
+        s_tracer = NULL;
+    }
+    while (tracer->rings) {
+        trace_ring* next = tracer->rings->next;
+        free(tracer->rings);
+        tracer->rings = next;
+    }
+    pthread_mutex_destroy(&tracer->lock);
+    free(tracer->dumpPath);
+    free(tracer);
+}
+
+QStatus aj_tracer_dump(aj_tracer tracer, const char* path, uint32_t* numRecords)
+{
+    aj_tracefile_header header;
+    aj_tracerecord* copy = NULL;
+    trace_ring* ring;
+    struct timespec ts;
+    uint32_t total = 0;
+    char* tmpPath = NULL;
+    FILE* f = NULL;
+    QStatus status = ER_OK;
+
+    if (numRecords) {
+        *numRecords = 0;
+    }
+    copy = (aj_tracerecord*) malloc(tracer->size * sizeof(aj_tracerecord));
+    tmpPath = (char*) malloc(strlen(path) + 5);
+    if (!copy || !tmpPath) {
+        free(copy);
+        free(tmpPath);
+        return ER_OUT_OF_MEMORY;
+    }
+    sprintf(tmpPath, "%s.tmp", path);
+
+    pthread_mutex_lock(&tracer->lock);
+    f = fopen(tmpPath, "wb");
+    if (!f) {
+        printf("aj_tracer: cannot open %s (%s)\n", tmpPath, strerror(errno));
+        status = ER_OS_ERROR;
+        goto done;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, AJ_TRACEFILE_MAGIC, sizeof(header.magic));
+    header.version = AJ_TRACEFILE_VERSION;
+    header.recordSize = sizeof(aj_tracerecord);
+    header.sampleEvery = tracer->sampleEvery;
+    header.numRings = tracer->numRings;
+    header.monotonicNs = aj_time_now_ns();
+    clock_gettime(CLOCK_REALTIME, &ts);
+    header.realtimeNs = (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+    if (1 != fwrite(&header, sizeof(header), 1, f)) {
+        status = ER_OS_ERROR;
+    }
+
+    for (ring = tracer->rings; ring && ER_OK == status; ring = ring->next) {
+        aj_tracefile_ring hdr;
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t n = head < tracer->size ? head : tracer->size;
+        uint64_t first = head - n;
+        uint64_t intact;
+        uint64_t skip;
+        uint64_t i;
+
+        for (i = 0; i < n; ++i) {
+            copy[i] = ring->records[(first + i) & (tracer->size - 1)];
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        intact = head + 1 > tracer->size ? head + 1 - tracer->size : 0;
+        skip = intact > first ? intact - first : 0;
+        if (skip > n) {
+            skip = n;
+        }
+
+        hdr.thread = ring->thread;
+        hdr.numRecords = (uint32_t) (n - skip);
+        hdr.sampled = head;
+        hdr.seen = ring->seen;
+        if (1 != fwrite(&hdr, sizeof(hdr), 1, f) ||
+            (hdr.numRecords && hdr.numRecords != fwrite(copy + skip, sizeof(aj_tracerecord), hdr.numRecords, f))) {
+            status = ER_OS_ERROR;
+        }
+        total += hdr.numRecords;
+    }
+
+    if (0 != fclose(f) && ER_OK == status) {
+        status = ER_OS_ERROR;
+    }
+    if (ER_OK == status && 0 != rename(tmpPath, path)) {
+        status = ER_OS_ERROR;
+    }
+    if (ER_OK != status) {
+        printf("aj_tracer: cannot write %s (%s)\n", path, strerror(errno));
+        remove(tmpPath);
+    } else if (numRecords) {
+        *numRecords = total;
+    }
+
+done:
+    pthread_mutex_unlock(&tracer->lock);
+    free(tmpPath);
+    free(copy);
+    return status;
+}
+
+/*
+ * Signal dumps
+ */
+
+static void dump_signal_handler(int signum)
+{
+    aj_tracer tracer = s_tracer;
+
+    /* sem_post is async-signal-safe; the dump itself is not */
+    if (tracer) {
+        sem_post(&tracer->dumpRequest);
+    }
+}
+
+static void* dump_thread(void* arg)
+{
+    aj_tracer tracer = (aj_tracer) arg;
+
+    for (;;) {
+        uint32_t n = 0;
+
+        if (0 != sem_wait(&tracer->dumpRequest)) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (tracer->stopping) {
+            break;
+        }
+        if (ER_OK == aj_tracer_dump(tracer, tracer->dumpPath, &n)) {
+            printf("aj_tracer: dumped %u records to %s\n", n, tracer->dumpPath);
+        }
+    }
+    return NULL;
+}
+
+static QStatus claim(aj_tracer tracer)
+{
+    if (!__sync_bool_compare_and_swap(&s_tracer, NULL, tracer) && s_tracer != tracer) {
+        printf("aj_tracer: another tracer already takes signal and bus dumps\n");
+        return ER_FAIL;
+    }
+    return ER_OK;
+}
+
+QStatus aj_tracer_dumponsignal(aj_tracer tracer, int signum)
+{
+    struct sigaction action;
+    QStatus status;
+
+    if (tracer->signum) {
+        return ER_FAIL;
+    }
+    status = claim(tracer);
+    if (ER_OK != status) {
+        return status;
+    }
+    if (0 != sem_init(&tracer->dumpRequest, 0, 0)) {
+        return ER_OS_ERROR;
+    }
+    if (0 != pthread_create(&tracer->dumpThread, NULL, dump_thread, tracer)) {
+        sem_destroy(&tracer->dumpRequest);
+        return ER_OS_ERROR;
+    }
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = dump_signal_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (0 != sigaction(signum, &action, &tracer->oldAction)) {
+        tracer->stopping = QCC_TRUE;
+        sem_post(&tracer->dumpRequest);
+        pthread_join(tracer->dumpThread, NULL);
+        sem_destroy(&tracer->dumpRequest);
+        return ER_OS_ERROR;
+    }
+    tracer->signum = signum;
+    return ER_OK;
+}
+
+/*
+ * Bus method dumps
+ */
+
+static void dump_method(alljoyn_busobject busObject, const alljoyn_interfacedescription_member* member,
+                        alljoyn_message msg)
+{
+    aj_tracer tracer = s_tracer;
+    alljoyn_msgarg outArgs;
+    uint32_t n = 0;
+    QStatus status;
+
+    if (!tracer) {
+        alljoyn_busobject_methodreply_status(busObject, msg, ER_BUS_OBJ_NOT_FOUND);
+        return;
+    }
+    status = aj_tracer_dump(tracer, tracer->dumpPath, &n);
+    if (ER_OK != status) {
+        alljoyn_busobject_methodreply_status(busObject, msg, status);
+        return;
+    }
+    outArgs = alljoyn_msgarg_array_create(2);
+    alljoyn_msgarg_set(alljoyn_msgarg_array_element(outArgs, 0), "s", tracer->dumpPath);
+    alljoyn_msgarg_set(alljoyn_msgarg_array_element(outArgs, 1), "u", n);
+    status = alljoyn_busobject_methodreply_args(busObject, msg, outArgs, 2);
+    if (ER_OK != status) {
+        printf("aj_tracer: Dump reply failed (%s)\n", QCC_StatusText(status));
+    }
+    alljoyn_msgarg_destroy(outArgs);
+}
+
+QStatus aj_tracer_register(aj_tracer tracer, alljoyn_busattachment bus, const char* path)
+{
+    alljoyn_busobject_callbacks busObjCbs = { NULL, NULL, NULL, NULL };
+    alljoyn_interfacedescription iface = NULL;
+    alljoyn_interfacedescription_member member;
+    QStatus status;
+
+    if (tracer->busObject) {
+        return ER_FAIL;
+    }
+    status = claim(tracer);
+    if (ER_OK != status) {
+        return status;
+    }
+    iface = alljoyn_busattachment_getinterface(bus, AJ_TRACER_INTERFACE);
+    if (!iface) {
+        status = alljoyn_busattachment_createinterface(bus, AJ_TRACER_INTERFACE, &iface);
+        if (ER_OK == status) {
+            status = alljoyn_interfacedescription_addmember(iface, ALLJOYN_MESSAGE_METHOD_CALL, "Dump", "", "su",
+                                                            "file,records", 0);
+            alljoyn_interfacedescription_activate(iface);
+        }
+    }
+    if (ER_OK == status && !alljoyn_interfacedescription_getmember(iface, "Dump", &member)) {
+        status = ER_BUS_INTERFACE_NO_SUCH_MEMBER;
+    }
+    if (ER_OK != status) {
+        printf("aj_tracer: cannot create interface %s (%s)\n", AJ_TRACER_INTERFACE, QCC_StatusText(status));
+        return status;
+    }
+
+    tracer->busObject = alljoyn_busobject_create(path, QCC_FALSE, &busObjCbs, NULL);
+    status = alljoyn_busobject_addinterface(tracer->busObject, iface);
+    if (ER_OK == status) {
+        status = alljoyn_busobject_addmethodhandler(tracer->busObject, member, &dump_method, NULL);
+    }
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_registerbusobject(bus, tracer->busObject);
+    }
+    if (ER_OK != status) {
+        printf("aj_tracer: cannot register %s (%s)\n", path, QCC_StatusText(status));
+        alljoyn_busobject_destroy(tracer->busObject);
+        tracer->busObject = NULL;
+        return status;
+    }
+    tracer->bus = bus;
+    return ER_OK;
+}
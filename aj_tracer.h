@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @brief Always-on sampling tracer recording compact message metadata into
+ * per-thread rings.
+ *
+ * alljoyn_message_tostring() and alljoyn_message_description() format the
+ * whole message and cost far too much to call on every message. Handlers
+ * instead pass each message they receive to aj_tracer_trace(), which keeps
+ * one in N of them as a fixed-size aj_tracerecord: type, flags, serials,
+ * session id, argument count, receive time, and the sender, destination,
+ * path and member truncated to fixed fields. Each thread writes its own
+ * ring with no lock and no atomic read-modify-write; when a ring is full the
+ * oldest records are overwritten.
+ *
+ * A dump writes every ring to a binary file without stopping the writers:
+ *
+ *   aj_tracefile_header, then for each thread an aj_tracefile_ring followed
+ *   by its records, oldest first.
+ *
+ * Dumps are taken with aj_tracer_dump(), on a signal (aj_tracer_dumponsignal),
+ * or through the Dump method of the AJ_TRACER_INTERFACE bus object
+ * (aj_tracer_register). The last two act on one tracer per process.
+ */
+#ifndef _AJ_TRACER_H
+#define _AJ_TRACER_H
+
+#include <qcc/platform.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/Message.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Interface of the bus object registered by aj_tracer_register(). */
+#define AJ_TRACER_INTERFACE     "com.BandRich.Tracer"
+
+/** First four bytes of a dump. */
+#define AJ_TRACEFILE_MAGIC      "AJTR"
+
+/** Dump format version. */
+#define AJ_TRACEFILE_VERSION    1
+
+/** Tracer handle */
+typedef struct _aj_tracer_handle* aj_tracer;
+
+/** One sampled message, 128 bytes. Strings are NUL-terminated and may be truncated. */
+typedef struct {
+    uint64_t timestamp;         /**< Receive time, CLOCK_MONOTONIC nanoseconds */
+    uint32_t serial;
+    uint32_t replySerial;
+    uint32_t sessionId;
+    uint16_t numArgs;           /**< The body size is not exposed by the C binding; its argument count is */
+    uint8_t type;               /**< alljoyn_messagetype */
+    uint8_t flags;              /**< alljoyn_message_getflags() */
+    char sender[16];
+    char destination[16];
+    char path[40];
+    char member[32];
+} aj_tracerecord;
+
+/** Start of a dump. */
+typedef struct {
+    char magic[4];              /**< AJ_TRACEFILE_MAGIC */
+    uint16_t version;           /**< AJ_TRACEFILE_VERSION */
+    uint16_t recordSize;        /**< sizeof(aj_tracerecord) */
+    uint32_t sampleEvery;
+    uint32_t numRings;
+    uint64_t monotonicNs;       /**< Dump time on the clock of the timestamps... */
+    uint64_t realtimeNs;        /**< ...and on the wall clock, to convert them */
+} aj_tracefile_header;
+
+/** Start of one thread's records in a dump. */
+typedef struct {
+    uint32_t thread;            /**< Order in which the thread first traced */
+    uint32_t numRecords;
+    uint64_t sampled;           /**< Records ever written, including overwritten ones */
+    uint64_t seen;              /**< Messages passed to aj_tracer_trace() */
+} aj_tracefile_ring;
+
+/**
+ * Create a tracer.
+ *
+ * @param sampleEvery  Keep one message in this many; 1 keeps all.
+ * @param ringRecords  Records kept per thread, rounded up to a power of two.
+ * @param dumpPath     File written by signal and bus method dumps.
+ *
+ * @return the tracer, or NULL on failure.
+ */
+aj_tracer aj_tracer_create(uint32_t sampleEvery, uint32_t ringRecords, const char* dumpPath);
+
+/**
+ * Stop signal and bus method dumps, and free the rings. No thread may be
+ * tracing: stop and join the bus whose handlers call aj_tracer_trace() first.
+ * The bus given to aj_tracer_register() must not be destroyed yet.
+ */
+void aj_tracer_destroy(aj_tracer tracer);
+
+/**
+ * Count a received message and record it if it is the one in N. Call from
+ * the handler that received it; lock free.
+ */
+void aj_tracer_trace(aj_tracer tracer, alljoyn_message msg);
+
+/**
+ * Write every ring to @p path, replacing the file atomically. Tracing
+ * continues meanwhile; records overwritten during the copy are left out.
+ *
+ * @param[out] numRecords  Receives the number of records written, or NULL.
+ */
+QStatus aj_tracer_dump(aj_tracer tracer, const char* path, uint32_t* numRecords);
+
+/**
+ * Dump to the tracer's dumpPath whenever the process receives @p signum,
+ * typically SIGUSR1. The dump runs on a thread of the tracer, not in the
+ * signal handler.
+ */
+QStatus aj_tracer_dumponsignal(aj_tracer tracer, int signum);
+
+/**
+ * Register a bus object at @p path implementing AJ_TRACER_INTERFACE, whose
+ * Dump method dumps to the tracer's dumpPath and returns the file name and
+ * the number of records.
+ */
+QStatus aj_tracer_register(aj_tracer tracer, alljoyn_busattachment bus, const char* path);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ * @file
+ * @brief Record bus signals to a capture file for later replay with ajreplay.
+ *
+ * AllJoyn only delivers a signal to a bus attachment that knows its interface,
+ * so the interfaces to record are given as introspection XML files. A handler
+ * is registered for every signal they declare and a match rule makes the
+ * router route all such signals here, whatever their session or sender.
+ *
+ * The router never forwards method calls addressed to other endpoints, so
+ * they cannot be captured from outside. Services record their own incoming
+ * calls instead by calling aj_capwriter_record() from the method handler
+ * (see the -c option of aj_service).
+ *
+ * Usage: ajcap [-o file] [-m rule] iface.xml...
+ */
+#include <qcc/platform.h>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <alljoyn_c/BusAttachment.h>
+
+#include "aj_capfile.h"
+
+static const char* CONNECTSPEC = "unix:abstract=alljoyn";
+
+static volatile sig_atomic_t g_interrupt = QCC_FALSE;
+
+/* The signal handler signature carries no context */
+static aj_capwriter g_writer = NULL;
+
+static void SigIntHandler(int sig)
+{
+    g_interrupt = QCC_TRUE;
+}
+
+static void capture_signal(const alljoyn_interfacedescription_member* member, const char* srcPath, alljoyn_message msg)
+{
+    QStatus status = aj_capwriter_record(g_writer, msg);
+    if (ER_OK != status) {
+        printf("[INFO] Cannot record %s.%s (%s)\n", alljoyn_message_getinterface(msg), member->name, QCC_StatusText(status));
+    }
+}
+
+/* Standard interfaces are handled by the bus attachment itself and cannot be replayed */
+static QCC_BOOL is_standard(const char* name)
+{
+    return strncmp(name, "org.freedesktop.DBus", 20) == 0 || strncmp(name, "org.alljoyn.", 12) == 0;
+}
+
+/* Register capture_signal() for every signal of every application interface */
+static size_t register_handlers(alljoyn_busattachment bus)
+{
+    size_t numIfaces = alljoyn_busattachment_getinterfaces(bus, NULL, 0);
+    alljoyn_interfacedescription* ifaces;
+    size_t numSignals = 0;
+    size_t i;
+
+    ifaces = (alljoyn_interfacedescription*) calloc(numIfaces ? numIfaces : 1, sizeof(*ifaces));
+    if (!ifaces) {
+        return 0;
+    }
+    numIfaces = alljoyn_busattachment_getinterfaces(bus, ifaces, numIfaces);
+    for (i = 0; i < numIfaces; ++i) {
+        size_t numMembers = alljoyn_interfacedescription_getmembers(ifaces[i], NULL, 0);
+        alljoyn_interfacedescription_member* members;
+        size_t m;
+
+        if (is_standard(alljoyn_interfacedescription_getname(ifaces[i])) || !numMembers) {
+            continue;
+        }
+        members = (alljoyn_interfacedescription_member*) calloc(numMembers, sizeof(*members));
+        if (!members) {
+            break;
+        }
+        numMembers = alljoyn_interfacedescription_getmembers(ifaces[i], members, numMembers);
+        for (m = 0; m < numMembers; ++m) {
+            if (members[m].memberType != ALLJOYN_MESSAGE_SIGNAL) {
+                continue;
+            }
+            if (ER_OK == alljoyn_busattachment_registersignalhandler(bus, capture_signal, members[m], NULL)) {
+                printf("[INFO] Capturing %s.%s\n", alljoyn_interfacedescription_getname(ifaces[i]), members[m].name);
+                numSignals++;
+            }
+        }
+        free(members);
+    }
+    free(ifaces);
+    return numSignals;
+}
+
+int main(int argc, char** argv)
+{
+    alljoyn_busattachment bus = NULL;
+    const char* outPath = "capture.ajcap";
+    const char* rule = "type='signal'";
+    size_t numSignals;
+    QStatus status = ER_OK;
+    int i;
+
+    signal(SIGINT, SigIntHandler);
+
+    bus = alljoyn_busattachment_create("ajcap", QCC_TRUE);
+    for (i = 1; i < argc && ER_OK == status; ++i) {
+        if (0 == strcmp(argv[i], "-o") && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (0 == strcmp(argv[i], "-m") && i + 1 < argc) {
+            rule = argv[++i];
+        } else {
+            status = aj_capfile_loadinterfaces(bus, argv[i]);
+        }
+    }
+    if (ER_OK != status) {
+        goto oops;
+    }
+
+    numSignals = register_handlers(bus);
+    if (!numSignals) {
+        printf("Usage: %s [-o file] [-m rule] iface.xml...\n", argv[0]);
+        printf("[INFO] No signals to capture\n");
+        status = ER_BAD_ARG_3;
+        goto oops;
+    }
+
+    g_writer = aj_capwriter_open(outPath);
+    if (!g_writer) {
+        status = ER_OPEN_FAILED;
+        goto oops;
+    }
+
+    status = alljoyn_busattachment_start(bus);
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_connect(bus, CONNECTSPEC);
+    }
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_addmatch(bus, rule);
+    }
+    if (ER_OK != status) {
+        printf("[INFO] Bus setup failed (%s)\n", QCC_StatusText(status));
+        goto oops;
+    }
+    printf("[INFO] Recording %u signals matching \"%s\" to %s\n", (unsigned) numSignals, rule, outPath);
+
+    while (g_interrupt == QCC_FALSE) {
+        usleep(100 * 1000);
+    }
+    printf("[INFO] %u messages recorded\n", aj_capwriter_getcount(g_writer));
+
+oops:
+    if (bus) {
+        alljoyn_busattachment_stop(bus);
+        alljoyn_busattachment_join(bus);
+        alljoyn_busattachment_destroy(bus);
+    }
+    aj_capwriter_close(g_writer);
+    return (ER_OK == status) ? 0 : 1;
+}
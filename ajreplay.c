@@ -0,0 +1,390 @@
+/**
+ * @file
+ * @brief Replay a capture file written by ajcap (or aj_capwriter_record())
+ * against the local router.
+ *
+ * The capture is mapped read-only and bodies are rebuilt as MsgArgs that
+ * point into the mapping, so replay speed is bounded by the bus, not by file
+ * reading. Signals are emitted from bus objects registered at the recorded
+ * paths; method calls are sent to the destination given with -d, with at
+ * most MAX_OUTSTANDING calls in flight. Records are paced by their capture
+ * timestamps divided by the speed factor; speed 0 sends as fast as possible.
+ *
+ * Usage: ajreplay [-s speed] [-d destination] [-n loops] file iface.xml...
+ */
+#include <qcc/platform.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/BusObject.h>
+#include <alljoyn_c/ProxyBusObject.h>
+
+#include "aj_argarena.h"
+#include "aj_capfile.h"
+#include "aj_time.h"
+
+static const char* CONNECTSPEC = "unix:abstract=alljoyn";
+
+#define MAX_OUTSTANDING     64
+#define CALL_TIMEOUT        10000
+
+/* Flags that still mean something when the signal is emitted again */
+#define REPLAY_SIGNAL_FLAGS (ALLJOYN_MESSAGE_FLAG_SESSIONLESS | ALLJOYN_MESSAGE_FLAG_GLOBAL_BROADCAST | \
+                             ALLJOYN_MESSAGE_FLAG_COMPRESSED)
+
+static volatile sig_atomic_t g_interrupt = QCC_FALSE;
+
+static void SigIntHandler(int sig)
+{
+    g_interrupt = QCC_TRUE;
+}
+
+/* One emitting object or one call target per recorded path */
+typedef struct {
+    const char* path;
+    alljoyn_busobject obj;
+    alljoyn_proxybusobject proxy;
+} replay_path;
+
+typedef struct {
+    alljoyn_busattachment bus;
+    const char* destination;
+    double speed;
+
+    replay_path* paths;
+    size_t numPaths;
+    size_t lastPath;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t outstanding;
+    uint32_t callErrors;
+
+    uint32_t signals;
+    uint32_t calls;
+    uint32_t skipped;
+    uint64_t maxLagNs;
+} replay_state;
+
+static replay_path* find_path(replay_state* state, const char* path)
+{
+    size_t i;
+
+    /* Captures tend to repeat the same path, so try the last one first */
+    if (state->lastPath < state->numPaths && 0 == strcmp(state->paths[state->lastPath].path, path)) {
+        return &state->paths[state->lastPath];
+    }
+    for (i = 0; i < state->numPaths; ++i) {
+        if (0 == strcmp(state->paths[i].path, path)) {
+            state->lastPath = i;
+            return &state->paths[i];
+        }
+    }
+    return NULL;
+}
+
+static replay_path* add_path(replay_state* state, const char* path)
+{
+    replay_path* paths = (replay_path*) realloc(state->paths, (state->numPaths + 1) * sizeof(replay_path));
+    if (!paths) {
+        return NULL;
+    }
+    state->paths = paths;
+    memset(&paths[state->numPaths], 0, sizeof(replay_path));
+    paths[state->numPaths].path = path;
+    return &paths[state->numPaths++];
+}
+
+/*
+ * Interfaces cannot be added to a registered object, so the whole capture is
+ * scanned first and every object is created with all interfaces it emitted.
+ */
+static QStatus prepare_paths(replay_state* state, aj_capreader reader)
+{
+    alljoyn_busobject_callbacks busObjCbs = { NULL, NULL, NULL, NULL };
+    aj_caprecord rec;
+    QStatus status;
+    size_t i;
+
+    while (ER_OK == (status = aj_capreader_next(reader, &rec))) {
+        replay_path* p;
+        if (!rec.path[0]) {
+            continue;
+        }
+        p = find_path(state, rec.path);
+        if (!p) {
+            p = add_path(state, rec.path);
+            if (!p) {
+                return ER_OUT_OF_MEMORY;
+            }
+        }
+        if (ALLJOYN_MESSAGE_SIGNAL == rec.type) {
+            alljoyn_interfacedescription iface = alljoyn_busattachment_getinterface(state->bus, rec.iface);
+            if (!iface) {
+                continue;       /* reported when the record is replayed */
+            }
+            if (!p->obj) {
+                p->obj = alljoyn_busobject_create(rec.path, QCC_FALSE, &busObjCbs, NULL);
+            }
+            /* Adding an interface twice fails harmlessly */
+            alljoyn_busobject_addinterface(p->obj, iface);
+        } else if (ALLJOYN_MESSAGE_METHOD_CALL == rec.type && state->destination && !p->proxy) {
+            p->proxy = alljoyn_proxybusobject_create(state->bus, state->destination, rec.path, 0);
+        }
+        if (p->proxy && ALLJOYN_MESSAGE_METHOD_CALL == rec.type) {
+            alljoyn_proxybusobject_addinterface_by_name(p->proxy, rec.iface);
+        }
+    }
+    if (ER_NONE != status) {
+        printf("[INFO] Capture is corrupt, replaying the records before the damage\n");
+    }
+    aj_capreader_rewind(reader);
+
+    for (i = 0; i < state->numPaths; ++i) {
+        if (state->paths[i].obj) {
+            status = alljoyn_busattachment_registerbusobject(state->bus, state->paths[i].obj);
+            if (ER_OK != status) {
+                printf("[INFO] Cannot register object %s (%s)\n", state->paths[i].path, QCC_StatusText(status));
+                return status;
+            }
+        }
+    }
+    return ER_OK;
+}
+
+static void call_reply(alljoyn_message message, void* context)
+{
+    replay_state* state = (replay_state*) context;
+
+    pthread_mutex_lock(&state->lock);
+    if (ALLJOYN_MESSAGE_ERROR == alljoyn_message_gettype(message)) {
+        state->callErrors++;
+    }
+    state->outstanding--;
+    pthread_cond_signal(&state->cond);
+    pthread_mutex_unlock(&state->lock);
+}
+
+static QStatus replay_record(replay_state* state, const aj_caprecord* rec, aj_argarena arena)
+{
+    replay_path* p = rec->path[0] ? find_path(state, rec->path) : NULL;
+    alljoyn_msgarg args;
+    size_t numArgs;
+    QStatus status;
+
+    if (!p || (ALLJOYN_MESSAGE_SIGNAL == rec->type ? !p->obj : !p->proxy)) {
+        return ER_BUS_NO_SUCH_OBJECT;
+    }
+    status = aj_capfile_decodebody(rec, arena, &args, &numArgs);
+    if (ER_OK != status) {
+        return status;
+    }
+
+    if (ALLJOYN_MESSAGE_SIGNAL == rec->type) {
+        alljoyn_interfacedescription iface = alljoyn_busattachment_getinterface(state->bus, rec->iface);
+        alljoyn_interfacedescription_member member;
+        if (!iface || !alljoyn_interfacedescription_getmember(iface, rec->member, &member)) {
+            return ER_BUS_INTERFACE_NO_SUCH_MEMBER;
+        }
+        /* Recorded unique names and session ids are stale, so everything goes out as a broadcast */
+        status = alljoyn_busobject_signal(p->obj, NULL, 0, member,
+                                          args, numArgs, 0, rec->msgFlags & REPLAY_SIGNAL_FLAGS, NULL);
+        if (ER_OK == status) {
+            state->signals++;
+        }
+    } else {
+        pthread_mutex_lock(&state->lock);
+        while (state->outstanding >= MAX_OUTSTANDING) {
+            pthread_cond_wait(&state->cond, &state->lock);
+        }
+        state->outstanding++;
+        pthread_mutex_unlock(&state->lock);
+
+        status = alljoyn_proxybusobject_methodcallasync(p->proxy, rec->iface, rec->member, call_reply,
+                                                        args, numArgs, state, CALL_TIMEOUT, 0);
+        if (ER_OK == status) {
+            state->calls++;
+        } else {
+            pthread_mutex_lock(&state->lock);
+            state->outstanding--;
+            pthread_mutex_unlock(&state->lock);
+        }
+    }
+    return status;
+}
+
+/* Sleep until @p due, in aj_time_now_ns() time */
+static void wait_until(uint64_t due)
+{
+    uint64_t now = aj_time_now_ns();
+    struct timespec ts;
+
+    while (now < due && g_interrupt == QCC_FALSE) {
+        ts.tv_sec = (time_t) ((due - now) / 1000000000ull);
+        ts.tv_nsec = (long) ((due - now) % 1000000000ull);
+        if (nanosleep(&ts, NULL) != 0 && errno != EINTR) {
+            break;
+        }
+        now = aj_time_now_ns();
+    }
+}
+
+static QStatus replay_pass(replay_state* state, aj_capreader reader, aj_argarena arena)
+{
+    uint64_t start = aj_time_now_ns();
+    uint64_t firstTimestamp = 0;
+    QCC_BOOL first = QCC_TRUE;
+    aj_caprecord rec;
+    QStatus status = ER_NONE;   /* what aj_capreader_next() returns at the end of the capture */
+
+    while (g_interrupt == QCC_FALSE && ER_OK == (status = aj_capreader_next(reader, &rec))) {
+        if (ALLJOYN_MESSAGE_SIGNAL != rec.type && ALLJOYN_MESSAGE_METHOD_CALL != rec.type) {
+            continue;
+        }
+        if (first) {
+            firstTimestamp = rec.timestamp;
+            first = QCC_FALSE;
+        }
+        if (state->speed > 0 && rec.timestamp > firstTimestamp) {
+            uint64_t due = start + (uint64_t) ((double) (rec.timestamp - firstTimestamp) / state->speed);
+            uint64_t now;
+            wait_until(due);
+            now = aj_time_now_ns();
+            if (now > due && now - due > state->maxLagNs) {
+                state->maxLagNs = now - due;
+            }
+        }
+
+        status = replay_record(state, &rec, arena);
+        if (ER_OK != status) {
+            if (!state->skipped) {
+                printf("[INFO] Skipping %s.%s on %s (%s)\n", rec.iface, rec.member, rec.path, QCC_StatusText(status));
+            }
+            state->skipped++;
+        }
+        /* Every send marshals before returning, so the args can go */
+        aj_argarena_reset(arena);
+    }
+    aj_capreader_rewind(reader);
+    return g_interrupt ? ER_OK : (ER_NONE == status ? ER_OK : status);
+}
+
+int main(int argc, char** argv)
+{
+    replay_state state;
+    aj_capreader reader = NULL;
+    aj_argarena arena = NULL;
+    const char* capPath = NULL;
+    uint64_t start;
+    double secs;
+    int loops = 1;
+    int loop;
+    size_t i;
+    QStatus status = ER_OK;
+
+    memset(&state, 0, sizeof(state));
+    state.speed = 1.0;
+    pthread_mutex_init(&state.lock, NULL);
+    pthread_cond_init(&state.cond, NULL);
+    signal(SIGINT, SigIntHandler);
+
+    state.bus = alljoyn_busattachment_create("ajreplay", QCC_TRUE);
+    for (i = 1; i < (size_t) argc && ER_OK == status; ++i) {
+        if (0 == strcmp(argv[i], "-s") && i + 1 < (size_t) argc) {
+            state.speed = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "-d") && i + 1 < (size_t) argc) {
+            state.destination = argv[++i];
+        } else if (0 == strcmp(argv[i], "-n") && i + 1 < (size_t) argc) {
+            loops = atoi(argv[++i]);
+        } else if (!capPath) {
+            capPath = argv[i];
+        } else {
+            status = aj_capfile_loadinterfaces(state.bus, argv[i]);
+        }
+    }
+    if (ER_OK != status) {
+        goto oops;
+    }
+    if (!capPath) {
+        printf("Usage: %s [-s speed] [-d destination] [-n loops] file iface.xml...\n", argv[0]);
+        status = ER_BAD_ARG_3;
+        goto oops;
+    }
+
+    reader = aj_capreader_open(capPath);
+    arena = aj_argarena_create(0);
+    if (!reader || !arena) {
+        status = ER_OPEN_FAILED;
+        goto oops;
+    }
+
+    status = alljoyn_busattachment_start(state.bus);
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_connect(state.bus, CONNECTSPEC);
+    }
+    if (ER_OK != status) {
+        printf("[INFO] Bus setup failed (%s)\n", QCC_StatusText(status));
+        goto oops;
+    }
+    status = prepare_paths(&state, reader);
+    if (ER_OK != status) {
+        goto oops;
+    }
+
+    if (state.speed > 0) {
+        printf("[INFO] Replaying %s at %gx\n", capPath, state.speed);
+    } else {
+        printf("[INFO] Replaying %s at full speed\n", capPath);
+    }
+    start = aj_time_now_ns();
+    for (loop = 0; loop < loops && ER_OK == status && g_interrupt == QCC_FALSE; ++loop) {
+        status = replay_pass(&state, reader, arena);
+    }
+
+    /* Let the last calls complete before the bus goes away */
+    pthread_mutex_lock(&state.lock);
+    while (state.outstanding > 0) {
+        pthread_cond_wait(&state.cond, &state.lock);
+    }
+    pthread_mutex_unlock(&state.lock);
+
+    secs = (double) (aj_time_now_ns() - start) / 1e9;
+    printf("[INFO] %u signals, %u calls (%u failed), %u skipped in %.3f s: %.0f msgs/s, max lag %.3f ms\n",
+           state.signals, state.calls, state.callErrors, state.skipped, secs,
+           secs > 0 ? (double) (state.signals + state.calls) / secs : 0.0, (double) state.maxLagNs / 1e6);
+
+oops:
+    if (state.bus) {
+        for (i = 0; i < state.numPaths; ++i) {
+            if (state.paths[i].obj) {
+                alljoyn_busattachment_unregisterbusobject(state.bus, state.paths[i].obj);
+            }
+        }
+        alljoyn_busattachment_stop(state.bus);
+        alljoyn_busattachment_join(state.bus);
+    }
+    for (i = 0; i < state.numPaths; ++i) {
+        if (state.paths[i].proxy) {
+            alljoyn_proxybusobject_destroy(state.paths[i].proxy);
+        }
+        if (state.paths[i].obj) {
+            alljoyn_busobject_destroy(state.paths[i].obj);
+        }
+    }
+    free(state.paths);
+    if (state.bus) {
+        alljoyn_busattachment_destroy(state.bus);
+    }
+    aj_argarena_destroy(arena);
+    aj_capreader_close(reader);
+    pthread_cond_destroy(&state.cond);
+    pthread_mutex_destroy(&state.lock);
+    return (ER_OK == status) ? 0 : 1;
+}
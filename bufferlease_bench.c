@@ -0,0 +1,258 @@
+/**
+ * @file
+ * @brief Benchmark of leased (borrowed) versus copied array arguments.
+ *
+ * A single bus attachment registers a sink object and calls it through its
+ * own unique name with 'ay' and 'ai' payloads from 1 MB to 64 MB. AllJoyn
+ * rejects arrays above 128 KiB, so each payload goes out as CHUNK_SIZE
+ * calls, as aj_client's put does. Each size is sent twice: once built with
+ * alljoyn_msgarg_set_and_stabilize(), which copies every chunk into its
+ * arg, and once bound to a pooled buffer with aj_lease_bind_*(), which does
+ * not. The time to build the args and the time for the calls are summed
+ * over the chunks and reported for both.
+ *
+ * Usage: bufferlease_bench [file]
+ * With a file, its contents are also sent as 'ay' straight from a mapping.
+ */
+#include <qcc/platform.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/BusObject.h>
+#include <alljoyn_c/ProxyBusObject.h>
+
+#include "aj_bufferlease.h"
+#include "aj_time.h"
+
+static const char* INTERFACE_NAME = "com.bandrich.Bus.bench.lease";
+static const char* OBJECT_PATH = "/bench";
+
+#define MAX_PAYLOAD     (64 * 1024 * 1024)
+#define CHUNK_SIZE      (120 * 1024)    /* under ALLJOYN_MAX_ARRAY_LEN, a multiple of 4 for 'ai' */
+#define CALL_TIMEOUT    60000
+
+static void sink_method(alljoyn_busobject bus, const alljoyn_interfacedescription_member* member, alljoyn_message msg)
+{
+    alljoyn_busobject_methodreply_args(bus, msg, NULL, 0);
+}
+
+typedef struct {
+    double buildMs;
+    double callMs;
+} sample;
+
+/* Send @p arg, already built, and add the round trip to @p ms */
+static QStatus send_arg(alljoyn_busattachment bus, alljoyn_proxybusobject proxy, const char* method, alljoyn_msgarg arg, double* ms)
+{
+    alljoyn_message reply = alljoyn_message_create(bus);
+    uint64_t start = aj_time_now_ns();
+    QStatus status = alljoyn_proxybusobject_methodcall(proxy, INTERFACE_NAME, method, arg, 1, reply, CALL_TIMEOUT, 0);
+
+    *ms += (double) (aj_time_now_ns() - start) / 1e6;
+    alljoyn_message_destroy(reply);
+    return status;
+}
+
+static QStatus run_copy(alljoyn_busattachment bus, alljoyn_proxybusobject proxy, QCC_BOOL ints,
+                        const uint8_t* src, size_t bytes, sample* out)
+{
+    size_t offset;
+    QStatus status = ER_OK;
+
+    out->buildMs = out->callMs = 0.0;
+    for (offset = 0; offset < bytes && ER_OK == status; offset += CHUNK_SIZE) {
+        size_t len = bytes - offset < CHUNK_SIZE ? bytes - offset : CHUNK_SIZE;
+        alljoyn_msgarg arg = alljoyn_msgarg_create();
+        uint64_t start = aj_time_now_ns();
+
+        if (ints) {
+            status = alljoyn_msgarg_set_and_stabilize(arg, "ai", len / sizeof(int32_t), (const int32_t*) (src + offset));
+        } else {
+            status = alljoyn_msgarg_set_and_stabilize(arg, "ay", len, src + offset);
+        }
+        out->buildMs += (double) (aj_time_now_ns() - start) / 1e6;
+        if (ER_OK == status) {
+            status = send_arg(bus, proxy, ints ? "PutInts" : "PutBytes", arg, &out->callMs);
+        }
+        alljoyn_msgarg_destroy(arg);
+    }
+    return status;
+}
+
+static QStatus run_lease(alljoyn_busattachment bus, alljoyn_proxybusobject proxy, QCC_BOOL ints,
+                         aj_lease lease, size_t bytes, sample* out)
+{
+    size_t offset;
+    QStatus status = ER_OK;
+
+    out->buildMs = out->callMs = 0.0;
+    for (offset = 0; offset < bytes && ER_OK == status; offset += CHUNK_SIZE) {
+        size_t len = bytes - offset < CHUNK_SIZE ? bytes - offset : CHUNK_SIZE;
+        alljoyn_msgarg arg = alljoyn_msgarg_create();
+        uint64_t start = aj_time_now_ns();
+
+        if (ints) {
+            status = aj_lease_bind_int32(lease, arg, offset, len / sizeof(int32_t));
+        } else {
+            status = aj_lease_bind_uint8(lease, arg, offset, len);
+        }
+        out->buildMs += (double) (aj_time_now_ns() - start) / 1e6;
+        if (ER_OK == status) {
+            status = send_arg(bus, proxy, ints ? "PutInts" : "PutBytes", arg, &out->callMs);
+            aj_lease_unbind(lease, arg, QCC_FALSE);
+        }
+        alljoyn_msgarg_destroy(arg);
+    }
+    return status;
+}
+
+static void print_row(const char* type, size_t bytes, const char* path, const sample* s)
+{
+    double mb = (double) bytes / (1024.0 * 1024.0);
+    printf("%-4s %6.0f MB  %-6s build %9.3f ms  call %9.3f ms  %8.1f MB/s\n",
+           type, mb, path, s->buildMs, s->callMs, s->callMs > 0 ? mb * 1000.0 / (s->buildMs + s->callMs) : 0.0);
+}
+
+/* Best of a few runs so page faults on first touch do not dominate */
+static QStatus measure(alljoyn_busattachment bus, alljoyn_proxybusobject proxy, QCC_BOOL ints, const uint8_t* src,
+                       aj_lease lease, size_t bytes, sample* copy, sample* leased)
+{
+    int runs = bytes <= 4 * 1024 * 1024 ? 5 : 3;
+    QStatus status = ER_OK;
+    int i;
+
+    copy->buildMs = copy->callMs = leased->buildMs = leased->callMs = 1e12;
+    for (i = 0; i < runs && ER_OK == status; ++i) {
+        sample s;
+        status = run_copy(bus, proxy, ints, src, bytes, &s);
+        if (s.buildMs + s.callMs < copy->buildMs + copy->callMs) {
+            *copy = s;
+        }
+        if (ER_OK == status) {
+            status = run_lease(bus, proxy, ints, lease, bytes, &s);
+            if (s.buildMs + s.callMs < leased->buildMs + leased->callMs) {
+                *leased = s;
+            }
+        }
+    }
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    alljoyn_busattachment bus = NULL;
+    alljoyn_interfacedescription intf = NULL;
+    alljoyn_busobject_callbacks busObjCbs = { NULL, NULL, NULL, NULL };
+    alljoyn_interfacedescription_member bytesMember;
+    alljoyn_interfacedescription_member intsMember;
+    alljoyn_busobject_methodentry methodEntries[] = {
+        { &bytesMember, sink_method },
+        { &intsMember, sink_method },
+    };
+    alljoyn_busobject sinkObj = NULL;
+    alljoyn_proxybusobject proxy = NULL;
+    aj_bufpool pool = NULL;
+    uint8_t* src = NULL;
+    size_t bytes;
+    QStatus status;
+
+    bus = alljoyn_busattachment_create("bufferlease_bench", QCC_FALSE);
+    status = alljoyn_busattachment_createinterface(bus, INTERFACE_NAME, &intf);
+    if (ER_OK != status) {
+        printf("[INFO] Failed to create interface (%s)\n", QCC_StatusText(status));
+        goto oops;
+    }
+    alljoyn_interfacedescription_addmember(intf, ALLJOYN_MESSAGE_METHOD_CALL, "PutBytes", "ay", "", "data", 0);
+    alljoyn_interfacedescription_addmember(intf, ALLJOYN_MESSAGE_METHOD_CALL, "PutInts", "ai", "", "data", 0);
+    alljoyn_interfacedescription_activate(intf);
+    alljoyn_interfacedescription_getmember(intf, "PutBytes", &bytesMember);
+    alljoyn_interfacedescription_getmember(intf, "PutInts", &intsMember);
+
+    sinkObj = alljoyn_busobject_create(OBJECT_PATH, QCC_FALSE, &busObjCbs, NULL);
+    alljoyn_busobject_addinterface(sinkObj, intf);
+    alljoyn_busobject_addmethodhandlers(sinkObj, methodEntries, sizeof(methodEntries) / sizeof(methodEntries[0]));
+
+    status = alljoyn_busattachment_start(bus);
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_registerbusobject(bus, sinkObj);
+    }
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_connect(bus, "unix:abstract=alljoyn");
+    }
+    if (ER_OK != status) {
+        printf("[INFO] Bus setup failed (%s)\n", QCC_StatusText(status));
+        goto oops;
+    }
+    proxy = alljoyn_proxybusobject_create(bus, alljoyn_busattachment_getuniquename(bus), OBJECT_PATH, 0);
+    alljoyn_proxybusobject_addinterface(proxy, intf);
+
+    /* The copying path reads from a plain heap buffer, the lease path from a pool buffer */
+    src = (uint8_t*) malloc(MAX_PAYLOAD);
+    pool = aj_bufpool_create(MAX_PAYLOAD, 1);
+    if (!src || !pool) {
+        printf("[INFO] Out of memory\n");
+        goto oops;
+    }
+    {
+        aj_lease lease = aj_bufpool_acquire(pool);
+        size_t i;
+        for (i = 0; i < MAX_PAYLOAD; ++i) {
+            src[i] = (uint8_t) i;
+        }
+        memcpy(aj_lease_data(lease), src, MAX_PAYLOAD);
+
+        for (bytes = 1024 * 1024; bytes <= MAX_PAYLOAD && ER_OK == status; bytes *= 4) {
+            sample copy;
+            sample leased;
+            int t;
+            for (t = 0; t < 2 && ER_OK == status; ++t) {
+                status = measure(bus, proxy, t ? QCC_TRUE : QCC_FALSE, src, lease, bytes, &copy, &leased);
+                if (ER_OK == status) {
+                    print_row(t ? "ai" : "ay", bytes, "copy", &copy);
+                    print_row(t ? "ai" : "ay", bytes, "lease", &leased);
+                }
+            }
+        }
+        aj_lease_release(lease);
+    }
+    if (ER_OK != status) {
+        printf("[INFO] Call failed (%s)\n", QCC_StatusText(status));
+    }
+
+    if (ER_OK == status && argc > 1) {
+        aj_lease file = aj_lease_mapfile(argv[1], 0, 0);
+        if (!file) {
+            printf("[INFO] Cannot map %s\n", argv[1]);
+        } else {
+            sample s;
+            bytes = aj_lease_size(file) < MAX_PAYLOAD ? aj_lease_size(file) : MAX_PAYLOAD;
+            status = run_lease(bus, proxy, QCC_FALSE, file, bytes, &s);
+            if (ER_OK == status) {
+                print_row("ay", bytes, "mmap", &s);
+            }
+            aj_lease_release(file);
+        }
+    }
+
+oops:
+    if (proxy) {
+        alljoyn_proxybusobject_destroy(proxy);
+    }
+    aj_bufpool_destroy(pool);
+    free(src);
+    if (bus) {
+        if (sinkObj) {
+            alljoyn_busattachment_unregisterbusobject(bus, sinkObj);
+        }
+        alljoyn_busattachment_stop(bus);
+        alljoyn_busattachment_join(bus);
+        alljoyn_busattachment_destroy(bus);
+    }
+    if (sinkObj) {
+        alljoyn_busobject_destroy(sinkObj);
+    }
+    return (ER_OK == status) ? 0 : 1;
+}
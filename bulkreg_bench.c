@@ -0,0 +1,204 @@
+/**
+ * @file
+ * @brief Registration rate and memory cost of many bus objects, one by one
+ * against aj_bulkreg.
+ *
+ * For 1,000, 10,000 and 100,000 objects under /hub, each implementing the
+ * same two interfaces, reports objects/s for registering and unregistering
+ * them, and the growth of the resident set per registered object. "naive"
+ * creates, adds the interfaces to and registers each object in turn, the
+ * way a sample registers its one object; "bulk" hands all paths to an
+ * aj_bulkreg. Run one mode per process so the memory figures do not include
+ * heap left over from the other; within a run, each size can still reuse
+ * the heap freed by the smaller one before it. The bus is connected to the
+ * local daemon if there is one, and used unconnected otherwise.
+ *
+ * Usage: bulkreg_bench [naive|bulk] [maxObjects]
+ */
+#include <qcc/platform.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/BusObject.h>
+#include <alljoyn_c/InterfaceDescription.h>
+
+#include "aj_bulkreg.h"
+#include "aj_time.h"
+
+static const char* CONNECTSPEC = "unix:abstract=alljoyn";
+static const char* IFACE_NAMES[] = { "com.BandRich.door", "com.BandRich.sensor" };
+
+#define NUM_IFACES  2
+#define GROUP_SIZE  100
+#define PATH_SIZE   48
+
+/* Resident set in bytes, from /proc/self/statm */
+static uint64_t rss_bytes(void)
+{
+    FILE* f = fopen("/proc/self/statm", "r");
+    unsigned long size = 0;
+    unsigned long resident = 0;
+
+    if (!f) {
+        return 0;
+    }
+    if (2 != fscanf(f, "%lu %lu", &size, &resident)) {
+        resident = 0;
+    }
+    fclose(f);
+    return (uint64_t) resident * (uint64_t) sysconf(_SC_PAGESIZE);
+}
+
+static QStatus create_interfaces(alljoyn_busattachment bus)
+{
+    QStatus status = ER_OK;
+    size_t i;
+
+    for (i = 0; i < NUM_IFACES && ER_OK == status; ++i) {
+        alljoyn_interfacedescription iface = NULL;
+        status = alljoyn_busattachment_createinterface(bus, IFACE_NAMES[i], &iface);
+        if (ER_OK == status) {
+            status = alljoyn_interfacedescription_addsignal(iface, "changed", "i", "state", 0, NULL);
+        }
+        if (ER_OK == status) {
+            status = alljoyn_interfacedescription_addproperty(iface, "State", "i", ALLJOYN_PROP_ACCESS_READ);
+        }
+        if (ER_OK == status) {
+            alljoyn_interfacedescription_activate(iface);
+        }
+    }
+    return status;
+}
+
+static void make_path(char* path, size_t i)
+{
+    snprintf(path, PATH_SIZE, "/hub/g%u/d%u", (unsigned) (i / GROUP_SIZE), (unsigned) (i % GROUP_SIZE));
+}
+
+static QStatus register_naive(alljoyn_busattachment bus, alljoyn_busobject* objects, size_t n)
+{
+    alljoyn_busobject_callbacks busObjCbs = { NULL, NULL, NULL, NULL };
+    QStatus status = ER_OK;
+    char path[PATH_SIZE];
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < n && ER_OK == status; ++i) {
+        make_path(path, i);
+        objects[i] = alljoyn_busobject_create(path, QCC_FALSE, &busObjCbs, NULL);
+        for (j = 0; j < NUM_IFACES && ER_OK == status; ++j) {
+            status = alljoyn_busobject_addinterface(objects[i],
+                                                    alljoyn_busattachment_getinterface(bus, IFACE_NAMES[j]));
+        }
+        if (ER_OK == status) {
+            status = alljoyn_busattachment_registerbusobject(bus, objects[i]);
+        }
+    }
+    return status;
+}
+
+static void unregister_naive(alljoyn_busattachment bus, alljoyn_busobject* objects, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        if (objects[i]) {
+            alljoyn_busattachment_unregisterbusobject(bus, objects[i]);
+            alljoyn_busobject_destroy(objects[i]);
+            objects[i] = NULL;
+        }
+    }
+}
+
+static QStatus register_bulk(alljoyn_busattachment bus, aj_bulkreg* reg, size_t n)
+{
+    QStatus status = ER_OK;
+    char path[PATH_SIZE];
+    size_t i;
+
+    *reg = aj_bulkreg_create(bus, IFACE_NAMES, NUM_IFACES, NULL, NULL);
+    if (!*reg) {
+        return ER_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < n && ER_OK == status; ++i) {
+        make_path(path, i);
+        status = aj_bulkreg_add(*reg, path);
+    }
+    if (ER_OK == status) {
+        status = aj_bulkreg_register(*reg);
+    }
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    static const size_t sizes[] = { 1000, 10000, 100000 };
+    QCC_BOOL bulk = !(argc > 1 && 0 == strcmp(argv[1], "naive"));
+    size_t maxObjects = argc > 2 ? (size_t) atoi(argv[2]) : 100000;
+    alljoyn_busattachment bus = NULL;
+    QStatus status;
+    size_t s;
+
+    bus = alljoyn_busattachment_create("bulkreg_bench", QCC_TRUE);
+    status = create_interfaces(bus);
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_start(bus);
+    }
+    if (ER_OK != status) {
+        printf("[INFO] Cannot start bus (%s)\n", QCC_StatusText(status));
+        goto oops;
+    }
+    if (ER_OK != alljoyn_busattachment_connect(bus, CONNECTSPEC)) {
+        printf("[INFO] No daemon at %s, registering on an unconnected bus\n", CONNECTSPEC);
+    }
+
+    printf("[INFO] Mode %s\n", bulk ? "bulk" : "naive");
+    printf("%8s %14s %16s %14s\n", "objects", "register /s", "unregister /s", "bytes/object");
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && sizes[s] <= maxObjects && ER_OK == status; ++s) {
+        size_t n = sizes[s];
+        alljoyn_busobject* objects = NULL;
+        aj_bulkreg reg = NULL;
+        uint64_t startRss = rss_bytes();
+        uint64_t start = aj_time_now_ns();
+        uint64_t registerNs;
+        uint64_t unregisterNs;
+        int64_t grown;
+
+        if (bulk) {
+            status = register_bulk(bus, &reg, n);
+        } else {
+            objects = (alljoyn_busobject*) calloc(n, sizeof(alljoyn_busobject));
+            status = objects ? register_naive(bus, objects, n) : ER_OUT_OF_MEMORY;
+        }
+        registerNs = aj_time_now_ns() - start;
+        grown = (int64_t) (rss_bytes() - startRss);
+
+        start = aj_time_now_ns();
+        if (bulk) {
+            aj_bulkreg_destroy(reg);
+        } else if (objects) {
+            unregister_naive(bus, objects, n);
+            free(objects);
+        }
+        unregisterNs = aj_time_now_ns() - start;
+
+        if (ER_OK != status) {
+            printf("[INFO] %u objects failed (%s)\n", (unsigned) n, QCC_StatusText(status));
+            break;
+        }
+        printf("%8u %14.0f %16.0f %14.0f\n", (unsigned) n, (double) n * 1e9 / (double) registerNs,
+               (double) n * 1e9 / (double) unregisterNs, (double) grown / (double) n);
+    }
+
+oops:
+    if (bus) {
+        alljoyn_busattachment_stop(bus);
+        alljoyn_busattachment_join(bus);
+        alljoyn_busattachment_destroy(bus);
+    }
+    return (int) status;
+}
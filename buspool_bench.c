@@ -0,0 +1,263 @@
+/**
+ * @file
+ * @brief Throughput benchmark for aj_buspool.
+ *
+ * For each pool size N (1, 2, 4, ... up to the maximum) the benchmark creates
+ * a server pool and a client pool of N attachments on the local daemon.
+ * Every server shard registers an echo object; client shard i calls the
+ * object on server shard i from several threads for a fixed time. The
+ * printed calls per second should grow with N until the daemon or the CPUs
+ * saturate, where a single attachment stays flat.
+ *
+ * Usage: buspool_bench [maxShards] [secondsPerRun] [threadsPerShard]
+ */
+#include <qcc/platform.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/BusObject.h>
+#include <alljoyn_c/ProxyBusObject.h>
+
+#include "aj_buspool.h"
+#include "aj_time.h"
+
+static const char* INTERFACE_NAME = "com.bandrich.Bus.bench.pool";
+static const char* OBJECT_PATH = "/bench";
+static const char* PAYLOAD = "0123456789abcdef0123456789abcdef";
+
+#define MAX_THREADS_PER_SHARD   16
+
+static volatile sig_atomic_t g_interrupt = QCC_FALSE;
+
+static void SigIntHandler(int sig)
+{
+    g_interrupt = QCC_TRUE;
+}
+
+typedef struct {
+    alljoyn_busobject* objects;
+} server_ctx;
+
+typedef struct {
+    aj_buspool servers;
+    alljoyn_proxybusobject* proxies;
+} client_ctx;
+
+typedef struct {
+    alljoyn_busattachment bus;
+    alljoyn_proxybusobject proxy;
+    volatile int* stop;
+    uint64_t calls;
+    uint64_t errors;
+} worker;
+
+static void echo_method(alljoyn_busobject bus, const alljoyn_interfacedescription_member* member, alljoyn_message msg)
+{
+    alljoyn_busobject_methodreply_args(bus, msg, alljoyn_message_getarg(msg, 0), 1);
+}
+
+static QStatus create_interface(alljoyn_busattachment bus)
+{
+    alljoyn_interfacedescription intf = NULL;
+    QStatus status = alljoyn_busattachment_createinterface(bus, INTERFACE_NAME, &intf);
+    if (ER_OK == status) {
+        alljoyn_interfacedescription_addmember(intf, ALLJOYN_MESSAGE_METHOD_CALL, "Echo", "s", "s", "in,out", 0);
+        alljoyn_interfacedescription_activate(intf);
+    }
+    return status;
+}
+
+static QStatus setup_server_shard(void* context, size_t shard, alljoyn_busattachment bus)
+{
+    server_ctx* ctx = (server_ctx*) context;
+    alljoyn_busobject_callbacks busObjCbs = { NULL, NULL, NULL, NULL };
+    alljoyn_interfacedescription_member echo_member;
+    alljoyn_busobject_methodentry methodEntries[] = { { &echo_member, echo_method } };
+    alljoyn_interfacedescription intf;
+    alljoyn_busobject obj;
+    QStatus status;
+
+    status = create_interface(bus);
+    if (ER_OK != status) {
+        return status;
+    }
+    intf = alljoyn_busattachment_getinterface(bus, INTERFACE_NAME);
+    alljoyn_interfacedescription_getmember(intf, "Echo", &echo_member);
+
+    obj = alljoyn_busobject_create(OBJECT_PATH, QCC_FALSE, &busObjCbs, NULL);
+    alljoyn_busobject_addinterface(obj, intf);
+    status = alljoyn_busobject_addmethodhandlers(obj, methodEntries, 1);
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_registerbusobject(bus, obj);
+    }
+    ctx->objects[shard] = obj;
+    return status;
+}
+
+static QStatus setup_client_shard(void* context, size_t shard, alljoyn_busattachment bus)
+{
+    client_ctx* ctx = (client_ctx*) context;
+    const char* server = alljoyn_busattachment_getuniquename(aj_buspool_get(ctx->servers, shard));
+    QStatus status;
+
+    status = create_interface(bus);
+    if (ER_OK != status) {
+        return status;
+    }
+    /* Local daemon, so the server's unique name is reachable without a session */
+    ctx->proxies[shard] = alljoyn_proxybusobject_create(bus, server, OBJECT_PATH, 0);
+    if (!ctx->proxies[shard]) {
+        return ER_OUT_OF_MEMORY;
+    }
+    return alljoyn_proxybusobject_addinterface_by_name(ctx->proxies[shard], INTERFACE_NAME);
+}
+
+static void* worker_run(void* arg)
+{
+    worker* w = (worker*) arg;
+    alljoyn_msgarg in = alljoyn_msgarg_create_and_set("s", PAYLOAD);
+    alljoyn_message reply = alljoyn_message_create(w->bus);
+
+    while (!*w->stop) {
+        QStatus status = alljoyn_proxybusobject_methodcall(w->proxy, INTERFACE_NAME, "Echo", in, 1, reply,
+                                                           ALLJOYN_MESSAGE_DEFAULT_TIMEOUT, 0);
+        if (ER_OK == status) {
+            w->calls++;
+        } else {
+            w->errors++;
+        }
+    }
+    alljoyn_message_destroy(reply);
+    alljoyn_msgarg_destroy(in);
+    return NULL;
+}
+
+/* One measurement; returns calls per second, or a negative value on setup failure */
+static double run(size_t numShards, unsigned seconds, unsigned threadsPerShard)
+{
+    aj_buspool servers = NULL;
+    aj_buspool clients = NULL;
+    server_ctx sctx;
+    client_ctx cctx;
+    worker* workers = NULL;
+    pthread_t* threads = NULL;
+    size_t numWorkers = numShards * threadsPerShard;
+    volatile int stop = 0;
+    uint64_t calls = 0;
+    uint64_t errors = 0;
+    uint64_t start;
+    uint64_t elapsed;
+    double rate = -1.0;
+    size_t i;
+
+    sctx.objects = (alljoyn_busobject*) calloc(numShards, sizeof(alljoyn_busobject));
+    cctx.proxies = (alljoyn_proxybusobject*) calloc(numShards, sizeof(alljoyn_proxybusobject));
+    workers = (worker*) calloc(numWorkers, sizeof(worker));
+    threads = (pthread_t*) calloc(numWorkers, sizeof(pthread_t));
+    if (!sctx.objects || !cctx.proxies || !workers || !threads) {
+        goto oops;
+    }
+
+    servers = aj_buspool_create("buspool_bench_srv", numShards, QCC_FALSE, 0);
+    clients = aj_buspool_create("buspool_bench_cli", numShards, QCC_FALSE, 0);
+    if (!servers || !clients) {
+        printf("[INFO] Failed to create pools of %u\n", (unsigned) numShards);
+        goto oops;
+    }
+    if (ER_OK != aj_buspool_foreach(servers, &setup_server_shard, &sctx) ||
+        ER_OK != aj_buspool_connect(servers, NULL) ||
+        ER_OK != aj_buspool_connect(clients, NULL)) {
+        printf("[INFO] Failed to set up server pool\n");
+        goto oops;
+    }
+    cctx.servers = servers;
+    if (ER_OK != aj_buspool_foreach(clients, &setup_client_shard, &cctx)) {
+        printf("[INFO] Failed to set up client pool\n");
+        goto oops;
+    }
+
+    start = aj_time_now_ms();
+    for (i = 0; i < numWorkers; ++i) {
+        workers[i].bus = aj_buspool_get(clients, i % numShards);
+        workers[i].proxy = cctx.proxies[i % numShards];
+        workers[i].stop = &stop;
+        pthread_create(&threads[i], NULL, &worker_run, &workers[i]);
+    }
+    while (aj_time_now_ms() - start < (uint64_t) seconds * 1000 && g_interrupt == QCC_FALSE) {
+        usleep(50 * 1000);
+    }
+    stop = 1;
+    for (i = 0; i < numWorkers; ++i) {
+        pthread_join(threads[i], NULL);
+        calls += workers[i].calls;
+        errors += workers[i].errors;
+    }
+    elapsed = aj_time_now_ms() - start;
+    rate = elapsed ? (double) calls * 1000.0 / (double) elapsed : 0.0;
+    if (errors) {
+        printf("[INFO] %llu calls failed\n", (unsigned long long) errors);
+    }
+
+oops:
+    for (i = 0; cctx.proxies && i < numShards; ++i) {
+        if (cctx.proxies[i]) {
+            alljoyn_proxybusobject_destroy(cctx.proxies[i]);
+        }
+    }
+    aj_buspool_destroy(clients);
+    for (i = 0; servers && sctx.objects && i < numShards; ++i) {
+        if (sctx.objects[i]) {
+            alljoyn_busattachment_unregisterbusobject(aj_buspool_get(servers, i), sctx.objects[i]);
+        }
+    }
+    aj_buspool_destroy(servers);
+    for (i = 0; sctx.objects && i < numShards; ++i) {
+        if (sctx.objects[i]) {
+            alljoyn_busobject_destroy(sctx.objects[i]);
+        }
+    }
+    free(sctx.objects);
+    free(cctx.proxies);
+    free(workers);
+    free(threads);
+    return rate;
+}
+
+int main(int argc, char** argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t maxShards = (argc > 1) ? (size_t) atoi(argv[1]) : (cpus > 0 ? (size_t) cpus : 1);
+    unsigned seconds = (argc > 2) ? (unsigned) atoi(argv[2]) : 5;
+    unsigned threadsPerShard = (argc > 3) ? (unsigned) atoi(argv[3]) : 4;
+    double base = 0.0;
+    size_t n;
+
+    if (maxShards == 0) {
+        maxShards = 1;
+    }
+    if (threadsPerShard == 0 || threadsPerShard > MAX_THREADS_PER_SHARD) {
+        threadsPerShard = 4;
+    }
+
+    signal(SIGINT, SigIntHandler);
+
+    printf("[INFO] %u s per run, %u threads per shard\n", seconds, threadsPerShard);
+    printf("%8s %14s %9s\n", "shards", "calls/s", "speedup");
+    for (n = 1; n <= maxShards && g_interrupt == QCC_FALSE; n = (n * 2 > maxShards && n < maxShards) ? maxShards : n * 2) {
+        double rate = run(n, seconds, threadsPerShard);
+        if (rate < 0) {
+            return 1;
+        }
+        if (n == 1) {
+            base = rate;
+        }
+        printf("%8u %14.0f %8.2fx\n", (unsigned) n, rate, base > 0 ? rate / base : 0.0);
+    }
+    return 0;
+}
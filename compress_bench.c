@@ -0,0 +1,240 @@
+/**
+ * @file
+ * @brief Bytes on the wire and CPU cost of door_signal with and without
+ * header compression.
+ *
+ * A sender and a receiver attachment connect to the local daemon. The sender
+ * emits door_signal to the receiver's unique name as fast as it can (or at
+ * the given rate), once uncompressed, once always compressed and once with
+ * aj_compresspolicy deciding. Bytes are what this process wrote to its
+ * sockets according to /proc/self/io, so they include the receiver's
+ * (small) traffic; CPU is user plus system time of the whole process.
+ *
+ * Usage: compress_bench [signals] [signalsPerSecond]
+ */
+#include <qcc/platform.h>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/BusObject.h>
+#include <alljoyn_c/Message.h>
+
+#include "aj_compresspolicy.h"
+#include "aj_time.h"
+
+static const char* INTERFACE_NAME = "com.BandRich.signal";
+static const char* OBJECT_PATH = "/door";
+static const char* CONNECTSPEC = "unix:abstract=alljoyn";
+
+#define SIG_NAME        "door_signal"
+#define DRAIN_TIMEOUT_MS 10000
+
+typedef enum {
+    MODE_PLAIN,
+    MODE_COMPRESSED,
+    MODE_POLICY
+} bench_mode;
+
+static volatile sig_atomic_t g_interrupt = QCC_FALSE;
+static volatile uint32_t g_received = 0;
+
+static void SigIntHandler(int sig)
+{
+    g_interrupt = QCC_TRUE;
+}
+
+static void door_signal_handler(const alljoyn_interfacedescription_member* member, const char* srcPath,
+                                alljoyn_message message)
+{
+    __sync_fetch_and_add(&g_received, 1);
+}
+
+/* Bytes this process has passed to write() and send() so far */
+static uint64_t bytes_written(void)
+{
+    FILE* f = fopen("/proc/self/io", "r");
+    char line[128];
+    unsigned long long wchar = 0;
+
+    if (!f) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (1 == sscanf(line, "wchar: %llu", &wchar)) {
+            break;
+        }
+    }
+    fclose(f);
+    return wchar;
+}
+
+static uint64_t cpu_us(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return (uint64_t) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+           (uint64_t) (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+}
+
+static QStatus create_interface(alljoyn_busattachment bus)
+{
+    alljoyn_interfacedescription iface = NULL;
+    QStatus status = alljoyn_busattachment_createinterface(bus, INTERFACE_NAME, &iface);
+    if (ER_OK == status) {
+        status = alljoyn_interfacedescription_addsignal(iface, SIG_NAME, "i", "state", 0, NULL);
+        alljoyn_interfacedescription_activate(iface);
+    }
+    return status;
+}
+
+static QStatus connect_bus(alljoyn_busattachment bus)
+{
+    QStatus status = create_interface(bus);
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_start(bus);
+    }
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_connect(bus, CONNECTSPEC);
+    }
+    return status;
+}
+
+static QStatus run(bench_mode mode, alljoyn_busobject obj, const alljoyn_interfacedescription_member* member,
+                   const char* destination, uint32_t count, uint32_t rate)
+{
+    static const char* names[] = { "plain", "compressed", "policy" };
+    aj_compresspolicy policy = NULL;
+    alljoyn_msgarg arg = alljoyn_msgarg_create();
+    uint64_t startBytes, startCpu, startMs;
+    uint64_t bytes, cpu, elapsedMs;
+    uint32_t sent = 0;
+    QStatus status = ER_OK;
+
+    if (mode == MODE_POLICY) {
+        policy = aj_compresspolicy_create(8, 1000, 0);
+        if (!policy) {
+            status = ER_OUT_OF_MEMORY;
+            goto oops;
+        }
+    }
+    g_received = 0;
+    startBytes = bytes_written();
+    startCpu = cpu_us();
+    startMs = aj_time_now_ms();
+
+    for (sent = 0; sent < count && ER_OK == status && g_interrupt == QCC_FALSE; ++sent) {
+        alljoyn_msgarg_set(arg, "i", (int32_t) (sent & 1));
+        if (mode == MODE_POLICY) {
+            status = aj_compresspolicy_signal(policy, obj, destination, 0, *member, arg, 1, 0, 0, NULL);
+        } else {
+            status = alljoyn_busobject_signal(obj, destination, 0, *member, arg, 1, 0,
+                                              mode == MODE_COMPRESSED ? ALLJOYN_MESSAGE_FLAG_COMPRESSED : 0, NULL);
+        }
+        alljoyn_msgarg_clear(arg);
+        /* Pace against the schedule rather than sleeping a fixed time per signal */
+        if (rate) {
+            uint64_t due = startMs + (uint64_t) (sent + 1) * 1000 / rate;
+            uint64_t now = aj_time_now_ms();
+            if (due > now) {
+                usleep((useconds_t) (due - now) * 1000);
+            }
+        }
+    }
+    if (ER_OK != status) {
+        printf("[INFO] %s: signal failed after %u (%s)\n", names[mode], sent, QCC_StatusText(status));
+        goto oops;
+    }
+    while (g_received < sent && aj_time_now_ms() - startMs < DRAIN_TIMEOUT_MS && g_interrupt == QCC_FALSE) {
+        usleep(1000);
+    }
+    elapsedMs = aj_time_now_ms() - startMs;
+    bytes = bytes_written() - startBytes;
+    cpu = cpu_us() - startCpu;
+
+    printf("%-11s %8u %8u %10.1f %10.2f %10.0f", names[mode], sent, (unsigned) g_received,
+           sent ? (double) bytes / sent : 0.0, sent ? (double) cpu / sent : 0.0,
+           elapsedMs ? (double) g_received * 1000.0 / (double) elapsedMs : 0.0);
+    if (policy) {
+        aj_compresspolicy_stats stats;
+        aj_compresspolicy_getstats(policy, &stats);
+        printf("   %llu compressed, %u rejected", (unsigned long long) stats.compressed, stats.rejected);
+    }
+    printf("\n");
+
+oops:
+    aj_compresspolicy_destroy(policy);
+    alljoyn_msgarg_destroy(arg);
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t count = (argc > 1) ? (uint32_t) atoi(argv[1]) : 20000;
+    uint32_t rate = (argc > 2) ? (uint32_t) atoi(argv[2]) : 0;
+    alljoyn_busattachment sender = alljoyn_busattachment_create("compress_bench_tx", QCC_TRUE);
+    alljoyn_busattachment receiver = alljoyn_busattachment_create("compress_bench_rx", QCC_TRUE);
+    alljoyn_busobject_callbacks busObjCbs = { NULL, NULL, NULL, NULL };
+    alljoyn_busobject obj = NULL;
+    alljoyn_interfacedescription_member member;
+    char rule[128];
+    QStatus status;
+
+    signal(SIGINT, SigIntHandler);
+
+    status = connect_bus(sender);
+    if (ER_OK == status) {
+        status = connect_bus(receiver);
+    }
+    if (ER_OK != status) {
+        printf("[INFO] Cannot connect to %s (%s)\n", CONNECTSPEC, QCC_StatusText(status));
+        goto oops;
+    }
+
+    alljoyn_interfacedescription_getmember(alljoyn_busattachment_getinterface(receiver, INTERFACE_NAME),
+                                           SIG_NAME, &member);
+    status = alljoyn_busattachment_registersignalhandler(receiver, door_signal_handler, member, NULL);
+    snprintf(rule, sizeof(rule), "type='signal',interface='%s',member='%s'", INTERFACE_NAME, SIG_NAME);
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_addmatch(receiver, rule);
+    }
+
+    obj = alljoyn_busobject_create(OBJECT_PATH, QCC_FALSE, &busObjCbs, NULL);
+    if (ER_OK == status) {
+        status = alljoyn_busobject_addinterface(obj, alljoyn_busattachment_getinterface(sender, INTERFACE_NAME));
+    }
+    if (ER_OK == status) {
+        status = alljoyn_busattachment_registerbusobject(sender, obj);
+    }
+    if (ER_OK != status) {
+        printf("[INFO] Setup failed (%s)\n", QCC_StatusText(status));
+        goto oops;
+    }
+    alljoyn_interfacedescription_getmember(alljoyn_busattachment_getinterface(sender, INTERFACE_NAME),
+                                           SIG_NAME, &member);
+
+    printf("[INFO] %u signals, %s\n", count, rate ? "paced" : "unpaced");
+    printf("%-11s %8s %8s %10s %10s %10s\n", "mode", "sent", "recv", "bytes/sig", "cpu us/sig", "recv/s");
+    status = run(MODE_PLAIN, obj, &member, alljoyn_busattachment_getuniquename(receiver), count, rate);
+    if (ER_OK == status) {
+        status = run(MODE_COMPRESSED, obj, &member, alljoyn_busattachment_getuniquename(receiver), count, rate);
+    }
+    if (ER_OK == status) {
+        status = run(MODE_POLICY, obj, &member, alljoyn_busattachment_getuniquename(receiver), count, rate);
+    }
+
+oops:
+    if (obj) {
+        alljoyn_busattachment_unregisterbusobject(sender, obj);
+        alljoyn_busobject_destroy(obj);
+    }
+    alljoyn_busattachment_destroy(receiver);
+    alljoyn_busattachment_destroy(sender);
+    return (ER_OK == status) ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @brief Benchmark of dictionary lookups: alljoyn_msgarg_getdictelement()
+ * against aj_dictindex.
+ *
+ * For a{sv} dictionaries of 10 to 10,000 entries, every key (at most
+ * MAX_PROBES of them) is looked up in random order both ways. The time to
+ * build the index is reported separately, so the number of lookups after
+ * which it pays for itself can be read off directly. No bus is needed.
+ */
+#include <qcc/platform.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alljoyn_c/MsgArg.h>
+
+#include "aj_dictindex.h"
+#include "aj_time.h"
+
+#define MAX_ENTRIES     10000
+#define MAX_PROBES      2000
+#define KEY_SIZE        24
+
+static char s_keys[MAX_ENTRIES][KEY_SIZE];
+
+int main(int argc, char** argv)
+{
+    static const size_t sizes[] = { 10, 100, 1000, 10000 };
+    size_t order[MAX_PROBES];
+    size_t s;
+    QStatus status = ER_OK;
+
+    srand(1);
+    printf("%8s %12s %14s %14s %10s\n", "entries", "build us", "linear ns/op", "index ns/op", "break-even");
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && ER_OK == status; ++s) {
+        size_t n = sizes[s];
+        size_t probes = n < MAX_PROBES ? n : MAX_PROBES;
+        alljoyn_msgarg values = alljoyn_msgarg_array_create(n);
+        alljoyn_msgarg entries = alljoyn_msgarg_array_create(n);
+        alljoyn_msgarg dict = alljoyn_msgarg_create();
+        aj_dictindex index = NULL;
+        double buildUs;
+        double linearNs;
+        double indexNs;
+        uint64_t start;
+        size_t i;
+
+        /* Property-like names sharing a long prefix, as real interfaces tend to */
+        for (i = 0; i < n && ER_OK == status; ++i) {
+            snprintf(s_keys[i], KEY_SIZE, "Property%06u", (unsigned) (i * 7919 % 1000003));
+            status = alljoyn_msgarg_set(alljoyn_msgarg_array_element(values, i), "i", (int32_t) i);
+            if (ER_OK == status) {
+                status = alljoyn_msgarg_set(alljoyn_msgarg_array_element(entries, i), "{sv}", s_keys[i],
+                                            alljoyn_msgarg_array_element(values, i));
+            }
+        }
+        if (ER_OK == status) {
+            status = alljoyn_msgarg_set(dict, "a{sv}", n, entries);
+        }
+        if (ER_OK != status) {
+            printf("[INFO] Cannot build dictionary (%s)\n", QCC_StatusText(status));
+            goto next;
+        }
+        for (i = 0; i < probes; ++i) {
+            order[i] = (size_t) rand() % n;
+        }
+
+        start = aj_time_now_ns();
+        for (i = 0; i < probes && ER_OK == status; ++i) {
+            alljoyn_msgarg v = NULL;
+            status = alljoyn_msgarg_getdictelement(dict, "{sv}", s_keys[order[i]], &v);
+        }
+        linearNs = (double) (aj_time_now_ns() - start) / (double) probes;
+        if (ER_OK != status) {
+            printf("[INFO] getdictelement failed (%s)\n", QCC_StatusText(status));
+            goto next;
+        }
+
+        start = aj_time_now_ns();
+        index = aj_dictindex_create(dict);
+        buildUs = (double) (aj_time_now_ns() - start) / 1e3;
+        if (!index) {
+            printf("[INFO] Cannot index dictionary\n");
+            status = ER_OUT_OF_MEMORY;
+            goto next;
+        }
+
+        start = aj_time_now_ns();
+        for (i = 0; i < probes; ++i) {
+            if (!aj_dictindex_lookup(index, s_keys[order[i]])) {
+                printf("[INFO] Key %s missing from index\n", s_keys[order[i]]);
+                status = ER_FAIL;
+                break;
+            }
+        }
+        indexNs = (double) (aj_time_now_ns() - start) / (double) probes;
+
+        if (ER_OK == status) {
+            double gain = linearNs - indexNs;
+            printf("%8u %12.1f %14.1f %14.1f %10.0f\n", (unsigned) n, buildUs, linearNs, indexNs,
+                   gain > 0 ? buildUs * 1e3 / gain : -1.0);
+        }
+
+    next:
+        aj_dictindex_destroy(index);
+        alljoyn_msgarg_destroy(dict);
+        alljoyn_msgarg_destroy(entries);
+        alljoyn_msgarg_destroy(values);
+    }
+    return (ER_OK == status) ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file
+ * @brief Test of the flap accounting in aj_disccache.
+ *
+ * Feeds found and lost events straight into the cache, the way the AllJoyn
+ * bus listener would, and checks the notifications and counters. Covers a
+ * loss cancelled inside the hold-off, a name that comes back after its
+ * loss was reported but inside the TTL, and a delayed redelivery. No bus is
+ * needed. Exits non-zero if a check fails.
+ */
+#include <qcc/platform.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <alljoyn_c/TransportMask.h>
+
+#include "aj_disccache.h"
+
+#define HOLDOFF_MS      50
+#define TTL_MS          5000
+#define SETTLE_MS       (HOLDOFF_MS * 4)
+#define NAME            "org.alljoyn.Bus.test.flappy"
+
+static volatile uint32_t s_available = 0;
+static volatile uint32_t s_unavailable = 0;
+static int s_failures = 0;
+
+static void name_available(const void* context, const char* name, alljoyn_transportmask transports)
+{
+    __sync_fetch_and_add(&s_available, 1);
+}
+
+static void name_unavailable(const void* context, const char* name)
+{
+    __sync_fetch_and_add(&s_unavailable, 1);
+}
+
+static void settle(void)
+{
+    usleep(SETTLE_MS * 1000);
+}
+
+static void check(const char* what, uint32_t actual, uint32_t expected)
+{
+    if (actual != expected) {
+        printf("[FAIL] %s: %u, expected %u\n", what, actual, expected);
+        s_failures++;
+    } else {
+        printf("[INFO] %s: %u\n", what, actual);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    aj_disccache_callbacks callbacks = { name_available, name_unavailable };
+    aj_disccache_stats stats;
+    aj_disccache cache = aj_disccache_create(&callbacks, NULL, HOLDOFF_MS, TTL_MS);
+
+    if (!cache) {
+        printf("[FAIL] aj_disccache_create\n");
+        return 1;
+    }
+
+    /* First sighting is not a flap */
+    aj_disccache_found_advertised_name(cache, NAME, ALLJOYN_TRANSPORT_TCP, NAME);
+    settle();
+    aj_disccache_getstats(cache, &stats);
+    check("first found: available", s_available, 1);
+    check("first found: flaps", stats.flaps, 0);
+
+    /* Lost and found again inside the hold-off: nothing delivered */
+    aj_disccache_lost_advertised_name(cache, NAME, ALLJOYN_TRANSPORT_TCP, NAME);
+    aj_disccache_found_advertised_name(cache, NAME, ALLJOYN_TRANSPORT_TCP, NAME);
+    settle();
+    aj_disccache_getstats(cache, &stats);
+    check("found inside hold-off: available", s_available, 1);
+    check("found inside hold-off: unavailable", s_unavailable, 0);
+    check("found inside hold-off: flaps", stats.flaps, 1);
+
+    /* Lost for longer than the hold-off: reported, then back inside the TTL */
+    aj_disccache_lost_advertised_name(cache, NAME, ALLJOYN_TRANSPORT_TCP, NAME);
+    settle();
+    check("lost past hold-off: unavailable", s_unavailable, 1);
+    aj_disccache_found_advertised_name(cache, NAME, ALLJOYN_TRANSPORT_TCP, NAME);
+    settle();
+    aj_disccache_getstats(cache, &stats);
+    check("found inside TTL: available", s_available, 2);
+    check("found inside TTL: flaps", stats.flaps, 2);
+    check("found inside TTL: isavailable", aj_disccache_isavailable(cache, NAME, NULL), QCC_TRUE);
+
+    /* Redelivered once the delay has passed, e.g. for a rejoin */
+    aj_disccache_redeliver(cache, NAME, SETTLE_MS * 2);
+    settle();
+    check("redeliver: available before the delay", s_available, 2);
+    settle();
+    settle();
+    check("redeliver: available after the delay", s_available, 3);
+
+    /* A name never seen before is not a flap */
+    aj_disccache_found_advertised_name(cache, NAME ".other", ALLJOYN_TRANSPORT_TCP, NAME);
+    settle();
+    aj_disccache_getstats(cache, &stats);
+    check("other name: flaps", stats.flaps, 2);
+
+    aj_disccache_destroy(cache);
+    printf("[INFO] %s\n", s_failures ? "FAILED" : "PASSED");
+    return s_failures ? 1 : 0;
+}
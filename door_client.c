@@ -38,18 +38,34 @@
 #include <alljoyn_c/Status.h>
 #include <unistd.h>
 
+#include "aj_compresspolicy.h"
+#include "aj_lastvalue.h"
+#include "aj_objmanager.h"
+#include "aj_sharedarg.h"
+#include "aj_stateprop.h"
+
 #define APP_NAME "door_app_cli"
 #define SIG_NAME "door_signal"
 #define SIG_SIGN "i"
+#define STATE_TTL_SECONDS 60
+#define PROP_NAME "State"
+#define STATE_WINDOW_MS 500
 
 /*constants*/
 static const char* INTERFACE_NAME = "com.BandRich.signal";
 static const char* OBJECT_NAME = "com.BandRich.signal";
 static const char* OBJECT_PATH = "/door";
+static const char* MANAGER_PATH = "/";
 static const char* CONNECTSPEC = "unix:abstract=alljoyn";
 static const alljoyn_sessionport SERVICE_PORT = 1024;
 
+/* door_signal goes out every second; compress its header once it has repeated a few times */
+static const uint32_t COMPRESS_AFTER = 3;
+static const uint32_t COMPRESS_IDLE_MS = 5000;
+
 static QCC_BOOL g_found = QCC_FALSE;
+static aj_compresspolicy g_compress = NULL;
+static aj_stateprop g_state = NULL;
 static volatile sig_atomic_t g_interrupt = QCC_FALSE;
 
 static void SigIntHandler(int sig)
@@ -77,6 +93,15 @@ void lost_advertised_name(const void *context, const char *name, alljoyn_transpo
 	}
 }
 
+/* Property Get callback */
+QStatus property_get(const void* context, const char* ifcName, const char* propName, alljoyn_msgarg val)
+{
+	if (g_state && aj_stateprop_matches(g_state, ifcName, propName)) {
+		return aj_stateprop_get(g_state, val);
+	}
+	return ER_BUS_NO_SUCH_PROPERTY;
+}
+
 /* ObjectRegistered callback */
 void busobject_object_registered(const void* context)
 {
@@ -147,6 +172,18 @@ QStatus create_iface(alljoyn_busattachment *bus, alljoyn_interfacedescription *i
 														"state",
 														0,
 														NULL);
+		if (status == ER_OK) {
+			status = alljoyn_interfacedescription_addproperty(*iface,
+															  PROP_NAME,
+															  SIG_SIGN,
+															  ALLJOYN_PROP_ACCESS_READ);
+		}
+		if (status == ER_OK) {
+			status = alljoyn_interfacedescription_addpropertyannotation(*iface,
+																		PROP_NAME,
+																		"org.freedesktop.DBus.Property.EmitsChangedSignal",
+																		"true");
+		}
 		alljoyn_interfacedescription_activate(*iface);
 		printf("Interface Created.\n");
 	} else {
@@ -193,7 +230,7 @@ QStatus bus_object_init(alljoyn_busattachment *bus, alljoyn_busobject *busObject
 {
 	QStatus status = ER_FAIL;
 	alljoyn_busobject_callbacks busObjCbs = {
-		NULL,
+		&property_get,
 		NULL,
 		&busobject_object_registered,
 		NULL
@@ -215,33 +252,44 @@ QStatus bus_object_init(alljoyn_busattachment *bus, alljoyn_busobject *busObject
 	return status;
 }
 
-QStatus emit_signal(alljoyn_busattachment *bus, alljoyn_busobject *bus_object, const int state)
+/* Signal payload for a state, built once and emitted as often as needed */
+aj_sharedarg make_state_arg(const int state)
 {
-	QStatus status;
 	size_t sz = 1;
-	alljoyn_msgarg args;
-	
+	alljoyn_msgarg args = alljoyn_msgarg_array_create(sz);
+
+	if (ER_OK != alljoyn_msgarg_array_set(args, &sz, SIG_SIGN, state)) {
+		alljoyn_msgarg_destroy(args);
+		return NULL;
+	}
+	return aj_sharedarg_adopt(args, sz);
+}
+
+/* Publisher for door_signal; each state supersedes the previous one in the sessionless cache */
+aj_lastvalue publisher_init(alljoyn_busattachment *bus, alljoyn_busobject *bus_object, uint16_t ttl)
+{
+	aj_lastvalue publisher;
 	alljoyn_interfacedescription_member member;
 	alljoyn_interfacedescription interface;
 	interface = alljoyn_busattachment_getinterface(*bus, INTERFACE_NAME);
 	alljoyn_interfacedescription_getmember(interface, SIG_NAME, &member);
-	
-	args = alljoyn_msgarg_array_create(sz);
-	status = alljoyn_msgarg_array_set(args, &sz, SIG_SIGN, state);
 
-	if (ER_OK == status) {
-		status = alljoyn_busobject_signal(*bus_object,
-										  NULL,
-										  0,
-										  member,
-										  args,
-										  sz,
-										  0,
-										  ALLJOYN_MESSAGE_FLAG_SESSIONLESS,
-										  NULL);
-		printf("alljoyn_busobject_signal Fail reason is %s\n", QCC_StatusText(status));
-    }
-	alljoyn_msgarg_destroy(args);
+	publisher = aj_lastvalue_create(*bus_object, &member, ttl);
+	if (publisher) {
+		aj_lastvalue_setcompresspolicy(publisher, g_compress);
+	}
+	return publisher;
+}
+
+QStatus emit_signal(aj_lastvalue publisher, aj_sharedarg state)
+{
+	QStatus status;
+	
+	status = aj_lastvalue_publish(publisher,
+								  aj_sharedarg_getargs(state),
+								  aj_sharedarg_getnumargs(state),
+								  0);
+	printf("alljoyn_busobject_signal Fail reason is %s\n", QCC_StatusText(status));
 	return status;
 }
 
@@ -255,9 +303,23 @@ int main(int argc, char** argv, char** envArg)
 	alljoyn_interfacedescription interface = NULL;
 	alljoyn_buslistener busListener = NULL;
 	alljoyn_busobject bus_object = NULL;
+	aj_sharedarg state_args[2] = { NULL, NULL };
+	aj_lastvalue publisher = NULL;
+	aj_objmanager objects = NULL;
+	uint16_t state_ttl = STATE_TTL_SECONDS;
+	uint32_t state_window = STATE_WINDOW_MS;
+	int i;
 
 	/* Install SIGINT handler */
 	signal(SIGINT, SigIntHandler);
+
+	for (i = 1; i < argc; ++i) {
+		if (0 == strcmp(argv[i], "-t") && i + 1 < argc) {
+			state_ttl = (uint16_t) atoi(argv[++i]);
+		} else if (0 == strcmp(argv[i], "-w") && i + 1 < argc) {
+			state_window = (uint32_t) atoi(argv[++i]);
+		}
+	}
 	
 	printf("AllJoyn Library version: %s\n", alljoyn_getversion());
 	printf("AllJoyn Library build info: %s\n", alljoyn_getbuildinfo());
@@ -302,12 +364,55 @@ int main(int argc, char** argv, char** envArg)
 		printf("[ERROR] Find Advertise Failed\n");
 		goto oops;
 	}
+
+	// both door states are emitted over and over; build their payloads once
+	state_args[0] = make_state_arg(0);
+	state_args[1] = make_state_arg(1);
+	g_compress = aj_compresspolicy_create(COMPRESS_AFTER, COMPRESS_IDLE_MS, 0);
+	if ( !state_args[0] || !state_args[1] || !g_compress ) {
+		printf("[ERROR] State Args Create Failed\n");
+		status = ER_OUT_OF_MEMORY;
+		goto oops;
+	}
+
+	publisher = publisher_init(&aj_bus, &bus_object, state_ttl);
+	if ( !publisher ) {
+		printf("[ERROR] Publisher Create Failed\n");
+		status = ER_FAIL;
+		goto oops;
+	}
+
+	// State property; flapping within the window produces one PropertiesChanged
+	g_state = aj_stateprop_create(bus_object,
+								  INTERFACE_NAME,
+								  PROP_NAME,
+								  alljoyn_msgarg_array_element(aj_sharedarg_getargs(state_args[dummy_state]), 0),
+								  state_window,
+								  0);
+	if ( !g_state ) {
+		printf("[ERROR] State Property Create Failed\n");
+		status = ER_FAIL;
+		goto oops;
+	}
+
+	// GetManagedObjects on MANAGER_PATH reports every object's properties in one call
+	objects = aj_objmanager_create(aj_bus, MANAGER_PATH);
+	if ( !objects ) {
+		printf("[ERROR] Object Manager Create Failed\n");
+		status = ER_FAIL;
+		goto oops;
+	}
+	aj_objmanager_setproperty(objects, OBJECT_PATH, INTERFACE_NAME, PROP_NAME,
+							  alljoyn_msgarg_array_element(aj_sharedarg_getargs(state_args[dummy_state]), 0));
 	
 	/* Wait for join session to complete */
 	while (g_interrupt == QCC_FALSE) {
 		if (g_found == QCC_TRUE) {
 			printf("emit_signal\n");
-			status = emit_signal(&aj_bus, &bus_object, dummy_state);
+			status = emit_signal(publisher, state_args[dummy_state]);
+			aj_stateprop_set(g_state, alljoyn_msgarg_array_element(aj_sharedarg_getargs(state_args[dummy_state]), 0));
+			aj_objmanager_setproperty(objects, OBJECT_PATH, INTERFACE_NAME, PROP_NAME,
+									  alljoyn_msgarg_array_element(aj_sharedarg_getargs(state_args[dummy_state]), 0));
 
 			// the state should be read from arduino (TBD)
 			dummy_state = (dummy_state==0) ? 1 : 0;
@@ -320,6 +425,17 @@ int main(int argc, char** argv, char** envArg)
 	}
 	
 oops:
+	// the door is going away, so its state should not be served to late joiners
+	if (publisher) {
+		aj_lastvalue_withdraw(publisher);
+	}
+	aj_lastvalue_destroy(publisher);
+	aj_objmanager_destroy(objects);
+	aj_stateprop_destroy(g_state);
+	g_state = NULL;
+	aj_compresspolicy_destroy(g_compress);
+	aj_sharedarg_release(state_args[0]);
+	aj_sharedarg_release(state_args[1]);
 	program_uninitialize(&aj_bus,
 						 &busListener,
 						 &bus_object,
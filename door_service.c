@@ -39,9 +39,20 @@
 
 #include <alljoyn_c/MsgArg.h>
 
+#include "aj_sigdesc.h"
+#include "aj_startup.h"
+#include "aj_tracer.h"
+
 #define APP_NAME "door_app_srv"
 #define SIG_NAME "door_signal"
 #define SIG_SIGN "i"
+#define PROP_NAME "State"
+
+/* Trace one received message in TRACE_SAMPLE_EVERY; kill -USR1 or the Dump method writes TRACE_DUMP_PATH */
+#define TRACE_SAMPLE_EVERY 16
+#define TRACE_RING_RECORDS 4096
+#define TRACE_DUMP_PATH "door_service.ajtr"
+#define TRACE_OBJECT_PATH "/tracer"
 
 /*constants*/
 static const char* INTERFACE_NAME = "com.BandRich.signal";
@@ -52,6 +63,24 @@ static const alljoyn_sessionport SERVICE_PORT = 1024;
 static volatile sig_atomic_t g_interrupt = QCC_FALSE;
 static QCC_BOOL g_found = QCC_FALSE;
 
+/* SIG_SIGN, compiled when the signal handler is registered */
+static aj_sigdesc g_doorSig = NULL;
+
+static aj_tracer g_tracer = NULL;
+
+/* Startup timeline; also times the first signal */
+static aj_startup g_startup = NULL;
+
+/* What the startup phases set up, torn down by program_uninitialize() */
+typedef struct {
+	alljoyn_busattachment bus;
+	alljoyn_buslistener busListener;
+	alljoyn_interfacedescription iface;
+	alljoyn_sessionopts opts;
+	alljoyn_sessionportlistener spl;
+	alljoyn_sessionport port;
+} door_state;
+
 static void SigIntHandler(int sig)
 {
     g_interrupt = QCC_TRUE;
@@ -137,6 +166,15 @@ QStatus create_iface(alljoyn_busattachment *bus, alljoyn_interfacedescription *i
 											   "state",
 											   0,
 											   NULL);
+		/* Same definition as the door, so proxies built from it can read State */
+		alljoyn_interfacedescription_addproperty(*iface,
+												 PROP_NAME,
+												 SIG_SIGN,
+												 ALLJOYN_PROP_ACCESS_READ);
+		alljoyn_interfacedescription_addpropertyannotation(*iface,
+														   PROP_NAME,
+														   "org.freedesktop.DBus.Property.EmitsChangedSignal",
+														   "true");
 
         alljoyn_interfacedescription_activate(*iface);
         printf("Interface Created.\n");
@@ -146,9 +184,8 @@ QStatus create_iface(alljoyn_busattachment *bus, alljoyn_interfacedescription *i
 	return status;
 }
 
-QStatus session_create(alljoyn_busattachment *bus, alljoyn_sessionportlistener *sessionPortListener, alljoyn_sessionopts *opts, alljoyn_sessionport sp)
+QStatus session_prepare(alljoyn_sessionportlistener *sessionPortListener, alljoyn_sessionopts *opts)
 {
-	QStatus status;
 	alljoyn_sessionportlistener_callbacks spl_cbs = {
         accept_session_joiner,
         NULL
@@ -157,30 +194,39 @@ QStatus session_create(alljoyn_busattachment *bus, alljoyn_sessionportlistener *
 	/* Create session port listener */
     *sessionPortListener = alljoyn_sessionportlistener_create(&spl_cbs, NULL);
 
-    /* Create session */
+    /* Create session options */
     *opts = alljoyn_sessionopts_create(ALLJOYN_TRAFFIC_TYPE_MESSAGES, QCC_FALSE, ALLJOYN_PROXIMITY_ANY, ALLJOYN_TRANSPORT_ANY);
-    status = alljoyn_busattachment_bindsessionport(*bus, &sp, *opts, *sessionPortListener);
+	return (*sessionPortListener && *opts) ? ER_OK : ER_OUT_OF_MEMORY;
+}
+
+QStatus session_bind(alljoyn_busattachment *bus, alljoyn_sessionportlistener *sessionPortListener, alljoyn_sessionopts *opts, alljoyn_sessionport sp)
+{
+    QStatus status = alljoyn_busattachment_bindsessionport(*bus, &sp, *opts, *sessionPortListener);
     if (ER_OK != status) {
         printf("alljoyn_busattachment_bindsessionport failed (%s)\n", QCC_StatusText(status));
     }
 	return status;
 }
 
-QStatus advertise_name(alljoyn_busattachment *bus, alljoyn_sessionopts *opts)
+QStatus request_name(alljoyn_busattachment *bus)
 {
-	/* Request name */
     uint32_t flags = DBUS_NAME_FLAG_REPLACE_EXISTING | DBUS_NAME_FLAG_DO_NOT_QUEUE;
     QStatus status = alljoyn_busattachment_requestname(*bus, OBJECT_NAME, flags);
-    if (ER_OK == status) {
-		/* Advertise name */
-		status = alljoyn_busattachment_advertisename(*bus, OBJECT_NAME, alljoyn_sessionopts_get_transports(*opts));
-		if (status != ER_OK) {
-			printf("Failed to advertise name %s (%s)\n", OBJECT_NAME, QCC_StatusText(status));
-		}
+    if (ER_OK != status) {
+		printf("Failed to request name %s (%s)\n", OBJECT_NAME, QCC_StatusText(status));
     }
 	return status;
 }
 
+QStatus advertise_name(alljoyn_busattachment *bus, alljoyn_sessionopts *opts)
+{
+	QStatus status = alljoyn_busattachment_advertisename(*bus, OBJECT_NAME, alljoyn_sessionopts_get_transports(*opts));
+	if (status != ER_OK) {
+		printf("Failed to advertise name %s (%s)\n", OBJECT_NAME, QCC_StatusText(status));
+	}
+	return status;
+}
+
 void program_uninitialize(alljoyn_busattachment 		*bus,
 						  alljoyn_buslistener 			*busListener,
 						  alljoyn_busobject 			*bus_object,
@@ -218,6 +264,12 @@ void program_uninitialize(alljoyn_busattachment 		*bus,
 
 void signalHandler(const alljoyn_interfacedescription_member* member, const char* srcPath, alljoyn_message message)
 {
+	if (!g_found && g_startup) {
+		printf("[INFO] First signal %.2f ms after start\n", aj_startup_getelapsedms(g_startup));
+	}
+	if (g_tracer) {
+		aj_tracer_trace(g_tracer, message);
+	}
 	printf("*********Received signal*********\n");
 	
 	const char *interface = alljoyn_message_getinterface(message);
@@ -229,19 +281,13 @@ void signalHandler(const alljoyn_interfacedescription_member* member, const char
         return;
     }
 
-    alljoyn_msgarg inputs;
-    size_t inputs_size = 0;
+    int32_t state = -1;
 
-    alljoyn_message_getargs(message, &inputs_size, &inputs);
-
-    if (inputs_size != 1) {
-        printf("Invalid number of arguments.\n");
+    if (ER_OK != aj_sigdesc_decodemessage(g_doorSig, message, &state)) {
+        printf("Invalid arguments.\n");
         return;
     }
 
-    int state = -1;
-    alljoyn_msgarg_get(alljoyn_msgarg_array_element(inputs, 0), "i", &state);
-
     printf("DOOR : %d\n", state);	
 	g_found = QCC_TRUE;
 }
@@ -257,6 +303,11 @@ QStatus register_signal_handler(alljoyn_busattachment *bus, alljoyn_interfacedes
 		printf("alljoyn_interfacedescription_getmember FAIL\n");
 	}
 
+	g_doorSig = aj_sigdesc_compile(SIG_SIGN);
+	if (!g_doorSig) {
+		return ER_BUS_BAD_SIGNATURE;
+	}
+
     status = alljoyn_busattachment_registersignalhandler(*bus, signalHandler, member, NULL);
 	
     if (ER_OK == status) {
@@ -270,18 +321,81 @@ QStatus register_signal_handler(alljoyn_busattachment *bus, alljoyn_interfacedes
 	return status;
 }
 
+/*
+ * Startup phases. Stage 0 builds everything local while the bus connects;
+ * stage 1 issues the daemon round trips that do not depend on each other at
+ * the same time. Stage 2 advertises, which needs the name requested in
+ * stage 1.
+ */
+static QStatus phase_connect(void* context)
+{
+	door_state* door = (door_state*) context;
+	return bus_connect(&door->bus);
+}
+
+static QStatus phase_build(void* context)
+{
+	door_state* door = (door_state*) context;
+	QStatus status = bus_register(&door->bus, &door->busListener);
+	
+	if (ER_OK == status) {
+		status = create_iface(&door->bus, &door->iface);
+	}
+	if (ER_OK == status) {
+		status = session_prepare(&door->spl, &door->opts);
+	}
+	
+	// message tracer; a failure here only costs the traces
+	g_tracer = aj_tracer_create(TRACE_SAMPLE_EVERY, TRACE_RING_RECORDS, TRACE_DUMP_PATH);
+	if ( !g_tracer || ER_OK != aj_tracer_dumponsignal(g_tracer, SIGUSR1) ) {
+		printf("[INFO] Tracer Dump Setup Failed\n");
+	}
+	return status;
+}
+
+static QStatus phase_signal_handler(void* context)
+{
+	door_state* door = (door_state*) context;
+	return register_signal_handler(&door->bus, &door->iface);
+}
+
+static QStatus phase_bind(void* context)
+{
+	door_state* door = (door_state*) context;
+	return session_bind(&door->bus, &door->spl, &door->opts, door->port);
+}
+
+static QStatus phase_request_name(void* context)
+{
+	door_state* door = (door_state*) context;
+	return request_name(&door->bus);
+}
+
+static QStatus phase_advertise(void* context)
+{
+	door_state* door = (door_state*) context;
+	return advertise_name(&door->bus, &door->opts);
+}
+
+static QStatus phase_tracer(void* context)
+{
+	door_state* door = (door_state*) context;
+	if ( g_tracer && ER_OK != aj_tracer_register(g_tracer, door->bus, TRACE_OBJECT_PATH) ) {
+		printf("[INFO] Tracer Dump Setup Failed\n");
+	}
+	return ER_OK;
+}
+
 /** Main entry point */
 int main(int argc, char** argv, char** envArg)
 {
 	QStatus status = ER_OK;
 	
-	alljoyn_busattachment aj_bus = NULL;
-    alljoyn_interfacedescription interface = NULL;
-	alljoyn_buslistener busListener = NULL;
+	door_state door = { NULL, NULL, NULL, NULL, NULL, SERVICE_PORT };
     alljoyn_busobject bus_object = NULL;
-	alljoyn_sessionopts opts;
-    alljoyn_sessionport session_port = SERVICE_PORT;
-    alljoyn_sessionportlistener session_port_listener = NULL;
+	
+	/* -S runs the startup phases one after another, to compare */
+	QCC_BOOL concurrent = !(argc > 1 && 0 == strcmp(argv[1], "-S"));
 	
 	/* Install SIGINT handler */
     signal(SIGINT, SigIntHandler);
@@ -289,54 +403,31 @@ int main(int argc, char** argv, char** envArg)
 	printf("AllJoyn Library version: %s\n", alljoyn_getversion());
     printf("AllJoyn Library build info: %s\n", alljoyn_getbuildinfo());
 	
-	// create bus
-	status = bus_create(&aj_bus);
-	if ( ER_FAIL == status ) {
-		printf("[ERROR] Bus Create Failed\n");
-		goto oops;
-	}
-	
-#if 1
-	// register bus
-	status = bus_register(&aj_bus, &busListener);
-	if ( ER_FAIL == status ) {
-		printf("[ERROR] Bus Register Failed\n");
-		goto oops;
-	}
-#endif
-	
-	// connect bus
-	status = bus_connect(&aj_bus);
-	if ( ER_FAIL == status ) {
-		printf("[ERROR] Bus Connect Failed\n");
+	g_startup = aj_startup_create(concurrent);
+	if ( !g_startup ) {
+		status = ER_OUT_OF_MEMORY;
 		goto oops;
 	}
 	
-	// create interface
-	status = create_iface(&aj_bus, &interface);
-	if ( ER_FAIL == status ) {
-		printf("[ERROR] Interface Create Failed\n");
-		goto oops;
-	}
-	
-	// register signal handler
-	status = register_signal_handler(&aj_bus, &interface);
-	if ( ER_FAIL == status ) {
-		printf("[ERROR] Register Handler Failed\n");
+	// create bus
+	status = bus_create(&door.bus);
+	if ( ER_OK != status ) {
+		printf("[ERROR] Bus Create Failed\n");
 		goto oops;
 	}
 	
-	// session initialize
-	status = session_create(&aj_bus, &session_port_listener, &opts, session_port);
-	if ( ER_FAIL == status ) {
-		printf("[ERROR] Session Initialize Failed\n");
-		goto oops;
-	}
+	aj_startup_add(g_startup, 0, "connect", phase_connect, &door);
+	aj_startup_add(g_startup, 0, "build", phase_build, &door);
+	aj_startup_add(g_startup, 1, "signal handler", phase_signal_handler, &door);
+	aj_startup_add(g_startup, 1, "bind", phase_bind, &door);
+	aj_startup_add(g_startup, 1, "request name", phase_request_name, &door);
+	aj_startup_add(g_startup, 1, "tracer", phase_tracer, &door);
+	aj_startup_add(g_startup, 2, "advertise", phase_advertise, &door);
 	
-	// advertise name
-	status = advertise_name(&aj_bus, &opts);
-	if ( ER_FAIL == status ) {
-		printf("[ERROR] Advertise Name Failed\n");
+	status = aj_startup_run(g_startup);
+	aj_startup_report(g_startup);
+	if ( ER_OK != status ) {
+		printf("[ERROR] Startup Failed\n");
 		goto oops;
 	}
 	
@@ -352,12 +443,21 @@ int main(int argc, char** argv, char** envArg)
     }
 	
 oops:
-	program_uninitialize(&aj_bus,
-						 &busListener,
+	/* Stop the dispatchers before the tracer goes; signalHandler traces on them */
+	if ( door.bus ) {
+		alljoyn_busattachment_stop(door.bus);
+		alljoyn_busattachment_join(door.bus);
+	}
+	aj_tracer_destroy(g_tracer);
+	g_tracer = NULL;
+	program_uninitialize(&door.bus,
+						 &door.busListener,
 						 &bus_object,
-						 &interface,
-						 &opts,
-						 &session_port_listener);
+						 &door.iface,
+						 &door.opts,
+						 &door.spl);
+	aj_startup_destroy(g_startup);
+	g_startup = NULL;
 
     return (int) status;
 }
@@ -46,7 +46,7 @@ typedef struct _alljoyn_sessionopts_handle*                 alljoyn_sessionopts;
 typedef uint16_t alljoyn_sessionport;
 
 /** Invalid SessionPort value used to indicate that BindSessionPort should choose any available port */
-const alljoyn_sessionport ALLJOYN_SESSION_PORT_ANY = 0;
+static const alljoyn_sessionport ALLJOYN_SESSION_PORT_ANY = 0;
 
 /** SessionId uniquely identifies an AllJoyn session instance */
 typedef uint32_t alljoyn_sessionid;
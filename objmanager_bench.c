@@ -0,0 +1,146 @@
+/**
+ * @file
+ * @brief Benchmark of aj_objmanager snapshots of large object trees.
+ *
+ * For trees of 10 to 10,000 objects under /bench, each with two interfaces
+ * of two properties, reports the time to populate the cache, to take the
+ * whole-tree snapshot, to take a snapshot of one 100-object subtree, and to
+ * take the whole-tree snapshot again after every value has changed. A
+ * snapshot assembles the same a{oa{sa{sv}}} a GetManagedObjects call
+ * replies with, minus the marshalling. The bus is started but not
+ * connected.
+ *
+ * Usage: objmanager_bench [maxObjects]
+ */
+#include <qcc/platform.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/MsgArg.h>
+
+#include "aj_objmanager.h"
+#include "aj_time.h"
+
+#define GROUP_SIZE  100
+#define PATH_SIZE   48
+
+static const char* IFACES[] = { "com.BandRich.door", "com.BandRich.sensor" };
+static const char* PROPS[] = { "State", "Battery" };
+
+static QStatus populate(aj_objmanager om, size_t n, int32_t generation)
+{
+    alljoyn_msgarg value = alljoyn_msgarg_create();
+    QStatus status = ER_OK;
+    char path[PATH_SIZE];
+    size_t i;
+    size_t f;
+    size_t p;
+
+    for (i = 0; i < n && ER_OK == status; ++i) {
+        /* /bench/gN/oM: GROUP_SIZE objects per group, so a group is a 100-object subtree */
+        snprintf(path, sizeof(path), "/bench/g%u/o%u", (unsigned) (i / GROUP_SIZE), (unsigned) (i % GROUP_SIZE));
+        for (f = 0; f < 2 && ER_OK == status; ++f) {
+            for (p = 0; p < 2 && ER_OK == status; ++p) {
+                alljoyn_msgarg_clear(value);
+                status = alljoyn_msgarg_set(value, "i", generation + (int32_t) (i + f + p));
+                if (ER_OK == status) {
+                    status = aj_objmanager_setproperty(om, path, IFACES[f], PROPS[p], value);
+                }
+            }
+        }
+    }
+    alljoyn_msgarg_destroy(value);
+    return status;
+}
+
+static QStatus snapshot(aj_objmanager om, const char* prefix, double* us, size_t* count)
+{
+    alljoyn_msgarg out = alljoyn_msgarg_create();
+    uint64_t start = aj_time_now_ns();
+    QStatus status = aj_objmanager_snapshot(om, prefix, out);
+
+    *us = (double) (aj_time_now_ns() - start) / 1000.0;
+    *count = 0;
+    if (ER_OK == status) {
+        alljoyn_msgarg entries = NULL;
+        status = alljoyn_msgarg_get(out, "a{oa{sa{sv}}}", count, &entries);
+    }
+    alljoyn_msgarg_destroy(out);
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    static const size_t sizes[] = { 10, 100, 1000, 10000 };
+    size_t maxObjects = argc > 1 ? (size_t) atoi(argv[1]) : 10000;
+    alljoyn_busattachment bus = NULL;
+    QStatus status;
+    size_t s;
+
+    bus = alljoyn_busattachment_create("objmanager_bench", QCC_TRUE);
+    status = alljoyn_busattachment_start(bus);
+    if (ER_OK != status) {
+        printf("[INFO] Cannot start bus (%s)\n", QCC_StatusText(status));
+        goto oops;
+    }
+
+    printf("%8s %12s %12s %12s %14s\n", "objects", "populate us", "snapshot us", "subtree us", "resnapshot us");
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && sizes[s] <= maxObjects && ER_OK == status; ++s) {
+        size_t n = sizes[s];
+        aj_objmanager om = aj_objmanager_create(bus, "/bench");
+        double populateUs;
+        double fullUs = 0;
+        double subtreeUs = 0;
+        double againUs = 0;
+        size_t count = 0;
+        uint64_t start;
+
+        if (!om) {
+            status = ER_FAIL;
+            break;
+        }
+        start = aj_time_now_ns();
+        status = populate(om, n, 0);
+        populateUs = (double) (aj_time_now_ns() - start) / 1000.0;
+
+        if (ER_OK == status) {
+            status = snapshot(om, "", &fullUs, &count);
+            if (ER_OK == status && count != n) {
+                printf("[INFO] Snapshot has %u objects, expected %u\n", (unsigned) count, (unsigned) n);
+                status = ER_FAIL;
+            }
+        }
+        if (ER_OK == status) {
+            size_t expected = n < GROUP_SIZE ? n : GROUP_SIZE;
+            status = snapshot(om, "/bench/g0", &subtreeUs, &count);
+            if (ER_OK == status && count != expected) {
+                printf("[INFO] Subtree has %u objects, expected %u\n", (unsigned) count, (unsigned) expected);
+                status = ER_FAIL;
+            }
+        }
+        if (ER_OK == status) {
+            /* Value changes only: the cached args are updated in place */
+            status = populate(om, n, 1);
+        }
+        if (ER_OK == status) {
+            status = snapshot(om, NULL, &againUs, &count);
+        }
+        if (ER_OK == status) {
+            printf("%8u %12.0f %12.0f %12.0f %14.0f\n", (unsigned) n, populateUs, fullUs, subtreeUs, againUs);
+        } else {
+            printf("[INFO] %u objects failed (%s)\n", (unsigned) n, QCC_StatusText(status));
+        }
+        aj_objmanager_destroy(om);
+    }
+
+oops:
+    if (bus) {
+        alljoyn_busattachment_stop(bus);
+        alljoyn_busattachment_join(bus);
+        alljoyn_busattachment_destroy(bus);
+    }
+    return (int) status;
+}
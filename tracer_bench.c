@@ -0,0 +1,148 @@
+/**
+ * @file
+ * @brief Cost of aj_tracer_trace() per message and per sampled message.
+ *
+ * Traces the same message a few million times from one or more threads
+ * with 1-in-1, 1-in-16 and 1-in-64 sampling, then times a dump of the full
+ * rings. The message is the reply to a NameHasOwner call to the local
+ * daemon, so its sender, destination and serials are real; without a
+ * daemon an empty message is traced instead, which makes the string copies
+ * cheaper than they would be.
+ *
+ * Usage: tracer_bench [threads] [messagesPerThread]
+ */
+#include <qcc/platform.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <alljoyn_c/BusAttachment.h>
+#include <alljoyn_c/Message.h>
+#include <alljoyn_c/MsgArg.h>
+#include <alljoyn_c/ProxyBusObject.h>
+
+#include "aj_time.h"
+#include "aj_tracer.h"
+
+static const char* CONNECTSPEC = "unix:abstract=alljoyn";
+static const char* DUMP_PATH = "tracer_bench.ajtr";
+
+#define RING_RECORDS    4096
+#define MAX_THREADS     16
+
+typedef struct {
+    aj_tracer tracer;
+    alljoyn_message msg;
+    uint32_t count;
+    uint64_t elapsedNs;
+} bench_thread;
+
+static void* trace_thread(void* arg)
+{
+    bench_thread* t = (bench_thread*) arg;
+    uint64_t start = aj_time_now_ns();
+    uint32_t i;
+
+    for (i = 0; i < t->count; ++i) {
+        aj_tracer_trace(t->tracer, t->msg);
+    }
+    t->elapsedNs = aj_time_now_ns() - start;
+    return NULL;
+}
+
+/* A reply from the daemon, or an empty message if there is none */
+static alljoyn_message get_message(alljoyn_busattachment bus)
+{
+    alljoyn_message reply = alljoyn_message_create(bus);
+    alljoyn_msgarg arg = alljoyn_msgarg_create_and_set("s", "org.freedesktop.DBus");
+    QStatus status = alljoyn_busattachment_connect(bus, CONNECTSPEC);
+
+    if (ER_OK == status) {
+        status = alljoyn_proxybusobject_methodcall(alljoyn_busattachment_getdbusproxyobj(bus), "org.freedesktop.DBus",
+                                                   "NameHasOwner", arg, 1, reply, 5000, 0);
+    }
+    if (ER_OK != status) {
+        printf("[INFO] No reply from a daemon (%s), tracing an empty message\n", QCC_StatusText(status));
+        alljoyn_message_destroy(reply);
+        reply = alljoyn_message_create(bus);
+    }
+    alljoyn_msgarg_destroy(arg);
+    return reply;
+}
+
+int main(int argc, char** argv)
+{
+    static const uint32_t rates[] = { 1, 16, 64 };
+    uint32_t numThreads = argc > 1 ? (uint32_t) atoi(argv[1]) : 1;
+    uint32_t count = argc > 2 ? (uint32_t) atoi(argv[2]) : 4000000;
+    bench_thread threads[MAX_THREADS];
+    pthread_t ids[MAX_THREADS];
+    alljoyn_busattachment bus = NULL;
+    alljoyn_message msg = NULL;
+    QStatus status = ER_OK;
+    size_t r;
+    uint32_t i;
+
+    if (numThreads < 1 || numThreads > MAX_THREADS) {
+        printf("[INFO] threads must be 1..%d\n", MAX_THREADS);
+        return 1;
+    }
+    bus = alljoyn_busattachment_create("tracer_bench", QCC_TRUE);
+    status = alljoyn_busattachment_start(bus);
+    if (ER_OK != status) {
+        printf("[INFO] Cannot start bus (%s)\n", QCC_StatusText(status));
+        goto oops;
+    }
+    msg = get_message(bus);
+
+    printf("%8s %8s %10s %12s %14s %10s\n", "threads", "1-in-N", "messages", "ns/message", "ns/sampled", "dump us");
+    for (r = 0; r < sizeof(rates) / sizeof(rates[0]) && ER_OK == status; ++r) {
+        aj_tracer tracer = aj_tracer_create(rates[r], RING_RECORDS, DUMP_PATH);
+        uint64_t elapsedNs = 0;
+        uint64_t start;
+        uint32_t records = 0;
+        double dumpUs;
+
+        if (!tracer) {
+            status = ER_OUT_OF_MEMORY;
+            break;
+        }
+        for (i = 0; i < numThreads; ++i) {
+            threads[i].tracer = tracer;
+            threads[i].msg = msg;
+            threads[i].count = count;
+            pthread_create(&ids[i], NULL, trace_thread, &threads[i]);
+        }
+        for (i = 0; i < numThreads; ++i) {
+            pthread_join(ids[i], NULL);
+            elapsedNs += threads[i].elapsedNs;
+        }
+
+        start = aj_time_now_ns();
+        status = aj_tracer_dump(tracer, DUMP_PATH, &records);
+        dumpUs = (double) (aj_time_now_ns() - start) / 1000.0;
+        aj_tracer_destroy(tracer);
+        if (ER_OK != status) {
+            printf("[INFO] Dump failed (%s)\n", QCC_StatusText(status));
+            break;
+        }
+
+        /* Per-thread time, so contention would show up as a higher figure */
+        printf("%8u %8u %10u %12.1f %14.1f %10.0f\n", numThreads, rates[r], count,
+               (double) elapsedNs / ((double) count * numThreads),
+               (double) elapsedNs * rates[r] / ((double) count * numThreads), dumpUs);
+    }
+    remove(DUMP_PATH);
+
+oops:
+    if (msg) {
+        alljoyn_message_destroy(msg);
+    }
+    if (bus) {
+        alljoyn_busattachment_stop(bus);
+        alljoyn_busattachment_join(bus);
+        alljoyn_busattachment_destroy(bus);
+    }
+    return (int) status;
+}